@@ -0,0 +1,553 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file benchmark.c
+ *
+ * \brief
+ * OSD rendering benchmark. Measures pixel kernel throughput for every kernel variant,
+ * times every graphics controller draw function on the software framebuffer backend
+ * at common screen resolutions and OSD surface formats and dumps rendered frames.
+ * Event reactor notification latency is measured between a posting thread and the loop
+ * and the cost of one trace point is measured from one and from several threads.
+ * OSD removal timeouts are run on the simulated clock to show the scripted test speedup.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "graphics_controller.h"
+#include "software_framebuffer.h"
+#include "osd_kernels.h"
+#include "timer_controller.h"
+#include "event_reactor.h"
+#include "trace.h"
+#include "virtual_clock.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* helper keywords needed only for benchmark module */
+#define DEFAULT_ITERATIONS 20
+#define DEFAULT_OUTPUT_DIRECTORY "."
+
+#define KERNEL_PIXELS (1920 * 1080)
+#define KERNEL_REPETITIONS 50
+
+#define REACTOR_NOTIFICATIONS 10000
+
+#define TRACE_POINTS 1000000
+#define TRACE_THREADS 4
+
+#define OSD_TIMEOUT_CYCLES 200
+#define OSD_LONGEST_TIMEOUT_MS 4000 // channel info banner
+
+#define SHOW_NAME "Dnevnik"
+#define SHOW_DESCRIPTION "Informativni program s najnovijim vijestima iz zemlje i svijeta, sportom, vremenskom prognozom i pregledom dogadjaja dana."
+
+typedef struct _resolution
+{
+    const char *name;
+    int width;
+    int height;
+} resolution;
+
+typedef enum _kernelType
+{
+    KERNEL_FILL = 0,
+    KERNEL_COPY,
+    KERNEL_BLEND,
+    KERNEL_BLIT_GLYPH,
+    KERNEL_TYPE_COUNT
+} kernelType;
+
+typedef struct _benchmarkResult
+{
+    double minUs;
+    double maxUs;
+    double totalUs;
+} benchmarkResult;
+
+/* helper variables needed only for benchmark module */
+static const resolution resolutions[] = {
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"2160p", 3840, 2160}};
+
+static const char *pixelFormatNames[GRAPHICS_PIXELFORMAT_COUNT] = {"ARGB", "ARGB4444", "LUT8"};
+
+/* bytes per pixel of each OSD surface format */
+static const uint32_t pixelFormatBytes[GRAPHICS_PIXELFORMAT_COUNT] = {4, 2, 1};
+
+static const char *kernelNames[KERNEL_TYPE_COUNT] = {"fill", "copy", "blend", "blitGlyph"};
+
+/* bytes read and written per pixel by each kernel */
+static const uint32_t kernelBytesPerPixel[KERNEL_TYPE_COUNT] = {4, 8, 12, 9};
+
+static int iterations = DEFAULT_ITERATIONS;
+
+/* reactor benchmark, posting thread waits for every notification to be handled */
+static pthread_mutex_t reactorMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reactorCondition = PTHREAD_COND_INITIALIZER;
+static uint32_t reactorHandled;
+static int32_t reactorNotification;
+
+/* simulated clock benchmark, set by a timer expiring right after the OSD removal timers */
+static volatile uint8_t osdTimeoutsDone;
+static const char *outputDirectory = DEFAULT_OUTPUT_DIRECTORY;
+
+/* helper functions needed only for benchmark module */
+static double nowUs();
+static graphicsControllerStatus benchChannelNumber(int iteration);
+static graphicsControllerStatus benchChannelNumberMessage(int iteration);
+static graphicsControllerStatus benchChannelInfo(int iteration);
+static graphicsControllerStatus benchVolumeInfo(int iteration);
+static graphicsControllerStatus benchMenuInfoNow(int iteration);
+static graphicsControllerStatus benchMenuInfoNext(int iteration);
+static graphicsControllerStatus benchMenuInfoRender(int iteration);
+static graphicsControllerStatus benchClearScreen(int iteration);
+static void runDrawBenchmark(const resolution *mode, graphicsPixelFormat format, const char *name, graphicsControllerStatus (*draw)(int iteration));
+static void runKernelBenchmark();
+static void runReactorBenchmark();
+static void runTraceBenchmark();
+static void runOsdTimeoutBenchmark();
+
+int main(int argc, char **argv)
+{
+    uint32_t i;
+    int32_t format;
+
+    if (argc > 1)
+        iterations = atoi(argv[1]);
+    if (argc > 2)
+        outputDirectory = argv[2];
+
+    if (iterations < 1)
+    {
+        printf("Usage: %s [iterations] [output directory]\n", argv[0]);
+        return 1;
+    }
+
+    runKernelBenchmark();
+    runReactorBenchmark();
+    runTraceBenchmark();
+    osdKernelsInit();
+
+    if (timerControllerInit(TIMER_CONTROLLER_OWN_THREAD) != TIMER_CONTROLLER_NO_ERROR)
+    {
+        printf("timerControllerInit failed\n");
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(resolutions) / sizeof(resolutions[0]); i++)
+    {
+        printf("\n%-8s %-9s %-26s %10s %10s %10s\n", "mode", "format", "function", "min [us]", "avg [us]", "max [us]");
+
+        for (format = GRAPHICS_PIXELFORMAT_ARGB; format < GRAPHICS_PIXELFORMAT_COUNT; format++)
+        {
+            softwareFramebufferSetMode(resolutions[i].width, resolutions[i].height);
+            graphicsControllerSetPixelFormat(format);
+            if (graphicsControllerInit() != GRAPHICS_CONTROLLER_NO_ERROR)
+            {
+                printf("graphicsControllerInit failed at %s %s\n", resolutions[i].name, pixelFormatNames[format]);
+                return 1;
+            }
+
+            runDrawBenchmark(&resolutions[i], format, "clearScreen", benchClearScreen);
+            runDrawBenchmark(&resolutions[i], format, "drawChannelNumber", benchChannelNumber);
+            runDrawBenchmark(&resolutions[i], format, "drawChannelNumberMessage", benchChannelNumberMessage);
+            runDrawBenchmark(&resolutions[i], format, "drawChannelInfo", benchChannelInfo);
+            runDrawBenchmark(&resolutions[i], format, "drawVolumeInfo", benchVolumeInfo);
+            runDrawBenchmark(&resolutions[i], format, "drawMenuInfo_now", benchMenuInfoNow);
+            runDrawBenchmark(&resolutions[i], format, "drawMenuInfo_next", benchMenuInfoNext);
+            runDrawBenchmark(&resolutions[i], format, "drawMenuInfo_render", benchMenuInfoRender);
+
+            /* primary surface is double buffered, each menu page is one more screen sized surface */
+            printf("%-8s %-9s %-26s %10.1f MiB\n", resolutions[i].name, pixelFormatNames[format], "surface memory",
+                   (double)resolutions[i].width * resolutions[i].height * pixelFormatBytes[format] * 4 / (1024 * 1024));
+
+            /* drawing the channel number stops every pending removal timer before the surface goes away */
+            drawChannelNumber(1);
+            graphicsControllerDeinit();
+        }
+    }
+
+    timerControllerDeinit();
+
+    runOsdTimeoutBenchmark();
+
+    return 0;
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for reading monotonic time.
+ *
+ * @return   Current monotonic time in microseconds.
+****************************************************************************/
+static double nowUs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+/* draw function wrappers with a common signature, iteration number varies the drawn values */
+static graphicsControllerStatus benchChannelNumber(int iteration)
+{
+    return drawChannelNumber(iteration % 1000);
+}
+
+static graphicsControllerStatus benchChannelNumberMessage(int iteration)
+{
+    return drawChannelNumberMessage(iteration % 1000);
+}
+
+static graphicsControllerStatus benchChannelInfo(int iteration)
+{
+    return drawChannelInfo(iteration % 1000 + 1, 2, "hrveng");
+}
+
+static graphicsControllerStatus benchVolumeInfo(int iteration)
+{
+    return drawVolumeInfo((iteration % 21) * 0.05);
+}
+
+static graphicsControllerStatus benchMenuInfoNow(int iteration)
+{
+    return drawMenuInfo(0x193000, 0x003000, SHOW_NAME, SHOW_DESCRIPTION,
+                        0x200000, 0x013000, SHOW_NAME, SHOW_DESCRIPTION, 1);
+}
+
+static graphicsControllerStatus benchMenuInfoNext(int iteration)
+{
+    return drawMenuInfo(0x193000, 0x003000, SHOW_NAME, SHOW_DESCRIPTION,
+                        0x200000, 0x013000, SHOW_NAME, SHOW_DESCRIPTION, 2);
+}
+
+/* menu pages are rendered again on every iteration, as after an EIT update or channel change */
+static graphicsControllerStatus benchMenuInfoRender(int iteration)
+{
+    invalidateMenuInfo();
+    return drawMenuInfo(0x193000, 0x003000, SHOW_NAME, SHOW_DESCRIPTION,
+                        0x200000, 0x013000, SHOW_NAME, SHOW_DESCRIPTION, 1 + iteration % 2);
+}
+
+static graphicsControllerStatus benchClearScreen(int iteration)
+{
+    return clearScreen(COLOUR_BLACK);
+}
+
+/****************************************************************************
+ * @brief    Function for timing one draw function and dumping its last frame.
+ *
+ * @param    mode - [in] Screen resolution the primary surface was created with.
+ *           format - [in] OSD surface format the primary surface was created with.
+ *           name - [in] Benchmarked function name.
+ *           draw - [in] Function drawing one frame.
+****************************************************************************/
+static void runDrawBenchmark(const resolution *mode, graphicsPixelFormat format, const char *name, graphicsControllerStatus (*draw)(int iteration))
+{
+    benchmarkResult result = {1e12, 0, 0};
+    char fileName[256];
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        double start = nowUs();
+
+        if (draw(i) != GRAPHICS_CONTROLLER_NO_ERROR)
+        {
+            printf("%-8s %-9s %-26s failed\n", mode->name, pixelFormatNames[format], name);
+            return;
+        }
+        drawOnScreen();
+
+        double elapsed = nowUs() - start;
+        result.totalUs += elapsed;
+        if (elapsed < result.minUs)
+            result.minUs = elapsed;
+        if (elapsed > result.maxUs)
+            result.maxUs = elapsed;
+    }
+
+    printf("%-8s %-9s %-26s %10.1f %10.1f %10.1f\n", mode->name, pixelFormatNames[format], name, result.minUs, result.totalUs / iterations, result.maxUs);
+
+    snprintf(fileName, sizeof(fileName), "%s/%s_%s_%s.png", outputDirectory, name, mode->name, pixelFormatNames[format]);
+    softwareFramebufferDumpPNG(fileName);
+}
+
+/****************************************************************************
+ * @brief    Function for measuring throughput of every kernel variant on a full HD buffer.
+****************************************************************************/
+static void runKernelBenchmark()
+{
+    uint32_t *destination = (uint32_t *)malloc(KERNEL_PIXELS * sizeof(uint32_t));
+    uint32_t *source = (uint32_t *)malloc(KERNEL_PIXELS * sizeof(uint32_t));
+    uint8_t *coverage = (uint8_t *)malloc(KERNEL_PIXELS);
+    double scalarSpeed[KERNEL_TYPE_COUNT] = {0};
+    int32_t variant;
+    int32_t kernel;
+    uint32_t i;
+
+    if (!destination || !source || !coverage)
+    {
+        printf("Kernel benchmark allocation failed\n");
+        free(destination);
+        free(source);
+        free(coverage);
+        return;
+    }
+
+    /* translucent source and glyph-like coverage with empty, opaque and anti-aliased pixels */
+    for (i = 0; i < KERNEL_PIXELS; i++)
+    {
+        destination[i] = 0xff383838;
+        source[i] = (i & 1) ? 0x80523200 : 0x00000000;
+        coverage[i] = (i % 7 < 3) ? 0 : (i % 7 == 3) ? 0xff : (uint8_t)(i * 37);
+    }
+
+    printf("%-8s %-10s %10s %10s\n", "variant", "kernel", "GB/s", "speedup");
+
+    for (variant = OSD_KERNELS_SCALAR; variant < OSD_KERNELS_VARIANT_COUNT; variant++)
+    {
+        if (osdKernelsSelect(variant) != OSD_KERNELS_NO_ERROR)
+            continue;
+
+        for (kernel = KERNEL_FILL; kernel < KERNEL_TYPE_COUNT; kernel++)
+        {
+            double start = nowUs();
+
+            for (i = 0; i < KERNEL_REPETITIONS; i++)
+            {
+                switch (kernel)
+                {
+                case KERNEL_FILL:
+                    osdFill(destination, KERNEL_PIXELS, 0xffffa500);
+                    break;
+
+                case KERNEL_COPY:
+                    osdCopy(destination, source, KERNEL_PIXELS);
+                    break;
+
+                case KERNEL_BLEND:
+                    osdBlend(destination, source, KERNEL_PIXELS);
+                    break;
+
+                case KERNEL_BLIT_GLYPH:
+                    osdBlitGlyph(destination, coverage, KERNEL_PIXELS, 0xffffa500);
+                    break;
+                }
+            }
+
+            double seconds = (nowUs() - start) / 1e6;
+            double speed = (double)KERNEL_PIXELS * KERNEL_REPETITIONS * kernelBytesPerPixel[kernel] / seconds / 1e9;
+
+            if (variant == OSD_KERNELS_SCALAR)
+                scalarSpeed[kernel] = speed;
+
+            printf("%-8s %-10s %10.2f %9.2fx\n", osdKernelsName(variant), kernelNames[kernel], speed, speed / scalarSpeed[kernel]);
+        }
+    }
+
+    free(destination);
+    free(source);
+    free(coverage);
+}
+/****************************************************************************
+ * @brief    Reactor benchmark notification handler, acknowledges the post.
+****************************************************************************/
+static void reactorBenchmarkHandler(int32_t fileDesc, uint32_t events, void *context)
+{
+    pthread_mutex_lock(&reactorMutex);
+    reactorHandled++;
+    pthread_cond_signal(&reactorCondition);
+    pthread_mutex_unlock(&reactorMutex);
+
+    if (reactorHandled == REACTOR_NOTIFICATIONS)
+    {
+        eventReactorStop();
+    }
+}
+
+/****************************************************************************
+ * @brief    Reactor benchmark posting thread, posts the next notification after the previous one is handled.
+****************************************************************************/
+static void *reactorBenchmarkPoster()
+{
+    uint32_t i;
+
+    for (i = 0; i < REACTOR_NOTIFICATIONS; i++)
+    {
+        eventReactorNotify(reactorNotification);
+
+        pthread_mutex_lock(&reactorMutex);
+        while (reactorHandled <= i)
+        {
+            pthread_cond_wait(&reactorCondition, &reactorMutex);
+        }
+        pthread_mutex_unlock(&reactorMutex);
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for measuring post to dispatch latency of event reactor notifications,
+ *           as seen by demux sections handed from the SDK thread to the event loop.
+****************************************************************************/
+static void runReactorBenchmark()
+{
+    pthread_t posterThread;
+
+    if (eventReactorInit() != EVENT_REACTOR_NO_ERROR ||
+        eventReactorAddNotification("benchmark", reactorBenchmarkHandler, NULL, &reactorNotification) != EVENT_REACTOR_NO_ERROR)
+    {
+        printf("eventReactorInit failed\n");
+        return;
+    }
+
+    reactorHandled = 0;
+    if (pthread_create(&posterThread, NULL, reactorBenchmarkPoster, NULL))
+    {
+        eventReactorDeinit();
+        return;
+    }
+
+    eventReactorRun();
+    pthread_join(posterThread, NULL);
+
+    eventReactorPrintStatistics();
+    eventReactorDeinit();
+}
+
+/****************************************************************************
+ * @brief    Trace benchmark thread, records begin/end pairs.
+ *
+ * @param    result - [out] Pointer to double receiving nanoseconds per trace point.
+****************************************************************************/
+static void *traceBenchmarkThread(void *result)
+{
+    double start = nowUs();
+    uint32_t i;
+
+    for (i = 0; i < TRACE_POINTS / 2; i++)
+    {
+        traceRecord(TRACE_PHASE_BEGIN, "benchmark span", 0);
+        traceRecord(TRACE_PHASE_END, "benchmark span", 0);
+    }
+
+    *(double *)result = (nowUs() - start) * 1000.0 / TRACE_POINTS;
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for measuring the cost of one trace point and of the dump.
+ *           Trace points are called directly, so the cost is measured even if the build has them compiled out.
+****************************************************************************/
+static void runTraceBenchmark()
+{
+    pthread_t threads[TRACE_THREADS];
+    double results[TRACE_THREADS];
+    char fileName[256];
+    double start;
+    double total = 0;
+    uint32_t i;
+
+    printf("\n%-26s %10s\n", "trace points", "[ns/point]");
+
+    traceBenchmarkThread(&results[0]);
+    printf("%-26s %10.1f\n", "1 thread", results[0]);
+
+    for (i = 0; i < TRACE_THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, traceBenchmarkThread, &results[i]);
+    }
+    for (i = 0; i < TRACE_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+        total += results[i];
+    }
+    printf("%d threads %16s %10.1f\n", TRACE_THREADS, "", total / TRACE_THREADS);
+
+    snprintf(fileName, sizeof(fileName), "%s/benchmark_trace.json", outputDirectory);
+    start = nowUs();
+    traceDump(fileName);
+    printf("%-26s %10.1f ms\n", "dump", (nowUs() - start) / 1000.0);
+}
+
+/****************************************************************************
+ * @brief    Timer callback marking that every OSD removal timer of a cycle has run.
+****************************************************************************/
+static void osdTimeoutsExpired()
+{
+    osdTimeoutsDone = 1;
+}
+
+/****************************************************************************
+ * @brief    Function for running banner and volume OSD removal timeouts on the simulated clock
+ *           and comparing the real time taken with the simulated time covered.
+****************************************************************************/
+static void runOsdTimeoutBenchmark()
+{
+    timerHandle sentinel = {0};
+    uint64_t simulatedStart;
+    double start;
+    double realMs;
+    double simulatedMs;
+    uint32_t i;
+
+    virtualClockInit(VIRTUAL_CLOCK_SIMULATED);
+    if (timerControllerInit(TIMER_CONTROLLER_OWN_THREAD) != TIMER_CONTROLLER_NO_ERROR)
+    {
+        printf("timerControllerInit failed\n");
+        virtualClockInit(VIRTUAL_CLOCK_REAL);
+        return;
+    }
+
+    softwareFramebufferSetMode(resolutions[0].width, resolutions[0].height);
+    graphicsControllerSetPixelFormat(GRAPHICS_PIXELFORMAT_ARGB);
+    if (graphicsControllerInit() != GRAPHICS_CONTROLLER_NO_ERROR)
+    {
+        printf("graphicsControllerInit failed\n");
+        timerControllerDeinit();
+        virtualClockInit(VIRTUAL_CLOCK_REAL);
+        return;
+    }
+
+    simulatedStart = virtualClockNowNs();
+    start = nowUs();
+    for (i = 0; i < OSD_TIMEOUT_CYCLES; i++)
+    {
+        drawChannelInfo(i % 1000 + 1, 2, "hrveng");
+        drawVolumeInfo((i % 100) / 100.0f);
+
+        /* the sentinel expires one tick after the banner, so both removals have returned by then */
+        osdTimeoutsDone = 0;
+        timerSetAndStartMs(&sentinel, OSD_LONGEST_TIMEOUT_MS + TIMER_TICK_MS, osdTimeoutsExpired);
+        virtualClockAdvance((OSD_LONGEST_TIMEOUT_MS + 2 * TIMER_TICK_MS) * 1000000ULL);
+        while (!osdTimeoutsDone)
+        {
+            sched_yield();
+        }
+    }
+    realMs = (nowUs() - start) / 1000.0;
+    simulatedMs = (virtualClockNowNs() - simulatedStart) / 1000000.0;
+
+    printf("\n%-26s %10s %12s %10s\n", "OSD timeouts", "real [ms]", "simulated [s]", "speedup");
+    printf("%-26u %10.1f %12.1f %9.0fx\n", OSD_TIMEOUT_CYCLES, realMs, simulatedMs / 1000.0, simulatedMs / realMs);
+
+    drawChannelNumber(1);
+    graphicsControllerDeinit();
+    timerControllerDeinit();
+    virtualClockInit(VIRTUAL_CLOCK_REAL);
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
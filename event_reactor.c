@@ -0,0 +1,428 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file event_reactor.c
+ *
+ * \brief
+ * Implementation of the event reactor module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "event_reactor.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+/* helper keywords needed only for event reactor module */
+#define MAX_READY_EVENTS 8
+
+typedef struct _reactorSource
+{
+    uint8_t used;
+    uint8_t notification; // 1 for eventfd created by eventReactorAddNotification
+    int32_t fileDesc;
+    const char *name;
+    eventReactorHandler handler;
+    void *context;
+    uint64_t postedAt; // time of the first post not yet dispatched, 0 if none
+    uint64_t dispatchCount;
+    uint64_t runTimeTotal;
+    uint64_t runTimeMax;
+    uint64_t delayTotal;
+    uint64_t delayMax;
+} reactorSource;
+
+/* helper variables needed only for event reactor module */
+static reactorSource sources[EVENT_REACTOR_MAX_SOURCES];
+static int32_t epollFileDesc = -1;
+static int32_t stopFileDesc = -1;
+static volatile uint8_t reactorRunning;
+static pthread_mutex_t sourceMutex = PTHREAD_MUTEX_INITIALIZER; // startup phases register sources concurrently
+
+static uint64_t loopBusyTime;
+static uint64_t loopWallTime;
+
+/* helper functions needed only for event reactor module */
+static uint64_t monotonicNs();
+static reactorSource *allocateSource(const char *name, eventReactorHandler handler, void *context);
+static void dispatchSource(reactorSource *source, uint32_t events);
+
+eventReactorStatus eventReactorInit()
+{
+    struct epoll_event event;
+
+    memset(sources, 0, sizeof(sources));
+    loopBusyTime = 0;
+    loopWallTime = 0;
+
+    epollFileDesc = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFileDesc == -1)
+    {
+        printf("Error while creating epoll instance!\n");
+        return EVENT_REACTOR_ERROR;
+    }
+
+    /* stop requests are the only events with no source attached */
+    stopFileDesc = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFileDesc == -1)
+    {
+        close(epollFileDesc);
+        epollFileDesc = -1;
+        return EVENT_REACTOR_ERROR;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (epoll_ctl(epollFileDesc, EPOLL_CTL_ADD, stopFileDesc, &event))
+    {
+        eventReactorDeinit();
+        return EVENT_REACTOR_ERROR;
+    }
+
+    return EVENT_REACTOR_NO_ERROR;
+}
+
+eventReactorStatus eventReactorDeinit()
+{
+    uint32_t i;
+
+    if (epollFileDesc == -1)
+    {
+        return EVENT_REACTOR_ERROR;
+    }
+
+    for (i = 0; i < EVENT_REACTOR_MAX_SOURCES; i++)
+    {
+        /* watched descriptors belong to their modules, only notifications are closed here */
+        if (sources[i].used && sources[i].notification)
+        {
+            close(sources[i].fileDesc);
+        }
+        sources[i].used = 0;
+    }
+
+    close(stopFileDesc);
+    stopFileDesc = -1;
+    close(epollFileDesc);
+    epollFileDesc = -1;
+
+    return EVENT_REACTOR_NO_ERROR;
+}
+
+eventReactorStatus eventReactorAddFileDesc(int32_t fileDesc, uint32_t events, const char *name, eventReactorHandler handler, void *context)
+{
+    struct epoll_event event;
+    reactorSource *source;
+
+    if (epollFileDesc == -1 || fileDesc < 0 || !handler)
+    {
+        return EVENT_REACTOR_ERROR;
+    }
+
+    source = allocateSource(name, handler, context);
+    if (!source)
+    {
+        printf("Event reactor: no free source for %s!\n", name);
+        return EVENT_REACTOR_ERROR;
+    }
+    source->fileDesc = fileDesc;
+
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.ptr = source;
+    if (epoll_ctl(epollFileDesc, EPOLL_CTL_ADD, fileDesc, &event))
+    {
+        source->used = 0;
+        return EVENT_REACTOR_ERROR;
+    }
+
+    return EVENT_REACTOR_NO_ERROR;
+}
+
+eventReactorStatus eventReactorRemoveFileDesc(int32_t fileDesc)
+{
+    uint32_t i;
+
+    for (i = 0; i < EVENT_REACTOR_MAX_SOURCES; i++)
+    {
+        if (sources[i].used && !sources[i].notification && sources[i].fileDesc == fileDesc)
+        {
+            epoll_ctl(epollFileDesc, EPOLL_CTL_DEL, fileDesc, NULL);
+            sources[i].used = 0;
+            return EVENT_REACTOR_NO_ERROR;
+        }
+    }
+
+    return EVENT_REACTOR_ERROR;
+}
+
+eventReactorStatus eventReactorAddNotification(const char *name, eventReactorHandler handler, void *context, int32_t *notificationId)
+{
+    struct epoll_event event;
+    reactorSource *source;
+
+    if (epollFileDesc == -1 || !handler || !notificationId)
+    {
+        return EVENT_REACTOR_ERROR;
+    }
+
+    source = allocateSource(name, handler, context);
+    if (!source)
+    {
+        printf("Event reactor: no free source for %s!\n", name);
+        return EVENT_REACTOR_ERROR;
+    }
+
+    source->fileDesc = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (source->fileDesc == -1)
+    {
+        source->used = 0;
+        return EVENT_REACTOR_ERROR;
+    }
+    source->notification = 1;
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = source;
+    if (epoll_ctl(epollFileDesc, EPOLL_CTL_ADD, source->fileDesc, &event))
+    {
+        close(source->fileDesc);
+        source->used = 0;
+        return EVENT_REACTOR_ERROR;
+    }
+
+    *notificationId = source - sources;
+    return EVENT_REACTOR_NO_ERROR;
+}
+
+void eventReactorNotify(int32_t notificationId)
+{
+    reactorSource *source;
+    uint64_t one = 1;
+
+    if (notificationId < 0 || notificationId >= EVENT_REACTOR_MAX_SOURCES)
+    {
+        return;
+    }
+    source = &sources[notificationId];
+
+    /* only the first post wakes the loop, later ones are handled by the same dispatch */
+    if (__sync_bool_compare_and_swap(&source->postedAt, 0, monotonicNs()))
+    {
+        if (write(source->fileDesc, &one, sizeof(one)) != sizeof(one))
+        {
+            printf("Event reactor: failed to post %s!\n", source->name);
+        }
+    }
+}
+
+eventReactorStatus eventReactorRun()
+{
+    struct epoll_event events[MAX_READY_EVENTS];
+    uint64_t loopStart;
+    uint64_t dispatchStart;
+    uint64_t counter;
+    int32_t readyCount;
+    int32_t i;
+
+    if (epollFileDesc == -1)
+    {
+        return EVENT_REACTOR_ERROR;
+    }
+
+    reactorRunning = 1;
+    loopStart = monotonicNs();
+
+    while (reactorRunning)
+    {
+        readyCount = epoll_wait(epollFileDesc, events, MAX_READY_EVENTS, -1);
+        if (readyCount < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            printf("Event reactor: epoll_wait failed!\n");
+            reactorRunning = 0;
+            loopWallTime += monotonicNs() - loopStart;
+            return EVENT_REACTOR_ERROR;
+        }
+
+        dispatchStart = monotonicNs();
+        for (i = 0; i < readyCount; i++)
+        {
+            reactorSource *source = (reactorSource *)events[i].data.ptr;
+
+            if (!source)
+            {
+                /* stop request, the flag is already cleared by eventReactorStop */
+                if (read(stopFileDesc, &counter, sizeof(counter)) < 0)
+                {
+                    counter = 0;
+                }
+                continue;
+            }
+
+            /* a handler earlier in this batch may have removed the source */
+            if (source->used)
+            {
+                dispatchSource(source, events[i].events);
+            }
+        }
+        loopBusyTime += monotonicNs() - dispatchStart;
+    }
+
+    loopWallTime += monotonicNs() - loopStart;
+    return EVENT_REACTOR_NO_ERROR;
+}
+
+void eventReactorStop()
+{
+    uint64_t one = 1;
+
+    reactorRunning = 0;
+    if (stopFileDesc != -1 && write(stopFileDesc, &one, sizeof(one)) != sizeof(one))
+    {
+        printf("Event reactor: failed to post stop request!\n");
+    }
+}
+
+void eventReactorPrintStatistics()
+{
+    uint32_t i;
+
+    printf("\nEvent reactor: loop busy %.1f ms of %.1f ms (%.2f%% utilization)\n",
+           loopBusyTime / 1000000.0, loopWallTime / 1000000.0,
+           loopWallTime ? 100.0 * loopBusyTime / loopWallTime : 0.0);
+
+    for (i = 0; i < EVENT_REACTOR_MAX_SOURCES; i++)
+    {
+        reactorSource *source = &sources[i];
+
+        if (!source->used || !source->dispatchCount)
+        {
+            continue;
+        }
+
+        printf("  %-16s %8llu dispatches, run avg %7.1f us max %7.1f us", source->name,
+               (unsigned long long)source->dispatchCount,
+               source->runTimeTotal / 1000.0 / source->dispatchCount, source->runTimeMax / 1000.0);
+        if (source->notification)
+        {
+            printf(", post to dispatch avg %7.1f us max %7.1f us",
+                   source->delayTotal / 1000.0 / source->dispatchCount, source->delayMax / 1000.0);
+        }
+        printf("\n");
+    }
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for reading monotonic time in nanoseconds.
+ *
+ * @return   Current time.
+****************************************************************************/
+static uint64_t monotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/****************************************************************************
+ * @brief    Function for taking a free source slot.
+ *
+ * @param    name - [in] Source name used in statistics.
+ *           handler - [in] Function called when the source is ready.
+ *           context - [in] Value passed to handler.
+ *
+ * @return   Pointer to source, NULL if all slots are used.
+****************************************************************************/
+static reactorSource *allocateSource(const char *name, eventReactorHandler handler, void *context)
+{
+    uint32_t i;
+
+    pthread_mutex_lock(&sourceMutex);
+    for (i = 0; i < EVENT_REACTOR_MAX_SOURCES; i++)
+    {
+        if (!sources[i].used)
+        {
+            memset(&sources[i], 0, sizeof(sources[i]));
+            sources[i].used = 1;
+            sources[i].fileDesc = -1;
+            sources[i].name = name;
+            sources[i].handler = handler;
+            sources[i].context = context;
+            pthread_mutex_unlock(&sourceMutex);
+            return &sources[i];
+        }
+    }
+    pthread_mutex_unlock(&sourceMutex);
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for calling source handler and recording its run time.
+ *           Notification counter is consumed before the handler runs, so a post
+ *           made while the handler is running wakes the loop again.
+ *
+ * @param    source - [in] Ready source.
+ *           events - [in] Ready epoll events.
+****************************************************************************/
+static void dispatchSource(reactorSource *source, uint32_t events)
+{
+    uint64_t start = monotonicNs();
+    uint64_t runTime;
+    uint64_t counter;
+
+    if (source->notification)
+    {
+        uint64_t postedAt;
+
+        if (read(source->fileDesc, &counter, sizeof(counter)) < 0)
+        {
+            counter = 0;
+        }
+
+        postedAt = __sync_lock_test_and_set(&source->postedAt, 0);
+        if (postedAt)
+        {
+            uint64_t delay = start > postedAt ? start - postedAt : 0;
+
+            source->delayTotal += delay;
+            if (delay > source->delayMax)
+            {
+                source->delayMax = delay;
+            }
+        }
+    }
+
+    TRACE_BEGIN(source->name);
+    source->handler(source->fileDesc, events, source->context);
+    TRACE_END(source->name);
+
+    runTime = monotonicNs() - start;
+    source->dispatchCount++;
+    source->runTimeTotal += runTime;
+    if (runTime > source->runTimeMax)
+    {
+        source->runTimeMax = runTime;
+    }
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
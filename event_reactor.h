@@ -0,0 +1,117 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file event_reactor.h
+ *
+ * \brief
+ * Header of the event reactor module. One epoll loop watches file descriptors (remote input,
+ * timers) and notifications posted from other threads (demux callbacks) and calls their
+ * handlers on the loop thread. Handler run time, notification delay and loop utilization are recorded.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _EVENT_REACTOR_H_
+#define _EVENT_REACTOR_H_
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#define EVENT_REACTOR_MAX_SOURCES 16
+
+typedef enum _eventReactorStatus
+{
+    EVENT_REACTOR_NO_ERROR = 0,
+    EVENT_REACTOR_ERROR
+} eventReactorStatus;
+
+/* handler called on the loop thread, events are EPOLLIN, EPOLLERR... flags */
+typedef void (*eventReactorHandler)(int32_t fileDesc, uint32_t events, void *context);
+
+/****************************************************************************
+ * @brief    Function for event reactor initialization.
+ *
+ * @return   EVENT_REACTOR_NO_ERROR, if there are no errors.
+ *           EVENT_REACTOR_ERROR, in case of an error.
+****************************************************************************/
+eventReactorStatus eventReactorInit();
+
+/****************************************************************************
+ * @brief    Function for event reactor deinitialization. Closes notification descriptors.
+ *
+ * @return   EVENT_REACTOR_NO_ERROR, if there are no errors.
+ *           EVENT_REACTOR_ERROR, in case of an error.
+****************************************************************************/
+eventReactorStatus eventReactorDeinit();
+
+/****************************************************************************
+ * @brief    Function for watching a file descriptor. Called by startup phases before the loop runs or from a handler.
+ *
+ * @param    fileDesc - [in] File descriptor to watch.
+ *           events - [in] epoll events to watch for.
+ *           name - [in] Source name used in statistics.
+ *           handler - [in] Function called when the descriptor is ready.
+ *           context - [in] Value passed to handler.
+ *
+ * @return   EVENT_REACTOR_NO_ERROR, if there are no errors.
+ *           EVENT_REACTOR_ERROR, in case of an error.
+****************************************************************************/
+eventReactorStatus eventReactorAddFileDesc(int32_t fileDesc, uint32_t events, const char *name, eventReactorHandler handler, void *context);
+
+/****************************************************************************
+ * @brief    Function for removing a watched file descriptor. Called before the loop runs or from a handler.
+ *
+ * @param    fileDesc - [in] Watched file descriptor.
+ *
+ * @return   EVENT_REACTOR_NO_ERROR, if there are no errors.
+ *           EVENT_REACTOR_ERROR, if the descriptor is not watched.
+****************************************************************************/
+eventReactorStatus eventReactorRemoveFileDesc(int32_t fileDesc);
+
+/****************************************************************************
+ * @brief    Function for creating a notification other threads can post to the loop.
+ *
+ * @param    name - [in] Notification name used in statistics.
+ *           handler - [in] Function called on the loop thread after the notification is posted.
+ *           context - [in] Value passed to handler.
+ *           notificationId - [out] Identifier passed to eventReactorNotify.
+ *
+ * @return   EVENT_REACTOR_NO_ERROR, if there are no errors.
+ *           EVENT_REACTOR_ERROR, in case of an error.
+****************************************************************************/
+eventReactorStatus eventReactorAddNotification(const char *name, eventReactorHandler handler, void *context, int32_t *notificationId);
+
+/****************************************************************************
+ * @brief    Function for posting a notification, safe to call from any thread.
+ *           Several posts before the handler runs result in one handler call.
+ *
+ * @param    notificationId - [in] Identifier returned by eventReactorAddNotification.
+****************************************************************************/
+void eventReactorNotify(int32_t notificationId);
+
+/****************************************************************************
+ * @brief    Function for running the loop on the calling thread until eventReactorStop is called.
+ *
+ * @return   EVENT_REACTOR_NO_ERROR, if there are no errors.
+ *           EVENT_REACTOR_ERROR, in case of an error.
+****************************************************************************/
+eventReactorStatus eventReactorRun();
+
+/****************************************************************************
+ * @brief    Function for stopping the loop, safe to call from any thread.
+****************************************************************************/
+void eventReactorStop();
+
+/****************************************************************************
+ * @brief    Function for printing per source dispatch statistics and loop utilization.
+****************************************************************************/
+void eventReactorPrintStatistics();
+
+#endif // _EVENT_REACTOR_H_
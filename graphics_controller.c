@@ -19,10 +19,18 @@
 #include "graphics_controller.h"
 
 #include <stdio.h>
+#ifdef GRAPHICS_SOFTWARE_BACKEND
+#include "software_framebuffer.h"
+#else
 #include <directfb.h>
+#endif
 #include "math.h"
 
 #include "timer_controller.h"
+#include "text_layout.h"
+#include "latency_histogram.h"
+#include "trace.h"
+#include "metrics.h"
 
 /* helper macro functions needed only for graphics controller module */
 #define DEGREES_TO_RADIANS(deg) ((deg)*M_PI / 180.0)
@@ -40,6 +48,14 @@
         }                                                        \
     }
 
+/* helper keywords needed only for graphics controller module */
+#define FONT_PATH "/home/galois/fonts/DejaVuSans.ttf"
+#define FONT_CACHE_SIZE 8
+#define MENU_PAGE_COUNT 2
+#define MENU_DESCRIPTION_TOP 300
+#define MENU_DESCRIPTION_ROW_HEIGHT 100
+#define MENU_DESCRIPTION_MAX_ROWS 5
+
 /* helper variables needed only for graphics controller module */
 static IDirectFBSurface *primary = NULL;
 static IDirectFB *dfbInterface = NULL;
@@ -50,25 +66,70 @@ static DFBSurfaceDescription surfaceDesc;
 static IDirectFBFont *fontInterface = NULL;
 static DFBFontDescription fontDesc;
 
-static timer_t timerChannelInfo;
-static timer_t timerChannelNumberMessage;
-static timer_t timerVolumeInfo;
+/* fonts created so far, one per height */
+static IDirectFBFont *fonts[FONT_CACHE_SIZE];
+static int fontHeights[FONT_CACHE_SIZE];
+static uint8_t fontCount;
+
+static timerHandle timerChannelInfo;
+static timerHandle timerChannelNumberMessage;
+static timerHandle timerVolumeInfo;
 
 static uint8_t showingChannelInfo;
 static uint8_t showingVolumeInfo;
 
+static graphicsPixelFormat osdPixelFormat = OSD_PIXELFORMAT;
+static const DFBSurfacePixelFormat dfbPixelFormats[GRAPHICS_PIXELFORMAT_COUNT] = {DSPF_ARGB, DSPF_ARGB4444, DSPF_LUT8};
+
+/* LUT8 palette holds every colour the OSD is drawn with: transparent, #FFA500, #383838, black and white */
+static const DFBColor osdPalette[] = {
+    {0x00, 0x00, 0x00, 0x00},
+    {0xff, 0xff, 0xa5, 0x00},
+    {0xff, 0x38, 0x38, 0x38},
+    {0xff, 0x00, 0x00, 0x00},
+    {0xff, 0xff, 0xff, 0xff}};
+
+/* offscreen "Now" and "Next" menu pages, rendered once and blitted on page switch */
+static IDirectFBSurface *menuPages[MENU_PAGE_COUNT];
+static uint8_t menuPagesValid;
+
+static int32_t framesMetric = -1;
+static int32_t flipTimeMetric = -1;
+
 /* helper functions needed only for graphics controller module */
 static void removeChannelInfo();
 static void removeVolumeInfo();
 static void removeMenuInfo();
 static void removeChannelNumberMessage();
 
-static graphicsControllerStatus formatAndDrawMenuShowName(const char *status, char *showname);
-static graphicsControllerStatus formatAndDrawMenuShowTimes(uint32_t startTime, uint32_t duration);
-static graphicsControllerStatus formatAndDrawShowDescription(char *source);
+static graphicsControllerStatus drawMenuPage(IDirectFBSurface *surface,
+                                             uint32_t presentShowStartTime, uint32_t presentShowDuration, char *presentShowName, char *presentShowDescription,
+                                             uint32_t followingShowStartTime, uint32_t followingShowDuration, char *followingShowName, char *followingShowDescription,
+                                             uint8_t channelFlag);
+static graphicsControllerStatus formatAndDrawMenuShowName(IDirectFBSurface *surface, const char *status, char *showname);
+static graphicsControllerStatus formatAndDrawMenuShowTimes(IDirectFBSurface *surface, uint32_t startTime, uint32_t duration);
+static graphicsControllerStatus formatAndDrawShowDescription(IDirectFBSurface *surface, char *source);
+static DFBResult getFont(int height, IDirectFBFont **font);
+static DFBResult setOsdPalette(IDirectFBSurface *surface);
+
+graphicsControllerStatus graphicsControllerSetPixelFormat(graphicsPixelFormat format)
+{
+    if (format >= GRAPHICS_PIXELFORMAT_COUNT)
+    {
+        return GRAPHICS_CONTROLLER_ERROR;
+    }
+
+    osdPixelFormat = format;
+    return GRAPHICS_CONTROLLER_NO_ERROR;
+}
 
 graphicsControllerStatus graphicsControllerInit()
 {
+    int i;
+
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_osd_frames_total", "OSD frames flipped to the screen", &framesMetric);
+    metricsRegister(METRICS_TYPE_GAUGE, "tv_last_flip_monotonic_nanoseconds", "CLOCK_MONOTONIC time the last OSD flip completed", &flipTimeMetric);
+
     /* initialize DirectFB */
     DFBCHECK(DirectFBInit(NULL, NULL));
 
@@ -78,19 +139,47 @@ graphicsControllerStatus graphicsControllerInit()
     /* tell the DirectFB to take the full screen for this application */
     DFBCHECK(dfbInterface->SetCooperativeLevel(dfbInterface, DFSCL_FULLSCREEN));
 
-    /* create primary surface with double buffering enabled */
-    surfaceDesc.flags = DSDESC_CAPS;
+    /* create primary surface with double buffering enabled in the OSD pixel format */
+    surfaceDesc.flags = DSDESC_CAPS | DSDESC_PIXELFORMAT;
     surfaceDesc.caps = DSCAPS_PRIMARY | DSCAPS_FLIPPING;
+    surfaceDesc.pixelformat = dfbPixelFormats[osdPixelFormat];
     DFBCHECK(dfbInterface->CreateSurface(dfbInterface, &surfaceDesc, &primary));
+    DFBCHECK(setOsdPalette(primary));
 
     /* fetch the screen size */
     DFBCHECK(primary->GetSize(primary, &screenWidth, &screenHeight));
 
+    /* create screen sized offscreen surfaces for menu pages */
+    surfaceDesc.flags = DSDESC_WIDTH | DSDESC_HEIGHT | DSDESC_PIXELFORMAT;
+    surfaceDesc.width = screenWidth;
+    surfaceDesc.height = screenHeight;
+    surfaceDesc.pixelformat = dfbPixelFormats[osdPixelFormat];
+    for (i = 0; i < MENU_PAGE_COUNT; i++)
+    {
+        DFBCHECK(dfbInterface->CreateSurface(dfbInterface, &surfaceDesc, &menuPages[i]));
+        DFBCHECK(setOsdPalette(menuPages[i]));
+    }
+    menuPagesValid = 0;
+
     return GRAPHICS_CONTROLLER_NO_ERROR;
 }
 
 graphicsControllerStatus graphicsControllerDeinit()
 {
+    int i;
+
+    for (i = 0; i < MENU_PAGE_COUNT; i++)
+    {
+        DFBCHECK(menuPages[i]->Release(menuPages[i]));
+        menuPages[i] = NULL;
+    }
+    for (i = 0; i < fontCount; i++)
+    {
+        textLayoutForgetFont(fonts[i]);
+        DFBCHECK(fonts[i]->Release(fonts[i]));
+    }
+    fontCount = 0;
+    fontInterface = NULL;
     DFBCHECK(primary->Release(primary));
     DFBCHECK(dfbInterface->Release(dfbInterface));
 
@@ -99,24 +188,17 @@ graphicsControllerStatus graphicsControllerDeinit()
 
 graphicsControllerStatus drawChannelNumber(uint16_t channelNumberValue)
 {
-    if (timerChannelInfo)
-        timerStopAndDelete(&timerChannelInfo);
-    if (timerVolumeInfo)
-        timerStopAndDelete(&timerVolumeInfo);
-    if (timerChannelNumberMessage)
-        timerStopAndDelete(&timerChannelNumberMessage);
+    timerStopAndDelete(&timerChannelInfo);
+    timerStopAndDelete(&timerVolumeInfo);
+    timerStopAndDelete(&timerChannelNumberMessage);
 
     char channelNumberString[4];
     sprintf(channelNumberString, "%d", channelNumberValue);
 
     clearScreen(COLOUR_BLACK);
 
-    /* specify the height of the font by raising the appropriate flag and setting the height value */
-    fontDesc.flags = DFDESC_HEIGHT;
-    fontDesc.height = 100;
-
-    /* create the font and set the created font for primary surface text drawing */
-    DFBCHECK(dfbInterface->CreateFont(dfbInterface, "/home/galois/fonts/DejaVuSans.ttf", &fontDesc, &fontInterface));
+    /* fetch the font of the appropriate height and set it for primary surface text drawing */
+    DFBCHECK(getFont(100, &fontInterface));
     DFBCHECK(primary->SetFont(primary, fontInterface));
 
     /* draw yellow #FFA500 channel number */
@@ -128,24 +210,17 @@ graphicsControllerStatus drawChannelNumber(uint16_t channelNumberValue)
 
 graphicsControllerStatus drawChannelNumberMessage(uint16_t channelNumberValue)
 {
-    if (timerChannelInfo)
-        timerStopAndDelete(&timerChannelInfo);
-    if (timerVolumeInfo)
-        timerStopAndDelete(&timerVolumeInfo);
-    if (timerChannelNumberMessage)
-        timerStopAndDelete(&timerChannelNumberMessage);
+    timerStopAndDelete(&timerChannelInfo);
+    timerStopAndDelete(&timerVolumeInfo);
+    timerStopAndDelete(&timerChannelNumberMessage);
 
     char message[27];
     sprintf(message, "Invalid channel number %d", channelNumberValue);
 
     clearScreen(COLOUR_BLACK);
 
-    /* specify the height of the font by raising the appropriate flag and setting the height value */
-    fontDesc.flags = DFDESC_HEIGHT;
-    fontDesc.height = 70;
-
-    /* create the font and set the created font for primary surface text drawing */
-    DFBCHECK(dfbInterface->CreateFont(dfbInterface, "/home/galois/fonts/DejaVuSans.ttf", &fontDesc, &fontInterface));
+    /* fetch the font of the appropriate height and set it for primary surface text drawing */
+    DFBCHECK(getFont(70, &fontInterface));
     DFBCHECK(primary->SetFont(primary, fontInterface));
 
     /* draw yellow #FFA500 channel number */
@@ -160,12 +235,9 @@ graphicsControllerStatus drawChannelNumberMessage(uint16_t channelNumberValue)
 
 graphicsControllerStatus drawChannelInfo(uint16_t channelNumberValue, uint8_t subtitleCount, char *subtitles)
 {
-    if (timerChannelInfo)
-        timerStopAndDelete(&timerChannelInfo);
-    if (timerVolumeInfo)
-        timerStopAndDelete(&timerVolumeInfo);
-    if (timerChannelNumberMessage)
-        timerStopAndDelete(&timerChannelNumberMessage);
+    timerStopAndDelete(&timerChannelInfo);
+    timerStopAndDelete(&timerVolumeInfo);
+    timerStopAndDelete(&timerChannelNumberMessage);
 
     char channelNumber[12];
 
@@ -216,24 +288,16 @@ graphicsControllerStatus drawChannelInfo(uint16_t channelNumberValue, uint8_t su
     DFBCHECK(primary->SetColor(primary, 0x38, 0x38, 0x38, COLOUR_WHITE));
     DFBCHECK(primary->FillRectangle(primary, screenWidth / 4 + 5, (5.3 * screenHeight) / 6.5 + 5, screenWidth / 2 - 10, screenHeight / 6 - 10));
 
-    /* specify the height of the font by raising the appropriate flag and setting the height value */
-    fontDesc.flags = DFDESC_HEIGHT;
-    fontDesc.height = 68;
-
-    /* create the font and set the created font for primary surface text drawing */
-    DFBCHECK(dfbInterface->CreateFont(dfbInterface, "/home/galois/fonts/DejaVuSans.ttf", &fontDesc, &fontInterface));
+    /* fetch the font of the appropriate height and set it for primary surface text drawing */
+    DFBCHECK(getFont(68, &fontInterface));
     DFBCHECK(primary->SetFont(primary, fontInterface));
 
     /* draw yellow #FFA500 channel string information */
     DFBCHECK(primary->SetColor(primary, 0xff, 0xa5, 0x00, COLOUR_WHITE));
     DFBCHECK(primary->DrawString(primary, channelNumber, -1, screenWidth / 4 + 20, (5.3 * screenHeight) / 6.5 + 80, DSTF_LEFT));
 
-    /* specify the height of the font by raising the appropriate flag and setting the height value */
-    fontDesc.flags = DFDESC_HEIGHT;
-    fontDesc.height = 48;
-
-    /* create the font and set the created font for primary surface text drawing */
-    DFBCHECK(dfbInterface->CreateFont(dfbInterface, "/home/galois/fonts/DejaVuSans.ttf", &fontDesc, &fontInterface));
+    /* fetch the font of the appropriate height and set it for primary surface text drawing */
+    DFBCHECK(getFont(48, &fontInterface));
     DFBCHECK(primary->SetFont(primary, fontInterface));
 
     if (subtitleCount)
@@ -259,12 +323,9 @@ graphicsControllerStatus drawChannelInfo(uint16_t channelNumberValue, uint8_t su
 
 graphicsControllerStatus drawVolumeInfo(float volumePercent)
 {
-    if (timerChannelInfo)
-        timerStopAndDelete(&timerChannelInfo);
-    if (timerVolumeInfo)
-        timerStopAndDelete(&timerVolumeInfo);
-    if (timerChannelNumberMessage)
-        timerStopAndDelete(&timerChannelNumberMessage);
+    timerStopAndDelete(&timerChannelInfo);
+    timerStopAndDelete(&timerVolumeInfo);
+    timerStopAndDelete(&timerChannelNumberMessage);
 
     char volume[4]; // 3 digits + 1 % sign + 1 '\0' - 1 index
     uint8_t volumePercentInt = roundNumber(volumePercent * 100);
@@ -336,12 +397,8 @@ graphicsControllerStatus drawVolumeInfo(float volumePercent)
         y1 = y2;
     }
 
-    /* specify the height of the font by raising the appropriate flag and setting the height value */
-    fontDesc.flags = DFDESC_HEIGHT;
-    fontDesc.height = 38;
-
-    /* create the font and set the created font for primary surface text drawing */
-    DFBCHECK(dfbInterface->CreateFont(dfbInterface, "/home/galois/fonts/DejaVuSans.ttf", &fontDesc, &fontInterface));
+    /* fetch the font of the appropriate height and set it for primary surface text drawing */
+    DFBCHECK(getFont(38, &fontInterface));
     DFBCHECK(primary->SetFont(primary, fontInterface));
 
     /* draw yellow #FFA500 volume string information */
@@ -363,111 +420,65 @@ graphicsControllerStatus drawMenuInfo(uint32_t presentShowStartTime, uint32_t pr
                                       uint32_t followingShowStartTime, uint32_t followingShowDuration, char *followingShowName, char *followingShowDescription,
                                       uint8_t channelFlag)
 {
-    if (timerChannelInfo)
-        timerStopAndDelete(&timerChannelInfo);
-    if (timerVolumeInfo)
-        timerStopAndDelete(&timerVolumeInfo);
-    if (timerChannelNumberMessage)
-        timerStopAndDelete(&timerChannelNumberMessage);
+    timerStopAndDelete(&timerChannelInfo);
+    timerStopAndDelete(&timerVolumeInfo);
+    timerStopAndDelete(&timerChannelNumberMessage);
 
     if (channelFlag == 0)
     {
+        invalidateMenuInfo();
         removeMenuInfo();
         return GRAPHICS_CONTROLLER_NO_ERROR;
     }
 
-    clearScreen(COLOUR_BLACK);
-
-    /* draw yellow #FFA500 menu background rectangle */
-    DFBCHECK(primary->SetColor(primary, 0xff, 0xa5, 0x00, COLOUR_WHITE));
-    DFBCHECK(primary->FillRectangle(primary, screenWidth / 10, screenHeight / 6, (8 * screenWidth) / 10, (4 * screenHeight) / 6));
-
-    /* draw grey #383838 menu foreground rectangle */
-    DFBCHECK(primary->SetColor(primary, 0x38, 0x38, 0x38, COLOUR_WHITE));
-    DFBCHECK(primary->FillRectangle(primary, screenWidth / 10 + 5, screenHeight / 6 + 5, (8 * screenWidth) / 10 - 10, (4 * screenHeight) / 6 - 10));
-
-    /* draw yellow #FFA500 menu line rectangle */
-    DFBCHECK(primary->SetColor(primary, 0xff, 0xa5, 0x00, COLOUR_WHITE));
-    DFBCHECK(primary->FillRectangle(primary, screenWidth / 10, screenHeight / 6 + 100, (8 * screenWidth) / 10, 5));
-
-    /* specify the height of the font by raising the appropriate flag and setting the height value */
-    fontDesc.flags = DFDESC_HEIGHT;
-    fontDesc.height = 70;
-
-    /* create the font and set the created font for primary surface text drawing */
-    DFBCHECK(dfbInterface->CreateFont(dfbInterface, "/home/galois/fonts/DejaVuSans.ttf", &fontDesc, &fontInterface));
-    DFBCHECK(primary->SetFont(primary, fontInterface));
-
-    if (channelFlag == 1)
+    if (channelFlag > MENU_PAGE_COUNT)
     {
-        if ((presentShowStartTime != -1) && (presentShowDuration != -1))
-        { // CONFIGURATION_PARSER_NOT_SET == -1
-            if (presentShowName != NULL)
-                formatAndDrawMenuShowName("Now:", presentShowName);
-
-            formatAndDrawMenuShowTimes(presentShowStartTime, presentShowDuration);
-
-            if (presentShowDescription != NULL)
-                formatAndDrawShowDescription(presentShowDescription);
-
-            if (followingShowStartTime && followingShowDuration)
-            {
-                /* draw yellow #FFA500 right arrow */
-                DFBCHECK(primary->SetColor(primary, 0xff, 0xa5, 0x00, COLOUR_WHITE));
-                DFBCHECK(primary->FillRectangle(primary, (4 * screenWidth) / 6 + 100, (5 * screenHeight) / 6 - 100, 100, 50));
-
-                DFBCHECK(primary->FillTriangle(primary, (5 * screenWidth) / 6 - 125, (5 * screenHeight) / 6 - 125,
-                                               (5 * screenWidth) / 6 - 125, (5 * screenHeight) / 6 - 25,
-                                               (5 * screenWidth) / 6 - 25, (5 * screenHeight) / 6 - 75));
-            }
-        }
-        else
-        {
-            /* draw yellow #FFA500 show name string information */
-            DFBCHECK(primary->SetColor(primary, 0xff, 0xa5, 0x00, COLOUR_WHITE));
-            DFBCHECK(primary->DrawString(primary, "Information Not Available!", -1, screenWidth / 10 + 20, screenHeight / 6 + 300, DSTF_LEFT));
-        }
+        return GRAPHICS_CONTROLLER_ERROR;
     }
 
-    if (channelFlag == 2)
+    /* render both pages once, switching between them afterwards is a single blit */
+    if (!menuPagesValid)
     {
-        if ((followingShowStartTime != -1) && (followingShowStartTime != -1))
-        { // CONFIGURATION_PARSER_NOT_SET == -1
-            if (followingShowName != NULL)
-                formatAndDrawMenuShowName("Next:", followingShowName);
-
-            formatAndDrawMenuShowTimes(followingShowStartTime, followingShowDuration);
-
-            if (followingShowDescription != NULL)
-                formatAndDrawShowDescription(followingShowDescription);
-
-            if (presentShowStartTime && presentShowDuration)
-            {
-                /* draw yellow #FFA500 left arrow */
-                DFBCHECK(primary->SetColor(primary, 0xff, 0xa5, 0x00, COLOUR_WHITE));
-                DFBCHECK(primary->FillRectangle(primary, screenWidth / 6 + 125, (5 * screenHeight) / 6 - 100, 100, 50));
-
-                DFBCHECK(primary->FillTriangle(primary, (screenWidth) / 6 + 125, (5 * screenHeight) / 6 - 125,
-                                               (screenWidth) / 6 + 125, (5 * screenHeight) / 6 - 25,
-                                               (screenWidth) / 6 + 25, (5 * screenHeight) / 6 - 75));
-            }
-        }
-
-        else
+        /* marked valid before rendering, so invalidation from another thread during rendering is not lost */
+        menuPagesValid = 1;
+
+        TRACE_BEGIN("render menu pages");
+        if (drawMenuPage(menuPages[0], presentShowStartTime, presentShowDuration, presentShowName, presentShowDescription,
+                         followingShowStartTime, followingShowDuration, followingShowName, followingShowDescription, 1) ||
+            drawMenuPage(menuPages[1], presentShowStartTime, presentShowDuration, presentShowName, presentShowDescription,
+                         followingShowStartTime, followingShowDuration, followingShowName, followingShowDescription, 2))
         {
-            /* draw yellow #FFA500 show name string information */
-            DFBCHECK(primary->SetColor(primary, 0xff, 0xa5, 0x00, COLOUR_WHITE));
-            DFBCHECK(primary->DrawString(primary, "Information Not Available!", -1, screenWidth / 10 + 20, screenHeight / 6 + 300, DSTF_LEFT));
+            TRACE_END("render menu pages");
+            menuPagesValid = 0;
+            return GRAPHICS_CONTROLLER_ERROR;
         }
+        TRACE_END("render menu pages");
     }
 
+    DFBCHECK(primary->Blit(primary, menuPages[channelFlag - 1], NULL, 0, 0));
+
     return GRAPHICS_CONTROLLER_NO_ERROR;
 }
 
+void invalidateMenuInfo()
+{
+    menuPagesValid = 0;
+}
+
 graphicsControllerStatus drawOnScreen()
 {
+    uint64_t flipStart = latencyNowNs();
+
     /* switch between the displayed and the work buffer (update the display) */
+    TRACE_BEGIN("flip");
     DFBCHECK(primary->Flip(primary, NULL, 0));
+    TRACE_END("flip");
+
+    latencyRecordSince(LATENCY_STAGE_FLIP, flipStart);
+    latencyPhotonReached();
+    metricsAdd(framesMetric, 1);
+    metricsSet(flipTimeMetric, latencyNowNs());
+
     return GRAPHICS_CONTROLLER_NO_ERROR;
 }
 
@@ -525,24 +536,125 @@ static void removeChannelNumberMessage()
     clearScreen(COLOUR_BLACK);
 }
 
+/****************************************************************************
+ * @brief    Function for rendering one menu information page to an offscreen surface.
+ *
+ * @param    surface - [in] Page surface to render to.
+ *           Other parameters are the same as in drawMenuInfo.
+ *
+ * @return   GRAPHICS_CONTROLLER_NO_ERROR, if there are no errors.
+ *           GRAPHICS_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static graphicsControllerStatus drawMenuPage(IDirectFBSurface *surface,
+                                             uint32_t presentShowStartTime, uint32_t presentShowDuration, char *presentShowName, char *presentShowDescription,
+                                             uint32_t followingShowStartTime, uint32_t followingShowDuration, char *followingShowName, char *followingShowDescription,
+                                             uint8_t channelFlag)
+{
+    /* pages are blitted over the whole screen, so everything outside the menu stays transparent */
+    DFBCHECK(surface->SetColor(surface, COLOUR_BLACK, COLOUR_BLACK, COLOUR_BLACK, COLOUR_BLACK));
+    DFBCHECK(surface->FillRectangle(surface, 0, 0, screenWidth, screenHeight));
+
+    /* draw yellow #FFA500 menu background rectangle */
+    DFBCHECK(surface->SetColor(surface, 0xff, 0xa5, 0x00, COLOUR_WHITE));
+    DFBCHECK(surface->FillRectangle(surface, screenWidth / 10, screenHeight / 6, (8 * screenWidth) / 10, (4 * screenHeight) / 6));
+
+    /* draw grey #383838 menu foreground rectangle */
+    DFBCHECK(surface->SetColor(surface, 0x38, 0x38, 0x38, COLOUR_WHITE));
+    DFBCHECK(surface->FillRectangle(surface, screenWidth / 10 + 5, screenHeight / 6 + 5, (8 * screenWidth) / 10 - 10, (4 * screenHeight) / 6 - 10));
+
+    /* draw yellow #FFA500 menu line rectangle */
+    DFBCHECK(surface->SetColor(surface, 0xff, 0xa5, 0x00, COLOUR_WHITE));
+    DFBCHECK(surface->FillRectangle(surface, screenWidth / 10, screenHeight / 6 + 100, (8 * screenWidth) / 10, 5));
+
+    /* fetch the font of the appropriate height and set it for page surface text drawing */
+    DFBCHECK(getFont(70, &fontInterface));
+    DFBCHECK(surface->SetFont(surface, fontInterface));
+
+    if (channelFlag == 1)
+    {
+        if ((presentShowStartTime != -1) && (presentShowDuration != -1))
+        { // CONFIGURATION_PARSER_NOT_SET == -1
+            if (presentShowName != NULL)
+                formatAndDrawMenuShowName(surface, "Now:", presentShowName);
+
+            formatAndDrawMenuShowTimes(surface, presentShowStartTime, presentShowDuration);
+
+            if (presentShowDescription != NULL)
+                formatAndDrawShowDescription(surface, presentShowDescription);
+
+            if (followingShowStartTime && followingShowDuration)
+            {
+                /* draw yellow #FFA500 right arrow */
+                DFBCHECK(surface->SetColor(surface, 0xff, 0xa5, 0x00, COLOUR_WHITE));
+                DFBCHECK(surface->FillRectangle(surface, (4 * screenWidth) / 6 + 100, (5 * screenHeight) / 6 - 100, 100, 50));
+
+                DFBCHECK(surface->FillTriangle(surface, (5 * screenWidth) / 6 - 125, (5 * screenHeight) / 6 - 125,
+                                               (5 * screenWidth) / 6 - 125, (5 * screenHeight) / 6 - 25,
+                                               (5 * screenWidth) / 6 - 25, (5 * screenHeight) / 6 - 75));
+            }
+        }
+        else
+        {
+            /* draw yellow #FFA500 show name string information */
+            DFBCHECK(surface->SetColor(surface, 0xff, 0xa5, 0x00, COLOUR_WHITE));
+            DFBCHECK(surface->DrawString(surface, "Information Not Available!", -1, screenWidth / 10 + 20, screenHeight / 6 + 300, DSTF_LEFT));
+        }
+    }
+
+    if (channelFlag == 2)
+    {
+        if ((followingShowStartTime != -1) && (followingShowStartTime != -1))
+        { // CONFIGURATION_PARSER_NOT_SET == -1
+            if (followingShowName != NULL)
+                formatAndDrawMenuShowName(surface, "Next:", followingShowName);
+
+            formatAndDrawMenuShowTimes(surface, followingShowStartTime, followingShowDuration);
+
+            if (followingShowDescription != NULL)
+                formatAndDrawShowDescription(surface, followingShowDescription);
+
+            if (presentShowStartTime && presentShowDuration)
+            {
+                /* draw yellow #FFA500 left arrow */
+                DFBCHECK(surface->SetColor(surface, 0xff, 0xa5, 0x00, COLOUR_WHITE));
+                DFBCHECK(surface->FillRectangle(surface, screenWidth / 6 + 125, (5 * screenHeight) / 6 - 100, 100, 50));
+
+                DFBCHECK(surface->FillTriangle(surface, (screenWidth) / 6 + 125, (5 * screenHeight) / 6 - 125,
+                                               (screenWidth) / 6 + 125, (5 * screenHeight) / 6 - 25,
+                                               (screenWidth) / 6 + 25, (5 * screenHeight) / 6 - 75));
+            }
+        }
+
+        else
+        {
+            /* draw yellow #FFA500 show name string information */
+            DFBCHECK(surface->SetColor(surface, 0xff, 0xa5, 0x00, COLOUR_WHITE));
+            DFBCHECK(surface->DrawString(surface, "Information Not Available!", -1, screenWidth / 10 + 20, screenHeight / 6 + 300, DSTF_LEFT));
+        }
+    }
+
+    return GRAPHICS_CONTROLLER_NO_ERROR;
+}
+
 /****************************************************************************
  * @brief    Function for drawing menu information banner show name.
  *
- * @param    status - [in] String marking show running status, "Now" or "Next".
+ * @param    surface - [in] Page surface to draw to.
+ *           status - [in] String marking show running status, "Now" or "Next".
  *           showName - [in] Show name string.
  *
  * @return   GRAPHICS_CONTROLLER_NO_ERROR, if there are no errors.
  *           GRAPHICS_CONTROLLER_ERROR, in case of an error.
 ****************************************************************************/
-static graphicsControllerStatus formatAndDrawMenuShowName(const char *status, char *showName)
+static graphicsControllerStatus formatAndDrawMenuShowName(IDirectFBSurface *surface, const char *status, char *showName)
 {
     /* draw yellow #FFA500 Now or Next string information */
-    DFBCHECK(primary->SetColor(primary, 0xff, 0xa5, 0x00, COLOUR_WHITE));
-    DFBCHECK(primary->DrawString(primary, status, -1, screenWidth / 10 + 20, (screenHeight) / 6 + 85, DSTF_LEFT));
+    DFBCHECK(surface->SetColor(surface, 0xff, 0xa5, 0x00, COLOUR_WHITE));
+    DFBCHECK(surface->DrawString(surface, status, -1, screenWidth / 10 + 20, (screenHeight) / 6 + 85, DSTF_LEFT));
 
     /* draw yellow #FFA500 show name string information */
-    DFBCHECK(primary->SetColor(primary, 0xff, 0xa5, 0x00, COLOUR_WHITE));
-    DFBCHECK(primary->DrawString(primary, showName, -1, screenWidth / 10 + 200, (screenHeight) / 6 + 85, DSTF_LEFT));
+    DFBCHECK(surface->SetColor(surface, 0xff, 0xa5, 0x00, COLOUR_WHITE));
+    DFBCHECK(surface->DrawString(surface, showName, -1, screenWidth / 10 + 200, (screenHeight) / 6 + 85, DSTF_LEFT));
 
     return GRAPHICS_CONTROLLER_NO_ERROR;
 }
@@ -550,13 +662,14 @@ static graphicsControllerStatus formatAndDrawMenuShowName(const char *status, ch
 /****************************************************************************
  * @brief    Function for drawing menu information banner show times.
  *
- * @param    startTime - [in] Show start time value.
+ * @param    surface - [in] Page surface to draw to.
+ *           startTime - [in] Show start time value.
  *           duration - [in] Show duration value.
  *
  * @return   GRAPHICS_CONTROLLER_NO_ERROR, if there are no errors.
  *           GRAPHICS_CONTROLLER_ERROR, in case of an error.
 ****************************************************************************/
-static graphicsControllerStatus formatAndDrawMenuShowTimes(uint32_t startTime, uint32_t duration)
+static graphicsControllerStatus formatAndDrawMenuShowTimes(IDirectFBSurface *surface, uint32_t startTime, uint32_t duration)
 {
     char startTimeString[6];
     char durationString[8];
@@ -573,12 +686,12 @@ static graphicsControllerStatus formatAndDrawMenuShowTimes(uint32_t startTime, u
     sprintf(durationString, "%d min", (hrs * 60) + ((min >> 4) * 10) + (min & 0x0f));
 
     /* draw yellow #FFA500 show start time string information */
-    DFBCHECK(primary->SetColor(primary, 0xff, 0xa5, 0x00, COLOUR_WHITE));
-    DFBCHECK(primary->DrawString(primary, startTimeString, -1, screenWidth / 10 + 20, screenHeight / 6 + 200, DSTF_LEFT));
+    DFBCHECK(surface->SetColor(surface, 0xff, 0xa5, 0x00, COLOUR_WHITE));
+    DFBCHECK(surface->DrawString(surface, startTimeString, -1, screenWidth / 10 + 20, screenHeight / 6 + 200, DSTF_LEFT));
 
     /* draw yellow #FFA500 show run time string information */
-    DFBCHECK(primary->SetColor(primary, 0xff, 0xa5, 0x00, COLOUR_WHITE));
-    DFBCHECK(primary->DrawString(primary, durationString, -1, (5 * screenWidth) / 6 - 150, screenHeight / 6 + 200, DSTF_LEFT));
+    DFBCHECK(surface->SetColor(surface, 0xff, 0xa5, 0x00, COLOUR_WHITE));
+    DFBCHECK(surface->DrawString(surface, durationString, -1, (5 * screenWidth) / 6 - 150, screenHeight / 6 + 200, DSTF_LEFT));
 
     return GRAPHICS_CONTROLLER_NO_ERROR;
 }
@@ -586,57 +699,121 @@ static graphicsControllerStatus formatAndDrawMenuShowTimes(uint32_t startTime, u
 /****************************************************************************
  * @brief    Function for drawing menu information banner show description.
  *
- * @param    source - [in] Show description string.
+ * @param    surface - [in] Page surface to draw to.
+ *           source - [in] Show description string.
  *
  * @return   GRAPHICS_CONTROLLER_NO_ERROR, if there are no errors.
  *           GRAPHICS_CONTROLLER_ERROR, in case of an error.
 ****************************************************************************/
-static graphicsControllerStatus formatAndDrawShowDescription(char *source)
+static graphicsControllerStatus formatAndDrawShowDescription(IDirectFBSurface *surface, char *source)
 {
-    /* specify the height of the font by raising the appropriate flag and setting the height value */
-    fontDesc.flags = DFDESC_HEIGHT;
-    fontDesc.height = 50;
-
-    /* create the font and set the created font for primary surface text drawing */
-    DFBCHECK(dfbInterface->CreateFont(dfbInterface, "/home/galois/fonts/DejaVuSans.ttf", &fontDesc, &fontInterface));
-    DFBCHECK(primary->SetFont(primary, fontInterface));
+    const textLayout *layout;
+    int descender;
+    uint32_t rows;
+    uint32_t i;
+
+    /* fetch the font of the appropriate height and set it for page surface text drawing */
+    DFBCHECK(getFont(50, &fontInterface));
+    DFBCHECK(surface->SetFont(surface, fontInterface));
+    DFBCHECK(fontInterface->GetDescender(fontInterface, &descender));
+
+    /* rows which fit above the bottom edge of the menu foreground rectangle */
+    rows = ((5 * screenHeight) / 6 - 5 + descender - (screenHeight / 6 + MENU_DESCRIPTION_TOP)) / MENU_DESCRIPTION_ROW_HEIGHT + 1;
+    if (rows > MENU_DESCRIPTION_MAX_ROWS)
+        rows = MENU_DESCRIPTION_MAX_ROWS;
+
+    if (textLayoutBreakLines(fontInterface, source, (8 * screenWidth) / 10 - 40, rows, &layout) != TEXT_LAYOUT_NO_ERROR)
+    {
+        return GRAPHICS_CONTROLLER_ERROR;
+    }
 
-    int i = 0;
-    int j;
-    char buffer[255];
+    for (i = 0; i < layout->lineCount; i++)
+    {
+        DFBCHECK(surface->DrawString(surface, source + layout->line[i].start, layout->line[i].length,
+                                     screenWidth / 10 + 20, screenHeight / 6 + MENU_DESCRIPTION_TOP + i * MENU_DESCRIPTION_ROW_HEIGHT, DSTF_LEFT));
+    }
 
-    while (source[i] != '\0')
+    if (layout->truncated)
     {
-        buffer[i] = source[i];
-        i++;
+        /* text did not fit, mark the end of the last row */
+        i = layout->lineCount - 1;
+        DFBCHECK(surface->DrawString(surface, "...", -1, screenWidth / 10 + 20 + layout->line[i].width,
+                                     screenHeight / 6 + MENU_DESCRIPTION_TOP + i * MENU_DESCRIPTION_ROW_HEIGHT, DSTF_LEFT));
     }
-    buffer[i] = '\0';
 
-    char *temp;
-    temp = buffer;
+    return GRAPHICS_CONTROLLER_NO_ERROR;
+}
 
-    for (i = 0; i < 5; i++)
-    { // maximum 5 rows
-        j = 0;
-        while (temp[j] != '\0' && j < 54)
-        {
-            j++; // maximum 54 characters per row
-        }
-        if (j == 54)
+/****************************************************************************
+ * @brief    Function for fetching the font of passed height, fonts are created once and kept until deinitialization.
+ *
+ * @param    height - [in] Font height in pixels.
+ *           font - [out] Pointer to font interface.
+ *
+ * @return   DFB_OK, if there are no errors.
+ *           Error returned by CreateFont or DFB_FAILURE if all font slots are taken, in case of an error.
+****************************************************************************/
+static DFBResult getFont(int height, IDirectFBFont **font)
+{
+    DFBResult result;
+    uint8_t i;
+
+    for (i = 0; i < fontCount; i++)
+    {
+        if (fontHeights[i] == height)
         {
-            while (temp[j] != ' ' && j > 0)
-            {
-                j--;
-            }
+            *font = fonts[i];
+            return DFB_OK;
         }
+    }
+
+    if (fontCount == FONT_CACHE_SIZE)
+    {
+        return DFB_FAILURE;
+    }
 
-        DFBCHECK(primary->DrawString(primary, temp, j, screenWidth / 10 + 20, screenHeight / 6 + 300 + i * 100, DSTF_LEFT));
+    /* specify the height of the font by raising the appropriate flag and setting the height value */
+    fontDesc.flags = DFDESC_HEIGHT;
+    fontDesc.height = height;
 
-        if (temp[j] == '\0')
-            break;
-        temp = (char *)(temp + j);
+    result = dfbInterface->CreateFont(dfbInterface, FONT_PATH, &fontDesc, &fonts[fontCount]);
+    if (result != DFB_OK)
+    {
+        return result;
     }
 
-    return GRAPHICS_CONTROLLER_NO_ERROR;
+    fontHeights[fontCount] = height;
+    *font = fonts[fontCount++];
+    return DFB_OK;
+}
+
+/****************************************************************************
+ * @brief    Function for loading the OSD colours into the palette of an LUT8 surface.
+ *
+ * @param    surface - [in] Surface to set the palette for.
+ *
+ * @return   DFB_OK, if there are no errors or the surface has no palette.
+ *           Error returned by the palette interface, in case of an error.
+****************************************************************************/
+static DFBResult setOsdPalette(IDirectFBSurface *surface)
+{
+    IDirectFBPalette *palette;
+    DFBResult result;
+
+    if (dfbPixelFormats[osdPixelFormat] != DSPF_LUT8)
+    {
+        return DFB_OK;
+    }
+
+    result = surface->GetPalette(surface, &palette);
+    if (result != DFB_OK)
+    {
+        return result;
+    }
+
+    result = palette->SetEntries(palette, osdPalette, sizeof(osdPalette) / sizeof(osdPalette[0]), 0);
+    palette->Release(palette);
+
+    return result;
 }
 /* -------------------- HELPER FUNCTIONS -------------------- */
@@ -35,6 +35,30 @@ typedef enum _graphicsControllerStatus
     GRAPHICS_CONTROLLER_ERROR
 } graphicsControllerStatus;
 
+/* OSD surface formats, reduced formats are expanded by the display at composition time */
+typedef enum _graphicsPixelFormat
+{
+    GRAPHICS_PIXELFORMAT_ARGB = 0, // 32 bits per pixel
+    GRAPHICS_PIXELFORMAT_ARGB4444, // 16 bits per pixel, anti-aliased text is dithered
+    GRAPHICS_PIXELFORMAT_LUT8,     // 8 bits per pixel, OSD colours in a palette, anti-aliased text is dithered
+    GRAPHICS_PIXELFORMAT_COUNT
+} graphicsPixelFormat;
+
+/* OSD surface format used unless changed by graphicsControllerSetPixelFormat, set at build time */
+#ifndef OSD_PIXELFORMAT
+#define OSD_PIXELFORMAT GRAPHICS_PIXELFORMAT_ARGB
+#endif
+
+/****************************************************************************
+ * @brief    Function for choosing OSD surface format. Takes effect at the next initialization.
+ *
+ * @param    format - [in] OSD surface pixel format.
+ *
+ * @return   GRAPHICS_CONTROLLER_NO_ERROR, if there are no errors.
+ *           GRAPHICS_CONTROLLER_ERROR, in case of an unknown format.
+****************************************************************************/
+graphicsControllerStatus graphicsControllerSetPixelFormat(graphicsPixelFormat format);
+
 /****************************************************************************
  * @brief    Function for DirectFB initialization.
  *
@@ -111,6 +135,9 @@ graphicsControllerStatus drawVolumeInfo(float volumePercent);
  *                              1 Draws present show menu banner.
  *                              2 Draws following show menu banner.
  *
+ *           Both banners are rendered offscreen on the first call after invalidateMenuInfo,
+ *           following calls only copy the requested banner to the screen.
+ *
  * @return   GRAPHICS_CONTROLLER_NO_ERROR, if there are no errors.
  *           GRAPHICS_CONTROLLER_ERROR, in case of an error.
 ****************************************************************************/
@@ -118,6 +145,12 @@ graphicsControllerStatus drawMenuInfo(uint32_t presentShowStartTime, uint32_t pr
                                       uint32_t followingShowStartTime, uint32_t followingShowDuration, char *followingShowName, char *followingShowDescription,
                                       uint8_t channelFlag);
 
+/****************************************************************************
+ * @brief    Function for discarding rendered menu banners. Has to be called whenever
+ *           show information passed to drawMenuInfo changes.
+****************************************************************************/
+void invalidateMenuInfo();
+
 /****************************************************************************
  * @brief    Function for showing drawn graphics to screen.
  *
@@ -0,0 +1,395 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file input_controller.c
+ *
+ * \brief
+ * Implementation of the module for input devices.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "input_controller.h"
+#include "event_reactor.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+
+/* helper keywords needed only for input controller module */
+#define DEVICE_PREFIX "event"
+#define DEVICE_PATH_LENGTH 64
+#define DEVICE_NAME_LENGTH 64
+#define INPUT_BATCH_SIZE 64
+#define INOTIFY_BUFFER_SIZE 4096
+
+#define BITS_PER_LONG (sizeof(long) * 8)
+#define TEST_BIT(bit, array) ((array[(bit) / BITS_PER_LONG] >> ((bit) % BITS_PER_LONG)) & 1)
+
+/* older kernel headers name the timestamp fields directly */
+#ifndef input_event_sec
+#define input_event_sec time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
+
+typedef struct _inputDevice
+{
+    int32_t fileDesc; // -1 while the slot is free
+    char path[DEVICE_PATH_LENGTH];
+    char name[DEVICE_NAME_LENGTH];
+} inputDevice;
+
+/* helper variables needed only for input controller module */
+static inputDevice devices[INPUT_MAX_DEVICES];
+static uint32_t deviceCount;
+static int32_t inotifyFileDesc = -1;
+static inputEventCallback eventCallback;
+static struct input_event eventBatch[INPUT_BATCH_SIZE];
+
+/* helper functions needed only for input controller module */
+static void openDevice(const char *fileName);
+static void closeDevice(inputDevice *device);
+static inputDevice *findDevice(const char *path);
+static uint8_t reportsKeys(int32_t fileDesc);
+static void deviceHandler(int32_t fileDesc, uint32_t events, void *context);
+static void hotplugHandler(int32_t fileDesc, uint32_t events, void *context);
+
+inputControllerStatus inputControllerInit(inputEventCallback callback)
+{
+    struct dirent *entry;
+    DIR *directory;
+    uint32_t i;
+
+    if (!callback)
+    {
+        return INPUT_CONTROLLER_ERROR;
+    }
+
+    eventCallback = callback;
+    deviceCount = 0;
+    for (i = 0; i < INPUT_MAX_DEVICES; i++)
+    {
+        devices[i].fileDesc = -1;
+    }
+
+    /* start watching before the scan so a device plugged in meanwhile is not missed */
+    inotifyFileDesc = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFileDesc == -1 ||
+        inotify_add_watch(inotifyFileDesc, INPUT_DEVICE_DIRECTORY, IN_CREATE | IN_ATTRIB | IN_DELETE) == -1 ||
+        eventReactorAddFileDesc(inotifyFileDesc, EPOLLIN, "input hotplug", hotplugHandler, NULL))
+    {
+        printf("Input hotplug not available (%s), only present devices are used!\n", strerror(errno));
+        if (inotifyFileDesc != -1)
+        {
+            close(inotifyFileDesc);
+            inotifyFileDesc = -1;
+        }
+    }
+
+    directory = opendir(INPUT_DEVICE_DIRECTORY);
+    if (!directory)
+    {
+        printf("Error while opening %s (%s)!\n", INPUT_DEVICE_DIRECTORY, strerror(errno));
+        return inotifyFileDesc == -1 ? INPUT_CONTROLLER_ERROR : INPUT_CONTROLLER_NO_ERROR;
+    }
+
+    while ((entry = readdir(directory)) != NULL)
+    {
+        openDevice(entry->d_name);
+    }
+    closedir(directory);
+
+    if (deviceCount == 0)
+    {
+        printf("No input device found, waiting for one to be plugged in\n");
+        return inotifyFileDesc == -1 ? INPUT_CONTROLLER_ERROR : INPUT_CONTROLLER_NO_ERROR;
+    }
+
+    return INPUT_CONTROLLER_NO_ERROR;
+}
+
+inputControllerStatus inputControllerDeinit()
+{
+    uint32_t i;
+
+    for (i = 0; i < INPUT_MAX_DEVICES; i++)
+    {
+        if (devices[i].fileDesc != -1)
+        {
+            closeDevice(&devices[i]);
+        }
+    }
+
+    if (inotifyFileDesc != -1)
+    {
+        eventReactorRemoveFileDesc(inotifyFileDesc);
+        close(inotifyFileDesc);
+        inotifyFileDesc = -1;
+    }
+
+    return INPUT_CONTROLLER_NO_ERROR;
+}
+
+uint32_t inputControllerDeviceCount()
+{
+    return deviceCount;
+}
+
+int64_t inputEventAgeUs(const struct input_event *event)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - event->input_event_sec) * 1000000 + (now.tv_nsec / 1000 - event->input_event_usec);
+}
+
+uint64_t inputEventTimestampNs(const struct input_event *event)
+{
+    return (uint64_t)event->input_event_sec * 1000000000ULL + (uint64_t)event->input_event_usec * 1000;
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for opening an evdev device and adding it to the event loop.
+ *           Devices without keys (mice, sensors) and already opened devices are skipped.
+ *
+ * @param    fileName - [in] File name in the input directory.
+****************************************************************************/
+static void openDevice(const char *fileName)
+{
+    char path[DEVICE_PATH_LENGTH];
+    inputDevice *device = NULL;
+    int clockId = CLOCK_MONOTONIC;
+    int32_t fileDesc;
+    uint32_t i;
+
+    if (strncmp(fileName, DEVICE_PREFIX, strlen(DEVICE_PREFIX)) != 0)
+    {
+        return;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", INPUT_DEVICE_DIRECTORY, fileName);
+    if (findDevice(path))
+    {
+        return;
+    }
+
+    for (i = 0; i < INPUT_MAX_DEVICES; i++)
+    {
+        if (devices[i].fileDesc == -1)
+        {
+            device = &devices[i];
+            break;
+        }
+    }
+    if (!device)
+    {
+        printf("Too many input devices, %s ignored!\n", path);
+        return;
+    }
+
+    /* node may still be owned by root right after creation, it is retried on IN_ATTRIB */
+    fileDesc = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fileDesc == -1)
+    {
+        return;
+    }
+
+    if (!reportsKeys(fileDesc))
+    {
+        close(fileDesc);
+        return;
+    }
+
+    /* timestamps on the same clock as the rest of the application, immune to time changes */
+    if (ioctl(fileDesc, EVIOCSCLOCKID, &clockId))
+    {
+        printf("%s does not support monotonic timestamps, input latency is not valid!\n", path);
+    }
+
+    memset(device->name, 0, sizeof(device->name));
+    ioctl(fileDesc, EVIOCGNAME(sizeof(device->name) - 1), device->name);
+    snprintf(device->path, sizeof(device->path), "%s", path);
+    device->fileDesc = fileDesc;
+
+    if (eventReactorAddFileDesc(fileDesc, EPOLLIN, device->name, deviceHandler, device))
+    {
+        close(fileDesc);
+        device->fileDesc = -1;
+        return;
+    }
+
+    deviceCount++;
+    printf("Input device opened succesfully [%s] %s\n", device->name, device->path);
+}
+
+/****************************************************************************
+ * @brief    Function for removing a device from the event loop and closing it.
+ *
+ * @param    device - [in] Opened device.
+****************************************************************************/
+static void closeDevice(inputDevice *device)
+{
+    eventReactorRemoveFileDesc(device->fileDesc);
+    close(device->fileDesc);
+    device->fileDesc = -1;
+    deviceCount--;
+
+    printf("Input device closed [%s] %s\n", device->name, device->path);
+}
+
+/****************************************************************************
+ * @brief    Function for finding an opened device by its path.
+ *
+ * @param    path - [in] Device node path.
+ *
+ * @return   Pointer to device, NULL if the device is not opened.
+****************************************************************************/
+static inputDevice *findDevice(const char *path)
+{
+    uint32_t i;
+
+    for (i = 0; i < INPUT_MAX_DEVICES; i++)
+    {
+        if (devices[i].fileDesc != -1 && strcmp(devices[i].path, path) == 0)
+        {
+            return &devices[i];
+        }
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for checking whether a device reports key events.
+ *
+ * @param    fileDesc - [in] Device file descriptor.
+ *
+ * @return   1 if the device has keys, 0 otherwise.
+****************************************************************************/
+static uint8_t reportsKeys(int32_t fileDesc)
+{
+    unsigned long eventTypes[EV_MAX / (sizeof(long) * 8) + 1];
+
+    memset(eventTypes, 0, sizeof(eventTypes));
+    if (ioctl(fileDesc, EVIOCGBIT(0, sizeof(eventTypes)), eventTypes) < 0)
+    {
+        return 0;
+    }
+
+    return TEST_BIT(EV_KEY, eventTypes);
+}
+
+/****************************************************************************
+ * @brief    Function for reading all pending events of a device in batches and passing key events on.
+ *
+ * @param    fileDesc - [in] Device file descriptor.
+ *           events - [in] Ready epoll events.
+ *           context - [in] Pointer to device.
+****************************************************************************/
+static void deviceHandler(int32_t fileDesc, uint32_t events, void *context)
+{
+    inputDevice *device = (inputDevice *)context;
+    int32_t bytesRead;
+    int32_t eventCount;
+    int32_t i;
+
+    while (1)
+    {
+        bytesRead = read(fileDesc, eventBatch, sizeof(eventBatch));
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                /* ENODEV, the device was unplugged */
+                closeDevice(device);
+            }
+            return;
+        }
+        if (bytesRead == 0)
+        {
+            return;
+        }
+
+        eventCount = bytesRead / (int32_t)sizeof(struct input_event);
+        for (i = 0; i < eventCount; i++)
+        {
+            if (eventBatch[i].type == EV_KEY)
+            {
+                eventCallback(&eventBatch[i]);
+            }
+            else if (eventBatch[i].type == EV_SYN && eventBatch[i].code == SYN_DROPPED)
+            {
+                printf("Input events of [%s] dropped by the kernel!\n", device->name);
+            }
+        }
+
+        if (bytesRead < (int32_t)sizeof(eventBatch))
+        {
+            /* short read, the device queue is drained */
+            return;
+        }
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for opening devices created in the input directory and closing removed ones.
+ *
+ * @param    fileDesc - [in] inotify file descriptor.
+ *           events - [in] Ready epoll events.
+ *           context - [in] Unused.
+****************************************************************************/
+static void hotplugHandler(int32_t fileDesc, uint32_t events, void *context)
+{
+    char buffer[INOTIFY_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *notification;
+    char path[DEVICE_PATH_LENGTH];
+    inputDevice *device;
+    int32_t bytesRead;
+    char *position;
+
+    while ((bytesRead = read(fileDesc, buffer, sizeof(buffer))) > 0)
+    {
+        for (position = buffer; position < buffer + bytesRead; position += sizeof(struct inotify_event) + notification->len)
+        {
+            notification = (const struct inotify_event *)position;
+            if (!notification->len)
+            {
+                continue;
+            }
+
+            if (notification->mask & (IN_CREATE | IN_ATTRIB))
+            {
+                openDevice(notification->name);
+            }
+            else if (notification->mask & IN_DELETE)
+            {
+                /* usually closed already by the failed read, the node can go first though */
+                snprintf(path, sizeof(path), "%s/%s", INPUT_DEVICE_DIRECTORY, notification->name);
+                device = findDevice(path);
+                if (device)
+                {
+                    closeDevice(device);
+                }
+            }
+        }
+    }
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
@@ -0,0 +1,86 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file input_controller.h
+ *
+ * \brief
+ * Header of the module for input devices. Every evdev device reporting keys (IR receivers,
+ * remotes, USB keyboards, uinput virtual devices) is opened non-blocking and read in batches
+ * on the event loop, devices plugged in later are found through inotify on the input directory.
+ * Event timestamps are taken by the kernel on CLOCK_MONOTONIC.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _INPUT_CONTROLLER_H_
+#define _INPUT_CONTROLLER_H_
+
+#include <stdint.h>
+#include <linux/input.h>
+
+#ifndef INPUT_DEVICE_DIRECTORY
+#define INPUT_DEVICE_DIRECTORY "/dev/input"
+#endif
+#define INPUT_MAX_DEVICES 8
+
+typedef enum _inputControllerStatus
+{
+    INPUT_CONTROLLER_NO_ERROR = 0,
+    INPUT_CONTROLLER_ERROR
+} inputControllerStatus;
+
+/* called on the event loop thread for every key event of every device */
+typedef void (*inputEventCallback)(const struct input_event *event);
+
+/****************************************************************************
+ * @brief    Function for input controller initialization. Opens present devices and starts watching for new ones.
+ *           Requires initialized event reactor.
+ *
+ * @param    callback - [in] Function called for every key event.
+ *
+ * @return   INPUT_CONTROLLER_NO_ERROR, if there are no errors.
+ *           INPUT_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+inputControllerStatus inputControllerInit(inputEventCallback callback);
+
+/****************************************************************************
+ * @brief    Function for input controller deinitialization. Closes all devices.
+ *
+ * @return   INPUT_CONTROLLER_NO_ERROR, if there are no errors.
+ *           INPUT_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+inputControllerStatus inputControllerDeinit();
+
+/****************************************************************************
+ * @brief    Function for getting the number of opened input devices.
+ *
+ * @return   Number of opened devices.
+****************************************************************************/
+uint32_t inputControllerDeviceCount();
+
+/****************************************************************************
+ * @brief    Function for getting time passed since the kernel timestamped an event.
+ *
+ * @param    event - [in] Event received by the callback.
+ *
+ * @return   Event age in microseconds.
+****************************************************************************/
+int64_t inputEventAgeUs(const struct input_event *event);
+
+/****************************************************************************
+ * @brief    Function for getting kernel timestamp of an event.
+ *
+ * @param    event - [in] Event received by the callback.
+ *
+ * @return   CLOCK_MONOTONIC timestamp in nanoseconds.
+****************************************************************************/
+uint64_t inputEventTimestampNs(const struct input_event *event);
+
+#endif // _INPUT_CONTROLLER_H_
@@ -0,0 +1,237 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file latency_histogram.c
+ *
+ * \brief
+ * Implementation of the module for latency histograms.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "latency_histogram.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* helper keywords needed only for latency histogram module */
+#define LINEAR_BUCKETS 16 // values below are counted exactly
+#define SUB_BUCKET_BITS 3 // every power of two is split in 8 buckets, 12.5% resolution
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+#define MAX_EXPONENT 39 // about 12 days in microseconds, longer values are counted in the last bucket
+#define FIRST_EXPONENT 4
+#define BUCKET_COUNT (LINEAR_BUCKETS + (MAX_EXPONENT - FIRST_EXPONENT + 1) * SUB_BUCKETS)
+
+typedef struct _latencyHistogram
+{
+    uint32_t bucket[BUCKET_COUNT];
+    uint64_t maxUs;
+} latencyHistogram;
+
+/* helper variables needed only for latency histogram module */
+static latencyHistogram histograms[LATENCY_STAGE_COUNT];
+static uint64_t inputMark;
+
+static const char *stageNames[LATENCY_STAGE_COUNT] = {
+    "input_dispatch",
+    "input_to_photon",
+    "key_to_zap",
+    "zap",
+    "zap_predicted",
+    "zap_cold",
+    "stream_stop",
+    "video_create",
+    "audio_create",
+    "draw",
+    "flip"};
+
+/* helper functions needed only for latency histogram module */
+static uint32_t bucketIndex(uint64_t valueUs);
+static uint64_t bucketUpperBound(uint32_t index);
+
+uint64_t latencyNowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void latencyRecord(latencyStage stage, uint64_t durationNs)
+{
+    latencyHistogram *histogram;
+    uint64_t valueUs = durationNs / 1000;
+    uint64_t currentMax;
+
+    if (stage >= LATENCY_STAGE_COUNT)
+    {
+        return;
+    }
+    histogram = &histograms[stage];
+
+    __sync_fetch_and_add(&histogram->bucket[bucketIndex(valueUs)], 1);
+
+    currentMax = histogram->maxUs;
+    while (valueUs > currentMax)
+    {
+        uint64_t previous = __sync_val_compare_and_swap(&histogram->maxUs, currentMax, valueUs);
+        if (previous == currentMax)
+        {
+            break;
+        }
+        currentMax = previous;
+    }
+}
+
+void latencyRecordSince(latencyStage stage, uint64_t startNs)
+{
+    uint64_t now;
+
+    if (!startNs)
+    {
+        return;
+    }
+
+    /* kernel timestamp may be a little ahead of the clock read right after it */
+    now = latencyNowNs();
+    latencyRecord(stage, now > startNs ? now - startNs : 0);
+}
+
+void latencyMarkInput(uint64_t timestampNs)
+{
+    __sync_lock_test_and_set(&inputMark, timestampNs);
+}
+
+uint64_t latencyInputTimestamp()
+{
+    return __sync_fetch_and_add(&inputMark, 0);
+}
+
+void latencyPhotonReached()
+{
+    /* only the first flip after a key counts, later ones are not caused by it */
+    uint64_t mark = __sync_lock_test_and_set(&inputMark, 0);
+
+    latencyRecordSince(LATENCY_STAGE_INPUT_TO_PHOTON, mark);
+}
+
+void latencyGetPercentiles(latencyStage stage, latencyPercentiles *percentiles)
+{
+    static const uint32_t permille[3] = {500, 950, 990};
+    uint32_t snapshot[BUCKET_COUNT];
+    uint64_t *results[3];
+    uint64_t cumulative = 0;
+    uint32_t next = 0;
+    uint32_t i;
+
+    memset(percentiles, 0, sizeof(*percentiles));
+    if (stage >= LATENCY_STAGE_COUNT)
+    {
+        return;
+    }
+
+    results[0] = &percentiles->p50Us;
+    results[1] = &percentiles->p95Us;
+    results[2] = &percentiles->p99Us;
+
+    /* counters keep changing while they are read, work on a copy */
+    for (i = 0; i < BUCKET_COUNT; i++)
+    {
+        snapshot[i] = __sync_fetch_and_add(&histograms[stage].bucket[i], 0);
+        percentiles->count += snapshot[i];
+    }
+    percentiles->maxUs = __sync_fetch_and_add(&histograms[stage].maxUs, 0);
+
+    if (!percentiles->count)
+    {
+        return;
+    }
+
+    for (i = 0; i < BUCKET_COUNT && next < 3; i++)
+    {
+        cumulative += snapshot[i];
+        while (next < 3 && cumulative * 1000 >= percentiles->count * permille[next])
+        {
+            uint64_t bound = bucketUpperBound(i);
+            *results[next++] = bound < percentiles->maxUs ? bound : percentiles->maxUs;
+        }
+    }
+}
+
+const char *latencyStageName(latencyStage stage)
+{
+    return stage < LATENCY_STAGE_COUNT ? stageNames[stage] : "unknown";
+}
+
+void latencyPrintReport()
+{
+    latencyPercentiles percentiles;
+    uint32_t stage;
+
+    printf("\n%-16s %8s %10s %10s %10s %10s\n", "stage", "count", "p50 [us]", "p95 [us]", "p99 [us]", "max [us]");
+    for (stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+    {
+        latencyGetPercentiles(stage, &percentiles);
+        printf("%-16s %8llu %10llu %10llu %10llu %10llu\n", stageNames[stage], (unsigned long long)percentiles.count,
+               (unsigned long long)percentiles.p50Us, (unsigned long long)percentiles.p95Us,
+               (unsigned long long)percentiles.p99Us, (unsigned long long)percentiles.maxUs);
+    }
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for finding the histogram bucket of a value.
+ *
+ * @param    valueUs - [in] Value in microseconds.
+ *
+ * @return   Bucket index.
+****************************************************************************/
+static uint32_t bucketIndex(uint64_t valueUs)
+{
+    uint32_t exponent;
+
+    if (valueUs < LINEAR_BUCKETS)
+    {
+        return valueUs;
+    }
+
+    exponent = 63 - __builtin_clzll(valueUs);
+    if (exponent > MAX_EXPONENT)
+    {
+        return BUCKET_COUNT - 1;
+    }
+
+    return LINEAR_BUCKETS + (exponent - FIRST_EXPONENT) * SUB_BUCKETS +
+           ((valueUs >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+}
+
+/****************************************************************************
+ * @brief    Function for getting the largest value counted in a bucket.
+ *
+ * @param    index - [in] Bucket index.
+ *
+ * @return   Upper bound of the bucket in microseconds.
+****************************************************************************/
+static uint64_t bucketUpperBound(uint32_t index)
+{
+    uint32_t exponent;
+    uint32_t subBucket;
+
+    if (index < LINEAR_BUCKETS)
+    {
+        return index;
+    }
+
+    exponent = (index - LINEAR_BUCKETS) / SUB_BUCKETS + FIRST_EXPONENT;
+    subBucket = (index - LINEAR_BUCKETS) % SUB_BUCKETS;
+
+    return (1ULL << exponent) + ((uint64_t)(subBucket + 1) << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
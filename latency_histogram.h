@@ -0,0 +1,116 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file latency_histogram.h
+ *
+ * \brief
+ * Header of the module for latency histograms. Every stage from key press to picture
+ * (input dispatch, stream stop and create, OSD draw and flip) has a log-linear histogram
+ * updated with atomic increments, so any thread can record without locking.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _LATENCY_HISTOGRAM_H_
+#define _LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+
+typedef enum _latencyStage
+{
+    LATENCY_STAGE_INPUT_DISPATCH = 0, // kernel event timestamp to key handler
+    LATENCY_STAGE_INPUT_TO_PHOTON,    // kernel event timestamp to the first flip caused by the key
+    LATENCY_STAGE_KEY_TO_ZAP,         // kernel event timestamp of the last zap key to streams started
+    LATENCY_STAGE_ZAP,                // whole startPlayerStream
+    LATENCY_STAGE_ZAP_PREDICTED,      // whole zap to a channel prepared by the zap predictor
+    LATENCY_STAGE_ZAP_COLD,           // whole zap to a channel which was not predicted
+    LATENCY_STAGE_STREAM_STOP,        // removing streams of the previous channel
+    LATENCY_STAGE_VIDEO_CREATE,       // Player_Stream_Create of video
+    LATENCY_STAGE_AUDIO_CREATE,       // Player_Stream_Create of audio
+    LATENCY_STAGE_DRAW,               // draw* call of OSD element
+    LATENCY_STAGE_FLIP,               // drawOnScreen flip
+    LATENCY_STAGE_COUNT
+} latencyStage;
+
+typedef struct _latencyPercentiles
+{
+    uint64_t count;
+    uint64_t p50Us;
+    uint64_t p95Us;
+    uint64_t p99Us;
+    uint64_t maxUs;
+} latencyPercentiles;
+
+/****************************************************************************
+ * @brief    Function for reading monotonic time.
+ *
+ * @return   Current time in nanoseconds.
+****************************************************************************/
+uint64_t latencyNowNs();
+
+/****************************************************************************
+ * @brief    Function for adding one measurement to a stage histogram, safe to call from any thread.
+ *
+ * @param    stage - [in] Measured stage.
+ *           durationNs - [in] Measured duration in nanoseconds.
+****************************************************************************/
+void latencyRecord(latencyStage stage, uint64_t durationNs);
+
+/****************************************************************************
+ * @brief    Function for adding time passed since passed start to a stage histogram.
+ *
+ * @param    stage - [in] Measured stage.
+ *           startNs - [in] Stage start returned by latencyNowNs, 0 records nothing.
+****************************************************************************/
+void latencyRecordSince(latencyStage stage, uint64_t startNs);
+
+/****************************************************************************
+ * @brief    Function for marking the key press whose effects are being handled on the event loop.
+ *           The next flip is recorded as its input to photon latency.
+ *
+ * @param    timestampNs - [in] Kernel timestamp of the key event, 0 to clear.
+****************************************************************************/
+void latencyMarkInput(uint64_t timestampNs);
+
+/****************************************************************************
+ * @brief    Function for getting the marked key press timestamp.
+ *
+ * @return   Kernel timestamp of the key being handled, 0 if none.
+****************************************************************************/
+uint64_t latencyInputTimestamp();
+
+/****************************************************************************
+ * @brief    Function for recording the flip of a marked key press, called after the OSD is flipped.
+****************************************************************************/
+void latencyPhotonReached();
+
+/****************************************************************************
+ * @brief    Function for computing stage percentiles from a snapshot of its histogram.
+ *
+ * @param    stage - [in] Stage.
+ *           percentiles - [out] Measurement count, 50th, 95th and 99th percentile and maximum.
+****************************************************************************/
+void latencyGetPercentiles(latencyStage stage, latencyPercentiles *percentiles);
+
+/****************************************************************************
+ * @brief    Function for getting stage name.
+ *
+ * @param    stage - [in] Stage.
+ *
+ * @return   Stage name.
+****************************************************************************/
+const char *latencyStageName(latencyStage stage);
+
+/****************************************************************************
+ * @brief    Function for printing percentiles of all stages.
+****************************************************************************/
+void latencyPrintReport();
+
+#endif // _LATENCY_HISTOGRAM_H_
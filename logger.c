@@ -0,0 +1,538 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file logger.c
+ *
+ * \brief
+ * Implementation of the asynchronous logging module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "logger.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/* helper keywords needed only for logger module */
+#define LOGGER_RING_MASK (LOGGER_RING_SIZE - 1)
+#define LOGGER_MAX_ARGS 8
+#define LOGGER_TEXT_SIZE 96 // bytes for copied %s arguments of one record
+#define LOGGER_LINE_SIZE 512
+#define LOGGER_SPEC_SIZE 16
+
+#define COLOR_ERROR "\x1B[1;31;40m"
+#define COLOR_DEFAULT "\x1B[0;37;40m"
+
+typedef enum _loggerArgKind
+{
+    ARG_NONE = 0,
+    ARG_INT,
+    ARG_LONG,
+    ARG_LONG_LONG,
+    ARG_SIZE,
+    ARG_UNSIGNED,
+    ARG_UNSIGNED_LONG,
+    ARG_UNSIGNED_LONG_LONG,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_POINTER,
+    ARG_PERCENT,
+    ARG_UNSUPPORTED
+} loggerArgKind;
+
+typedef union _loggerArg
+{
+    int64_t integer;
+    uint64_t unsignedInteger;
+    double real;
+    const void *pointer;
+    uint32_t textOffset;
+} loggerArg;
+
+typedef struct _loggerRecord
+{
+    uint32_t sequence; // equals the write position when free, position + 1 when filled
+    uint8_t level;
+    uint8_t argCount;
+    uint64_t timestampNs;
+    const char *format;
+    loggerArg args[LOGGER_MAX_ARGS];
+    char text[LOGGER_TEXT_SIZE];
+} loggerRecord;
+
+/* helper variables needed only for logger module */
+static loggerRecord ring[LOGGER_RING_SIZE];
+static uint32_t writePosition;
+static uint32_t readPosition; // flusher only
+static uint32_t droppedRecords;
+static uint32_t droppedReported;
+static volatile uint8_t loggerRunning;
+static uint8_t exitHandlerRegistered;
+static pthread_t flusherThread;
+
+/* helper functions needed only for logger module */
+static const char *parseConversion(const char *spec, loggerArgKind *kind);
+static void captureArgs(loggerRecord *record, const char *format, va_list args);
+static void formatRecord(const loggerRecord *record, char *line, size_t lineSize);
+static uint32_t flushRecords();
+static void *flusherLoop(void *arg);
+static void exitHandler();
+
+loggerStatus loggerInit()
+{
+    uint32_t i;
+
+    if (loggerRunning)
+    {
+        return LOGGER_ERROR;
+    }
+
+    for (i = 0; i < LOGGER_RING_SIZE; i++)
+    {
+        ring[i].sequence = i;
+    }
+    writePosition = 0;
+    readPosition = 0;
+
+    __atomic_store_n(&loggerRunning, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&flusherThread, NULL, flusherLoop, NULL))
+    {
+        loggerRunning = 0;
+        printf("Error while creating logger thread!\n");
+        return LOGGER_ERROR;
+    }
+
+    if (!exitHandlerRegistered)
+    {
+        atexit(exitHandler);
+        exitHandlerRegistered = 1;
+    }
+
+    return LOGGER_NO_ERROR;
+}
+
+loggerStatus loggerDeinit()
+{
+    if (!loggerRunning)
+    {
+        return LOGGER_ERROR;
+    }
+
+    loggerRunning = 0;
+    pthread_join(flusherThread, NULL);
+    flushRecords();
+
+    return LOGGER_NO_ERROR;
+}
+
+void loggerWrite(uint8_t level, const char *format, ...)
+{
+    loggerRecord *record;
+    struct timespec now;
+    uint32_t position;
+    va_list args;
+
+    /* before the flusher runs and after it stops records are printed directly */
+    if (!__atomic_load_n(&loggerRunning, __ATOMIC_ACQUIRE))
+    {
+        va_start(args, format);
+        printf("%s", level == LOGGER_LEVEL_ERROR ? COLOR_ERROR : "");
+        vprintf(format, args);
+        printf("%s\n", level == LOGGER_LEVEL_ERROR ? COLOR_DEFAULT : "");
+        va_end(args);
+        return;
+    }
+
+    /* bounded multi producer queue, producers claim a slot by advancing the write position */
+    position = __atomic_load_n(&writePosition, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        int32_t difference;
+
+        record = &ring[position & LOGGER_RING_MASK];
+        difference = (int32_t)(__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) - position);
+        if (difference == 0)
+        {
+            if (__atomic_compare_exchange_n(&writePosition, &position, position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            __sync_fetch_and_add(&droppedRecords, 1);
+            return;
+        }
+        else
+        {
+            position = __atomic_load_n(&writePosition, __ATOMIC_RELAXED);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    record->timestampNs = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    record->level = level;
+    record->format = format;
+
+    va_start(args, format);
+    captureArgs(record, format, args);
+    va_end(args);
+
+    __atomic_store_n(&record->sequence, position + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t loggerDroppedCount()
+{
+    return __atomic_load_n(&droppedRecords, __ATOMIC_RELAXED);
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for parsing one printf conversion.
+ *
+ * @param    spec - [in] Pointer to the '%' character.
+ *           kind - [out] Type of the argument the conversion takes.
+ *
+ * @return   Pointer to the first character after the conversion.
+****************************************************************************/
+static const char *parseConversion(const char *spec, loggerArgKind *kind)
+{
+    uint8_t longCount = 0;
+    uint8_t sizeModifier = 0;
+
+    spec++;
+    while (*spec && strchr("-+ #0123456789.", *spec))
+    {
+        spec++;
+    }
+
+    while (*spec && strchr("hlzjt", *spec))
+    {
+        if (*spec == 'l')
+        {
+            longCount++;
+        }
+        else if (*spec == 'j')
+        {
+            longCount = 2;
+        }
+        else if (*spec == 'z' || *spec == 't')
+        {
+            sizeModifier = 1;
+        }
+        spec++;
+    }
+
+    switch (*spec)
+    {
+    case 'd':
+    case 'i':
+        *kind = sizeModifier ? ARG_SIZE : longCount == 0 ? ARG_INT : longCount == 1 ? ARG_LONG : ARG_LONG_LONG;
+        break;
+
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        *kind = sizeModifier ? ARG_SIZE : longCount == 0 ? ARG_UNSIGNED : longCount == 1 ? ARG_UNSIGNED_LONG : ARG_UNSIGNED_LONG_LONG;
+        break;
+
+    case 'c':
+        *kind = ARG_INT;
+        break;
+
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+        *kind = ARG_DOUBLE;
+        break;
+
+    case 's':
+        *kind = ARG_STRING;
+        break;
+
+    case 'p':
+        *kind = ARG_POINTER;
+        break;
+
+    case '%':
+        *kind = ARG_PERCENT;
+        break;
+
+    default:
+        /* %n, '*' widths and %L long double are not supported */
+        *kind = ARG_UNSUPPORTED;
+        return spec;
+    }
+
+    return spec + 1;
+}
+
+/****************************************************************************
+ * @brief    Function for copying arguments into the record, strings are copied into its text area.
+ *
+ * @param    record - [out] Record being written.
+ *           format - [in] printf style format.
+ *           args - [in] Arguments matching the format.
+****************************************************************************/
+static void captureArgs(loggerRecord *record, const char *format, va_list args)
+{
+    uint32_t textUsed = 0;
+    loggerArgKind kind;
+
+    record->argCount = 0;
+    while ((format = strchr(format, '%')) && record->argCount < LOGGER_MAX_ARGS)
+    {
+        loggerArg *arg = &record->args[record->argCount];
+
+        format = parseConversion(format, &kind);
+        switch (kind)
+        {
+        case ARG_INT:
+            arg->integer = va_arg(args, int);
+            break;
+        case ARG_LONG:
+            arg->integer = va_arg(args, long);
+            break;
+        case ARG_LONG_LONG:
+            arg->integer = va_arg(args, long long);
+            break;
+        case ARG_SIZE:
+            arg->unsignedInteger = va_arg(args, size_t);
+            break;
+        case ARG_UNSIGNED:
+            arg->unsignedInteger = va_arg(args, unsigned int);
+            break;
+        case ARG_UNSIGNED_LONG:
+            arg->unsignedInteger = va_arg(args, unsigned long);
+            break;
+        case ARG_UNSIGNED_LONG_LONG:
+            arg->unsignedInteger = va_arg(args, unsigned long long);
+            break;
+        case ARG_DOUBLE:
+            arg->real = va_arg(args, double);
+            break;
+        case ARG_POINTER:
+            arg->pointer = va_arg(args, void *);
+            break;
+        case ARG_STRING:
+        {
+            const char *text = va_arg(args, const char *);
+            uint32_t length;
+
+            /* long strings are truncated, once the area is full the rest print as empty */
+            text = text ? text : "(null)";
+            if (textUsed > LOGGER_TEXT_SIZE - 1)
+            {
+                textUsed = LOGGER_TEXT_SIZE - 1;
+            }
+            length = strlen(text);
+            if (length > LOGGER_TEXT_SIZE - 1 - textUsed)
+            {
+                length = LOGGER_TEXT_SIZE - 1 - textUsed;
+            }
+            memcpy(&record->text[textUsed], text, length);
+            record->text[textUsed + length] = '\0';
+            arg->textOffset = textUsed;
+            textUsed += length + 1;
+            break;
+        }
+        case ARG_PERCENT:
+            continue;
+        default:
+            return;
+        }
+        record->argCount++;
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for formatting a record into a text line.
+ *
+ * @param    record - [in] Filled record.
+ *           line - [out] Output buffer.
+ *           lineSize - [in] Output buffer size.
+****************************************************************************/
+static void formatRecord(const loggerRecord *record, char *line, size_t lineSize)
+{
+    const char *format = record->format;
+    char spec[LOGGER_SPEC_SIZE];
+    size_t used;
+    uint8_t argIndex = 0;
+    loggerArgKind kind;
+
+    used = snprintf(line, lineSize, "[%6llu.%06llu] ", (unsigned long long)(record->timestampNs / 1000000000ULL),
+                    (unsigned long long)(record->timestampNs / 1000 % 1000000));
+
+    while (*format && used < lineSize - 1)
+    {
+        const char *end;
+        const loggerArg *arg;
+        size_t specLength;
+        int32_t written = 0;
+
+        if (*format != '%')
+        {
+            line[used++] = *format++;
+            continue;
+        }
+
+        end = parseConversion(format, &kind);
+        if (kind == ARG_PERCENT)
+        {
+            line[used++] = '%';
+            format = end;
+            continue;
+        }
+        if (kind == ARG_UNSUPPORTED || argIndex >= record->argCount)
+        {
+            /* print the rest of the format as it is */
+            written = snprintf(line + used, lineSize - used, "%s", format);
+            used += written > 0 ? (size_t)written : 0;
+            break;
+        }
+
+        specLength = end - format < LOGGER_SPEC_SIZE ? (size_t)(end - format) : LOGGER_SPEC_SIZE - 1;
+        memcpy(spec, format, specLength);
+        spec[specLength] = '\0';
+        arg = &record->args[argIndex++];
+
+        switch (kind)
+        {
+        case ARG_INT:
+            written = snprintf(line + used, lineSize - used, spec, (int)arg->integer);
+            break;
+        case ARG_LONG:
+            written = snprintf(line + used, lineSize - used, spec, (long)arg->integer);
+            break;
+        case ARG_LONG_LONG:
+            written = snprintf(line + used, lineSize - used, spec, (long long)arg->integer);
+            break;
+        case ARG_SIZE:
+            written = snprintf(line + used, lineSize - used, spec, (size_t)arg->unsignedInteger);
+            break;
+        case ARG_UNSIGNED:
+            written = snprintf(line + used, lineSize - used, spec, (unsigned int)arg->unsignedInteger);
+            break;
+        case ARG_UNSIGNED_LONG:
+            written = snprintf(line + used, lineSize - used, spec, (unsigned long)arg->unsignedInteger);
+            break;
+        case ARG_UNSIGNED_LONG_LONG:
+            written = snprintf(line + used, lineSize - used, spec, (unsigned long long)arg->unsignedInteger);
+            break;
+        case ARG_DOUBLE:
+            written = snprintf(line + used, lineSize - used, spec, arg->real);
+            break;
+        case ARG_POINTER:
+            written = snprintf(line + used, lineSize - used, spec, arg->pointer);
+            break;
+        case ARG_STRING:
+            written = snprintf(line + used, lineSize - used, spec, &record->text[arg->textOffset]);
+            break;
+        default:
+            break;
+        }
+
+        used += written > 0 ? (size_t)written : 0;
+        format = end;
+    }
+
+    line[used < lineSize ? used : lineSize - 1] = '\0';
+}
+
+/****************************************************************************
+ * @brief    Function for printing all filled records, called by one thread at a time.
+ *
+ * @return   Number of printed records.
+****************************************************************************/
+static uint32_t flushRecords()
+{
+    char line[LOGGER_LINE_SIZE];
+    uint32_t flushed = 0;
+    uint32_t dropped;
+
+    for (;;)
+    {
+        loggerRecord *record = &ring[readPosition & LOGGER_RING_MASK];
+
+        if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) != readPosition + 1)
+        {
+            break;
+        }
+
+        formatRecord(record, line, sizeof(line));
+        if (record->level == LOGGER_LEVEL_ERROR)
+        {
+            printf(COLOR_ERROR "%s" COLOR_DEFAULT "\n", line);
+        }
+        else
+        {
+            printf("%s\n", line);
+        }
+
+        /* hand the slot back to producers one lap later */
+        __atomic_store_n(&record->sequence, readPosition + LOGGER_RING_SIZE, __ATOMIC_RELEASE);
+        readPosition++;
+        flushed++;
+    }
+
+    dropped = __atomic_load_n(&droppedRecords, __ATOMIC_RELAXED);
+    if (dropped != droppedReported)
+    {
+        printf("%u log records dropped, logger ring is full!\n", dropped - droppedReported);
+        droppedReported = dropped;
+    }
+
+    if (flushed)
+    {
+        fflush(stdout);
+    }
+    return flushed;
+}
+
+/****************************************************************************
+ * @brief    Flusher thread, prints records every LOGGER_FLUSH_INTERVAL_MS.
+ *
+ * @param    arg - [in] Unused.
+****************************************************************************/
+static void *flusherLoop(void *arg)
+{
+    struct timespec interval;
+
+    (void)arg;
+    interval.tv_sec = 0;
+    interval.tv_nsec = LOGGER_FLUSH_INTERVAL_MS * 1000000L;
+
+    while (loggerRunning)
+    {
+        flushRecords();
+        nanosleep(&interval, NULL);
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function called on process exit, prints records left by an early return from main.
+****************************************************************************/
+static void exitHandler()
+{
+    loggerDeinit();
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
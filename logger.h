@@ -0,0 +1,110 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file logger.h
+ *
+ * \brief
+ * Header of the asynchronous logging module. Log calls copy the format pointer and the
+ * arguments into a binary record in a lock-free ring, a flusher thread formats and prints
+ * them. Levels below LOGGER_COMPILE_LEVEL are removed at compile time (make LOG_LEVEL=DEBUG
+ * keeps all of them).
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+#include <stdint.h>
+
+/* plain defines so the compile level can be compared by the preprocessor */
+#define LOGGER_LEVEL_DEBUG 0
+#define LOGGER_LEVEL_INFO 1
+#define LOGGER_LEVEL_WARN 2
+#define LOGGER_LEVEL_ERROR 3
+
+#ifndef LOGGER_COMPILE_LEVEL
+#define LOGGER_COMPILE_LEVEL LOGGER_LEVEL_INFO
+#endif
+
+#define LOGGER_RING_SIZE 1024 // records, must be a power of two
+#define LOGGER_FLUSH_INTERVAL_MS 20
+
+typedef enum _loggerStatus
+{
+    LOGGER_NO_ERROR = 0,
+    LOGGER_ERROR
+} loggerStatus;
+
+/* format strings are stored by pointer and must be literals, %s arguments are copied */
+#if LOGGER_COMPILE_LEVEL <= LOGGER_LEVEL_DEBUG
+#define LOG_DEBUG(...) loggerWrite(LOGGER_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) \
+    do                 \
+    {                  \
+    } while (0)
+#endif
+
+#if LOGGER_COMPILE_LEVEL <= LOGGER_LEVEL_INFO
+#define LOG_INFO(...) loggerWrite(LOGGER_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) \
+    do                \
+    {                 \
+    } while (0)
+#endif
+
+#if LOGGER_COMPILE_LEVEL <= LOGGER_LEVEL_WARN
+#define LOG_WARN(...) loggerWrite(LOGGER_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) \
+    do                \
+    {                 \
+    } while (0)
+#endif
+
+#define LOG_ERROR(...) loggerWrite(LOGGER_LEVEL_ERROR, __VA_ARGS__)
+
+/****************************************************************************
+ * @brief    Function for starting the flusher thread. Records are drained on exit,
+ *           so errors logged right before returning from main are not lost.
+ *
+ * @return   LOGGER_NO_ERROR, if there are no errors.
+ *           LOGGER_ERROR, in case of an error.
+****************************************************************************/
+loggerStatus loggerInit();
+
+/****************************************************************************
+ * @brief    Function for stopping the flusher thread and printing the remaining records.
+ *
+ * @return   LOGGER_NO_ERROR, if there are no errors.
+ *           LOGGER_ERROR, in case of an error.
+****************************************************************************/
+loggerStatus loggerDeinit();
+
+/****************************************************************************
+ * @brief    Function for queueing one log record, safe to call from any thread.
+ *           Never blocks, the record is dropped and counted if the ring is full.
+ *           Supported conversions are the integer and floating point ones, %c, %s, %p and %%.
+ *
+ * @param    level - [in] Record level.
+ *           format - [in] printf style format, must live until the record is flushed.
+****************************************************************************/
+void loggerWrite(uint8_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/****************************************************************************
+ * @brief    Function for getting the number of records dropped because the ring was full.
+ *
+ * @return   Dropped record count.
+****************************************************************************/
+uint32_t loggerDroppedCount();
+
+#endif // _LOGGER_H_
@@ -0,0 +1,415 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file metrics.c
+ *
+ * \brief
+ * Implementation of the runtime metrics module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "metrics.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* helper keywords needed only for metrics module */
+#define REQUEST_WAIT_MS 100 // time a client has to send an HTTP request line before plain text is sent
+#define REQUEST_MAX 512
+
+typedef struct _metricEntry
+{
+    metricsType type;
+    const char *name;
+    const char *help;
+    metricsReadFunction read;
+    int64_t value;
+    uint32_t boundCount;
+    uint64_t bounds[METRICS_MAX_BUCKETS];
+    uint64_t bucketCounts[METRICS_MAX_BUCKETS + 1]; // last bucket is +Inf
+    uint64_t sum;
+    double unitScale;
+} metricEntry;
+
+/* helper variables needed only for metrics module */
+static metricEntry metrics[METRICS_MAX];
+static uint32_t metricCount; // entries below are complete, published with a release store
+static pthread_mutex_t registerMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int32_t listenFileDesc = -1;
+static char socketFilePath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static pthread_t serverThread;
+
+/* helper functions needed only for metrics module */
+static metricsStatus addEntry(metricsType type, const char *name, const char *help, metricsReadFunction read,
+                              const uint64_t *bounds, uint32_t boundCount, double unitScale, int32_t *metricId);
+static uint32_t familyLength(const char *name);
+static void writeEntry(FILE *output, const metricEntry *entry, uint8_t writeHeader);
+static void serveClient(int32_t clientFileDesc);
+static void *serverLoop(void *arg);
+
+metricsStatus metricsInit(const char *socketPath)
+{
+    struct sockaddr_un address;
+
+    if (listenFileDesc != -1 || strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        return METRICS_ERROR;
+    }
+
+    listenFileDesc = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFileDesc == -1)
+    {
+        printf("Error while creating metrics socket!\n");
+        return METRICS_ERROR;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+    strcpy(socketFilePath, socketPath);
+
+    /* a socket left by a previous run would make bind fail */
+    unlink(socketPath);
+    if (bind(listenFileDesc, (struct sockaddr *)&address, sizeof(address)) || listen(listenFileDesc, 4))
+    {
+        printf("Error while binding metrics socket %s!\n", socketPath);
+        close(listenFileDesc);
+        listenFileDesc = -1;
+        return METRICS_ERROR;
+    }
+
+    if (pthread_create(&serverThread, NULL, serverLoop, NULL))
+    {
+        close(listenFileDesc);
+        listenFileDesc = -1;
+        unlink(socketPath);
+        return METRICS_ERROR;
+    }
+
+    return METRICS_NO_ERROR;
+}
+
+metricsStatus metricsDeinit()
+{
+    if (listenFileDesc == -1)
+    {
+        return METRICS_ERROR;
+    }
+
+    /* wakes accept in the server thread */
+    shutdown(listenFileDesc, SHUT_RDWR);
+    pthread_join(serverThread, NULL);
+    close(listenFileDesc);
+    listenFileDesc = -1;
+    unlink(socketFilePath);
+
+    return METRICS_NO_ERROR;
+}
+
+metricsStatus metricsRegister(metricsType type, const char *name, const char *help, int32_t *metricId)
+{
+    if (type == METRICS_TYPE_HISTOGRAM || !metricId)
+    {
+        return METRICS_ERROR;
+    }
+
+    return addEntry(type, name, help, NULL, NULL, 0, 1.0, metricId);
+}
+
+metricsStatus metricsRegisterCallback(metricsType type, const char *name, const char *help, metricsReadFunction read)
+{
+    int32_t metricId;
+
+    if (type == METRICS_TYPE_HISTOGRAM || !read)
+    {
+        return METRICS_ERROR;
+    }
+
+    return addEntry(type, name, help, read, NULL, 0, 1.0, &metricId);
+}
+
+metricsStatus metricsRegisterHistogram(const char *name, const char *help, const uint64_t *bounds, uint32_t boundCount,
+                                       double unitScale, int32_t *metricId)
+{
+    if (!bounds || !boundCount || boundCount > METRICS_MAX_BUCKETS || !metricId)
+    {
+        return METRICS_ERROR;
+    }
+
+    return addEntry(METRICS_TYPE_HISTOGRAM, name, help, NULL, bounds, boundCount, unitScale, metricId);
+}
+
+void metricsAdd(int32_t metricId, int64_t value)
+{
+    if (metricId < 0 || metricId >= METRICS_MAX)
+    {
+        return;
+    }
+
+    __sync_fetch_and_add(&metrics[metricId].value, value);
+}
+
+void metricsSet(int32_t metricId, int64_t value)
+{
+    if (metricId < 0 || metricId >= METRICS_MAX)
+    {
+        return;
+    }
+
+    __atomic_store_n(&metrics[metricId].value, value, __ATOMIC_RELAXED);
+}
+
+void metricsObserve(int32_t metricId, uint64_t value)
+{
+    metricEntry *entry;
+    uint32_t bucket;
+
+    if (metricId < 0 || metricId >= METRICS_MAX)
+    {
+        return;
+    }
+    entry = &metrics[metricId];
+
+    for (bucket = 0; bucket < entry->boundCount && value > entry->bounds[bucket]; bucket++)
+    {
+    }
+
+    /* buckets are exported cumulatively, each observation lands in one of them only */
+    __sync_fetch_and_add(&entry->bucketCounts[bucket], 1);
+    __sync_fetch_and_add(&entry->sum, value);
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for adding a registry entry, or finding an existing one with the same name.
+ *
+ * @param    type - [in] Metric type.
+ *           name - [in] Metric name.
+ *           help - [in] Description.
+ *           read - [in] Value function, NULL for values updated by the caller.
+ *           bounds - [in] Histogram bucket bounds, NULL for other types.
+ *           boundCount - [in] Number of bounds.
+ *           unitScale - [in] Factor for exported histogram values.
+ *           metricId - [out] Entry index.
+ *
+ * @return   METRICS_NO_ERROR, if there are no errors.
+ *           METRICS_ERROR, if the registry is full or the name exists with another type.
+****************************************************************************/
+static metricsStatus addEntry(metricsType type, const char *name, const char *help, metricsReadFunction read,
+                              const uint64_t *bounds, uint32_t boundCount, double unitScale, int32_t *metricId)
+{
+    metricEntry *entry;
+    uint32_t i;
+
+    pthread_mutex_lock(&registerMutex);
+
+    for (i = 0; i < metricCount; i++)
+    {
+        if (!strcmp(metrics[i].name, name))
+        {
+            pthread_mutex_unlock(&registerMutex);
+            if (metrics[i].type != type)
+            {
+                return METRICS_ERROR;
+            }
+            *metricId = i;
+            return METRICS_NO_ERROR;
+        }
+    }
+
+    if (metricCount == METRICS_MAX)
+    {
+        pthread_mutex_unlock(&registerMutex);
+        printf("Metrics: registry full, %s not registered!\n", name);
+        return METRICS_ERROR;
+    }
+
+    entry = &metrics[metricCount];
+    memset(entry, 0, sizeof(*entry));
+    entry->type = type;
+    entry->name = name;
+    entry->help = help;
+    entry->read = read;
+    entry->boundCount = boundCount;
+    entry->unitScale = unitScale;
+    if (bounds)
+    {
+        memcpy(entry->bounds, bounds, boundCount * sizeof(bounds[0]));
+    }
+
+    *metricId = metricCount;
+    __atomic_store_n(&metricCount, metricCount + 1, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&registerMutex);
+    return METRICS_NO_ERROR;
+}
+
+/****************************************************************************
+ * @brief    Function for getting the length of the metric family name, the name without labels.
+ *
+ * @param    name - [in] Metric name.
+ *
+ * @return   Family name length.
+****************************************************************************/
+static uint32_t familyLength(const char *name)
+{
+    const char *labels = strchr(name, '{');
+
+    return labels ? (uint32_t)(labels - name) : strlen(name);
+}
+
+/****************************************************************************
+ * @brief    Function for writing one metric in the Prometheus text format.
+ *
+ * @param    output - [in] Output stream.
+ *           entry - [in] Metric entry.
+ *           writeHeader - [in] 1 if HELP and TYPE lines of the family are written.
+****************************************************************************/
+static void writeEntry(FILE *output, const metricEntry *entry, uint8_t writeHeader)
+{
+    static const char *typeNames[] = {"counter", "gauge", "histogram"};
+    uint32_t length = familyLength(entry->name);
+    const char *labels = entry->name + length;
+    uint64_t cumulative = 0;
+    uint32_t i;
+
+    if (writeHeader)
+    {
+        fprintf(output, "# HELP %.*s %s\n", length, entry->name, entry->help);
+        fprintf(output, "# TYPE %.*s %s\n", length, entry->name, typeNames[entry->type]);
+    }
+
+    if (entry->type != METRICS_TYPE_HISTOGRAM)
+    {
+        fprintf(output, "%s %lld\n", entry->name,
+                (long long)(entry->read ? entry->read() : __atomic_load_n(&entry->value, __ATOMIC_RELAXED)));
+        return;
+    }
+
+    /* histogram labels are not supported, buckets use the le label */
+    for (i = 0; i <= entry->boundCount; i++)
+    {
+        cumulative += __atomic_load_n(&entry->bucketCounts[i], __ATOMIC_RELAXED);
+        if (i < entry->boundCount)
+        {
+            fprintf(output, "%.*s_bucket{le=\"%g\"} %llu\n", length, entry->name, entry->bounds[i] * entry->unitScale,
+                    (unsigned long long)cumulative);
+        }
+        else
+        {
+            fprintf(output, "%.*s_bucket{le=\"+Inf\"} %llu\n", length, entry->name, (unsigned long long)cumulative);
+        }
+    }
+    fprintf(output, "%.*s_sum%s %g\n", length, entry->name, labels,
+            __atomic_load_n(&entry->sum, __ATOMIC_RELAXED) * entry->unitScale);
+    fprintf(output, "%.*s_count%s %llu\n", length, entry->name, labels, (unsigned long long)cumulative);
+}
+
+/****************************************************************************
+ * @brief    Function for answering one client. Clients sending an HTTP request
+ *           (curl --unix-socket) get an HTTP response, others get plain text.
+ *
+ * @param    clientFileDesc - [in] Accepted connection.
+****************************************************************************/
+static void serveClient(int32_t clientFileDesc)
+{
+    struct pollfd request;
+    char requestLine[REQUEST_MAX];
+    uint8_t http = 0;
+    char *text = NULL;
+    size_t textSize = 0;
+    size_t written = 0;
+    uint32_t count;
+    uint32_t i;
+    FILE *output;
+
+    request.fd = clientFileDesc;
+    request.events = POLLIN;
+    if (poll(&request, 1, REQUEST_WAIT_MS) > 0)
+    {
+        ssize_t length = recv(clientFileDesc, requestLine, sizeof(requestLine) - 1, 0);
+
+        http = length >= 4 && !memcmp(requestLine, "GET ", 4);
+    }
+
+    output = open_memstream(&text, &textSize);
+    if (!output)
+    {
+        return;
+    }
+
+    if (http)
+    {
+        fprintf(output, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n");
+    }
+
+    count = __atomic_load_n(&metricCount, __ATOMIC_ACQUIRE);
+    for (i = 0; i < count; i++)
+    {
+        /* labelled metrics of one family are registered next to each other and share the header */
+        uint8_t writeHeader = !i || familyLength(metrics[i].name) != familyLength(metrics[i - 1].name) ||
+                              strncmp(metrics[i].name, metrics[i - 1].name, familyLength(metrics[i].name));
+
+        writeEntry(output, &metrics[i], writeHeader);
+    }
+    fclose(output);
+
+    while (written < textSize)
+    {
+        ssize_t result = send(clientFileDesc, text + written, textSize - written, MSG_NOSIGNAL);
+
+        if (result <= 0 && errno != EINTR)
+        {
+            break;
+        }
+        written += result > 0 ? (size_t)result : 0;
+    }
+
+    free(text);
+}
+
+/****************************************************************************
+ * @brief    Metrics server thread, answers one connection at a time until the socket is shut down.
+ *
+ * @param    arg - [in] Unused.
+****************************************************************************/
+static void *serverLoop(void *arg)
+{
+    (void)arg;
+
+    for (;;)
+    {
+        int32_t clientFileDesc = accept(listenFileDesc, NULL, NULL);
+
+        if (clientFileDesc == -1)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            break;
+        }
+
+        serveClient(clientFileDesc);
+        close(clientFileDesc);
+    }
+
+    return NULL;
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
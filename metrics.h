@@ -0,0 +1,133 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file metrics.h
+ *
+ * \brief
+ * Header of the runtime metrics module. Modules register counters, gauges and histograms
+ * once and update them with atomic operations, a server thread serves all of them in the
+ * Prometheus text format over a Unix domain socket.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stdint.h>
+
+#define METRICS_MAX 48
+#define METRICS_MAX_BUCKETS 16
+#define METRICS_SOCKET_PATH "/tmp/tv_app_metrics.sock"
+
+typedef enum _metricsStatus
+{
+    METRICS_NO_ERROR = 0,
+    METRICS_ERROR
+} metricsStatus;
+
+typedef enum _metricsType
+{
+    METRICS_TYPE_COUNTER = 0,
+    METRICS_TYPE_GAUGE,
+    METRICS_TYPE_HISTOGRAM
+} metricsType;
+
+/* value source read by the server thread on every scrape */
+typedef int64_t (*metricsReadFunction)();
+
+/****************************************************************************
+ * @brief    Function for starting the metrics server thread. Metrics may be registered
+ *           and updated before the server is started.
+ *
+ * @param    socketPath - [in] Path of the Unix domain socket, replaced if it exists.
+ *
+ * @return   METRICS_NO_ERROR, if there are no errors.
+ *           METRICS_ERROR, in case of an error.
+****************************************************************************/
+metricsStatus metricsInit(const char *socketPath);
+
+/****************************************************************************
+ * @brief    Function for stopping the metrics server thread and removing the socket.
+ *
+ * @return   METRICS_NO_ERROR, if there are no errors.
+ *           METRICS_ERROR, in case of an error.
+****************************************************************************/
+metricsStatus metricsDeinit();
+
+/****************************************************************************
+ * @brief    Function for registering a counter or a gauge updated by the caller.
+ *           Registering an existing name again returns the same metric.
+ *
+ * @param    type - [in] METRICS_TYPE_COUNTER or METRICS_TYPE_GAUGE.
+ *           name - [in] Metric name, may end with labels, e.g. name{table="pat"}. Must be a literal.
+ *           help - [in] Description printed for the metric family. Must be a literal.
+ *           metricId - [out] Identifier passed to update functions.
+ *
+ * @return   METRICS_NO_ERROR, if there are no errors.
+ *           METRICS_ERROR, in case of an error.
+****************************************************************************/
+metricsStatus metricsRegister(metricsType type, const char *name, const char *help, int32_t *metricId);
+
+/****************************************************************************
+ * @brief    Function for registering a counter or a gauge whose value is read on every scrape.
+ *
+ * @param    type - [in] METRICS_TYPE_COUNTER or METRICS_TYPE_GAUGE.
+ *           name - [in] Metric name. Must be a literal.
+ *           help - [in] Description. Must be a literal.
+ *           read - [in] Function returning the current value, called from the server thread.
+ *
+ * @return   METRICS_NO_ERROR, if there are no errors.
+ *           METRICS_ERROR, in case of an error.
+****************************************************************************/
+metricsStatus metricsRegisterCallback(metricsType type, const char *name, const char *help, metricsReadFunction read);
+
+/****************************************************************************
+ * @brief    Function for registering a histogram.
+ *
+ * @param    name - [in] Metric name. Must be a literal.
+ *           help - [in] Description. Must be a literal.
+ *           bounds - [in] Ascending bucket upper bounds in observed units, at most METRICS_MAX_BUCKETS.
+ *           boundCount - [in] Number of bounds.
+ *           unitScale - [in] Factor converting observed units to exported ones (1e-6 for us to seconds).
+ *           metricId - [out] Identifier passed to metricsObserve.
+ *
+ * @return   METRICS_NO_ERROR, if there are no errors.
+ *           METRICS_ERROR, in case of an error.
+****************************************************************************/
+metricsStatus metricsRegisterHistogram(const char *name, const char *help, const uint64_t *bounds, uint32_t boundCount,
+                                       double unitScale, int32_t *metricId);
+
+/****************************************************************************
+ * @brief    Function for adding to a counter or a gauge. Invalid identifiers are ignored,
+ *           so an unregistered metric never breaks the caller.
+ *
+ * @param    metricId - [in] Metric identifier.
+ *           value - [in] Value to add.
+****************************************************************************/
+void metricsAdd(int32_t metricId, int64_t value);
+
+/****************************************************************************
+ * @brief    Function for setting a gauge.
+ *
+ * @param    metricId - [in] Metric identifier.
+ *           value - [in] New value.
+****************************************************************************/
+void metricsSet(int32_t metricId, int64_t value);
+
+/****************************************************************************
+ * @brief    Function for recording one histogram observation.
+ *
+ * @param    metricId - [in] Metric identifier.
+ *           value - [in] Observed value in the units of the bucket bounds.
+****************************************************************************/
+void metricsObserve(int32_t metricId, uint64_t value);
+
+#endif // _METRICS_H_
@@ -0,0 +1,498 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file osd_kernels.c
+ *
+ * \brief
+ * Implementation of the module with pixel kernels for software and offscreen OSD rendering.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "osd_kernels.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OSD_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OSD_KERNELS_ARM_NEON
+#include <arm_neon.h>
+#if defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+/* helper macro functions needed only for osd kernels module */
+/* exact rounded division by 255 for values up to 255 * 255 */
+#define DIV255(x) (((x) + 128 + (((x) + 128) >> 8)) >> 8)
+
+typedef struct _osdKernelTable
+{
+    void (*fill)(uint32_t *destination, uint32_t count, uint32_t color);
+    void (*copy)(uint32_t *destination, const uint32_t *source, uint32_t count);
+    void (*blend)(uint32_t *destination, const uint32_t *source, uint32_t count);
+    void (*blitGlyph)(uint32_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color);
+} osdKernelTable;
+
+/* helper functions needed only for osd kernels module */
+static uint8_t variantSupported(osdKernelsVariant variant);
+static uint32_t blendPixel(uint32_t destination, uint32_t source);
+static uint32_t glyphPixel(uint32_t color, uint8_t coverage);
+
+/* kernel variants needed only for osd kernels module */
+static void fillScalar(uint32_t *destination, uint32_t count, uint32_t color);
+static void copyScalar(uint32_t *destination, const uint32_t *source, uint32_t count);
+static void blendScalar(uint32_t *destination, const uint32_t *source, uint32_t count);
+static void blitGlyphScalar(uint32_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color);
+
+#ifdef OSD_KERNELS_X86
+static void fillSSE2(uint32_t *destination, uint32_t count, uint32_t color);
+static void blendSSE2(uint32_t *destination, const uint32_t *source, uint32_t count);
+static void blitGlyphSSE2(uint32_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color);
+static void fillAVX2(uint32_t *destination, uint32_t count, uint32_t color);
+static void blendAVX2(uint32_t *destination, const uint32_t *source, uint32_t count);
+static void blitGlyphAVX2(uint32_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color);
+#endif
+
+#ifdef OSD_KERNELS_ARM_NEON
+static void fillNEON(uint32_t *destination, uint32_t count, uint32_t color);
+static void copyNEON(uint32_t *destination, const uint32_t *source, uint32_t count);
+static void blendNEON(uint32_t *destination, const uint32_t *source, uint32_t count);
+static void blitGlyphNEON(uint32_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color);
+#endif
+
+/* helper variables needed only for osd kernels module */
+static const osdKernelTable kernelTables[OSD_KERNELS_VARIANT_COUNT] = {
+    {fillScalar, copyScalar, blendScalar, blitGlyphScalar},
+#ifdef OSD_KERNELS_X86
+    /* glibc memmove already dispatches to vector copies on x86, hand written ones only lose to it */
+    {fillSSE2, copyScalar, blendSSE2, blitGlyphSSE2},
+    {fillAVX2, copyScalar, blendAVX2, blitGlyphAVX2},
+#else
+    {NULL, NULL, NULL, NULL},
+    {NULL, NULL, NULL, NULL},
+#endif
+#ifdef OSD_KERNELS_ARM_NEON
+    {fillNEON, copyNEON, blendNEON, blitGlyphNEON},
+#else
+    {NULL, NULL, NULL, NULL},
+#endif
+};
+
+static const char *variantNames[OSD_KERNELS_VARIANT_COUNT] = {"scalar", "SSE2", "AVX2", "NEON"};
+
+static const osdKernelTable *kernels = &kernelTables[OSD_KERNELS_SCALAR];
+
+void osdKernelsInit()
+{
+    int32_t variant;
+
+    for (variant = OSD_KERNELS_VARIANT_COUNT - 1; variant > OSD_KERNELS_SCALAR; variant--)
+    {
+        if (variantSupported(variant))
+            break;
+    }
+
+    kernels = &kernelTables[variant];
+}
+
+osdKernelsStatus osdKernelsSelect(osdKernelsVariant variant)
+{
+    if (variant >= OSD_KERNELS_VARIANT_COUNT || !variantSupported(variant))
+    {
+        return OSD_KERNELS_ERROR;
+    }
+
+    kernels = &kernelTables[variant];
+    return OSD_KERNELS_NO_ERROR;
+}
+
+const char *osdKernelsName(osdKernelsVariant variant)
+{
+    return variant < OSD_KERNELS_VARIANT_COUNT ? variantNames[variant] : "unknown";
+}
+
+void osdFill(uint32_t *destination, uint32_t count, uint32_t color)
+{
+    kernels->fill(destination, count, color);
+}
+
+void osdCopy(uint32_t *destination, const uint32_t *source, uint32_t count)
+{
+    kernels->copy(destination, source, count);
+}
+
+void osdBlend(uint32_t *destination, const uint32_t *source, uint32_t count)
+{
+    kernels->blend(destination, source, count);
+}
+
+void osdBlitGlyph(uint32_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color)
+{
+    kernels->blitGlyph(destination, coverage, count, color);
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for checking if kernel variant is built in and supported by the CPU.
+ *
+ * @param    variant - [in] Kernel variant.
+ *
+ * @return   1, if the variant can be used.
+ *           0, otherwise.
+****************************************************************************/
+static uint8_t variantSupported(osdKernelsVariant variant)
+{
+    if (!kernelTables[variant].fill)
+    {
+        return 0;
+    }
+
+    switch (variant)
+    {
+#ifdef OSD_KERNELS_X86
+    case OSD_KERNELS_SSE2:
+        return __builtin_cpu_supports("sse2") ? 1 : 0;
+
+    case OSD_KERNELS_AVX2:
+        return __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+
+#ifdef OSD_KERNELS_ARM_NEON
+    case OSD_KERNELS_NEON:
+#if defined(__arm__)
+        return (getauxval(AT_HWCAP) & HWCAP_NEON) ? 1 : 0;
+#else
+        return 1;
+#endif
+#endif
+
+    default:
+        return 1;
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for blending one premultiplied pixel over another.
+ *
+ * @param    destination - [in] Destination pixel.
+ *           source - [in] Source pixel.
+ *
+ * @return   Blended pixel.
+****************************************************************************/
+static uint32_t blendPixel(uint32_t destination, uint32_t source)
+{
+    uint32_t inverse = 255 - (source >> 24);
+    uint32_t result = 0;
+    uint32_t shift;
+
+    for (shift = 0; shift < 32; shift += 8)
+    {
+        uint32_t channel = ((source >> shift) & 0xff) + DIV255(((destination >> shift) & 0xff) * inverse);
+        result |= (channel > 255 ? 255 : channel) << shift;
+    }
+
+    return result;
+}
+
+/****************************************************************************
+ * @brief    Function for scaling a premultiplied colour by glyph coverage.
+ *
+ * @param    color - [in] Premultiplied colour.
+ *           coverage - [in] Glyph coverage value.
+ *
+ * @return   Premultiplied source pixel.
+****************************************************************************/
+static uint32_t glyphPixel(uint32_t color, uint8_t coverage)
+{
+    return (DIV255((color >> 24) * coverage) << 24) |
+           (DIV255(((color >> 16) & 0xff) * coverage) << 16) |
+           (DIV255(((color >> 8) & 0xff) * coverage) << 8) |
+           DIV255((color & 0xff) * coverage);
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
+
+/* -------------------- SCALAR KERNELS -------------------- */
+static void fillScalar(uint32_t *destination, uint32_t count, uint32_t color)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++)
+    {
+        destination[i] = color;
+    }
+}
+
+static void copyScalar(uint32_t *destination, const uint32_t *source, uint32_t count)
+{
+    memmove(destination, source, count * sizeof(uint32_t));
+}
+
+static void blendScalar(uint32_t *destination, const uint32_t *source, uint32_t count)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++)
+    {
+        destination[i] = blendPixel(destination[i], source[i]);
+    }
+}
+
+static void blitGlyphScalar(uint32_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++)
+    {
+        if (coverage[i])
+        {
+            destination[i] = blendPixel(destination[i], glyphPixel(color, coverage[i]));
+        }
+    }
+}
+/* -------------------- SCALAR KERNELS -------------------- */
+
+#ifdef OSD_KERNELS_X86
+/* -------------------- SSE2 KERNELS -------------------- */
+/* rounded division by 255 of eight 16-bit lanes, same result as DIV255 */
+#define DIV255_SSE2(x) _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16((x), _mm_set1_epi16(128)), \
+                                                    _mm_srli_epi16(_mm_add_epi16((x), _mm_set1_epi16(128)), 8)), 8)
+
+/* source-over of two pixels unpacked to 16-bit lanes */
+#define BLEND_SSE2(d16, s16) _mm_add_epi16((s16), DIV255_SSE2(_mm_mullo_epi16((d16),                                   \
+                                                                              _mm_sub_epi16(_mm_set1_epi16(255),      \
+                                                                                            _mm_shufflehi_epi16(      \
+                                                                                                _mm_shufflelo_epi16(  \
+                                                                                                    (s16), 0xff),     \
+                                                                                                0xff)))))
+
+__attribute__((target("sse2"))) static void fillSSE2(uint32_t *destination, uint32_t count, uint32_t color)
+{
+    __m128i value = _mm_set1_epi32(color);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_si128((__m128i *)(destination + i), value);
+    }
+    fillScalar(destination + i, count - i, color);
+}
+
+__attribute__((target("sse2"))) static void blendSSE2(uint32_t *destination, const uint32_t *source, uint32_t count)
+{
+    __m128i zero = _mm_setzero_si128();
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)(source + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(destination + i));
+
+        __m128i low = BLEND_SSE2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+        __m128i high = BLEND_SSE2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+
+        _mm_storeu_si128((__m128i *)(destination + i), _mm_packus_epi16(low, high));
+    }
+    blendScalar(destination + i, source + i, count - i);
+}
+
+__attribute__((target("sse2"))) static void blitGlyphSSE2(uint32_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i color16 = _mm_unpacklo_epi8(_mm_set1_epi32(color), zero);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32_t packedCoverage;
+        memcpy(&packedCoverage, coverage + i, sizeof(packedCoverage));
+        if (!packedCoverage)
+            continue;
+
+        /* spread each coverage byte over the four 16-bit channel lanes of its pixel */
+        __m128i coverage32 = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packedCoverage), zero), zero);
+        coverage32 = _mm_or_si128(coverage32, _mm_slli_epi32(coverage32, 16));
+
+        __m128i d = _mm_loadu_si128((const __m128i *)(destination + i));
+        __m128i sourceLow = DIV255_SSE2(_mm_mullo_epi16(color16, _mm_unpacklo_epi32(coverage32, coverage32)));
+        __m128i sourceHigh = DIV255_SSE2(_mm_mullo_epi16(color16, _mm_unpackhi_epi32(coverage32, coverage32)));
+
+        __m128i low = BLEND_SSE2(_mm_unpacklo_epi8(d, zero), sourceLow);
+        __m128i high = BLEND_SSE2(_mm_unpackhi_epi8(d, zero), sourceHigh);
+
+        _mm_storeu_si128((__m128i *)(destination + i), _mm_packus_epi16(low, high));
+    }
+    blitGlyphScalar(destination + i, coverage + i, count - i, color);
+}
+/* -------------------- SSE2 KERNELS -------------------- */
+
+/* -------------------- AVX2 KERNELS -------------------- */
+/* rounded division by 255 of sixteen 16-bit lanes, same result as DIV255 */
+#define DIV255_AVX2(x) _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16((x), _mm256_set1_epi16(128)), \
+                                                          _mm256_srli_epi16(_mm256_add_epi16((x), _mm256_set1_epi16(128)), 8)), 8)
+
+/* source-over of four pixels unpacked to 16-bit lanes */
+#define BLEND_AVX2(d16, s16) _mm256_add_epi16((s16), DIV255_AVX2(_mm256_mullo_epi16((d16),                                    \
+                                                                                    _mm256_sub_epi16(_mm256_set1_epi16(255), \
+                                                                                                     _mm256_shufflehi_epi16( \
+                                                                                                         _mm256_shufflelo_epi16((s16), 0xff), 0xff)))))
+
+__attribute__((target("avx2"))) static void fillAVX2(uint32_t *destination, uint32_t count, uint32_t color)
+{
+    __m256i value = _mm256_set1_epi32(color);
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_si256((__m256i *)(destination + i), value);
+    }
+    fillScalar(destination + i, count - i, color);
+}
+
+__attribute__((target("avx2"))) static void blendAVX2(uint32_t *destination, const uint32_t *source, uint32_t count)
+{
+    __m256i zero = _mm256_setzero_si256();
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(source + i));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(destination + i));
+
+        /* unpack and pack work inside 128-bit lanes, so the pixel order is preserved */
+        __m256i low = BLEND_AVX2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero));
+        __m256i high = BLEND_AVX2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero));
+
+        _mm256_storeu_si256((__m256i *)(destination + i), _mm256_packus_epi16(low, high));
+    }
+    blendSSE2(destination + i, source + i, count - i);
+}
+
+__attribute__((target("avx2"))) static void blitGlyphAVX2(uint32_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i color16 = _mm256_unpacklo_epi8(_mm256_set1_epi32(color), zero);
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        uint64_t packedCoverage;
+        memcpy(&packedCoverage, coverage + i, sizeof(packedCoverage));
+        if (!packedCoverage)
+            continue;
+
+        /* pixels 0-3 land in the low 128-bit lane and pixels 4-7 in the high one, as in the unpacked destination */
+        __m256i coverage32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(coverage + i)));
+        coverage32 = _mm256_or_si256(coverage32, _mm256_slli_epi32(coverage32, 16));
+
+        __m256i d = _mm256_loadu_si256((const __m256i *)(destination + i));
+        __m256i sourceLow = DIV255_AVX2(_mm256_mullo_epi16(color16, _mm256_unpacklo_epi32(coverage32, coverage32)));
+        __m256i sourceHigh = DIV255_AVX2(_mm256_mullo_epi16(color16, _mm256_unpackhi_epi32(coverage32, coverage32)));
+
+        __m256i low = BLEND_AVX2(_mm256_unpacklo_epi8(d, zero), sourceLow);
+        __m256i high = BLEND_AVX2(_mm256_unpackhi_epi8(d, zero), sourceHigh);
+
+        _mm256_storeu_si256((__m256i *)(destination + i), _mm256_packus_epi16(low, high));
+    }
+    blitGlyphSSE2(destination + i, coverage + i, count - i, color);
+}
+/* -------------------- AVX2 KERNELS -------------------- */
+#endif // OSD_KERNELS_X86
+
+#ifdef OSD_KERNELS_ARM_NEON
+/* -------------------- NEON KERNELS -------------------- */
+/* rounded division by 255 narrowed to 8 bits, same result as DIV255 */
+#define DIV255_NEON(x) vrshrn_n_u16(vrsraq_n_u16((x), (x), 8), 8)
+
+static void fillNEON(uint32_t *destination, uint32_t count, uint32_t color)
+{
+    uint32x4_t value = vdupq_n_u32(color);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        vst1q_u32(destination + i, value);
+    }
+    fillScalar(destination + i, count - i, color);
+}
+
+static void copyNEON(uint32_t *destination, const uint32_t *source, uint32_t count)
+{
+    uint32_t i = 0;
+
+    if (destination > source && destination < source + count)
+    {
+        /* overlapping spans are left to memmove */
+        copyScalar(destination, source, count);
+        return;
+    }
+
+    for (; i + 8 <= count; i += 8)
+    {
+        uint32x4_t a = vld1q_u32(source + i);
+        uint32x4_t b = vld1q_u32(source + i + 4);
+        vst1q_u32(destination + i, a);
+        vst1q_u32(destination + i + 4, b);
+    }
+    copyScalar(destination + i, source + i, count - i);
+}
+
+static void blendNEON(uint32_t *destination, const uint32_t *source, uint32_t count)
+{
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        /* de-interleave eight pixels into B, G, R and A planes */
+        uint8x8x4_t s = vld4_u8((const uint8_t *)(source + i));
+        uint8x8x4_t d = vld4_u8((const uint8_t *)(destination + i));
+        uint8x8_t inverse = vmvn_u8(s.val[3]);
+
+        d.val[0] = vqadd_u8(s.val[0], DIV255_NEON(vmull_u8(d.val[0], inverse)));
+        d.val[1] = vqadd_u8(s.val[1], DIV255_NEON(vmull_u8(d.val[1], inverse)));
+        d.val[2] = vqadd_u8(s.val[2], DIV255_NEON(vmull_u8(d.val[2], inverse)));
+        d.val[3] = vqadd_u8(s.val[3], DIV255_NEON(vmull_u8(d.val[3], inverse)));
+
+        vst4_u8((uint8_t *)(destination + i), d);
+    }
+    blendScalar(destination + i, source + i, count - i);
+}
+
+static void blitGlyphNEON(uint32_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color)
+{
+    uint8x8_t blue = vdup_n_u8(color & 0xff);
+    uint8x8_t green = vdup_n_u8((color >> 8) & 0xff);
+    uint8x8_t red = vdup_n_u8((color >> 16) & 0xff);
+    uint8x8_t alpha = vdup_n_u8(color >> 24);
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        uint8x8_t c = vld1_u8(coverage + i);
+        if (!vget_lane_u64(vreinterpret_u64_u8(c), 0))
+            continue;
+
+        uint8x8x4_t d = vld4_u8((const uint8_t *)(destination + i));
+        uint8x8_t sourceAlpha = DIV255_NEON(vmull_u8(alpha, c));
+        uint8x8_t inverse = vmvn_u8(sourceAlpha);
+
+        d.val[0] = vqadd_u8(DIV255_NEON(vmull_u8(blue, c)), DIV255_NEON(vmull_u8(d.val[0], inverse)));
+        d.val[1] = vqadd_u8(DIV255_NEON(vmull_u8(green, c)), DIV255_NEON(vmull_u8(d.val[1], inverse)));
+        d.val[2] = vqadd_u8(DIV255_NEON(vmull_u8(red, c)), DIV255_NEON(vmull_u8(d.val[2], inverse)));
+        d.val[3] = vqadd_u8(sourceAlpha, DIV255_NEON(vmull_u8(d.val[3], inverse)));
+
+        vst4_u8((uint8_t *)(destination + i), d);
+    }
+    blitGlyphScalar(destination + i, coverage + i, count - i, color);
+}
+/* -------------------- NEON KERNELS -------------------- */
+#endif // OSD_KERNELS_ARM_NEON
@@ -0,0 +1,102 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file osd_kernels.h
+ *
+ * \brief
+ * Header of the module with pixel kernels for software and offscreen OSD rendering.
+ * Every kernel works on one span of premultiplied ARGB pixels. The fastest variant
+ * supported by the CPU is chosen at startup.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _OSD_KERNELS_H_
+#define _OSD_KERNELS_H_
+
+#include <stdint.h>
+
+typedef enum _osdKernelsStatus
+{
+    OSD_KERNELS_NO_ERROR = 0,
+    OSD_KERNELS_ERROR
+} osdKernelsStatus;
+
+typedef enum _osdKernelsVariant
+{
+    OSD_KERNELS_SCALAR = 0,
+    OSD_KERNELS_SSE2,
+    OSD_KERNELS_AVX2,
+    OSD_KERNELS_NEON,
+    OSD_KERNELS_VARIANT_COUNT
+} osdKernelsVariant;
+
+/****************************************************************************
+ * @brief    Function for selecting the fastest kernel variant supported by the CPU.
+****************************************************************************/
+void osdKernelsInit();
+
+/****************************************************************************
+ * @brief    Function for forcing a kernel variant.
+ *
+ * @param    variant - [in] Kernel variant to use.
+ *
+ * @return   OSD_KERNELS_NO_ERROR, if there are no errors.
+ *           OSD_KERNELS_ERROR, if the variant is not built in or not supported by the CPU.
+****************************************************************************/
+osdKernelsStatus osdKernelsSelect(osdKernelsVariant variant);
+
+/****************************************************************************
+ * @brief    Function for getting the name of a kernel variant.
+ *
+ * @param    variant - [in] Kernel variant.
+ *
+ * @return   Variant name string.
+****************************************************************************/
+const char *osdKernelsName(osdKernelsVariant variant);
+
+/****************************************************************************
+ * @brief    Function for filling a span with a solid colour.
+ *
+ * @param    destination - [in] First pixel of the span.
+ *           count - [in] Number of pixels.
+ *           color - [in] Premultiplied ARGB colour.
+****************************************************************************/
+void osdFill(uint32_t *destination, uint32_t count, uint32_t color);
+
+/****************************************************************************
+ * @brief    Function for copying a span.
+ *
+ * @param    destination - [in] First destination pixel.
+ *           source - [in] First source pixel.
+ *           count - [in] Number of pixels.
+****************************************************************************/
+void osdCopy(uint32_t *destination, const uint32_t *source, uint32_t count);
+
+/****************************************************************************
+ * @brief    Function for blending a premultiplied span over the destination (source-over).
+ *
+ * @param    destination - [in] First destination pixel.
+ *           source - [in] First source pixel.
+ *           count - [in] Number of pixels.
+****************************************************************************/
+void osdBlend(uint32_t *destination, const uint32_t *source, uint32_t count);
+
+/****************************************************************************
+ * @brief    Function for blending glyph coverage in a solid colour over the destination.
+ *
+ * @param    destination - [in] First destination pixel.
+ *           coverage - [in] Glyph coverage values, one byte per pixel.
+ *           count - [in] Number of pixels.
+ *           color - [in] Premultiplied ARGB colour.
+****************************************************************************/
+void osdBlitGlyph(uint32_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color);
+
+#endif // _OSD_KERNELS_H_
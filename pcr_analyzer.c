@@ -0,0 +1,376 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file pcr_analyzer.c
+ *
+ * \brief
+ * Implementation of the PCR analyzer module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "pcr_analyzer.h"
+#include "ts_input.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* helper keywords needed only for PCR analyzer module */
+#define PCR_WRAP (300ULL << 33)  // 33 bit base in 90 kHz units times 300 plus the 27 MHz extension
+#define PCR_CLOCK_MHZ 27
+#define JITTER_SMOOTHING 16      // weight of the old value in the trend and jitter averages
+#define NO_PCR_PID TS_NULL_PID   // PMTs of programs without a PCR name the null PID
+
+/* published values have a single writer, stores and loads are atomic so readers never see a torn value */
+#define PUBLISH(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+#define READ(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+typedef struct _programClock
+{
+    uint16_t programNumber;
+    uint16_t pcrPid;
+    uint8_t restart; // set when the PCR PID is (re)assigned, the packet thread then starts over
+
+    /* packet thread only */
+    uint8_t referenced;
+    uint64_t lastPcr;
+    uint64_t lastArrivalNs;
+    uint64_t lastPacketIndex;
+    uint64_t referenceArrivalNs;
+    uint64_t pcrElapsedNs;   // program time since the reference PCR
+    int64_t trendOffsetNs;   // smoothed arrival minus program time, follows the drift
+    uint32_t fitCount;       // least squares fit of arrival time over program time, updated incrementally
+    double fitMeanPcr;
+    double fitMeanArrival;
+    double fitCovariance;
+    double fitVariance;
+
+    /* published to readers */
+    uint64_t pcrCount;
+    uint32_t discontinuities;
+    int32_t driftPpb;
+    uint32_t jitterNs;
+    uint32_t maxJitterNs;
+    uint32_t maxIntervalNs;
+    uint32_t bitrate;
+} programClock;
+
+/* helper variables needed only for PCR analyzer module */
+static programClock programs[PCR_ANALYZER_MAX_PROGRAMS];
+static uint32_t programCount;
+static uint64_t discontinuityCount; // all programs since start, not cleared by a PCR PID change
+
+/* helper functions needed only for PCR analyzer module */
+static programClock *findProgram(uint16_t programNumber);
+static void restartProgram(programClock *program);
+static void countDiscontinuity(programClock *program);
+static void takeReference(programClock *program, uint64_t pcr, uint64_t packetIndex, uint64_t arrivalNs);
+static void measurePcr(programClock *program, uint64_t pcr, uint64_t packetIndex, uint64_t arrivalNs);
+static int64_t discontinuitiesTotal();
+static int64_t maxJitter();
+
+pcrAnalyzerStatus pcrAnalyzerInit()
+{
+    memset(programs, 0, sizeof(programs));
+    programCount = 0;
+    discontinuityCount = 0;
+
+    metricsRegisterCallback(METRICS_TYPE_COUNTER, "tv_ts_pcr_discontinuities_total", "PCR discontinuities on all programs", discontinuitiesTotal);
+    metricsRegisterCallback(METRICS_TYPE_GAUGE, "tv_ts_pcr_jitter_max_nanoseconds", "Largest PCR arrival jitter seen on any program", maxJitter);
+
+    return PCR_ANALYZER_NO_ERROR;
+}
+
+pcrAnalyzerStatus pcrAnalyzerWatchProgram(uint16_t programNumber, uint16_t pcrPid)
+{
+    programClock *program = findProgram(programNumber);
+    uint32_t count = programCount;
+
+    if (program)
+    {
+        if (READ(program->pcrPid) != pcrPid)
+        {
+            PUBLISH(program->pcrPid, pcrPid);
+            __atomic_store_n(&program->restart, 1, __ATOMIC_RELEASE);
+        }
+        return PCR_ANALYZER_NO_ERROR;
+    }
+
+    if (count == PCR_ANALYZER_MAX_PROGRAMS)
+    {
+        return PCR_ANALYZER_ERROR;
+    }
+
+    /* the slot is filled in before the count makes it visible to the packet thread */
+    program = &programs[count];
+    program->programNumber = programNumber;
+    program->pcrPid = pcrPid;
+    program->restart = 1;
+    __atomic_store_n(&programCount, count + 1, __ATOMIC_RELEASE);
+
+    return PCR_ANALYZER_NO_ERROR;
+}
+
+void pcrAnalyzerPacket(uint16_t pid, const uint8_t *packet, uint64_t packetIndex, uint64_t arrivalNs)
+{
+    uint32_t count = __atomic_load_n(&programCount, __ATOMIC_ACQUIRE);
+    uint8_t discontinuity = packet[5] & 0x80;
+    uint64_t pcr;
+    uint32_t i;
+
+    pcr = (((uint64_t)packet[6] << 25) | (packet[7] << 17) | (packet[8] << 9) | (packet[9] << 1) | (packet[10] >> 7)) * 300 +
+          (((packet[10] & 0x01) << 8) | packet[11]);
+
+    /* programs often share the PCR of another program, PCR packets are rare enough to check every program */
+    for (i = 0; i < count; i++)
+    {
+        programClock *program = &programs[i];
+
+        if (READ(program->pcrPid) != pid || pid == NO_PCR_PID)
+        {
+            continue;
+        }
+
+        if (__atomic_exchange_n(&program->restart, 0, __ATOMIC_ACQUIRE))
+        {
+            restartProgram(program);
+        }
+
+        if (!program->referenced)
+        {
+            takeReference(program, pcr, packetIndex, arrivalNs);
+        }
+        else if (discontinuity)
+        {
+            countDiscontinuity(program);
+            takeReference(program, pcr, packetIndex, arrivalNs);
+        }
+        else
+        {
+            measurePcr(program, pcr, packetIndex, arrivalNs);
+        }
+    }
+}
+
+pcrAnalyzerStatus pcrAnalyzerStatistics(uint16_t programNumber, pcrStatistics *statistics)
+{
+    programClock *program = findProgram(programNumber);
+
+    if (!program || !statistics)
+    {
+        return PCR_ANALYZER_ERROR;
+    }
+
+    statistics->programNumber = program->programNumber;
+    statistics->pcrPid = READ(program->pcrPid);
+    statistics->pcrCount = READ(program->pcrCount);
+    statistics->discontinuities = READ(program->discontinuities);
+    statistics->driftPpb = READ(program->driftPpb);
+    statistics->jitterNs = READ(program->jitterNs);
+    statistics->maxJitterNs = READ(program->maxJitterNs);
+    statistics->maxIntervalNs = READ(program->maxIntervalNs);
+    statistics->bitrate = READ(program->bitrate);
+
+    return PCR_ANALYZER_NO_ERROR;
+}
+
+void pcrAnalyzerPrintStatistics()
+{
+    uint32_t count = __atomic_load_n(&programCount, __ATOMIC_ACQUIRE);
+    pcrStatistics statistics;
+    uint32_t i;
+
+    printf("\nPCR analyzer: %u programs\n", count);
+    for (i = 0; i < count; i++)
+    {
+        pcrAnalyzerStatistics(programs[i].programNumber, &statistics);
+        printf("  program %5u PID 0x%04x %8llu PCRs, drift %+8.3f ppm, jitter avg %7.1f us max %7.1f us, interval max %5.1f ms, mux %8.1f kbit/s, %u discontinuities\n",
+               statistics.programNumber, statistics.pcrPid, (unsigned long long)statistics.pcrCount, statistics.driftPpb / 1000.0,
+               statistics.jitterNs / 1000.0, statistics.maxJitterNs / 1000.0, statistics.maxIntervalNs / 1000000.0,
+               statistics.bitrate / 1000.0, statistics.discontinuities);
+    }
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for finding an analyzed program.
+ *
+ * @param    programNumber - [in] Program number.
+ *
+ * @return   Program, NULL if it is not analyzed.
+****************************************************************************/
+static programClock *findProgram(uint16_t programNumber)
+{
+    uint32_t count = __atomic_load_n(&programCount, __ATOMIC_ACQUIRE);
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (programs[i].programNumber == programNumber)
+        {
+            return &programs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for clearing the measurement of a program whose PCR PID changed.
+ *
+ * @param    program - [in] Program.
+****************************************************************************/
+static void restartProgram(programClock *program)
+{
+    program->referenced = 0;
+    PUBLISH(program->pcrCount, 0);
+    PUBLISH(program->discontinuities, 0);
+    PUBLISH(program->driftPpb, 0);
+    PUBLISH(program->jitterNs, 0);
+    PUBLISH(program->maxJitterNs, 0);
+    PUBLISH(program->maxIntervalNs, 0);
+    PUBLISH(program->bitrate, 0);
+}
+
+/****************************************************************************
+ * @brief    Function for starting drift and jitter measurement from a PCR.
+ *
+ * @param    program - [in] Program.
+ *           pcr - [in] PCR in 27 MHz units.
+ *           packetIndex - [in] Multiplex packet number of the PCR packet.
+ *           arrivalNs - [in] Arrival time of the PCR packet.
+****************************************************************************/
+static void takeReference(programClock *program, uint64_t pcr, uint64_t packetIndex, uint64_t arrivalNs)
+{
+    program->referenced = 1;
+    program->lastPcr = pcr;
+    program->lastArrivalNs = arrivalNs;
+    program->lastPacketIndex = packetIndex;
+    program->referenceArrivalNs = arrivalNs;
+    program->pcrElapsedNs = 0;
+    program->trendOffsetNs = 0;
+    program->fitCount = 0;
+    program->fitMeanPcr = 0;
+    program->fitMeanArrival = 0;
+    program->fitCovariance = 0;
+    program->fitVariance = 0;
+    PUBLISH(program->pcrCount, program->pcrCount + 1);
+}
+
+/****************************************************************************
+ * @brief    Function for updating interval, bitrate, drift and jitter with a PCR following
+ *           the previous one. Steps out of range are counted as discontinuities.
+ *
+ * @param    program - [in] Program.
+ *           pcr - [in] PCR in 27 MHz units.
+ *           packetIndex - [in] Multiplex packet number of the PCR packet.
+ *           arrivalNs - [in] Arrival time of the PCR packet.
+****************************************************************************/
+static void measurePcr(programClock *program, uint64_t pcr, uint64_t packetIndex, uint64_t arrivalNs)
+{
+    uint64_t intervalNs = (pcr + PCR_WRAP - program->lastPcr) % PCR_WRAP * 1000 / PCR_CLOCK_MHZ;
+    uint64_t arrivalElapsedNs;
+    int64_t offsetNs;
+    int64_t jitterNs;
+    double pcrDelta;
+
+    if (!intervalNs || intervalNs > PCR_ANALYZER_MAX_INTERVAL_NS)
+    {
+        countDiscontinuity(program);
+        takeReference(program, pcr, packetIndex, arrivalNs);
+        return;
+    }
+
+    if (intervalNs > program->maxIntervalNs)
+    {
+        PUBLISH(program->maxIntervalNs, intervalNs);
+    }
+    PUBLISH(program->bitrate, (packetIndex - program->lastPacketIndex) * TS_PACKET_SIZE * 8 * 1000000000ULL / intervalNs);
+
+    program->pcrElapsedNs += intervalNs;
+    arrivalElapsedNs = arrivalNs - program->referenceArrivalNs;
+
+    /* the trend follows a constant rate difference, what is left is the jitter of single arrivals */
+    offsetNs = (int64_t)arrivalElapsedNs - (int64_t)program->pcrElapsedNs;
+    program->trendOffsetNs += (offsetNs - program->trendOffsetNs) / JITTER_SMOOTHING;
+    jitterNs = offsetNs - program->trendOffsetNs;
+    if (jitterNs < 0)
+    {
+        jitterNs = -jitterNs;
+    }
+    PUBLISH(program->jitterNs, program->jitterNs + ((int64_t)jitterNs - (int64_t)program->jitterNs) / JITTER_SMOOTHING);
+    if (jitterNs > program->maxJitterNs)
+    {
+        PUBLISH(program->maxJitterNs, jitterNs);
+    }
+
+    /* the slope of the fit averages out the jitter of single arrivals, the reference one included */
+    program->fitCount++;
+    pcrDelta = program->pcrElapsedNs - program->fitMeanPcr;
+    program->fitMeanPcr += pcrDelta / program->fitCount;
+    program->fitMeanArrival += (arrivalElapsedNs - program->fitMeanArrival) / program->fitCount;
+    program->fitCovariance += pcrDelta * (arrivalElapsedNs - program->fitMeanArrival);
+    program->fitVariance += pcrDelta * (program->pcrElapsedNs - program->fitMeanPcr);
+    if (program->pcrElapsedNs >= PCR_ANALYZER_DRIFT_MIN_NS && program->fitCovariance > 0)
+    {
+        PUBLISH(program->driftPpb, (int32_t)((program->fitVariance / program->fitCovariance - 1) * 1e9));
+    }
+
+    program->lastPcr = pcr;
+    program->lastArrivalNs = arrivalNs;
+    program->lastPacketIndex = packetIndex;
+    PUBLISH(program->pcrCount, program->pcrCount + 1);
+}
+
+/****************************************************************************
+ * @brief    Function for counting a discontinuity of a program. The program count starts over
+ *           with its measurement, the total behind the metric never goes back.
+ *
+ * @param    program - [in] Program.
+****************************************************************************/
+static void countDiscontinuity(programClock *program)
+{
+    PUBLISH(program->discontinuities, program->discontinuities + 1);
+    PUBLISH(discontinuityCount, discontinuityCount + 1);
+}
+
+/****************************************************************************
+ * @brief    Function for reading the PCR discontinuities of all programs, called by the metrics server.
+ *
+ * @return   Discontinuity total.
+****************************************************************************/
+static int64_t discontinuitiesTotal()
+{
+    return READ(discontinuityCount);
+}
+
+/****************************************************************************
+ * @brief    Function for finding the largest jitter of all programs, called by the metrics server.
+ *
+ * @return   Jitter in nanoseconds.
+****************************************************************************/
+static int64_t maxJitter()
+{
+    uint32_t count = __atomic_load_n(&programCount, __ATOMIC_ACQUIRE);
+    int64_t jitter = 0;
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (READ(programs[i].maxJitterNs) > jitter)
+        {
+            jitter = READ(programs[i].maxJitterNs);
+        }
+    }
+
+    return jitter;
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
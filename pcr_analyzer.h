@@ -0,0 +1,98 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file pcr_analyzer.h
+ *
+ * \brief
+ * Header of the PCR analyzer module. PCRs are taken from the adaptation fields of the PCR
+ * PID of every program announced by its PMT and compared with their arrival times: drift is
+ * the long term rate difference between the program clock and the local clock, jitter the
+ * deviation of single PCR arrivals from the drift trend. The multiplex bitrate is derived
+ * from the packets received between consecutive PCRs, as ISO/IEC 13818-1 defines it.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _PCR_ANALYZER_H_
+#define _PCR_ANALYZER_H_
+
+#include <stdint.h>
+
+#define PCR_ANALYZER_MAX_PROGRAMS 16
+#define PCR_ANALYZER_MAX_INTERVAL_NS 100000000ULL // larger PCR steps are discontinuities, DVB allows 40 ms
+#define PCR_ANALYZER_DRIFT_MIN_NS 1000000000ULL    // drift is reported once a second of PCRs was seen
+
+typedef enum _pcrAnalyzerStatus
+{
+    PCR_ANALYZER_NO_ERROR = 0,
+    PCR_ANALYZER_ERROR
+} pcrAnalyzerStatus;
+
+typedef struct _pcrStatistics
+{
+    uint16_t programNumber;
+    uint16_t pcrPid;
+    uint64_t pcrCount;
+    uint32_t discontinuities; // signalled discontinuities and PCR steps out of range
+    int32_t driftPpb;         // program clock rate relative to the local clock, parts per billion
+    uint32_t jitterNs;        // average absolute deviation from the drift trend
+    uint32_t maxJitterNs;
+    uint32_t maxIntervalNs;   // longest time between consecutive PCRs
+    uint32_t bitrate;         // multiplex bits per second between the last two PCRs
+} pcrStatistics;
+
+/****************************************************************************
+ * @brief    Function for PCR analyzer initialization. Forgets all programs and registers metrics.
+ *
+ * @return   PCR_ANALYZER_NO_ERROR, if there are no errors.
+ *           PCR_ANALYZER_ERROR, in case of an error.
+****************************************************************************/
+pcrAnalyzerStatus pcrAnalyzerInit();
+
+/****************************************************************************
+ * @brief    Function for analyzing the PCR PID of a program, called when its PMT is parsed.
+ *           A changed PCR PID restarts the measurement of the program.
+ *
+ * @param    programNumber - [in] Program number.
+ *           pcrPid - [in] PCR PID from the PMT.
+ *
+ * @return   PCR_ANALYZER_NO_ERROR, if there are no errors.
+ *           PCR_ANALYZER_ERROR, if PCR_ANALYZER_MAX_PROGRAMS programs are already analyzed.
+****************************************************************************/
+pcrAnalyzerStatus pcrAnalyzerWatchProgram(uint16_t programNumber, uint16_t pcrPid);
+
+/****************************************************************************
+ * @brief    Function for passing a packet carrying a PCR, called by the transport stream input
+ *           on the packet source thread.
+ *
+ * @param    pid - [in] Packet identifier.
+ *           packet - [in] Transport stream packet with an adaptation field and the PCR flag set.
+ *           packetIndex - [in] Number of packets received on the multiplex before this one.
+ *           arrivalNs - [in] virtualClockNowNs time the packet was received.
+****************************************************************************/
+void pcrAnalyzerPacket(uint16_t pid, const uint8_t *packet, uint64_t packetIndex, uint64_t arrivalNs);
+
+/****************************************************************************
+ * @brief    Function for reading the PCR statistics of a program, safe to call from any thread.
+ *
+ * @param    programNumber - [in] Program number.
+ *           statistics - [out] PCR statistics of the program.
+ *
+ * @return   PCR_ANALYZER_NO_ERROR, if there are no errors.
+ *           PCR_ANALYZER_ERROR, if the program is not analyzed.
+****************************************************************************/
+pcrAnalyzerStatus pcrAnalyzerStatistics(uint16_t programNumber, pcrStatistics *statistics);
+
+/****************************************************************************
+ * @brief    Function for printing the PCR statistics of every analyzed program.
+****************************************************************************/
+void pcrAnalyzerPrintStatistics();
+
+#endif // _PCR_ANALYZER_H_
@@ -0,0 +1,571 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file pvr_benchmark.c
+ *
+ * \brief
+ * PVR recording benchmark. A recorded multiplex is loaded into memory, several of its
+ * programs are recorded at once while the multiplex is passed through the transport stream
+ * input, as fast as possible or paced to a given bitrate, with every thread on a single CPU
+ * by default. Programs are taken in PAT order and repeat if more recordings than programs
+ * are asked for. Every recording is checked afterwards: only the program PIDs and the
+ * generated PAT and PMT may be in it, the generated sections must have a correct CRC_32 and
+ * continuity, and without drops every program packet must be there. Input and write
+ * throughput, CPU time, bytes copied by the fan-out and dropped packets are printed and the
+ * exit status is 1 if a check fails or packets were dropped at a paced bitrate.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#define _GNU_SOURCE // sched_setaffinity
+
+#include "pvr_recorder.h"
+#include "ts_input.h"
+#include "ts_fanout.h"
+#include "tables_parser.h"
+#include "virtual_clock.h"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* helper keywords needed only for PVR benchmark module */
+#define DEFAULT_RECORDINGS 8
+#define DEFAULT_PASSES 20
+#define DEFAULT_DIRECTORY PVR_RECORDER_DIRECTORY
+#define PACKETS_PER_READ 64 // packets passed to the input at once, as the file source reads them
+#define BENCHMARK_CPU 0     // CPU every thread runs on, -1 in the cpu argument lets them spread
+
+/* helper variables needed only for PVR benchmark module */
+static uint8_t *multiplex;
+static uint32_t multiplexPackets;
+static pvrService services[PVR_RECORDER_MAX_RECORDINGS];
+static uint8_t servicePids[PVR_RECORDER_MAX_RECORDINGS][TS_PID_COUNT];
+
+/* helper functions needed only for PVR benchmark module */
+static int32_t loadMultiplex(const char *path);
+static const uint8_t *findSection(uint16_t pid, uint8_t tableId, uint16_t programNumber);
+static int32_t findServices(uint32_t count);
+static int32_t findService(uint16_t programNumber, uint16_t pmtPid, pvrService *service);
+static uint64_t copiedBytes(uint8_t *pidRecorded);
+static int32_t checkRecording(const char *path, uint32_t recordingIndex, uint64_t expectedPackets,
+                              const pvrStatistics *statistics);
+static uint64_t nowNs();
+static uint64_t cpuNs();
+
+int main(int argc, char **argv)
+{
+    uint32_t recordings = DEFAULT_RECORDINGS;
+    uint32_t passes = DEFAULT_PASSES;
+    uint32_t bitrate = 0;
+    int32_t cpu = BENCHMARK_CPU;
+    const char *directory = DEFAULT_DIRECTORY;
+    char paths[PVR_RECORDER_MAX_RECORDINGS][256];
+    int32_t recordingIds[PVR_RECORDER_MAX_RECORDINGS];
+    uint64_t expectedPackets[PVR_RECORDER_MAX_RECORDINGS] = {0};
+    uint8_t pidRecorded[TS_PID_COUNT] = {0};
+    pvrStatistics statistics;
+    cpu_set_t cpus;
+    struct timespec deadline;
+    uint64_t startNs;
+    uint64_t inputNs;
+    uint64_t startCpuNs;
+    uint64_t usedCpuNs;
+    uint64_t dueNs;
+    uint64_t sent = 0;
+    uint64_t written = 0;
+    uint64_t dropped = 0;
+    uint32_t pass;
+    uint32_t i;
+    uint32_t r;
+    uint32_t count;
+    uint16_t pid;
+    int32_t failed = 0;
+
+    if (argc < 2)
+    {
+        printf("Usage: %s <multiplex.ts> [recordings] [passes] [bitrate Mbit/s, 0 unpaced] [cpu, -1 any] [output directory]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 2)
+        recordings = atoi(argv[2]);
+    if (argc > 3)
+        passes = atoi(argv[3]);
+    if (argc > 4)
+        bitrate = atoi(argv[4]) * 1000000;
+    if (argc > 5)
+        cpu = atoi(argv[5]);
+    if (argc > 6)
+        directory = argv[6];
+    if (!recordings || recordings > PVR_RECORDER_MAX_RECORDINGS)
+    {
+        printf("Between 1 and %d recordings can run at once!\n", PVR_RECORDER_MAX_RECORDINGS);
+        return 1;
+    }
+
+    /* set before any thread is created, the recording writers inherit it */
+    if (cpu >= 0)
+    {
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        if (sched_setaffinity(0, sizeof(cpus), &cpus))
+        {
+            printf("Error while pinning to CPU %d!\n", cpu);
+            return 1;
+        }
+    }
+
+    virtualClockInit(VIRTUAL_CLOCK_REAL);
+    tablesParserInit();
+    tsInputInit();
+    tsFanoutInit();
+    pvrRecorderInit(NULL);
+
+    if (loadMultiplex(argv[1]) || findServices(recordings))
+    {
+        return 1;
+    }
+
+    for (i = 0; i < multiplexPackets; i++)
+    {
+        pid = ((multiplex[i * TS_PACKET_SIZE + 1] & 0x1F) << 8) | multiplex[i * TS_PACKET_SIZE + 2];
+        for (r = 0; r < recordings; r++)
+        {
+            expectedPackets[r] += servicePids[r][pid] * (uint64_t)passes;
+            pidRecorded[pid] |= servicePids[r][pid];
+        }
+    }
+
+    printf("Recording %u programs from %u packets, %u passes%s, ", recordings, multiplexPackets, passes,
+           bitrate ? "" : ", unpaced");
+    if (cpu >= 0)
+        printf("all threads on CPU %d\n", cpu);
+    else
+        printf("threads on any CPU\n");
+
+    for (r = 0; r < recordings; r++)
+    {
+        snprintf(paths[r], sizeof(paths[r]), "%s/pvr_benchmark_%u.ts", directory, r);
+        printf("  %u: program %u (video 0x%x, audio 0x%x, PCR 0x%x) to %s\n", r, services[r].programNumber,
+               services[r].videoPid, services[r].audioPid, services[r].pcrPid, paths[r]);
+        if (pvrRecorderStart(paths[r], &services[r], &recordingIds[r]))
+        {
+            return 1;
+        }
+    }
+
+    startNs = nowNs();
+    startCpuNs = cpuNs();
+    for (pass = 0; pass < passes; pass++)
+    {
+        for (i = 0; i < multiplexPackets; i += count)
+        {
+            count = multiplexPackets - i < PACKETS_PER_READ ? multiplexPackets - i : PACKETS_PER_READ;
+
+            /* paced input sleeps until the multiplex bitrate allows the next group, the writers share the CPU */
+            if (bitrate)
+            {
+                dueNs = startNs + sent * TS_PACKET_SIZE * 8 * 1000000000ULL / bitrate;
+                if (dueNs > nowNs())
+                {
+                    deadline.tv_sec = dueNs / 1000000000ULL;
+                    deadline.tv_nsec = dueNs % 1000000000ULL;
+                    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL))
+                    {
+                    }
+                }
+            }
+
+            tsInputPackets(&multiplex[i * TS_PACKET_SIZE], count, virtualClockNowNs());
+            sent += count;
+        }
+    }
+    inputNs = nowNs() - startNs;
+
+    pvrRecorderStopAll();
+    usedCpuNs = cpuNs() - startCpuNs;
+
+    printf("input    %10.1f MB/s (%llu packets in %.2f s)\n", sent * TS_PACKET_SIZE * 1000.0 / inputNs,
+           (unsigned long long)sent, inputNs / 1e9);
+    for (r = 0; r < recordings; r++)
+    {
+        pvrRecorderStatistics(recordingIds[r], &statistics);
+        printf("  %u: written %8.1f MB/s (%llu bytes in %.2f s%s, longest write %u us), %llu dropped\n", r,
+               statistics.writtenBytes * 1000.0 / statistics.durationNs, (unsigned long long)statistics.writtenBytes,
+               statistics.durationNs / 1e9, statistics.directIo ? ", O_DIRECT" : "", statistics.maxWriteUs,
+               (unsigned long long)statistics.droppedPackets);
+        failed |= statistics.failed;
+        failed |= checkRecording(paths[r], r, expectedPackets[r], &statistics);
+        written += statistics.writtenBytes;
+        dropped += statistics.droppedPackets;
+        unlink(paths[r]);
+    }
+
+    printf("written  %10.1f MB/s (%llu bytes by %u recordings)\n", written * 1000.0 / inputNs,
+           (unsigned long long)written, recordings);
+    printf("cpu      %10.2f s of %.2f s, %.0f%% of one CPU\n", usedCpuNs / 1e9, inputNs / 1e9,
+           usedCpuNs * 100.0 / inputNs);
+    printf("fan-out  %10llu bytes copied into shared blocks, %.2f copies per recorded byte\n",
+           (unsigned long long)copiedBytes(pidRecorded) * passes,
+           written ? copiedBytes(pidRecorded) * passes / (double)written : 0.0);
+    printf("dropped  %10llu packets\n", (unsigned long long)dropped);
+
+    if (bitrate && dropped)
+    {
+        printf("FAIL: packets dropped at %u Mbit/s\n", bitrate / 1000000);
+        failed = 1;
+    }
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    free(multiplex);
+
+    return failed;
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for loading the whole multiplex file into memory.
+ *
+ * @param    path - [in] Transport stream file, 188 byte packets.
+ *
+ * @return   0 on success, -1 in case of an error.
+****************************************************************************/
+static int32_t loadMultiplex(const char *path)
+{
+    struct stat fileStat;
+    int32_t fileDesc = open(path, O_RDONLY);
+    ssize_t result;
+    size_t loaded = 0;
+
+    if (fileDesc < 0 || fstat(fileDesc, &fileStat))
+    {
+        printf("Error while opening %s!\n", path);
+        return -1;
+    }
+
+    multiplexPackets = fileStat.st_size / TS_PACKET_SIZE;
+    multiplex = (uint8_t *)malloc((size_t)multiplexPackets * TS_PACKET_SIZE);
+    while (multiplex && loaded < (size_t)multiplexPackets * TS_PACKET_SIZE)
+    {
+        result = read(fileDesc, multiplex + loaded, (size_t)multiplexPackets * TS_PACKET_SIZE - loaded);
+        if (result <= 0)
+        {
+            break;
+        }
+        loaded += result;
+    }
+    close(fileDesc);
+
+    if (!multiplexPackets || loaded != (size_t)multiplexPackets * TS_PACKET_SIZE || multiplex[0] != TS_SYNC_BYTE)
+    {
+        printf("Error while reading %s, not a 188 byte packet transport stream!\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+/****************************************************************************
+ * @brief    Function for finding a section starting in a single packet of the multiplex.
+ *
+ * @param    pid - [in] Packet identifier.
+ *           tableId - [in] Table id of the section.
+ *           programNumber - [in] Program number of a PMT, 0 to take any.
+ *
+ * @return   Section starting with table_id, NULL if there is none.
+****************************************************************************/
+static const uint8_t *findSection(uint16_t pid, uint8_t tableId, uint16_t programNumber)
+{
+    const uint8_t *packet;
+    const uint8_t *section;
+    uint32_t i;
+
+    for (i = 0; i < multiplexPackets; i++)
+    {
+        packet = &multiplex[i * TS_PACKET_SIZE];
+        if ((((packet[1] & 0x1F) << 8) | packet[2]) != pid || !(packet[1] & 0x40) || (packet[3] & 0x30) != 0x10)
+        {
+            continue;
+        }
+
+        section = &packet[5 + packet[4]];
+        if (section - packet < TS_PACKET_SIZE - 3 && section[0] == tableId &&
+            (section - packet) + 3 + (((section[1] & 0x0F) << 8) | section[2]) <= TS_PACKET_SIZE &&
+            (!programNumber || ((section[3] << 8) | section[4]) == programNumber) && !checkSectionCrc(section))
+        {
+            return section;
+        }
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for taking the services to record in PAT order, starting over at the
+ *           first program once every program is taken.
+ *
+ * @param    count - [in] Number of recordings.
+ *
+ * @return   0 on success, -1 if the PAT or a PMT is not found.
+****************************************************************************/
+static int32_t findServices(uint32_t count)
+{
+    const uint8_t *section = findSection(0, 0x00, 0);
+    patTable pat;
+    uint32_t recordingIndex = 0;
+    uint32_t i;
+    int32_t result = 0;
+
+    if (!section || parsePAT((uint8_t *)section, &pat))
+    {
+        printf("No PAT in the multiplex!\n");
+        return -1;
+    }
+
+    /* program number 0 is the network PID */
+    for (i = 0; i < pat.programCount && !pat.programInformation[i].programNumber; i++)
+    {
+    }
+    if (i == pat.programCount)
+    {
+        printf("No program in the PAT!\n");
+        result = -1;
+    }
+
+    for (i = 0; recordingIndex < count && !result; i = (i + 1) % pat.programCount)
+    {
+        if (!pat.programInformation[i].programNumber)
+        {
+            continue;
+        }
+
+        result = findService(pat.programInformation[i].programNumber, pat.programInformation[i].programMapPid,
+                             &services[recordingIndex]);
+        if (!result)
+        {
+            memset(servicePids[recordingIndex], 0, TS_PID_COUNT);
+            servicePids[recordingIndex][services[recordingIndex].videoPid] = services[recordingIndex].videoPid != TS_NULL_PID;
+            servicePids[recordingIndex][services[recordingIndex].audioPid] = services[recordingIndex].audioPid != TS_NULL_PID;
+            servicePids[recordingIndex][services[recordingIndex].pcrPid] = services[recordingIndex].pcrPid != TS_NULL_PID;
+            recordingIndex++;
+        }
+    }
+    free(pat.programInformation);
+
+    return result;
+}
+
+/****************************************************************************
+ * @brief    Function for taking the PIDs of a program from its PMT.
+ *
+ * @param    programNumber - [in] Program number.
+ *           pmtPid - [in] PMT PID from the PAT.
+ *           service - [out] Service to record.
+ *
+ * @return   0 on success, -1 if the PMT is not found.
+****************************************************************************/
+static int32_t findService(uint16_t programNumber, uint16_t pmtPid, pvrService *service)
+{
+    const uint8_t *section;
+    pmtTable pmt;
+    uint32_t i;
+
+    memset(service, 0, sizeof(*service));
+    service->programNumber = programNumber;
+    service->pmtPid = pmtPid;
+    service->videoPid = TS_NULL_PID;
+    service->audioPid = TS_NULL_PID;
+
+    section = service->pmtPid ? findSection(service->pmtPid, 0x02, service->programNumber) : NULL;
+    if (!section || parsePMT((uint8_t *)section, &pmt))
+    {
+        printf("No PMT of program %u in the multiplex!\n", programNumber);
+        return -1;
+    }
+
+    service->pcrPid = pmt.pmtHeader.pcrPid;
+    for (i = 0; i < pmt.elementaryInformationCount; i++)
+    {
+        uint8_t streamType = pmt.elementaryInformation[i].streamType;
+
+        if ((streamType == 0x01 || streamType == 0x02 || streamType == 0x1B) && service->videoPid == TS_NULL_PID)
+        {
+            service->videoPid = pmt.elementaryInformation[i].elementaryPid;
+            service->videoStreamType = streamType;
+        }
+        else if ((streamType == 0x03 || streamType == 0x04 || streamType == 0x0F) && service->audioPid == TS_NULL_PID)
+        {
+            service->audioPid = pmt.elementaryInformation[i].elementaryPid;
+            service->audioStreamType = streamType;
+        }
+    }
+    free(pmt.elementaryInformation);
+    free(pmt.subtitles);
+
+    return 0;
+}
+
+/****************************************************************************
+ * @brief    Function for counting the bytes the fan-out copies in one pass, every block of
+ *           TS_FANOUT_BLOCK_PACKETS input packets with a recorded packet in it.
+ *
+ * @param    pidRecorded - [in] Nonzero for PIDs of any recording.
+ *
+ * @return   Bytes copied into shared blocks.
+****************************************************************************/
+static uint64_t copiedBytes(uint8_t *pidRecorded)
+{
+    uint64_t copied = 0;
+    uint32_t i;
+    uint32_t j;
+    uint32_t count;
+    const uint8_t *packet;
+
+    /* the input is passed in groups of PACKETS_PER_READ, a multiple of the block size */
+    for (i = 0; i < multiplexPackets; i += count)
+    {
+        count = multiplexPackets - i < TS_FANOUT_BLOCK_PACKETS ? multiplexPackets - i : TS_FANOUT_BLOCK_PACKETS;
+        for (j = 0; j < count; j++)
+        {
+            packet = &multiplex[(i + j) * TS_PACKET_SIZE];
+            if (pidRecorded[((packet[1] & 0x1F) << 8) | packet[2]])
+            {
+                copied += count * TS_PACKET_SIZE;
+                break;
+            }
+        }
+    }
+
+    return copied;
+}
+
+/****************************************************************************
+ * @brief    Function for checking the recording file against the service and the recorder statistics.
+ *
+ * @param    path - [in] Recording file.
+ *           recordingIndex - [in] Index of the recorded service.
+ *           expectedPackets - [in] Program packets passed to the input.
+ *           statistics - [in] Recorder statistics.
+ *
+ * @return   0 if the recording is correct, 1 otherwise.
+****************************************************************************/
+static int32_t checkRecording(const char *path, uint32_t recordingIndex, uint64_t expectedPackets,
+                              const pvrStatistics *statistics)
+{
+    const pvrService *service = &services[recordingIndex];
+    uint8_t packet[TS_PACKET_SIZE];
+    uint8_t continuity[2] = {0xFF, 0xFF};
+    uint64_t programPackets = 0;
+    uint64_t psiPackets = 0;
+    uint64_t filePackets = 0;
+    uint32_t errors = 0;
+    FILE *file = fopen(path, "rb");
+    patTable pat;
+    pmtTable pmt;
+    uint16_t pid;
+    uint8_t psi;
+
+    if (!file)
+    {
+        printf("FAIL: recording %s not found\n", path);
+        return 1;
+    }
+
+    while (fread(packet, TS_PACKET_SIZE, 1, file) == 1)
+    {
+        pid = ((packet[1] & 0x1F) << 8) | packet[2];
+        psi = pid == 0 ? 0 : pid == service->pmtPid ? 1 : 2;
+
+        if (packet[0] != TS_SYNC_BYTE || (!filePackets && pid != 0))
+        {
+            errors++;
+        }
+        else if (psi < 2)
+        {
+            /* generated sections, each in one packet */
+            if (checkSectionCrc(&packet[5]) || (continuity[psi] != 0xFF && (packet[3] & 0x0F) != ((continuity[psi] + 1) & 0x0F)))
+            {
+                errors++;
+            }
+            else if (psi == 0 && !parsePAT(&packet[5], &pat))
+            {
+                errors += pat.programCount != 1 || pat.programInformation[0].programNumber != service->programNumber ||
+                          pat.programInformation[0].programMapPid != service->pmtPid;
+                free(pat.programInformation);
+            }
+            else if (psi == 1 && !parsePMT(&packet[5], &pmt))
+            {
+                errors += pmt.pmtHeader.programNumber != service->programNumber || pmt.pmtHeader.pcrPid != service->pcrPid;
+                free(pmt.elementaryInformation);
+                free(pmt.subtitles);
+            }
+            continuity[psi] = packet[3] & 0x0F;
+            psiPackets++;
+        }
+        else if (servicePids[recordingIndex][pid])
+        {
+            programPackets++;
+        }
+        else
+        {
+            errors++;
+        }
+        filePackets++;
+    }
+    fclose(file);
+
+    printf("     recorded %llu program packets of %llu, %llu PAT and PMT packets, %u bad packets\n",
+           (unsigned long long)programPackets, (unsigned long long)expectedPackets, (unsigned long long)psiPackets, errors);
+
+    if (errors || filePackets != statistics->packets || filePackets * TS_PACKET_SIZE != statistics->writtenBytes ||
+        programPackets > expectedPackets || (!statistics->droppedPackets && programPackets != expectedPackets) || !psiPackets)
+    {
+        printf("FAIL: recording does not match the program\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/****************************************************************************
+ * @brief    Function for reading the CPU time of every thread of the process.
+ *
+ * @return   Time in nanoseconds.
+****************************************************************************/
+static uint64_t cpuNs()
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL +
+           (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+/****************************************************************************
+ * @brief    Function for reading the monotonic clock.
+ *
+ * @return   Time in nanoseconds.
+****************************************************************************/
+static uint64_t nowNs()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
@@ -0,0 +1,650 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file pvr_recorder.c
+ *
+ * \brief
+ * Implementation of the PVR recorder module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#define _GNU_SOURCE // O_DIRECT
+
+#include "pvr_recorder.h"
+#include "ts_fanout.h"
+#include "tables_parser.h"
+#include "latency_histogram.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* helper keywords needed only for PVR recorder module */
+#define GENERATED_TRANSPORT_STREAM_ID 1
+#define SECTION_RESERVED_VERSION 0xC1 // reserved bits, version_number 0, current_next_indicator 1
+
+/* counters have a single writer, stores and loads are atomic so readers never see a torn value */
+#define COUNTER_ADD(counter, value) __atomic_store_n(&(counter), (counter) + (value), __ATOMIC_RELAXED)
+#define COUNTER_READ(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+typedef enum _recordingState
+{
+    RECORDING_IDLE = 0,
+    RECORDING_RUNNING,
+    RECORDING_STOPPING       // the writer is storing the queued packets, or finished and waits to be reaped
+} recordingState;
+
+typedef struct _recording
+{
+    recordingState state;    // guarded by recorderMutex, start and stop come from the UI and scripts
+    uint8_t writerDone;      // guarded by recorderMutex, set by the writer as its last step
+    pvrService service;
+    int32_t subscriberId;
+    sem_t wake;
+    pthread_t writerThread;
+    uint8_t writerStopping;
+    uint8_t writeFailed;
+    int32_t fileDesc;
+    uint8_t directIo;
+    uint8_t *chunk;          // PVR_RECORDER_CHUNK_SIZE bytes, aligned for O_DIRECT
+    uint32_t chunkFill;
+    uint8_t patContinuity;
+    uint8_t pmtContinuity;
+    uint64_t nextPsiNs;
+
+    uint64_t packets;
+    uint64_t droppedPackets; // taken from the fan-out when the recording stops
+    uint64_t writtenBytes;
+    uint64_t startNs;
+    uint64_t stopNs;
+    uint32_t maxWriteUs;
+} recording;
+
+/* helper variables needed only for PVR recorder module */
+static recording recordings[PVR_RECORDER_MAX_RECORDINGS];
+static pthread_mutex_t recorderMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writerFinished = PTHREAD_COND_INITIALIZER;
+static pvrRecorderFinished finishedCallback;
+
+static int32_t writtenBytesMetric = -1;
+static int32_t droppedPacketsMetric = -1;
+static int32_t recordingsMetric = -1;
+
+/* helper functions needed only for PVR recorder module */
+static void putPacket(recording *recorded, const uint8_t *packet);
+static void putPsi(recording *recorded);
+static void putSection(recording *recorded, uint16_t pid, uint8_t *continuity, uint8_t *section);
+static void *writerWorker(void *arg);
+static void takeReferences(recording *recorded);
+static void writeChunk(recording *recorded, uint32_t length);
+static void reapRecording(recording *recorded);
+
+pvrRecorderStatus pvrRecorderInit(pvrRecorderFinished finished)
+{
+    finishedCallback = finished;
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_pvr_written_bytes_total", "Bytes written to recordings", &writtenBytesMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_pvr_dropped_packets_total", "Packets not recorded because a recording fell too far behind", &droppedPacketsMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_pvr_recordings_total", "Recordings started", &recordingsMetric);
+
+    return PVR_RECORDER_NO_ERROR;
+}
+
+pvrRecorderStatus pvrRecorderStart(const char *path, const pvrService *service, int32_t *recordingId)
+{
+    recording *recorded = NULL;
+    uint16_t pids[3];
+    uint32_t pidCount = 0;
+    int32_t i;
+
+    pthread_mutex_lock(&recorderMutex);
+    for (i = 0; i < PVR_RECORDER_MAX_RECORDINGS; i++)
+    {
+        if (recordings[i].state == RECORDING_STOPPING && recordings[i].writerDone)
+        {
+            reapRecording(&recordings[i]);
+        }
+        if (recordings[i].state == RECORDING_IDLE)
+        {
+            recorded = &recordings[i];
+            break;
+        }
+    }
+    if (!recorded)
+    {
+        pthread_mutex_unlock(&recorderMutex);
+        LOG_ERROR("All %d recordings are running!", PVR_RECORDER_MAX_RECORDINGS);
+        return PVR_RECORDER_ERROR;
+    }
+
+    if (!recorded->chunk && posix_memalign((void **)&recorded->chunk, PVR_RECORDER_ALIGNMENT, PVR_RECORDER_CHUNK_SIZE))
+    {
+        recorded->chunk = NULL;
+        pthread_mutex_unlock(&recorderMutex);
+        LOG_ERROR("Error while allocating the recording chunk!");
+        return PVR_RECORDER_ERROR;
+    }
+
+    /* file systems without O_DIRECT (tmpfs) refuse it when opening */
+    recorded->directIo = 1;
+    recorded->fileDesc = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (recorded->fileDesc < 0 && errno == EINVAL)
+    {
+        recorded->directIo = 0;
+        recorded->fileDesc = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (recorded->fileDesc < 0)
+    {
+        pthread_mutex_unlock(&recorderMutex);
+        LOG_ERROR("Error while creating recording %s: %s", path, strerror(errno));
+        return PVR_RECORDER_ERROR;
+    }
+
+    recorded->service = *service;
+    if (!recorded->service.pmtPid || recorded->service.pmtPid >= TS_NULL_PID)
+    {
+        recorded->service.pmtPid = PVR_RECORDER_PMT_PID;
+    }
+    if (service->videoPid < TS_NULL_PID)
+        pids[pidCount++] = service->videoPid;
+    if (service->audioPid < TS_NULL_PID && service->audioPid != service->videoPid)
+        pids[pidCount++] = service->audioPid;
+    if (service->pcrPid < TS_NULL_PID && service->pcrPid != service->videoPid && service->pcrPid != service->audioPid)
+        pids[pidCount++] = service->pcrPid;
+
+    recorded->chunkFill = 0;
+    recorded->patContinuity = 0;
+    recorded->pmtContinuity = 0;
+    recorded->nextPsiNs = 0;
+    recorded->packets = 0;
+    recorded->droppedPackets = 0;
+    recorded->writtenBytes = 0;
+    recorded->maxWriteUs = 0;
+    recorded->stopNs = 0;
+    recorded->writerStopping = 0;
+    recorded->writerDone = 0;
+    recorded->writeFailed = 0;
+    sem_init(&recorded->wake, 0, 0);
+
+    if (tsFanoutSubscribe(pids, pidCount, &recorded->wake, &recorded->subscriberId))
+    {
+        close(recorded->fileDesc);
+        sem_destroy(&recorded->wake);
+        pthread_mutex_unlock(&recorderMutex);
+        LOG_ERROR("Error while subscribing to the recorded PIDs!");
+        return PVR_RECORDER_ERROR;
+    }
+
+    if (pthread_create(&recorded->writerThread, NULL, writerWorker, recorded))
+    {
+        tsFanoutUnsubscribe(recorded->subscriberId);
+        close(recorded->fileDesc);
+        sem_destroy(&recorded->wake);
+        pthread_mutex_unlock(&recorderMutex);
+        LOG_ERROR("Error while starting the recording writer!");
+        return PVR_RECORDER_ERROR;
+    }
+
+    __atomic_store_n(&recorded->startNs, latencyNowNs(), __ATOMIC_RELAXED);
+    __atomic_store_n(&recorded->state, RECORDING_RUNNING, __ATOMIC_RELEASE);
+    metricsAdd(recordingsMetric, 1);
+    pthread_mutex_unlock(&recorderMutex);
+
+    *recordingId = recorded - recordings;
+    LOG_INFO("Recording program %u to %s (video 0x%x, audio 0x%x, PCR 0x%x%s)", service->programNumber, path,
+             service->videoPid, service->audioPid, service->pcrPid, recorded->directIo ? ", O_DIRECT" : "");
+
+    return PVR_RECORDER_NO_ERROR;
+}
+
+pvrRecorderStatus pvrRecorderStop(int32_t recordingId)
+{
+    recording *recorded;
+    tsFanoutStatistics subscription;
+
+    if (recordingId < 0 || recordingId >= PVR_RECORDER_MAX_RECORDINGS)
+    {
+        return PVR_RECORDER_ERROR;
+    }
+
+    recorded = &recordings[recordingId];
+    pthread_mutex_lock(&recorderMutex);
+    if (recorded->state != RECORDING_RUNNING)
+    {
+        pthread_mutex_unlock(&recorderMutex);
+        return PVR_RECORDER_ERROR;
+    }
+
+    /* packets dropped from here on are not part of the recording, the writer ends the subscription */
+    tsFanoutGetStatistics(recorded->subscriberId, &subscription);
+    COUNTER_ADD(recorded->droppedPackets, subscription.droppedPackets);
+    metricsAdd(droppedPacketsMetric, subscription.droppedPackets);
+    __atomic_store_n(&recorded->state, RECORDING_STOPPING, __ATOMIC_RELEASE);
+
+    /* the writer stores what is queued and closes the file, pvrRecorderReap collects it */
+    __atomic_store_n(&recorded->writerStopping, 1, __ATOMIC_RELEASE);
+    sem_post(&recorded->wake);
+    pthread_mutex_unlock(&recorderMutex);
+
+    return PVR_RECORDER_NO_ERROR;
+}
+
+void pvrRecorderReap()
+{
+    int32_t i;
+
+    pthread_mutex_lock(&recorderMutex);
+    for (i = 0; i < PVR_RECORDER_MAX_RECORDINGS; i++)
+    {
+        if (recordings[i].state == RECORDING_STOPPING && recordings[i].writerDone)
+        {
+            reapRecording(&recordings[i]);
+        }
+    }
+    pthread_mutex_unlock(&recorderMutex);
+}
+
+void pvrRecorderStopAll()
+{
+    int32_t i;
+
+    for (i = 0; i < PVR_RECORDER_MAX_RECORDINGS; i++)
+    {
+        pvrRecorderStop(i);
+    }
+
+    pthread_mutex_lock(&recorderMutex);
+    for (i = 0; i < PVR_RECORDER_MAX_RECORDINGS; i++)
+    {
+        while (recordings[i].state == RECORDING_STOPPING && !recordings[i].writerDone)
+        {
+            pthread_cond_wait(&writerFinished, &recorderMutex);
+        }
+        if (recordings[i].state == RECORDING_STOPPING)
+        {
+            reapRecording(&recordings[i]);
+        }
+    }
+    pthread_mutex_unlock(&recorderMutex);
+}
+
+pvrRecorderStatus pvrRecorderFind(uint16_t programNumber, int32_t *recordingId)
+{
+    int32_t i;
+
+    pthread_mutex_lock(&recorderMutex);
+    for (i = 0; i < PVR_RECORDER_MAX_RECORDINGS; i++)
+    {
+        if (recordings[i].state == RECORDING_RUNNING && recordings[i].service.programNumber == programNumber)
+        {
+            pthread_mutex_unlock(&recorderMutex);
+            *recordingId = i;
+            return PVR_RECORDER_NO_ERROR;
+        }
+    }
+    pthread_mutex_unlock(&recorderMutex);
+
+    return PVR_RECORDER_ERROR;
+}
+
+pvrRecorderStatus pvrRecorderStatistics(int32_t recordingId, pvrStatistics *statistics)
+{
+    recording *recorded;
+    tsFanoutStatistics subscription;
+    uint64_t startNs;
+    uint64_t endNs;
+
+    if (recordingId < 0 || recordingId >= PVR_RECORDER_MAX_RECORDINGS)
+    {
+        return PVR_RECORDER_ERROR;
+    }
+
+    recorded = &recordings[recordingId];
+    startNs = __atomic_load_n(&recorded->startNs, __ATOMIC_RELAXED);
+    if (!startNs)
+    {
+        return PVR_RECORDER_ERROR;
+    }
+
+    statistics->recording = __atomic_load_n(&recorded->state, __ATOMIC_ACQUIRE) == RECORDING_RUNNING;
+    statistics->programNumber = recorded->service.programNumber;
+    statistics->packets = COUNTER_READ(recorded->packets);
+    statistics->droppedPackets = COUNTER_READ(recorded->droppedPackets);
+    if (statistics->recording)
+    {
+        tsFanoutGetStatistics(recorded->subscriberId, &subscription);
+        statistics->droppedPackets = subscription.droppedPackets;
+    }
+    statistics->writtenBytes = COUNTER_READ(recorded->writtenBytes);
+    statistics->maxWriteUs = COUNTER_READ(recorded->maxWriteUs);
+    statistics->directIo = recorded->directIo;
+    statistics->failed = __atomic_load_n(&recorded->writeFailed, __ATOMIC_RELAXED);
+
+    /* a stopping recording lasts until its writer closed the file */
+    endNs = __atomic_load_n(&recorded->stopNs, __ATOMIC_RELAXED);
+    if (!endNs)
+    {
+        endNs = latencyNowNs();
+    }
+    statistics->durationNs = endNs > startNs ? endNs - startNs : 0;
+
+    return PVR_RECORDER_NO_ERROR;
+}
+
+void pvrRecorderPrintStatistics()
+{
+    pvrStatistics statistics;
+    int32_t i;
+
+    for (i = 0; i < PVR_RECORDER_MAX_RECORDINGS; i++)
+    {
+        if (pvrRecorderStatistics(i, &statistics) || !statistics.durationNs)
+        {
+            continue;
+        }
+
+        printf("\nRecording%s program %u: %llu packets, %llu dropped, %llu bytes written in %.1f s (%.1f MB/s%s), longest write %u us\n",
+               statistics.recording ? "" : " of", statistics.programNumber, (unsigned long long)statistics.packets,
+               (unsigned long long)statistics.droppedPackets, (unsigned long long)statistics.writtenBytes,
+               statistics.durationNs / 1e9, statistics.writtenBytes * 1000.0 / statistics.durationNs,
+               statistics.directIo ? ", O_DIRECT" : "", statistics.maxWriteUs);
+    }
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for copying a packet into the chunk, called on the writer thread. A full
+ *           chunk is written at once; packets do not divide it, so one may continue in the next.
+ *
+ * @param    recorded - [in] Recording.
+ *           packet - [in] Transport stream packet.
+****************************************************************************/
+static void putPacket(recording *recorded, const uint8_t *packet)
+{
+    uint32_t first = PVR_RECORDER_CHUNK_SIZE - recorded->chunkFill;
+
+    if (first > TS_PACKET_SIZE)
+    {
+        memcpy(&recorded->chunk[recorded->chunkFill], packet, TS_PACKET_SIZE);
+        recorded->chunkFill += TS_PACKET_SIZE;
+    }
+    else
+    {
+        memcpy(&recorded->chunk[recorded->chunkFill], packet, first);
+        writeChunk(recorded, PVR_RECORDER_CHUNK_SIZE);
+        memcpy(recorded->chunk, packet + first, TS_PACKET_SIZE - first);
+        recorded->chunkFill = TS_PACKET_SIZE - first;
+    }
+
+    COUNTER_ADD(recorded->packets, 1);
+}
+
+/****************************************************************************
+ * @brief    Function for putting the generated single program PAT and PMT into the chunk.
+ *
+ * @param    recorded - [in] Recording.
+****************************************************************************/
+static void putPsi(recording *recorded)
+{
+    uint8_t section[TS_PACKET_SIZE];
+    uint16_t sectionLength;
+    uint8_t *stream;
+    const pvrService *service = &recorded->service;
+
+    /* PAT with the recorded program only */
+    section[0] = 0x00;
+    section[1] = 0xB0;
+    section[2] = 13;
+    section[3] = GENERATED_TRANSPORT_STREAM_ID >> 8;
+    section[4] = GENERATED_TRANSPORT_STREAM_ID & 0xFF;
+    section[5] = SECTION_RESERVED_VERSION;
+    section[6] = 0;
+    section[7] = 0;
+    section[8] = service->programNumber >> 8;
+    section[9] = service->programNumber & 0xFF;
+    section[10] = 0xE0 | (service->pmtPid >> 8);
+    section[11] = service->pmtPid & 0xFF;
+    putSection(recorded, 0, &recorded->patContinuity, section);
+
+    /* PMT with the recorded streams, descriptors are not carried over */
+    section[0] = 0x02;
+    section[3] = service->programNumber >> 8;
+    section[4] = service->programNumber & 0xFF;
+    section[5] = SECTION_RESERVED_VERSION;
+    section[6] = 0;
+    section[7] = 0;
+    section[8] = 0xE0 | (service->pcrPid >> 8);
+    section[9] = service->pcrPid & 0xFF;
+    section[10] = 0xF0;
+    section[11] = 0;
+
+    stream = &section[12];
+    if (service->videoPid < TS_NULL_PID)
+    {
+        stream[0] = service->videoStreamType;
+        stream[1] = 0xE0 | (service->videoPid >> 8);
+        stream[2] = service->videoPid & 0xFF;
+        stream[3] = 0xF0;
+        stream[4] = 0;
+        stream += 5;
+    }
+    if (service->audioPid < TS_NULL_PID)
+    {
+        stream[0] = service->audioStreamType;
+        stream[1] = 0xE0 | (service->audioPid >> 8);
+        stream[2] = service->audioPid & 0xFF;
+        stream[3] = 0xF0;
+        stream[4] = 0;
+        stream += 5;
+    }
+
+    sectionLength = (stream - section) - 3 + 4;
+    section[1] = 0xB0 | (sectionLength >> 8);
+    section[2] = sectionLength & 0xFF;
+    putSection(recorded, service->pmtPid, &recorded->pmtContinuity, section);
+}
+
+/****************************************************************************
+ * @brief    Function for closing a section with its CRC_32 and putting it into the chunk as one packet.
+ *
+ * @param    recorded - [in] Recording.
+ *           pid - [in] Packet identifier.
+ *           continuity - [in/out] Continuity counter of the PID.
+ *           section - [in] Section without CRC_32, section_length already counting it.
+****************************************************************************/
+static void putSection(recording *recorded, uint16_t pid, uint8_t *continuity, uint8_t *section)
+{
+    uint8_t packet[TS_PACKET_SIZE];
+    uint16_t length = 3 + (((section[1] & 0x0F) << 8) | section[2]);
+    uint32_t crc = calculateSectionCrc(section, length - 4);
+
+    section[length - 4] = crc >> 24;
+    section[length - 3] = (crc >> 16) & 0xFF;
+    section[length - 2] = (crc >> 8) & 0xFF;
+    section[length - 1] = crc & 0xFF;
+
+    /* payload_unit_start_indicator set, pointer_field 0, stuffing after the section */
+    packet[0] = TS_SYNC_BYTE;
+    packet[1] = 0x40 | (pid >> 8);
+    packet[2] = pid & 0xFF;
+    packet[3] = 0x10 | *continuity;
+    packet[4] = 0;
+    memcpy(&packet[5], section, length);
+    memset(&packet[5 + length], 0xFF, TS_PACKET_SIZE - 5 - length);
+
+    *continuity = (*continuity + 1) & 0x0F;
+    putPacket(recorded, packet);
+}
+
+/****************************************************************************
+ * @brief    Function for storing the packets of a recording as the fan-out wakes the writer thread,
+ *           until the recording stops, then the incomplete last chunk. Ends the subscription, closes
+ *           the file and reports that the recording can be reaped.
+ *
+ * @param    arg - [in] Recording.
+ *
+ * @return   NULL.
+****************************************************************************/
+static void *writerWorker(void *arg)
+{
+    recording *recorded = arg;
+    uint8_t stopping = 0;
+
+    while (!stopping)
+    {
+        sem_wait(&recorded->wake);
+        stopping = __atomic_load_n(&recorded->writerStopping, __ATOMIC_ACQUIRE);
+        takeReferences(recorded);
+    }
+
+    /* the file length is no multiple of the block size, the end is written through the page cache */
+    if (recorded->chunkFill)
+    {
+        if (recorded->directIo)
+        {
+            fcntl(recorded->fileDesc, F_SETFL, fcntl(recorded->fileDesc, F_GETFL) & ~O_DIRECT);
+        }
+        writeChunk(recorded, recorded->chunkFill);
+        recorded->chunkFill = 0;
+    }
+
+    /* the writer is the only consumer of the subscription, nothing else takes its references */
+    tsFanoutUnsubscribe(recorded->subscriberId);
+    if (close(recorded->fileDesc))
+    {
+        LOG_ERROR("Error while closing the recording: %s", strerror(errno));
+        __atomic_store_n(&recorded->writeFailed, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&recorded->stopNs, latencyNowNs(), __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&recorderMutex);
+    recorded->writerDone = 1;
+    pthread_cond_broadcast(&writerFinished);
+    pthread_mutex_unlock(&recorderMutex);
+
+    if (finishedCallback)
+    {
+        finishedCallback();
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for taking every queued reference of a recording, storing its packets with
+ *           the generated PSI in between, and releasing the shared block.
+ *
+ * @param    recorded - [in] Recording.
+****************************************************************************/
+static void takeReferences(recording *recorded)
+{
+    tsFanoutReference reference;
+    uint64_t mask;
+
+    while (!tsFanoutNext(recorded->subscriberId, &reference))
+    {
+        /* the recording starts with PAT and PMT, a player can open it at any repetition */
+        if (reference.block->arrivalNs >= recorded->nextPsiNs)
+        {
+            putPsi(recorded);
+            recorded->nextPsiNs = reference.block->arrivalNs + PVR_RECORDER_PSI_INTERVAL_NS;
+        }
+
+        for (mask = reference.packetMask; mask; mask &= mask - 1)
+        {
+            putPacket(recorded, &reference.block->packets[__builtin_ctzll(mask) * TS_PACKET_SIZE]);
+        }
+        tsFanoutRelease(reference.block);
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for writing the start of the chunk to the file.
+ *
+ * @param    recorded - [in] Recording.
+ *           length - [in] Number of bytes to write.
+****************************************************************************/
+static void writeChunk(recording *recorded, uint32_t length)
+{
+    uint64_t written = 0;
+    uint64_t writeStartNs = latencyNowNs();
+    uint32_t writeUs;
+    ssize_t result;
+
+    while (written < length && !recorded->writeFailed)
+    {
+        result = write(recorded->fileDesc, recorded->chunk + written, length - written);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result < 0 && errno == EINVAL && recorded->directIo)
+        {
+            /* the file system accepted O_DIRECT when opening but not for writing */
+            recorded->directIo = 0;
+            fcntl(recorded->fileDesc, F_SETFL, fcntl(recorded->fileDesc, F_GETFL) & ~O_DIRECT);
+            continue;
+        }
+        if (result <= 0)
+        {
+            LOG_ERROR("Error while writing the recording: %s", result < 0 ? strerror(errno) : "nothing written");
+            __atomic_store_n(&recorded->writeFailed, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        written += result;
+    }
+
+    writeUs = (latencyNowNs() - writeStartNs) / 1000;
+    if (writeUs > recorded->maxWriteUs)
+    {
+        __atomic_store_n(&recorded->maxWriteUs, writeUs, __ATOMIC_RELAXED);
+    }
+    COUNTER_ADD(recorded->writtenBytes, written);
+    metricsAdd(writtenBytesMetric, written);
+}
+
+/****************************************************************************
+ * @brief    Function for joining the finished writer of a stopped recording, logging its
+ *           statistics and freeing its slot. Called with recorderMutex held.
+ *
+ * @param    recorded - [in] Stopping recording whose writer is done.
+****************************************************************************/
+static void reapRecording(recording *recorded)
+{
+    pvrStatistics statistics;
+
+    /* the writer already returned, the join does not wait */
+    pthread_join(recorded->writerThread, NULL);
+    sem_destroy(&recorded->wake);
+
+    pvrRecorderStatistics(recorded - recordings, &statistics);
+    if (statistics.failed)
+    {
+        LOG_ERROR("Recording of program %u failed after %llu bytes!", statistics.programNumber,
+                  (unsigned long long)statistics.writtenBytes);
+    }
+    else
+    {
+        LOG_INFO("Recording of program %u stopped: %llu bytes in %.1f s, %.1f MB/s, %llu packets dropped, longest write %u us",
+                 statistics.programNumber, (unsigned long long)statistics.writtenBytes, statistics.durationNs / 1e9,
+                 statistics.durationNs ? statistics.writtenBytes * 1000.0 / statistics.durationNs : 0.0,
+                 (unsigned long long)statistics.droppedPackets, statistics.maxWriteUs);
+    }
+
+    __atomic_store_n(&recorded->state, RECORDING_IDLE, __ATOMIC_RELEASE);
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
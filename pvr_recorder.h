@@ -0,0 +1,143 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file pvr_recorder.h
+ *
+ * \brief
+ * Header of the PVR recorder module. Up to PVR_RECORDER_MAX_RECORDINGS services of the
+ * multiplex are recorded to .ts files at once. Every recording subscribes to the video,
+ * audio and PCR PIDs of its service at the transport stream fan-out, and its writer thread
+ * reads the packets in place from the shared blocks, replaces the original PSI by a generated
+ * single program PAT and PMT, and gathers everything into an aligned chunk written with
+ * O_DIRECT. The packet source never waits for the disk; packets a recording falls too far
+ * behind for are dropped and counted.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _PVR_RECORDER_H_
+#define _PVR_RECORDER_H_
+
+#include <stdint.h>
+
+#define PVR_RECORDER_DIRECTORY "/var/tmp"
+#define PVR_RECORDER_MAX_RECORDINGS 8
+#define PVR_RECORDER_CHUNK_SIZE (512 * 1024)                      // bytes per write, a multiple of the block size
+#define PVR_RECORDER_ALIGNMENT 4096                               // O_DIRECT buffer and offset alignment
+#define PVR_RECORDER_PSI_INTERVAL_NS 100000000ULL                 // generated PAT and PMT repetition
+#define PVR_RECORDER_PMT_PID 0x0100                               // used if the service PMT PID is unknown
+
+typedef enum _pvrRecorderStatus
+{
+    PVR_RECORDER_NO_ERROR = 0,
+    PVR_RECORDER_ERROR
+} pvrRecorderStatus;
+
+typedef struct _pvrService
+{
+    uint16_t programNumber;
+    uint16_t pmtPid;          // PID the generated PMT is sent on, 0 for PVR_RECORDER_PMT_PID
+    uint16_t pcrPid;          // 0x1FFF if the service has no PCR
+    uint16_t videoPid;        // 0x1FFF if the service has no video
+    uint8_t videoStreamType;  // DVB stream_type written to the PMT
+    uint16_t audioPid;        // 0x1FFF if the service has no audio
+    uint8_t audioStreamType;
+} pvrService;
+
+typedef void (*pvrRecorderFinished)();
+
+typedef struct _pvrStatistics
+{
+    uint8_t recording;
+    uint16_t programNumber;
+    uint64_t packets;        // packets stored in the chunk, generated PAT and PMT included
+    uint64_t droppedPackets; // packets lost because the recording fell too far behind the fan-out
+    uint64_t writtenBytes;   // bytes the writer thread stored in the file
+    uint64_t durationNs;     // time since the recording started, or its length once stopped
+    uint32_t maxWriteUs;     // longest single write
+    uint8_t directIo;        // 1 if the file is written with O_DIRECT
+    uint8_t failed;          // 1 if a write or closing the file failed
+} pvrStatistics;
+
+/****************************************************************************
+ * @brief    Function for PVR recorder initialization. Registers metrics.
+ *
+ * @param    finished - [in] Called on a writer thread once a stopped recording can be reaped, may be NULL.
+ *
+ * @return   PVR_RECORDER_NO_ERROR, if there are no errors.
+ *           PVR_RECORDER_ERROR, in case of an error.
+****************************************************************************/
+pvrRecorderStatus pvrRecorderInit(pvrRecorderFinished finished);
+
+/****************************************************************************
+ * @brief    Function for starting to record a service to a file. The file is created or truncated.
+ *
+ * @param    path - [in] Output file path.
+ *           service - [in] PIDs and stream types of the service.
+ *           recordingId - [out] Recording identifier.
+ *
+ * @return   PVR_RECORDER_NO_ERROR, if there are no errors.
+ *           PVR_RECORDER_ERROR, if PVR_RECORDER_MAX_RECORDINGS recordings are running or the file
+ *           or writer thread can not be created.
+****************************************************************************/
+pvrRecorderStatus pvrRecorderStart(const char *path, const pvrService *service, int32_t *recordingId);
+
+/****************************************************************************
+ * @brief    Function for stopping a recording without waiting for it. The writer thread stores every
+ *           packet received so far, ends the subscription, closes the file and calls the finished
+ *           callback; pvrRecorderReap then logs the result and frees the recording.
+ *
+ * @param    recordingId - [in] Recording identifier.
+ *
+ * @return   PVR_RECORDER_NO_ERROR, if there are no errors.
+ *           PVR_RECORDER_ERROR, if the recording is not running.
+****************************************************************************/
+pvrRecorderStatus pvrRecorderStop(int32_t recordingId);
+
+/****************************************************************************
+ * @brief    Function for joining the writers of stopped recordings that finished, logging their
+ *           statistics and freeing them for new recordings. Never waits for a writer.
+****************************************************************************/
+void pvrRecorderReap();
+
+/****************************************************************************
+ * @brief    Function for stopping every running recording and waiting until every writer finished.
+****************************************************************************/
+void pvrRecorderStopAll();
+
+/****************************************************************************
+ * @brief    Function for finding the running recording of a program.
+ *
+ * @param    programNumber - [in] Program number of the service.
+ *           recordingId - [out] Recording identifier.
+ *
+ * @return   PVR_RECORDER_NO_ERROR, if the program is being recorded.
+ *           PVR_RECORDER_ERROR, if it is not.
+****************************************************************************/
+pvrRecorderStatus pvrRecorderFind(uint16_t programNumber, int32_t *recordingId);
+
+/****************************************************************************
+ * @brief    Function for reading the statistics of a running or stopped recording, safe to call
+ *           from any thread.
+ *
+ * @param    recordingId - [in] Recording identifier.
+ *           statistics - [out] Recording statistics.
+ *
+ * @return   PVR_RECORDER_NO_ERROR, if there are no errors.
+ *           PVR_RECORDER_ERROR, if the identifier was never started.
+****************************************************************************/
+pvrRecorderStatus pvrRecorderStatistics(int32_t recordingId, pvrStatistics *statistics);
+
+/****************************************************************************
+ * @brief    Function for printing the statistics of the running and last recordings.
+****************************************************************************/
+void pvrRecorderPrintStatistics();
+
+#endif // _PVR_RECORDER_H_
@@ -17,18 +17,16 @@
  ***************************************************************************************/
 
 #include "remote_controller.h"
+#include "timer_controller.h"
+#include "event_reactor.h"
+#include "input_controller.h"
+#include "latency_histogram.h"
+#include "trace.h"
+#include "metrics.h"
 
-#include <linux/input.h>
-#include <fcntl.h>
-#include <stdlib.h>
-#include <unistd.h>
 #include <stdint.h>
-#include <errno.h>
-
-/* helper keywords needed only for graphics controller module */
-#define DEV_PATH "/dev/input/event0"
-#define NUM_EVENTS 5
 
+/* helper keywords needed only for remote controller module */
 #define REMOTE_KEY_1 2
 #define REMOTE_KEY_2 3
 #define REMOTE_KEY_3 4
@@ -49,188 +47,192 @@
 #define REMOTE_KEY_INFO 358
 #define REMOTE_KEY_MENU 369
 #define REMOTE_KEY_EXIT 102
+#define REMOTE_KEY_RECORD 167
+#define REMOTE_KEY_PAUSE 119
+#define REMOTE_KEY_REWIND 168
+#define REMOTE_KEY_FAST_FORWARD 208
 
 /* helper variables needed only for remote controller module */
-static int32_t inputFileDesc;
-static struct input_event *eventBuf;
-
 static uint16_t channelNumber;
-static timer_t timerChannelNumber;
+static timerHandle timerChannelNumber;
 static uint8_t channelKeysPressed;
 static uint8_t channelKeys[3];
 
 static uint8_t showingMenuInfo;
 
+/* key-to-photon latency of menu page changes */
+static uint64_t menuLatencyTotalUs;
+static uint32_t menuLatencyCount;
+
+static int32_t keyPressesMetric = -1;
+
 /* helper functions needed only for remote controller module */
-remoteControllerStatus getKeys(int32_t count, uint8_t *buf, int32_t *eventRead);
 static void generateChannelNumber(uint8_t remoteKey);
 static void changeChannel();
+static void reportMenuLatency(const struct input_event *keyEvent);
+static void handleKeyEvent(const struct input_event *event);
 
 remoteControllerStatus remoteControllerInit()
 {
-    char deviceName[20];
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_key_presses_total", "Key presses handled from all input devices", &keyPressesMetric);
 
-    inputFileDesc = open(DEV_PATH, O_RDWR);
-    if (inputFileDesc == -1)
+    /* keys of every remote, IR receiver and keyboard are handled the same way */
+    if (inputControllerInit(handleKeyEvent))
     {
-        printf("Error while opening device (%s) !\n", strerror(errno));
-        return REMOTE_CONTROLLER_ERROR;
-    }
-
-    ioctl(inputFileDesc, EVIOCGNAME(sizeof(deviceName)), deviceName);
-    printf("RC device opened succesfully [%s]\n", deviceName);
-
-    eventBuf = malloc(NUM_EVENTS * sizeof(struct input_event));
-    if (!eventBuf)
-    {
-        printf("Error allocating memory !\n");
+        printf("Error while opening input devices!\n");
         return REMOTE_CONTROLLER_ERROR;
     }
 
     return REMOTE_CONTROLLER_NO_ERROR;
 }
 
-void *remoteControllerEvent()
+remoteControllerStatus remoteControllerDeinit()
 {
-    uint32_t eventCnt;
-    uint32_t i;
-    uint32_t exit = 0;
-
-    while (exit == 0)
-    {
-        /* read input events */
-        if (getKeys(NUM_EVENTS, (uint8_t *)eventBuf, &eventCnt))
-        {
-            printf("Error while reading input events!");
-            exit = 1;
-        }
+    timerStopAndDelete(&timerChannelNumber);
+    inputControllerDeinit();
 
-        for (i = 0; i < eventCnt; i++)
-        {
-            if (eventBuf[i].value == 1)
-            {
-                switch (eventBuf[i].code)
-                {
-                case REMOTE_KEY_PROGRAM_UP:
-                    playNextChannel();
-                    break;
-
-                case REMOTE_KEY_PROGRAM_DOWN:
-                    playPreviousChannel();
-                    break;
-
-                case REMOTE_KEY_VOLUME_UP:
-                    volumeUp();
-                    break;
-
-                case REMOTE_KEY_VOLUME_DOWN:
-                    volumeDown();
-                    break;
-
-                case REMOTE_KEY_MUTE:
-                    volumeMute();
-                    break;
-
-                case REMOTE_KEY_INFO:
-                    showChannelInfo();
-                    break;
-
-                case REMOTE_KEY_MENU:
-                    if (!showingMenuInfo)
-                    {
-                        showMenuInfo(1);
-                        showingMenuInfo = 1;
-                    }
-                    else
-                    {
-                        showMenuInfo(0);
-                        showingMenuInfo = 0;
-                    }
-                    break;
-
-                case REMOTE_KEY_LEFT_ARROW:
-                    if (showingMenuInfo)
-                    {
-                        showMenuInfo(1);
-                    }
-                    break;
-
-                case REMOTE_KEY_RIGHT_ARROW:
-                    if (showingMenuInfo)
-                    {
-                        showMenuInfo(2);
-                    }
-                    break;
-
-                case REMOTE_KEY_EXIT:
-                    exit = 1;
-                    break;
-
-                default:
-                    if (eventBuf[i].code >= 2 && eventBuf[i].code <= 11)
-                    {
-                        /* remote number buttor pressed */
-                        if (timerChannelNumber)
-                            timerStopAndDelete(&timerChannelNumber);
-                        if (eventBuf[i].code != 11)
-                            generateChannelNumber(eventBuf[i].code - 1);
-                        else
-                            generateChannelNumber(0);
-                        showChannelNumber(channelNumber);
-                        timerSetAndStart(&timerChannelNumber, 3, changeChannel);
-                    }
-                    else
-                    {
-                        printf("%d key not assigned!\n", eventBuf[i].code);
-                    }
-                    break;
-                } // switch exit
-            }     // if exit
-            else if (eventBuf[i].value == 2)
-            {
-                switch (eventBuf[i].code)
-                {
-                case REMOTE_KEY_VOLUME_UP:
-                    volumeUp();
-                    break;
-
-                case REMOTE_KEY_VOLUME_DOWN:
-                    volumeDown();
-                    break;
-                } // switch exit
-            }     // else if exit
-        }         // for loop exit
-    }             // while loop exit
-
-    free(eventBuf);
-    return (void *)REMOTE_CONTROLLER_NO_ERROR;
+    return REMOTE_CONTROLLER_NO_ERROR;
 }
 
+/* -------------------- HELPER FUNCTIONS -------------------- */
 /****************************************************************************
- * @brief    Function for getting values from remote key press.
+ * @brief    Function for executing functions on corresponding key press event.
+ *           Called on the event loop thread for key events of every input device.
  *
- * @param    count - [in] Number of pressed keys.
- *           subtitleCount - [in] Input buffer.
- *           subtitles - [in] Pointer to calculated read event number.
- *
- * @return   REMOTE_CONTROLLER_NO_ERROR, if there are no errors.
- *           REMOTE_CONTROLLER_ERROR, in case of an error.
+ * @param    event - [in] Key event with kernel timestamp.
 ****************************************************************************/
-remoteControllerStatus getKeys(int32_t count, uint8_t *buf, int32_t *eventsRead)
+static void handleKeyEvent(const struct input_event *event)
 {
-    int32_t ret = 0;
+    uint64_t keyTime;
 
-    /* read input events and put them in buffer */
-    ret = read(inputFileDesc, buf, (size_t)(count * (int)sizeof(struct input_event)));
-    if (ret <= 0)
+    if (event->value != 1 && event->value != 2)
     {
-        printf("Error code %d", ret);
-        return REMOTE_CONTROLLER_ERROR;
+        /* key release */
+        return;
     }
-    /* calculate number of read events */
-    *eventsRead = ret / (int)sizeof(struct input_event);
 
-    return REMOTE_CONTROLLER_NO_ERROR;
+    /* everything drawn and tuned below is attributed to this key press */
+    keyTime = inputEventTimestampNs(event);
+    latencyRecordSince(LATENCY_STAGE_INPUT_DISPATCH, keyTime);
+    latencyMarkInput(keyTime);
+    TRACE_COUNTER("key", event->code);
+    metricsAdd(keyPressesMetric, 1);
+
+    if (event->value == 1)
+    {
+        switch (event->code)
+        {
+        case REMOTE_KEY_PROGRAM_UP:
+            playNextChannel();
+            break;
+
+        case REMOTE_KEY_PROGRAM_DOWN:
+            playPreviousChannel();
+            break;
+
+        case REMOTE_KEY_VOLUME_UP:
+            volumeUp();
+            break;
+
+        case REMOTE_KEY_VOLUME_DOWN:
+            volumeDown();
+            break;
+
+        case REMOTE_KEY_MUTE:
+            volumeMute();
+            break;
+
+        case REMOTE_KEY_INFO:
+            showChannelInfo();
+            break;
+
+        case REMOTE_KEY_MENU:
+            if (!showingMenuInfo)
+            {
+                showMenuInfo(1);
+                showingMenuInfo = 1;
+                reportMenuLatency(event);
+            }
+            else
+            {
+                showMenuInfo(0);
+                showingMenuInfo = 0;
+            }
+            break;
+
+        case REMOTE_KEY_LEFT_ARROW:
+            if (showingMenuInfo)
+            {
+                showMenuInfo(1);
+                reportMenuLatency(event);
+            }
+            break;
+
+        case REMOTE_KEY_RIGHT_ARROW:
+            if (showingMenuInfo)
+            {
+                showMenuInfo(2);
+                reportMenuLatency(event);
+            }
+            break;
+
+#ifdef TDP_FILE_SOURCE
+        /* recordings and timeshift need the packets the player plays, only the file source player passes them */
+        case REMOTE_KEY_RECORD:
+            toggleRecording();
+            break;
+
+        case REMOTE_KEY_PAUSE:
+            togglePause();
+            break;
+
+        case REMOTE_KEY_REWIND:
+            jumpBackward();
+            break;
+
+        case REMOTE_KEY_FAST_FORWARD:
+            catchUpWithLive();
+            break;
+#endif
+
+        case REMOTE_KEY_EXIT:
+            eventReactorStop();
+            break;
+
+        default:
+            if (event->code >= 2 && event->code <= 11)
+            {
+                /* remote number buttor pressed */
+                if (event->code != 11)
+                    generateChannelNumber(event->code - 1);
+                else
+                    generateChannelNumber(0);
+                showChannelNumber(channelNumber);
+                timerSetAndStart(&timerChannelNumber, 3, changeChannel);
+            }
+            else
+            {
+                LOG_WARN("%d key not assigned!", event->code);
+            }
+            break;
+        } // switch exit
+    }     // if exit
+    else if (event->value == 2)
+    {
+        switch (event->code)
+        {
+        case REMOTE_KEY_VOLUME_UP:
+            volumeUp();
+            break;
+
+        case REMOTE_KEY_VOLUME_DOWN:
+            volumeDown();
+            break;
+        } // switch exit
+    }     // else if exit
+
+    /* key caused no flip, do not attribute a later one to it */
+    latencyMarkInput(0);
 }
 
 /****************************************************************************
@@ -283,3 +285,25 @@ static void changeChannel()
         channelKeys[i] = 0;
     }
 }
+
+/****************************************************************************
+ * @brief    Function for printing time passed from key press until the menu page was flipped to screen.
+ *
+ * @param    keyEvent - [in] Key press event with kernel timestamp.
+****************************************************************************/
+static void reportMenuLatency(const struct input_event *keyEvent)
+{
+    int64_t latencyUs = inputEventAgeUs(keyEvent);
+
+    if (latencyUs < 0)
+    {
+        return;
+    }
+
+    menuLatencyTotalUs += latencyUs;
+    menuLatencyCount++;
+
+    LOG_INFO("Menu page latency: %lld us (average %llu us over %u pages)", (long long)latencyUs,
+             (unsigned long long)(menuLatencyTotalUs / menuLatencyCount), menuLatencyCount);
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
@@ -28,7 +28,7 @@ typedef enum _remoteControllerStatus
 } remoteControllerStatus;
 
 /****************************************************************************
- * @brief    Function for remote controller initialization.
+ * @brief    Function for remote controller initialization. Key presses are handled on the event loop.
  *
  * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
  *           STREAM_CONTROLLER_ERROR, in case of an error.
@@ -36,8 +36,11 @@ typedef enum _remoteControllerStatus
 remoteControllerStatus remoteControllerInit();
 
 /****************************************************************************
- * @brief    Function for executing functions on corresponding key press event.
+ * @brief    Function for remote controller deinitialization.
+ *
+ * @return   REMOTE_CONTROLLER_NO_ERROR, if there are no errors.
+ *           REMOTE_CONTROLLER_ERROR, in case of an error.
 ****************************************************************************/
-void *remoteControllerEvent();
+remoteControllerStatus remoteControllerDeinit();
 
 #endif
@@ -0,0 +1,1036 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file software_framebuffer.c
+ *
+ * \brief
+ * Implementation of the headless software framebuffer backend.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "software_framebuffer.h"
+#include "osd_kernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+/* helper keywords needed only for software framebuffer module */
+#define GLYPH_COUNT 256
+#define PALETTE_SIZE 256
+
+/* helper macro functions needed only for software framebuffer module */
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+/* exact rounded division by 255 for values up to 255 * 255 */
+#define DIV255(x) (((x) + 128 + (((x) + 128) >> 8)) >> 8)
+/* 8-bit channel to 4 bits, rounded or with an ordered dither threshold from 0 to 15 */
+#define QUANTIZE4(x) (((x)*15 + 127) / 255)
+#define DITHER4(x, threshold) (((x)*15 + (threshold)*16 + 8) / 255)
+
+typedef struct _softwareGlyph
+{
+    uint8_t loaded;
+    uint8_t *bitmap;
+    int width;
+    int rows;
+    int left;
+    int top;
+    int advance;
+} softwareGlyph;
+
+/* helper variables needed only for software framebuffer module */
+static FT_Library freetypeLibrary;
+
+/* 4x4 Bayer matrix for ordered dithering of anti-aliased edges on reduced formats */
+static const uint8_t bayerMatrix[4][4] = {
+    {0, 8, 2, 10},
+    {12, 4, 14, 6},
+    {3, 11, 1, 9},
+    {15, 7, 13, 5}};
+
+static int modeWidth = SOFTWARE_FRAMEBUFFER_DEFAULT_WIDTH;
+static int modeHeight = SOFTWARE_FRAMEBUFFER_DEFAULT_HEIGHT;
+static IDirectFBSurface *primarySurface = NULL;
+
+/* helper functions needed only for software framebuffer module */
+static int bytesPerPixel(DFBSurfacePixelFormat format);
+static uint8_t *surfacePixel(IDirectFBSurface *surface, int x, int y);
+static void fillSpan(IDirectFBSurface *surface, int x, int y, int count);
+static void fill4444(uint16_t *destination, uint32_t count, uint16_t color);
+static void blendGlyph4444(uint16_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color, int x, int y);
+static void ditherGlyphLUT8(uint8_t *destination, const uint8_t *coverage, uint32_t count, uint8_t colorIndex, int x, int y);
+static uint8_t nearestPaletteIndex(IDirectFBPalette *palette, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+static void readPixel(IDirectFBSurface *surface, const uint8_t *row, int x, uint8_t *rgba);
+static softwareGlyph *loadGlyph(IDirectFBFont *font, uint8_t character);
+static void blendGlyph(IDirectFBSurface *surface, softwareGlyph *glyph, int x, int y);
+static void writeChunk(FILE *filePointer, const char *type, const uint8_t *data, uint32_t length);
+
+/* interface functions needed only for software framebuffer module */
+static DFBResult dfbSetCooperativeLevel(IDirectFB *thiz, DFBCooperativeLevel level);
+static DFBResult dfbCreateSurface(IDirectFB *thiz, const DFBSurfaceDescription *desc, IDirectFBSurface **interface);
+static DFBResult dfbCreateFont(IDirectFB *thiz, const char *filename, const DFBFontDescription *desc, IDirectFBFont **interface);
+static DFBResult dfbRelease(IDirectFB *thiz);
+static DFBResult surfaceGetSize(IDirectFBSurface *thiz, int *width, int *height);
+static DFBResult surfaceSetColor(IDirectFBSurface *thiz, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+static DFBResult surfaceSetFont(IDirectFBSurface *thiz, IDirectFBFont *font);
+static DFBResult surfaceFillRectangle(IDirectFBSurface *thiz, int x, int y, int w, int h);
+static DFBResult surfaceFillTriangle(IDirectFBSurface *thiz, int x1, int y1, int x2, int y2, int x3, int y3);
+static DFBResult surfaceDrawString(IDirectFBSurface *thiz, const char *text, int bytes, int x, int y, DFBSurfaceTextFlags flags);
+static DFBResult surfaceBlit(IDirectFBSurface *thiz, IDirectFBSurface *source, const DFBRectangle *source_rect, int x, int y);
+static DFBResult surfaceFlip(IDirectFBSurface *thiz, const DFBRegion *region, DFBSurfaceFlipFlags flags);
+static DFBResult surfaceGetPalette(IDirectFBSurface *thiz, IDirectFBPalette **interface);
+static DFBResult surfaceRelease(IDirectFBSurface *thiz);
+static DFBResult paletteGetSize(IDirectFBPalette *thiz, unsigned int *size);
+static DFBResult paletteSetEntries(IDirectFBPalette *thiz, const DFBColor *entries, unsigned int num_entries, unsigned int offset);
+static DFBResult paletteRelease(IDirectFBPalette *thiz);
+static DFBResult fontGetHeight(IDirectFBFont *thiz, int *height);
+static DFBResult fontGetDescender(IDirectFBFont *thiz, int *descender);
+static DFBResult fontGetGlyphExtents(IDirectFBFont *thiz, unsigned int character, DFBRectangle *rect, int *advance);
+static DFBResult fontGetStringWidth(IDirectFBFont *thiz, const char *text, int bytes, int *width);
+static DFBResult fontRelease(IDirectFBFont *thiz);
+
+DFBResult DirectFBInit(int *argc, char *(*argv[]))
+{
+    if (!freetypeLibrary && FT_Init_FreeType(&freetypeLibrary))
+    {
+        return DFB_FAILURE;
+    }
+
+    /* pick the fastest pixel kernels the CPU supports */
+    osdKernelsInit();
+
+    return DFB_OK;
+}
+
+DFBResult DirectFBCreate(IDirectFB **interface)
+{
+    IDirectFB *dfb = (IDirectFB *)calloc(1, sizeof(IDirectFB));
+    if (!dfb)
+    {
+        return DFB_NOSYSTEMMEMORY;
+    }
+
+    dfb->SetCooperativeLevel = dfbSetCooperativeLevel;
+    dfb->CreateSurface = dfbCreateSurface;
+    dfb->CreateFont = dfbCreateFont;
+    dfb->Release = dfbRelease;
+
+    *interface = dfb;
+    return DFB_OK;
+}
+
+DFBResult DirectFBErrorFatal(const char *msg, DFBResult result)
+{
+    fprintf(stderr, "(!) software framebuffer: %s failed with result %d\n", msg, result);
+    return result;
+}
+
+void softwareFramebufferSetMode(int width, int height)
+{
+    modeWidth = width;
+    modeHeight = height;
+}
+
+DFBResult softwareFramebufferDumpPNG(const char *fileName)
+{
+    IDirectFBSurface *surface = primarySurface;
+    if (!surface)
+    {
+        return DFB_FAILURE;
+    }
+
+    /* flipping surfaces show the buffer which is not being drawn to */
+    uint8_t displayed = (surface->caps & DSCAPS_FLIPPING) ? !surface->backBuffer : surface->backBuffer;
+    uLong rawSize = (uLong)surface->height * (surface->width * 4 + 1);
+    uLongf compressedSize = compressBound(rawSize);
+    uint8_t *raw = (uint8_t *)malloc(rawSize);
+    uint8_t *compressed = (uint8_t *)malloc(compressedSize);
+    FILE *filePointer;
+    int x;
+    int y;
+
+    if (!raw || !compressed)
+    {
+        free(raw);
+        free(compressed);
+        return DFB_NOSYSTEMMEMORY;
+    }
+
+    /* convert surface rows to straight RGBA scanlines with filter type 0 */
+    for (y = 0; y < surface->height; y++)
+    {
+        const uint8_t *row = surface->buffers[displayed] + y * surface->pitch;
+        uint8_t *out = raw + y * (surface->width * 4 + 1);
+
+        *out++ = 0;
+        for (x = 0; x < surface->width; x++)
+        {
+            readPixel(surface, row, x, out);
+            out += 4;
+        }
+    }
+
+    if (compress2(compressed, &compressedSize, raw, rawSize, Z_BEST_SPEED) != Z_OK || (filePointer = fopen(fileName, "wb")) == NULL)
+    {
+        free(raw);
+        free(compressed);
+        return DFB_FAILURE;
+    }
+
+    uint8_t header[13];
+    header[0] = surface->width >> 24;
+    header[1] = surface->width >> 16;
+    header[2] = surface->width >> 8;
+    header[3] = surface->width;
+    header[4] = surface->height >> 24;
+    header[5] = surface->height >> 16;
+    header[6] = surface->height >> 8;
+    header[7] = surface->height;
+    header[8] = 8;  // bit depth
+    header[9] = 6;  // colour type RGBA
+    header[10] = 0; // deflate compression
+    header[11] = 0; // adaptive filtering
+    header[12] = 0; // no interlace
+
+    fwrite("\x89PNG\r\n\x1a\n", 1, 8, filePointer);
+    writeChunk(filePointer, "IHDR", header, sizeof(header));
+    writeChunk(filePointer, "IDAT", compressed, compressedSize);
+    writeChunk(filePointer, "IEND", NULL, 0);
+    fclose(filePointer);
+
+    free(raw);
+    free(compressed);
+    return DFB_OK;
+}
+
+/* -------------------- INTERFACE FUNCTIONS -------------------- */
+static DFBResult dfbSetCooperativeLevel(IDirectFB *thiz, DFBCooperativeLevel level)
+{
+    return DFB_OK;
+}
+
+static DFBResult dfbCreateSurface(IDirectFB *thiz, const DFBSurfaceDescription *desc, IDirectFBSurface **interface)
+{
+    IDirectFBSurface *surface = (IDirectFBSurface *)calloc(1, sizeof(IDirectFBSurface));
+    if (!surface)
+    {
+        return DFB_NOSYSTEMMEMORY;
+    }
+
+    surface->caps = (desc->flags & DSDESC_CAPS) ? desc->caps : DSCAPS_NONE;
+    surface->width = (desc->flags & DSDESC_WIDTH) ? desc->width : modeWidth;
+    surface->height = (desc->flags & DSDESC_HEIGHT) ? desc->height : modeHeight;
+    surface->pixelformat = (desc->flags & DSDESC_PIXELFORMAT) ? desc->pixelformat : DSPF_ARGB;
+
+    if (!bytesPerPixel(surface->pixelformat))
+    {
+        free(surface);
+        return DFB_UNSUPPORTED;
+    }
+    surface->pitch = surface->width * bytesPerPixel(surface->pixelformat);
+
+    surface->buffers[0] = (uint8_t *)calloc(surface->height, surface->pitch);
+    if (surface->caps & DSCAPS_FLIPPING)
+    {
+        surface->buffers[1] = (uint8_t *)calloc(surface->height, surface->pitch);
+    }
+    if (surface->pixelformat == DSPF_LUT8)
+    {
+        /* every entry starts as transparent black until the palette is set */
+        surface->palette = (IDirectFBPalette *)calloc(1, sizeof(IDirectFBPalette));
+    }
+
+    if (!surface->buffers[0] || ((surface->caps & DSCAPS_FLIPPING) && !surface->buffers[1]) ||
+        (surface->pixelformat == DSPF_LUT8 && !surface->palette))
+    {
+        free(surface->buffers[0]);
+        free(surface->buffers[1]);
+        free(surface->palette);
+        free(surface);
+        return DFB_NOSYSTEMMEMORY;
+    }
+
+    if (surface->palette)
+    {
+        surface->palette->GetSize = paletteGetSize;
+        surface->palette->SetEntries = paletteSetEntries;
+        surface->palette->Release = paletteRelease;
+    }
+
+    surface->GetSize = surfaceGetSize;
+    surface->SetColor = surfaceSetColor;
+    surface->SetFont = surfaceSetFont;
+    surface->FillRectangle = surfaceFillRectangle;
+    surface->FillTriangle = surfaceFillTriangle;
+    surface->DrawString = surfaceDrawString;
+    surface->Blit = surfaceBlit;
+    surface->Flip = surfaceFlip;
+    surface->GetPalette = surfaceGetPalette;
+    surface->Release = surfaceRelease;
+
+    if (surface->caps & DSCAPS_PRIMARY)
+    {
+        primarySurface = surface;
+    }
+
+    *interface = surface;
+    return DFB_OK;
+}
+
+static DFBResult dfbCreateFont(IDirectFB *thiz, const char *filename, const DFBFontDescription *desc, IDirectFBFont **interface)
+{
+    FT_Face face;
+    IDirectFBFont *font;
+
+    /* fall back to the local font when the board font path does not exist on the host */
+    if (access(filename, R_OK) != 0)
+    {
+        filename = SOFTWARE_FRAMEBUFFER_FONT;
+    }
+
+    if (FT_New_Face(freetypeLibrary, filename, 0, &face))
+    {
+        return DFB_FILENOTFOUND;
+    }
+
+    font = (IDirectFBFont *)calloc(1, sizeof(IDirectFBFont));
+    if (!font)
+    {
+        FT_Done_Face(face);
+        return DFB_NOSYSTEMMEMORY;
+    }
+
+    font->glyphs = (softwareGlyph *)calloc(GLYPH_COUNT, sizeof(softwareGlyph));
+    if (!font->glyphs)
+    {
+        FT_Done_Face(face);
+        free(font);
+        return DFB_NOSYSTEMMEMORY;
+    }
+
+    font->height = (desc->flags & DFDESC_HEIGHT) ? desc->height : 24;
+    FT_Set_Pixel_Sizes(face, 0, font->height);
+
+    font->face = face;
+    font->ascender = face->size->metrics.ascender >> 6;
+    font->descender = face->size->metrics.descender >> 6;
+
+    font->GetHeight = fontGetHeight;
+    font->GetDescender = fontGetDescender;
+    font->GetGlyphExtents = fontGetGlyphExtents;
+    font->GetStringWidth = fontGetStringWidth;
+    font->Release = fontRelease;
+
+    *interface = font;
+    return DFB_OK;
+}
+
+static DFBResult dfbRelease(IDirectFB *thiz)
+{
+    free(thiz);
+    return DFB_OK;
+}
+
+static DFBResult surfaceGetSize(IDirectFBSurface *thiz, int *width, int *height)
+{
+    *width = thiz->width;
+    *height = thiz->height;
+    return DFB_OK;
+}
+
+static DFBResult surfaceSetColor(IDirectFBSurface *thiz, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    thiz->color = ((uint32_t)a << 24) | ((uint32_t)DIV255(r * a) << 16) | ((uint32_t)DIV255(g * a) << 8) | DIV255(b * a);
+    thiz->color4444 = (QUANTIZE4(a) << 12) | (QUANTIZE4(DIV255(r * a)) << 8) | (QUANTIZE4(DIV255(g * a)) << 4) | QUANTIZE4(DIV255(b * a));
+    if (thiz->palette)
+    {
+        thiz->colorIndex = nearestPaletteIndex(thiz->palette, r, g, b, a);
+    }
+    return DFB_OK;
+}
+
+static DFBResult surfaceSetFont(IDirectFBSurface *thiz, IDirectFBFont *font)
+{
+    thiz->font = font;
+    return DFB_OK;
+}
+
+static DFBResult surfaceFillRectangle(IDirectFBSurface *thiz, int x, int y, int w, int h)
+{
+    int x1 = MAX(x, 0);
+    int y1 = MAX(y, 0);
+    int x2 = MIN(x + w, thiz->width);
+    int y2 = MIN(y + h, thiz->height);
+
+    if (x1 >= x2)
+    {
+        return DFB_OK;
+    }
+
+    for (; y1 < y2; y1++)
+    {
+        fillSpan(thiz, x1, y1, x2 - x1);
+    }
+
+    return DFB_OK;
+}
+
+static DFBResult surfaceFillTriangle(IDirectFBSurface *thiz, int x1, int y1, int x2, int y2, int x3, int y3)
+{
+    int temp;
+    int y;
+
+    /* sort vertices from top to bottom */
+#define SWAP_VERTEX(xa, ya, xb, yb) \
+    {                               \
+        temp = xa;                  \
+        xa = xb;                    \
+        xb = temp;                  \
+        temp = ya;                  \
+        ya = yb;                    \
+        yb = temp;                  \
+    }
+    if (y1 > y2)
+        SWAP_VERTEX(x1, y1, x2, y2);
+    if (y2 > y3)
+        SWAP_VERTEX(x2, y2, x3, y3);
+    if (y1 > y2)
+        SWAP_VERTEX(x1, y1, x2, y2);
+#undef SWAP_VERTEX
+
+    for (y = MAX(y1, 0); y <= MIN(y3, thiz->height - 1); y++)
+    {
+        /* long edge from top to bottom vertex, short edges through the middle vertex */
+        int xa = (y3 == y1) ? x1 : x1 + (x3 - x1) * (y - y1) / (y3 - y1);
+        int xb;
+
+        if (y < y2)
+            xb = x1 + (x2 - x1) * (y - y1) / (y2 - y1);
+        else
+            xb = (y3 == y2) ? x2 : x2 + (x3 - x2) * (y - y2) / (y3 - y2);
+
+        if (xa > xb)
+        {
+            temp = xa;
+            xa = xb;
+            xb = temp;
+        }
+
+        xa = MAX(xa, 0);
+        xb = MIN(xb, thiz->width - 1);
+        if (xa <= xb)
+        {
+            fillSpan(thiz, xa, y, xb - xa + 1);
+        }
+    }
+
+    return DFB_OK;
+}
+
+static DFBResult surfaceDrawString(IDirectFBSurface *thiz, const char *text, int bytes, int x, int y, DFBSurfaceTextFlags flags)
+{
+    IDirectFBFont *font = thiz->font;
+    int width;
+    int i;
+
+    if (!font)
+    {
+        return DFB_INVARG;
+    }
+
+    if (bytes < 0)
+    {
+        bytes = strlen(text);
+    }
+
+    if (flags & (DSTF_RIGHT | DSTF_CENTER))
+    {
+        fontGetStringWidth(font, text, bytes, &width);
+        x -= (flags & DSTF_RIGHT) ? width : width / 2;
+    }
+
+    /* y is the baseline unless the string is aligned to its top or bottom */
+    if (flags & DSTF_TOP)
+        y += font->ascender;
+    else if (flags & DSTF_BOTTOM)
+        y += font->descender;
+
+    for (i = 0; i < bytes; i++)
+    {
+        softwareGlyph *glyph = loadGlyph(font, (uint8_t)text[i]);
+        if (glyph)
+        {
+            blendGlyph(thiz, glyph, x + glyph->left, y - glyph->top);
+            x += glyph->advance;
+        }
+    }
+
+    return DFB_OK;
+}
+
+static DFBResult surfaceBlit(IDirectFBSurface *thiz, IDirectFBSurface *source, const DFBRectangle *source_rect, int x, int y)
+{
+    DFBRectangle rect = {0, 0, source->width, source->height};
+    int row;
+
+    /* only copying between surfaces of the same format is supported */
+    if (source->pixelformat != thiz->pixelformat)
+    {
+        return DFB_UNSUPPORTED;
+    }
+
+    if (source_rect)
+    {
+        rect = *source_rect;
+    }
+
+    /* clip the source rectangle to the source surface, then the destination position to this surface */
+    if (rect.x < 0)
+    {
+        x -= rect.x;
+        rect.w += rect.x;
+        rect.x = 0;
+    }
+    if (rect.y < 0)
+    {
+        y -= rect.y;
+        rect.h += rect.y;
+        rect.y = 0;
+    }
+    if (x < 0)
+    {
+        rect.x -= x;
+        rect.w += x;
+        x = 0;
+    }
+    if (y < 0)
+    {
+        rect.y -= y;
+        rect.h += y;
+        y = 0;
+    }
+    rect.w = MIN(rect.w, MIN(source->width - rect.x, thiz->width - x));
+    rect.h = MIN(rect.h, MIN(source->height - rect.y, thiz->height - y));
+
+    /* no blitting flags are supported, pixels are copied as they are (DSBLIT_NOFX) */
+    for (row = 0; row < rect.h && rect.w > 0; row++)
+    {
+        if (thiz->pixelformat == DSPF_ARGB)
+            osdCopy((uint32_t *)surfacePixel(thiz, x, y + row), (uint32_t *)surfacePixel(source, rect.x, rect.y + row), rect.w);
+        else
+            memcpy(surfacePixel(thiz, x, y + row), surfacePixel(source, rect.x, rect.y + row), rect.w * bytesPerPixel(thiz->pixelformat));
+    }
+
+    return DFB_OK;
+}
+
+static DFBResult surfaceFlip(IDirectFBSurface *thiz, const DFBRegion *region, DFBSurfaceFlipFlags flags)
+{
+    if (thiz->caps & DSCAPS_FLIPPING)
+    {
+        thiz->backBuffer = !thiz->backBuffer;
+    }
+    thiz->flipCount++;
+
+    return DFB_OK;
+}
+
+static DFBResult surfaceGetPalette(IDirectFBSurface *thiz, IDirectFBPalette **interface)
+{
+    if (!thiz->palette)
+    {
+        return DFB_UNSUPPORTED;
+    }
+
+    *interface = thiz->palette;
+    return DFB_OK;
+}
+
+static DFBResult surfaceRelease(IDirectFBSurface *thiz)
+{
+    if (thiz == primarySurface)
+    {
+        primarySurface = NULL;
+    }
+    free(thiz->buffers[0]);
+    free(thiz->buffers[1]);
+    free(thiz->palette);
+    free(thiz);
+    return DFB_OK;
+}
+
+static DFBResult paletteGetSize(IDirectFBPalette *thiz, unsigned int *size)
+{
+    *size = PALETTE_SIZE;
+    return DFB_OK;
+}
+
+static DFBResult paletteSetEntries(IDirectFBPalette *thiz, const DFBColor *entries, unsigned int num_entries, unsigned int offset)
+{
+    if (offset + num_entries > PALETTE_SIZE)
+    {
+        return DFB_INVARG;
+    }
+
+    memcpy(&thiz->entries[offset], entries, num_entries * sizeof(DFBColor));
+    return DFB_OK;
+}
+
+static DFBResult paletteRelease(IDirectFBPalette *thiz)
+{
+    /* palette is owned by its surface and freed together with it */
+    return DFB_OK;
+}
+
+static DFBResult fontGetHeight(IDirectFBFont *thiz, int *height)
+{
+    *height = thiz->height;
+    return DFB_OK;
+}
+
+static DFBResult fontGetDescender(IDirectFBFont *thiz, int *descender)
+{
+    *descender = thiz->descender;
+    return DFB_OK;
+}
+
+static DFBResult fontGetGlyphExtents(IDirectFBFont *thiz, unsigned int character, DFBRectangle *rect, int *advance)
+{
+    softwareGlyph *glyph = (character < GLYPH_COUNT) ? loadGlyph(thiz, (uint8_t)character) : NULL;
+    if (!glyph)
+    {
+        return DFB_INVARG;
+    }
+
+    if (rect)
+    {
+        /* rectangle is relative to the pen position on the baseline */
+        rect->x = glyph->left;
+        rect->y = -glyph->top;
+        rect->w = glyph->width;
+        rect->h = glyph->rows;
+    }
+    if (advance)
+    {
+        *advance = glyph->advance;
+    }
+
+    return DFB_OK;
+}
+
+static DFBResult fontGetStringWidth(IDirectFBFont *thiz, const char *text, int bytes, int *width)
+{
+    int i;
+
+    if (bytes < 0)
+    {
+        bytes = strlen(text);
+    }
+
+    *width = 0;
+    for (i = 0; i < bytes; i++)
+    {
+        softwareGlyph *glyph = loadGlyph(thiz, (uint8_t)text[i]);
+        if (glyph)
+        {
+            *width += glyph->advance;
+        }
+    }
+
+    return DFB_OK;
+}
+
+static DFBResult fontRelease(IDirectFBFont *thiz)
+{
+    int i;
+    for (i = 0; i < GLYPH_COUNT; i++)
+    {
+        free(thiz->glyphs[i].bitmap);
+    }
+    free(thiz->glyphs);
+    FT_Done_Face((FT_Face)thiz->face);
+    free(thiz);
+    return DFB_OK;
+}
+/* -------------------- INTERFACE FUNCTIONS -------------------- */
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for getting pixel size of a surface format.
+ *
+ * @param    format - [in] Surface pixel format.
+ *
+ * @return   Bytes per pixel, 0 for unsupported formats.
+****************************************************************************/
+static int bytesPerPixel(DFBSurfacePixelFormat format)
+{
+    switch (format)
+    {
+    case DSPF_ARGB:
+        return 4;
+    case DSPF_ARGB4444:
+        return 2;
+    case DSPF_LUT8:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for getting the address of a pixel in the buffer being drawn to.
+ *
+ * @param    surface - [in] Surface to draw to.
+ *           x - [in] Column index.
+ *           y - [in] Row index.
+ *
+ * @return   Pointer to the pixel.
+****************************************************************************/
+static uint8_t *surfacePixel(IDirectFBSurface *surface, int x, int y)
+{
+    return surface->buffers[surface->backBuffer] + y * surface->pitch + x * bytesPerPixel(surface->pixelformat);
+}
+
+/****************************************************************************
+ * @brief    Function for filling a span of one row with current colour.
+ *
+ * @param    surface - [in] Surface to draw to.
+ *           x - [in] First column of the span.
+ *           y - [in] Row index.
+ *           count - [in] Number of pixels.
+****************************************************************************/
+static void fillSpan(IDirectFBSurface *surface, int x, int y, int count)
+{
+    switch (surface->pixelformat)
+    {
+    case DSPF_ARGB4444:
+        fill4444((uint16_t *)surfacePixel(surface, x, y), count, surface->color4444);
+        break;
+
+    case DSPF_LUT8:
+        memset(surfacePixel(surface, x, y), surface->colorIndex, count);
+        break;
+
+    default:
+        osdFill((uint32_t *)surfacePixel(surface, x, y), count, surface->color);
+        break;
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for filling an ARGB4444 span, pixel pairs are written by the 32-bit fill kernel.
+ *
+ * @param    destination - [in] First pixel of the span.
+ *           count - [in] Number of pixels.
+ *           color - [in] Premultiplied ARGB4444 colour.
+****************************************************************************/
+static void fill4444(uint16_t *destination, uint32_t count, uint16_t color)
+{
+    if (((uintptr_t)destination & 2) && count)
+    {
+        *destination++ = color;
+        count--;
+    }
+
+    osdFill((uint32_t *)destination, count / 2, ((uint32_t)color << 16) | color);
+
+    if (count & 1)
+    {
+        destination[count - 1] = color;
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for blending glyph coverage over an ARGB4444 span.
+ *           Partially covered pixels are dithered, fully covered opaque pixels get the flat colour.
+ *
+ * @param    destination - [in] First pixel of the span.
+ *           coverage - [in] Glyph coverage values, one byte per pixel.
+ *           count - [in] Number of pixels.
+ *           color - [in] Premultiplied ARGB colour.
+ *           x - [in] Screen column of the first pixel.
+ *           y - [in] Screen row of the span.
+****************************************************************************/
+static void blendGlyph4444(uint16_t *destination, const uint8_t *coverage, uint32_t count, uint32_t color, int x, int y)
+{
+    const uint8_t *thresholds = bayerMatrix[y & 3];
+    uint32_t sourceA = color >> 24;
+    uint32_t sourceR = (color >> 16) & 0xff;
+    uint32_t sourceG = (color >> 8) & 0xff;
+    uint32_t sourceB = color & 0xff;
+    uint16_t flat = (QUANTIZE4(sourceA) << 12) | (QUANTIZE4(sourceR) << 8) | (QUANTIZE4(sourceG) << 4) | QUANTIZE4(sourceB);
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t cover = coverage[i];
+        uint32_t pixel = destination[i];
+        uint32_t a, r, g, b, inverse, threshold;
+
+        if (!cover)
+        {
+            continue;
+        }
+
+        /* no dithering inside strokes of opaque text, matches flat fills */
+        if (cover == 255 && sourceA == 255)
+        {
+            destination[i] = flat;
+            continue;
+        }
+
+        /* source-over of the coverage scaled colour on the expanded destination pixel */
+        inverse = 255 - DIV255(sourceA * cover);
+        a = DIV255(sourceA * cover) + DIV255((pixel >> 12) * 17 * inverse);
+        r = DIV255(sourceR * cover) + DIV255(((pixel >> 8) & 0xf) * 17 * inverse);
+        g = DIV255(sourceG * cover) + DIV255(((pixel >> 4) & 0xf) * 17 * inverse);
+        b = DIV255(sourceB * cover) + DIV255((pixel & 0xf) * 17 * inverse);
+
+        threshold = thresholds[(x + i) & 3];
+        a = DITHER4(a, threshold);
+        r = MIN(DITHER4(r, threshold), a);
+        g = MIN(DITHER4(g, threshold), a);
+        b = MIN(DITHER4(b, threshold), a);
+        destination[i] = (a << 12) | (r << 8) | (g << 4) | b;
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for drawing glyph coverage to an LUT8 span. Palette formats cannot blend,
+ *           so coverage is turned into an ordered dither pattern of the colour index.
+ *
+ * @param    destination - [in] First pixel of the span.
+ *           coverage - [in] Glyph coverage values, one byte per pixel.
+ *           count - [in] Number of pixels.
+ *           colorIndex - [in] Palette index of current colour.
+ *           x - [in] Screen column of the first pixel.
+ *           y - [in] Screen row of the span.
+****************************************************************************/
+static void ditherGlyphLUT8(uint8_t *destination, const uint8_t *coverage, uint32_t count, uint8_t colorIndex, int x, int y)
+{
+    const uint8_t *thresholds = bayerMatrix[y & 3];
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (coverage[i] > thresholds[(x + i) & 3] * 16 + 8)
+        {
+            destination[i] = colorIndex;
+        }
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for finding the palette entry closest to a colour.
+ *
+ * @param    palette - [in] Palette to search.
+ *           r, g, b, a - [in] Colour to look for.
+ *
+ * @return   Index of the closest palette entry.
+****************************************************************************/
+static uint8_t nearestPaletteIndex(IDirectFBPalette *palette, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    uint32_t bestDistance = UINT32_MAX;
+    uint8_t best = 0;
+    int i;
+
+    for (i = 0; i < PALETTE_SIZE; i++)
+    {
+        const DFBColor *entry = &palette->entries[i];
+        int32_t da = entry->a - a;
+        int32_t dr = entry->r - r;
+        int32_t dg = entry->g - g;
+        int32_t db = entry->b - b;
+        uint32_t distance = da * da + dr * dr + dg * dg + db * db;
+
+        if (distance < bestDistance)
+        {
+            bestDistance = distance;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+/****************************************************************************
+ * @brief    Function for expanding one surface pixel to straight RGBA.
+ *
+ * @param    surface - [in] Surface the row belongs to.
+ *           row - [in] First byte of the row.
+ *           x - [in] Column index.
+ *           rgba - [out] Red, green, blue and alpha values.
+****************************************************************************/
+static void readPixel(IDirectFBSurface *surface, const uint8_t *row, int x, uint8_t *rgba)
+{
+    uint32_t pixel;
+    uint8_t a;
+
+    switch (surface->pixelformat)
+    {
+    case DSPF_LUT8:
+    {
+        const DFBColor *entry = &surface->palette->entries[row[x]];
+        rgba[0] = entry->r;
+        rgba[1] = entry->g;
+        rgba[2] = entry->b;
+        rgba[3] = entry->a;
+        return;
+    }
+
+    case DSPF_ARGB4444:
+        pixel = ((const uint16_t *)row)[x];
+        pixel = ((pixel >> 12) * 17 << 24) | (((pixel >> 8) & 0xf) * 17 << 16) | (((pixel >> 4) & 0xf) * 17 << 8) | ((pixel & 0xf) * 17);
+        break;
+
+    default:
+        pixel = ((const uint32_t *)row)[x];
+        break;
+    }
+
+    /* premultiplied to straight alpha */
+    a = pixel >> 24;
+    rgba[0] = a ? MIN(255, ((pixel >> 16) & 0xff) * 255 / a) : 0;
+    rgba[1] = a ? MIN(255, ((pixel >> 8) & 0xff) * 255 / a) : 0;
+    rgba[2] = a ? MIN(255, (pixel & 0xff) * 255 / a) : 0;
+    rgba[3] = a;
+}
+
+/****************************************************************************
+ * @brief    Function for rasterizing a glyph on its first use and caching it in the font.
+ *
+ * @param    font - [in] Font to take the glyph from.
+ *           character - [in] Character to rasterize.
+ *
+ * @return   Pointer to cached glyph.
+ *           NULL, in case of an error.
+****************************************************************************/
+static softwareGlyph *loadGlyph(IDirectFBFont *font, uint8_t character)
+{
+    softwareGlyph *glyph = &font->glyphs[character];
+    FT_Face face = (FT_Face)font->face;
+    int row;
+
+    if (glyph->loaded)
+    {
+        return glyph;
+    }
+
+    if (FT_Load_Char(face, character, FT_LOAD_RENDER))
+    {
+        return NULL;
+    }
+
+    glyph->width = face->glyph->bitmap.width;
+    glyph->rows = face->glyph->bitmap.rows;
+    glyph->left = face->glyph->bitmap_left;
+    glyph->top = face->glyph->bitmap_top;
+    glyph->advance = face->glyph->advance.x >> 6;
+
+    if (glyph->width && glyph->rows)
+    {
+        glyph->bitmap = (uint8_t *)malloc(glyph->width * glyph->rows);
+        if (!glyph->bitmap)
+        {
+            return NULL;
+        }
+        for (row = 0; row < glyph->rows; row++)
+        {
+            memcpy(glyph->bitmap + row * glyph->width, face->glyph->bitmap.buffer + row * face->glyph->bitmap.pitch, glyph->width);
+        }
+    }
+
+    glyph->loaded = 1;
+    return glyph;
+}
+
+/****************************************************************************
+ * @brief    Function for blending glyph coverage in current colour over the surface.
+ *
+ * @param    surface - [in] Surface to draw to.
+ *           glyph - [in] Glyph to draw.
+ *           x - [in] Left edge of the glyph bitmap.
+ *           y - [in] Top edge of the glyph bitmap.
+****************************************************************************/
+static void blendGlyph(IDirectFBSurface *surface, softwareGlyph *glyph, int x, int y)
+{
+    int firstColumn = MAX(0, -x);
+    int lastColumn = MIN(glyph->width, surface->width - x);
+    int row;
+
+    if (firstColumn >= lastColumn)
+    {
+        return;
+    }
+
+    for (row = MAX(0, -y); row < glyph->rows && y + row < surface->height; row++)
+    {
+        uint8_t *pixel = surfacePixel(surface, x + firstColumn, y + row);
+        const uint8_t *coverage = glyph->bitmap + row * glyph->width + firstColumn;
+
+        switch (surface->pixelformat)
+        {
+        case DSPF_ARGB4444:
+            blendGlyph4444((uint16_t *)pixel, coverage, lastColumn - firstColumn, surface->color, x + firstColumn, y + row);
+            break;
+
+        case DSPF_LUT8:
+            ditherGlyphLUT8(pixel, coverage, lastColumn - firstColumn, surface->colorIndex, x + firstColumn, y + row);
+            break;
+
+        default:
+            osdBlitGlyph((uint32_t *)pixel, coverage, lastColumn - firstColumn, surface->color);
+            break;
+        }
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for writing one PNG chunk.
+ *
+ * @param    filePointer - [in] Output file.
+ *           type - [in] Four character chunk type.
+ *           data - [in] Chunk data.
+ *           length - [in] Chunk data length.
+****************************************************************************/
+static void writeChunk(FILE *filePointer, const char *type, const uint8_t *data, uint32_t length)
+{
+    uint8_t bigEndian[4];
+    uLong crc = crc32(0, (const Bytef *)type, 4);
+
+    if (length)
+    {
+        crc = crc32(crc, data, length);
+    }
+
+    bigEndian[0] = length >> 24;
+    bigEndian[1] = length >> 16;
+    bigEndian[2] = length >> 8;
+    bigEndian[3] = length;
+    fwrite(bigEndian, 1, 4, filePointer);
+    fwrite(type, 1, 4, filePointer);
+    if (length)
+    {
+        fwrite(data, 1, length, filePointer);
+    }
+
+    bigEndian[0] = crc >> 24;
+    bigEndian[1] = crc >> 16;
+    bigEndian[2] = crc >> 8;
+    bigEndian[3] = crc;
+    fwrite(bigEndian, 1, 4, filePointer);
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
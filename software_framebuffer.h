@@ -0,0 +1,259 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file software_framebuffer.h
+ *
+ * \brief
+ * Header of the headless software framebuffer backend. Provides the subset of the DirectFB
+ * interface used by the graphics controller module, rendering into in-memory ARGB buffers.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _SOFTWARE_FRAMEBUFFER_H_
+#define _SOFTWARE_FRAMEBUFFER_H_
+
+#include <stdint.h>
+
+/* local TrueType font used when the font requested by the graphics controller is not present on the host */
+#ifndef SOFTWARE_FRAMEBUFFER_FONT
+#define SOFTWARE_FRAMEBUFFER_FONT "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf"
+#endif
+
+#define SOFTWARE_FRAMEBUFFER_DEFAULT_WIDTH 1920
+#define SOFTWARE_FRAMEBUFFER_DEFAULT_HEIGHT 1080
+
+typedef enum _DFBResult
+{
+    DFB_OK = 0,
+    DFB_FAILURE,
+    DFB_INVARG,
+    DFB_NOSYSTEMMEMORY,
+    DFB_FILENOTFOUND,
+    DFB_UNSUPPORTED
+} DFBResult;
+
+typedef enum _DFBCooperativeLevel
+{
+    DFSCL_NORMAL = 0,
+    DFSCL_FULLSCREEN,
+    DFSCL_EXCLUSIVE
+} DFBCooperativeLevel;
+
+typedef enum _DFBSurfaceDescriptionFlags
+{
+    DSDESC_NONE = 0x00000000,
+    DSDESC_CAPS = 0x00000001,
+    DSDESC_WIDTH = 0x00000002,
+    DSDESC_HEIGHT = 0x00000004,
+    DSDESC_PIXELFORMAT = 0x00000008
+} DFBSurfaceDescriptionFlags;
+
+typedef enum _DFBSurfaceCapabilities
+{
+    DSCAPS_NONE = 0x00000000,
+    DSCAPS_PRIMARY = 0x00000001,
+    DSCAPS_SYSTEMONLY = 0x00000002,
+    DSCAPS_DOUBLE = 0x00000010,
+    DSCAPS_FLIPPING = DSCAPS_DOUBLE,
+    DSCAPS_PREMULTIPLIED = 0x00001000
+} DFBSurfaceCapabilities;
+
+typedef enum _DFBSurfacePixelFormat
+{
+    DSPF_UNKNOWN = 0,
+    DSPF_ARGB,
+    DSPF_ARGB4444,
+    DSPF_LUT8
+} DFBSurfacePixelFormat;
+
+typedef enum _DFBFontDescriptionFlags
+{
+    DFDESC_NONE = 0x00000000,
+    DFDESC_ATTRIBUTES = 0x00000001,
+    DFDESC_HEIGHT = 0x00000002
+} DFBFontDescriptionFlags;
+
+typedef enum _DFBSurfaceTextFlags
+{
+    DSTF_LEFT = 0x00000000,
+    DSTF_CENTER = 0x00000001,
+    DSTF_RIGHT = 0x00000002,
+    DSTF_TOP = 0x00000004,
+    DSTF_BOTTOM = 0x00000008
+} DFBSurfaceTextFlags;
+
+typedef enum _DFBSurfaceFlipFlags
+{
+    DSFLIP_NONE = 0x00000000,
+    DSFLIP_WAIT = 0x00000001
+} DFBSurfaceFlipFlags;
+
+typedef struct _DFBRegion
+{
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+} DFBRegion;
+
+typedef struct _DFBRectangle
+{
+    int x;
+    int y;
+    int w;
+    int h;
+} DFBRectangle;
+
+typedef struct _DFBColor
+{
+    uint8_t a;
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+} DFBColor;
+
+typedef struct _DFBSurfaceDescription
+{
+    DFBSurfaceDescriptionFlags flags;
+    DFBSurfaceCapabilities caps;
+    int width;
+    int height;
+    DFBSurfacePixelFormat pixelformat;
+} DFBSurfaceDescription;
+
+typedef struct _DFBFontDescription
+{
+    DFBFontDescriptionFlags flags;
+    int height;
+} DFBFontDescription;
+
+typedef struct _IDirectFB IDirectFB;
+typedef struct _IDirectFBSurface IDirectFBSurface;
+typedef struct _IDirectFBFont IDirectFBFont;
+typedef struct _IDirectFBPalette IDirectFBPalette;
+
+/* software palette of an LUT8 surface, entries are not premultiplied */
+struct _IDirectFBPalette
+{
+    DFBResult (*GetSize)(IDirectFBPalette *thiz, unsigned int *size);
+    DFBResult (*SetEntries)(IDirectFBPalette *thiz, const DFBColor *entries, unsigned int num_entries, unsigned int offset);
+    DFBResult (*Release)(IDirectFBPalette *thiz);
+
+    /* software backend state */
+    DFBColor entries[256];
+};
+
+/* software font, glyphs are rasterized from a TrueType file on first use */
+struct _IDirectFBFont
+{
+    DFBResult (*GetHeight)(IDirectFBFont *thiz, int *height);
+    DFBResult (*GetDescender)(IDirectFBFont *thiz, int *descender);
+    DFBResult (*GetGlyphExtents)(IDirectFBFont *thiz, unsigned int character, DFBRectangle *rect, int *advance);
+    DFBResult (*GetStringWidth)(IDirectFBFont *thiz, const char *text, int bytes, int *width);
+    DFBResult (*Release)(IDirectFBFont *thiz);
+
+    /* software backend state */
+    void *face;
+    int height;
+    int ascender;
+    int descender;
+    struct _softwareGlyph *glyphs;
+};
+
+/* software surface, pixels are stored as premultiplied ARGB or ARGB4444, or as LUT8 palette indices */
+struct _IDirectFBSurface
+{
+    DFBResult (*GetSize)(IDirectFBSurface *thiz, int *width, int *height);
+    DFBResult (*SetColor)(IDirectFBSurface *thiz, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+    DFBResult (*SetFont)(IDirectFBSurface *thiz, IDirectFBFont *font);
+    DFBResult (*FillRectangle)(IDirectFBSurface *thiz, int x, int y, int w, int h);
+    DFBResult (*FillTriangle)(IDirectFBSurface *thiz, int x1, int y1, int x2, int y2, int x3, int y3);
+    DFBResult (*DrawString)(IDirectFBSurface *thiz, const char *text, int bytes, int x, int y, DFBSurfaceTextFlags flags);
+    DFBResult (*Blit)(IDirectFBSurface *thiz, IDirectFBSurface *source, const DFBRectangle *source_rect, int x, int y);
+    DFBResult (*Flip)(IDirectFBSurface *thiz, const DFBRegion *region, DFBSurfaceFlipFlags flags);
+    DFBResult (*GetPalette)(IDirectFBSurface *thiz, IDirectFBPalette **interface);
+    DFBResult (*Release)(IDirectFBSurface *thiz);
+
+    /* software backend state */
+    int width;
+    int height;
+    int pitch;
+    DFBSurfaceCapabilities caps;
+    DFBSurfacePixelFormat pixelformat;
+    uint8_t *buffers[2];
+    uint8_t backBuffer;
+    uint32_t color;        // premultiplied ARGB
+    uint16_t color4444;    // premultiplied ARGB4444
+    uint8_t colorIndex;    // nearest LUT8 palette entry
+    IDirectFBPalette *palette;
+    IDirectFBFont *font;
+    uint32_t flipCount;
+};
+
+struct _IDirectFB
+{
+    DFBResult (*SetCooperativeLevel)(IDirectFB *thiz, DFBCooperativeLevel level);
+    DFBResult (*CreateSurface)(IDirectFB *thiz, const DFBSurfaceDescription *desc, IDirectFBSurface **interface);
+    DFBResult (*CreateFont)(IDirectFB *thiz, const char *filename, const DFBFontDescription *desc, IDirectFBFont **interface);
+    DFBResult (*Release)(IDirectFB *thiz);
+};
+
+/****************************************************************************
+ * @brief    Function for software backend initialization.
+ *
+ * @param    argc - [in] Ignored, present for DirectFB compatibility.
+ *           argv - [in] Ignored, present for DirectFB compatibility.
+ *
+ * @return   DFB_OK, if there are no errors.
+ *           DFB_FAILURE, in case of an error.
+****************************************************************************/
+DFBResult DirectFBInit(int *argc, char *(*argv[]));
+
+/****************************************************************************
+ * @brief    Function for fetching the software backend interface.
+ *
+ * @param    interface - [out] Pointer to created interface.
+ *
+ * @return   DFB_OK, if there are no errors.
+ *           DFB_NOSYSTEMMEMORY, in case of an error.
+****************************************************************************/
+DFBResult DirectFBCreate(IDirectFB **interface);
+
+/****************************************************************************
+ * @brief    Function for reporting a failed backend call.
+ *
+ * @param    msg - [in] Failed call description.
+ *           result - [in] Failed call result.
+ *
+ * @return   Passed result value.
+****************************************************************************/
+DFBResult DirectFBErrorFatal(const char *msg, DFBResult result);
+
+/****************************************************************************
+ * @brief    Function for setting the size of primary surfaces created afterwards.
+ *
+ * @param    width - [in] Screen width in pixels.
+ *           height - [in] Screen height in pixels.
+****************************************************************************/
+void softwareFramebufferSetMode(int width, int height);
+
+/****************************************************************************
+ * @brief    Function for writing the currently displayed primary surface buffer to a PNG file.
+ *           ARGB4444 and LUT8 surfaces are expanded to 32 bits per pixel, as the display does at composition time.
+ *
+ * @param    fileName - [in] Full path to output file.
+ *
+ * @return   DFB_OK, if there are no errors.
+ *           DFB_FAILURE, in case of an error.
+****************************************************************************/
+DFBResult softwareFramebufferDumpPNG(const char *fileName);
+
+#endif // _SOFTWARE_FRAMEBUFFER_H_
@@ -0,0 +1,273 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file startup_graph.c
+ *
+ * \brief
+ * Implementation of the startup graph module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "startup_graph.h"
+#include "latency_histogram.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+/* helper keywords needed only for startup graph module */
+typedef enum _phaseState
+{
+    PHASE_WAITING = 0,
+    PHASE_RUNNING,
+    PHASE_DONE,
+    PHASE_FAILED,
+    PHASE_SKIPPED
+} phaseState;
+
+typedef struct _graphPhase
+{
+    const char *name;
+    startupGraphPhase phase;
+    void *context;
+    uint32_t dependencies;
+    phaseState state;
+    uint64_t startNs;
+    uint64_t endNs;
+} graphPhase;
+
+/* helper variables needed only for startup graph module */
+static graphPhase phases[STARTUP_GRAPH_MAX_PHASES];
+static uint32_t phaseCount;
+static uint64_t graphStartNs;
+static uint64_t graphEndNs;
+static pthread_mutex_t graphMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t graphCondition = PTHREAD_COND_INITIALIZER;
+
+static const char *stateNames[] = {"waiting", "running", "ok", "failed", "skipped"};
+
+/* helper functions needed only for startup graph module */
+static void *graphWorker(void *arg);
+static graphPhase *nextReadyPhase(uint8_t *finished);
+
+startupGraphStatus startupGraphAddPhase(const char *name, startupGraphPhase phase, void *context, uint32_t dependencies, int32_t *phaseId)
+{
+    graphPhase *added;
+
+    /* only already added phases can be depended on, so the graph never has a cycle */
+    if (!phase || phaseCount == STARTUP_GRAPH_MAX_PHASES || (dependencies >> phaseCount))
+    {
+        return STARTUP_GRAPH_ERROR;
+    }
+
+    added = &phases[phaseCount];
+    added->name = name;
+    added->phase = phase;
+    added->context = context;
+    added->dependencies = dependencies;
+    added->state = PHASE_WAITING;
+
+    if (phaseId)
+    {
+        *phaseId = phaseCount;
+    }
+    phaseCount++;
+
+    return STARTUP_GRAPH_NO_ERROR;
+}
+
+startupGraphStatus startupGraphRun(uint32_t workerCount)
+{
+    pthread_t workers[STARTUP_GRAPH_WORKERS];
+    uint32_t started = 0;
+    uint32_t i;
+
+    if (workerCount > STARTUP_GRAPH_WORKERS)
+    {
+        workerCount = STARTUP_GRAPH_WORKERS;
+    }
+
+    graphStartNs = latencyNowNs();
+
+    /* the calling thread is one of the workers */
+    for (i = 1; i < workerCount; i++)
+    {
+        if (!pthread_create(&workers[started], NULL, graphWorker, NULL))
+        {
+            started++;
+        }
+    }
+    graphWorker(NULL);
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    graphEndNs = latencyNowNs();
+
+    for (i = 0; i < phaseCount; i++)
+    {
+        if (phases[i].state != PHASE_DONE)
+        {
+            return STARTUP_GRAPH_ERROR;
+        }
+    }
+
+    return STARTUP_GRAPH_NO_ERROR;
+}
+
+void startupGraphPrintReport()
+{
+    uint8_t critical[STARTUP_GRAPH_MAX_PHASES] = {0};
+    int32_t last = -1;
+    uint32_t i;
+
+    /* the chain ends in the phase finishing last, each link is the dependency finishing last */
+    for (i = 0; i < phaseCount; i++)
+    {
+        if (phases[i].endNs && (last < 0 || phases[i].endNs > phases[last].endNs))
+        {
+            last = i;
+        }
+    }
+    while (last >= 0)
+    {
+        int32_t gate = -1;
+
+        critical[last] = 1;
+        for (i = 0; i < phaseCount; i++)
+        {
+            if ((phases[last].dependencies & STARTUP_GRAPH_AFTER(i)) && (gate < 0 || phases[i].endNs > phases[gate].endNs))
+            {
+                gate = i;
+            }
+        }
+        last = gate;
+    }
+
+    printf("\nStartup: %.1f ms on %u phases (* critical path)\n", (graphEndNs - graphStartNs) / 1000000.0, phaseCount);
+    for (i = 0; i < phaseCount; i++)
+    {
+        graphPhase *phase = &phases[i];
+
+        if (phase->endNs)
+        {
+            printf(" %c%-16s start %8.1f ms  duration %8.1f ms  %s\n", critical[i] ? '*' : ' ', phase->name,
+                   (phase->startNs - graphStartNs) / 1000000.0, (phase->endNs - phase->startNs) / 1000000.0, stateNames[phase->state]);
+        }
+        else
+        {
+            printf("  %-16s %s\n", phase->name, stateNames[phase->state]);
+        }
+    }
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for running ready phases until every phase is finished.
+ *
+ * @param    arg - [in] Unused.
+ *
+ * @return   NULL.
+****************************************************************************/
+static void *graphWorker(void *arg)
+{
+    graphPhase *phase;
+    uint8_t finished = 0;
+    int32_t result;
+
+    pthread_mutex_lock(&graphMutex);
+    while (!finished)
+    {
+        phase = nextReadyPhase(&finished);
+        if (!phase)
+        {
+            if (!finished)
+            {
+                pthread_cond_wait(&graphCondition, &graphMutex);
+            }
+            continue;
+        }
+
+        phase->state = PHASE_RUNNING;
+        phase->startNs = latencyNowNs();
+        pthread_mutex_unlock(&graphMutex);
+
+        result = phase->phase(phase->context);
+
+        pthread_mutex_lock(&graphMutex);
+        phase->endNs = latencyNowNs();
+        phase->state = result ? PHASE_FAILED : PHASE_DONE;
+        if (result)
+        {
+            printf("Startup phase %s failed (%d)!\n", phase->name, result);
+        }
+        pthread_cond_broadcast(&graphCondition);
+    }
+    pthread_cond_broadcast(&graphCondition);
+    pthread_mutex_unlock(&graphMutex);
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for finding a phase whose dependencies have all finished successfully.
+ *           Phases depending on a failed or skipped phase are skipped. Called with the graph
+ *           mutex locked.
+ *
+ * @param    finished - [out] Set to 1 if no phase is waiting or running any more.
+ *
+ * @return   Ready phase, NULL if there is none.
+****************************************************************************/
+static graphPhase *nextReadyPhase(uint8_t *finished)
+{
+    uint32_t done = 0;
+    uint32_t broken = 0;
+    uint8_t pending = 0;
+    uint32_t i;
+
+    /* phases only depend on earlier ones, one pass in order settles every skip */
+    for (i = 0; i < phaseCount; i++)
+    {
+        if (phases[i].state == PHASE_WAITING && (phases[i].dependencies & broken))
+        {
+            phases[i].state = PHASE_SKIPPED;
+        }
+
+        switch (phases[i].state)
+        {
+        case PHASE_DONE:
+            done |= STARTUP_GRAPH_AFTER(i);
+            break;
+
+        case PHASE_FAILED:
+        case PHASE_SKIPPED:
+            broken |= STARTUP_GRAPH_AFTER(i);
+            break;
+
+        default:
+            pending = 1;
+            break;
+        }
+    }
+
+    *finished = !pending;
+
+    for (i = 0; i < phaseCount; i++)
+    {
+        if (phases[i].state == PHASE_WAITING && (phases[i].dependencies & done) == phases[i].dependencies)
+        {
+            return &phases[i];
+        }
+    }
+
+    return NULL;
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
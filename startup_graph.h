@@ -0,0 +1,71 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file startup_graph.h
+ *
+ * \brief
+ * Header of the startup graph module. Startup phases are added with the phases they depend
+ * on and run on a small pool of worker threads, every phase as soon as its dependencies
+ * have finished. Start and end of every phase are recorded for the startup report.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _STARTUP_GRAPH_H_
+#define _STARTUP_GRAPH_H_
+
+#include <stdint.h>
+
+#define STARTUP_GRAPH_MAX_PHASES 16
+#define STARTUP_GRAPH_WORKERS 3
+
+#define STARTUP_GRAPH_AFTER(phaseId) (1U << (phaseId)) // dependency mask of a phase, combined with |
+
+typedef enum _startupGraphStatus
+{
+    STARTUP_GRAPH_NO_ERROR = 0,
+    STARTUP_GRAPH_ERROR
+} startupGraphStatus;
+
+/* phase function called on a worker thread, returns 0 on success like the module init functions */
+typedef int32_t (*startupGraphPhase)(void *context);
+
+/****************************************************************************
+ * @brief    Function for adding a startup phase. Dependencies must be added before the phase.
+ *
+ * @param    name - [in] Phase name used in the startup report.
+ *           phase - [in] Function running the phase.
+ *           context - [in] Value passed to the phase function.
+ *           dependencies - [in] STARTUP_GRAPH_AFTER masks of the phases that must finish first, 0 if none.
+ *           phaseId - [out] Id used in dependency masks of later phases, may be NULL.
+ *
+ * @return   STARTUP_GRAPH_NO_ERROR, if there are no errors.
+ *           STARTUP_GRAPH_ERROR, if there is no free phase or a dependency is unknown.
+****************************************************************************/
+startupGraphStatus startupGraphAddPhase(const char *name, startupGraphPhase phase, void *context, uint32_t dependencies, int32_t *phaseId);
+
+/****************************************************************************
+ * @brief    Function for running all added phases and waiting until they are finished.
+ *           Phases depending on a failed phase are skipped.
+ *
+ * @param    workerCount - [in] Worker threads running the phases, at most STARTUP_GRAPH_WORKERS.
+ *
+ * @return   STARTUP_GRAPH_NO_ERROR, if every phase succeeded.
+ *           STARTUP_GRAPH_ERROR, if a phase failed or workers can not be started.
+****************************************************************************/
+startupGraphStatus startupGraphRun(uint32_t workerCount);
+
+/****************************************************************************
+ * @brief    Function for printing start, duration and result of every phase and the phases
+ *           on the critical path, the chain of phases that determined the startup time.
+****************************************************************************/
+void startupGraphPrintReport();
+
+#endif // _STARTUP_GRAPH_H_
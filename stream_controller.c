@@ -20,11 +20,26 @@
 
 #include "tables_parser.h"
 #include "graphics_controller.h"
+#include "event_reactor.h"
+#include "timer_controller.h"
+#include "latency_histogram.h"
+#include "trace.h"
+#include "metrics.h"
+#include "virtual_clock.h"
+#include "table_timing.h"
+#include "pcr_analyzer.h"
+#include "pvr_recorder.h"
+#include "timeshift.h"
+#include "ts_input.h"
+#ifdef TDP_FILE_SOURCE
+#include "tdp_file_source.h"
+#endif
 
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <pthread.h>
-#include <sys/time.h>
+#include <time.h>
 #include "errno.h"
 
 /* helper keywords needed only for stream controller module */
@@ -40,33 +55,173 @@
 #define VOLUME_MIN 0
 #define VOLUME_STEP 0.05 // increase volume by 5%
 
+#define TUNE_SETTLE_MS 300  // program up/down presses closer than this are tuned as one
+#define VOLUME_APPLY_MS 20  // volume is set and drawn at most once per frame
+
 #define CHANNEL_RUNNING_STATUS 4
 
+#define TUNER_LOCK_TIMEOUT_MS 10000 // waits before any interval is learned, also their caps
+#define TABLE_TIMEOUT_MS 3000
+
+#define ZAP_BUCKET_COUNT 11
+#define ZAP_RECENT_CHANNELS 4                       // most recently tuned channels kept as predictions
+#define ZAP_PREDICTIONS (2 + ZAP_RECENT_CHANNELS)  // next, previous and recent channels
+
+#define SECTION_QUEUE_SIZE 16
+#define SECTION_MAX_SIZE 4096 // private sections are never longer
+
+typedef struct _queuedSection
+{
+    uint8_t tableId;
+    uint16_t length;
+    uint8_t data[SECTION_MAX_SIZE];
+} queuedSection;
+
+/* streams of a channel and which of the playing streams it shares, prepared before the zap */
+typedef struct _zapPlan
+{
+    int32_t channelIndex; // -1 for an unused plan
+    startingChannelInit streams;
+    uint16_t pcrPid;      // copied on the event loop, the worker does not read the channel list
+    uint8_t keepVideo;
+    uint8_t keepAudio;
+    uint32_t generation; // zapGeneration the keep flags were decided against
+} zapPlan;
+
+/* PMT of a channel and whether the scan has acquired it */
+typedef struct _pmtScanEntry
+{
+    uint16_t pmtPid;
+    uint8_t acquired;
+    uint8_t attempted; // filter was set and timed out, retried only on a priority request
+} pmtScanEntry;
+
 /* helper variables needed only for stream controller module */
 static uint32_t playerHandle;
 static uint32_t sourceHandle;
 static uint32_t filterHandle;
+static uint32_t filterPid; // PID of the PAT or PMT filter, arrivals on it are timed
+static uint8_t filterSectionTaken; // set by the first section of the PAT or PMT filter, repetitions are ignored
 static uint32_t videoHandle;
 static uint32_t audioHandle;
+static startingChannelInit playingStreams; // PIDs and types of the last started streams, guarded by zapMutex
 
-static pthread_cond_t statusCondition = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t statusCondition; // initialized on CLOCK_MONOTONIC by streamControllerInit
 static pthread_mutex_t statusMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t statusSignalled; // set by threadMutexUnlock, consumed by timedWaitForCondition
+static uint8_t tunerLockWaiting; // set while the tuner lock is waited for, a later lock wakes nothing
 
 static patTable *pat;
 static Channels channels;
-static uint16_t channelCounter;
 static uint16_t currentChannel;
 static uint32_t currentVolume;
 static uint8_t volumeMuted;
 
+/* key bursts are coalesced, only the last selected channel is tuned and the last volume set */
+static int32_t tunedChannel = -1; // channel whose streams are playing, -1 for the starting channel
+static timerHandle timerTune;
+static timerHandle timerVolume;
+static uint8_t volumePending;
+static uint32_t tunesAvoided;
+static uint32_t tunesAvoidedTotal;
+static uint32_t tunesDone;
+static uint32_t volumeSetsAvoided;
+static uint64_t selectionKeyTime; // kernel timestamp of the key which selected the channel to tune
+
+/* PMT acquisition order of the channel scan, the channel being zapped to is acquired next */
+static pmtScanEntry *pmtScan;
+static int32_t pmtPriorityChannel = -1;
+static uint8_t pmtScanFinished;  // set once the scan has tried every PMT, later zaps start a late acquisition
+static uint8_t pmtLateAcquiring; // set while the late acquisition thread runs
+static pthread_mutex_t pmtScanMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* zap predictor, plans are prepared after every zap for the channels most likely tuned next */
+static zapPlan zapPlans[ZAP_PREDICTIONS];
+static uint16_t recentChannels[ZAP_RECENT_CHANNELS]; // most recent first
+static uint8_t recentChannelCount;
+static uint32_t zapsPredicted;
+static uint32_t streamsKept;
+
+/* streams are removed and created by the zap worker while the event loop draws the banner,
+ * the loop is notified when a zap completes */
+static pthread_t zapWorkerThread;
+static pthread_mutex_t zapMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t zapCondition = PTHREAD_COND_INITIALIZER;
+static uint8_t zapWorkerRunning;
+static zapPlan zapRequest;
+static uint8_t zapRequestPending;
+static uint8_t zapRequestPredicted;
+static uint8_t zapWarmPending; // predicted plans changed, the idle worker sets up their streams ahead
+static uint64_t zapRequestKeyTime;
+static uint32_t zapGeneration;           // incremented whenever playingStreams change
+static int32_t zapCompletedChannel = -1; // last channel started by the worker, -1 if it failed
+static uint32_t zapRequestSequence;      // incremented by every request
+static uint32_t zapCompletedSequence;    // request the completed channel belongs to
+static int32_t zapNotification = -1;
+
+/* sections are copied out of demux callbacks and parsed on the event loop thread */
+static queuedSection sectionQueue[SECTION_QUEUE_SIZE];
+static uint32_t sectionQueueHead;
+static uint32_t sectionQueueCount;
+static uint32_t sectionsDropped;
+static pthread_mutex_t sectionQueueMutex = PTHREAD_MUTEX_INITIALIZER;
+static int32_t sectionNotification = -1;
+
+/* zap duration buckets in microseconds, exported in seconds */
+static const uint64_t zapBuckets[ZAP_BUCKET_COUNT] = {50000, 100000, 200000, 300000, 500000, 750000,
+                                                      1000000, 1500000, 2000000, 3000000, 5000000};
+static int32_t zapsMetric = -1;
+static int32_t zapTimeMetric = -1;
+static int32_t channelsMetric = -1;
+static int32_t zapDurationMetric = -1;
+static int32_t zapPredictedDurationMetric = -1;
+static int32_t zapColdDurationMetric = -1;
+static int32_t zapsPredictedMetric = -1;
+static int32_t streamsKeptMetric = -1;
+static int32_t tunesAvoidedMetric = -1;
+static int32_t eitUpdatesMetric = -1;
+static int32_t sectionsDroppedMetric = -1;
+static int32_t pmtPriorityMetric = -1;
+
 /* helper functions needed only for stream controller module */
 static streamControllerStatus setFilterAndRegister(uint32_t tableId, uint32_t tablePid);
 static streamControllerStatus freeFilter(int32_t (*callback)(uint8_t *buffer));
 static void pmtSaveChannel(pmtTable *pmt);
+static int32_t findChannel(uint16_t programNumber);
+static streamControllerStatus initChannels();
+static int32_t nextPmtToAcquire();
+static void requestPmtPriority(uint16_t channelIndex);
+static streamControllerStatus acquirePmt(int32_t channelIndex);
+static streamControllerStatus setEitFilter();
+static void startLatePmtAcquisition();
+static void *latePmtAcquisition(void *arg);
 static void eitSaveChannel(eitTable *eit);
 static streamControllerStatus streamTypeDVBtoTDP(uint32_t dvbStreamType);
-static streamControllerStatus timedWaitForCondition(uint8_t seconds);
+static streamControllerStatus timedWaitForCondition(uint32_t milliseconds);
+static streamControllerStatus waitForTable(uint32_t key, uint32_t defaultMs);
 static streamControllerStatus threadMutexUnlock();
+static streamControllerStatus queueSection(uint8_t tableId, uint8_t *buffer);
+static void sectionHandler(int32_t fileDesc, uint32_t events, void *context);
+static streamControllerStatus patSectionReceived(uint8_t *buffer);
+static streamControllerStatus pmtSectionReceived(uint8_t *buffer);
+static streamControllerStatus eitSectionReceived(uint8_t *buffer);
+static void selectChannel(uint16_t channelIndex, uint8_t tuneNow);
+static void tuneSettled();
+static streamControllerStatus tuneCurrentChannel();
+static void *zapWorker(void *arg);
+static void zapCompleted(int32_t fileDesc, uint32_t events, void *context);
+static streamControllerStatus startPlannedStream(const zapPlan *plan, uint8_t predicted);
+static streamControllerStatus switchStreams(const zapPlan *plan, startingChannelInit *playing, uint64_t zapStart);
+static void prepareZapPlan(zapPlan *plan, int32_t channelIndex, const startingChannelInit *streams, uint16_t pcrPid);
+static void setTimeshiftService(const zapPlan *plan);
+static const zapPlan *findZapPlan(uint16_t channelIndex);
+static void predictZaps();
+static void rememberChannel(uint16_t channelIndex);
+static void warmPredictedStreams();
+static void requestVolumeApply();
+static void volumeApplyExpired();
+static streamControllerStatus applyVolume();
+static streamControllerStatus setPlayerVolume();
 
 /* callback functions needed only for stream controller module */
 static int32_t tunerStatusCallback(t_LockStatus status);
@@ -77,6 +232,47 @@ static int32_t eitCallback(uint8_t *buffer);
 streamControllerStatus streamControllerInit(initialConfig *config)
 {
     uint8_t result;
+    uint32_t i;
+
+    tablesParserInit();
+    result = virtualClockConditionInit(&statusCondition);
+    ASSERT_TDP_RESULT(result, "streamControllerInit: virtualClockConditionInit");
+    for (i = 0; i < ZAP_PREDICTIONS; i++)
+    {
+        zapPlans[i].channelIndex = -1;
+    }
+    playingStreams.videoPID = CONFIGURATION_PARSER_NOT_SET;
+    playingStreams.audioPID = CONFIGURATION_PARSER_NOT_SET;
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_zaps_total", "Stream starts, including the starting channel", &zapsMetric);
+    metricsRegister(METRICS_TYPE_GAUGE, "tv_last_zap_monotonic_nanoseconds", "CLOCK_MONOTONIC time the last stream start completed", &zapTimeMetric);
+    metricsRegister(METRICS_TYPE_GAUGE, "tv_channels", "Channels found by the channel scan", &channelsMetric);
+    metricsRegisterHistogram("tv_zap_duration_seconds", "Time from stopping the old streams to creating the new ones",
+                             zapBuckets, ZAP_BUCKET_COUNT, 1e-6, &zapDurationMetric);
+    metricsRegisterHistogram("tv_zap_predicted_duration_seconds", "Duration of zaps to a channel prepared by the zap predictor",
+                             zapBuckets, ZAP_BUCKET_COUNT, 1e-6, &zapPredictedDurationMetric);
+    metricsRegisterHistogram("tv_zap_cold_duration_seconds", "Duration of zaps to a channel the zap predictor did not prepare",
+                             zapBuckets, ZAP_BUCKET_COUNT, 1e-6, &zapColdDurationMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_zaps_predicted_total", "Zaps to a channel prepared by the zap predictor", &zapsPredictedMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_streams_kept_total", "Streams kept playing across a zap because PID and type did not change", &streamsKeptMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_tunes_avoided_total", "Channel selections skipped by key burst coalescing", &tunesAvoidedMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_eit_updates_applied_total", "EIT sections applied to a known channel", &eitUpdatesMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_pmt_priority_acquisitions_total", "PMTs acquired ahead of PAT order because the channel was zapped to", &pmtPriorityMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_sections_dropped_total", "Sections dropped because the event loop queue was full", &sectionsDroppedMetric);
+
+    /* Sections received by demux callbacks are handed to the event loop */
+    result = eventReactorAddNotification("demux sections", sectionHandler, NULL, &sectionNotification);
+    ASSERT_TDP_RESULT(result, "streamControllerInit: eventReactorAddNotification");
+
+    /* Channel changes run their player calls on the zap worker and report back to the event loop */
+    result = eventReactorAddNotification("zap completed", zapCompleted, NULL, &zapNotification);
+    ASSERT_TDP_RESULT(result, "streamControllerInit: zap eventReactorAddNotification");
+    zapWorkerRunning = 1;
+    result = pthread_create(&zapWorkerThread, NULL, zapWorker, NULL);
+    if (result)
+    {
+        zapWorkerRunning = 0;
+    }
+    ASSERT_TDP_RESULT(result, "streamControllerInit: zap worker pthread_create");
 
     /* Initialize tuner */
     result = Tuner_Init();
@@ -86,12 +282,22 @@ streamControllerStatus streamControllerInit(initialConfig *config)
     result = Tuner_Register_Status_Callback(tunerStatusCallback);
     ASSERT_TDP_RESULT(result, "streamControllerInit: Tuner_Register_Status_Callback");
 
-    /* Lock to frequency */
+    /* Lock to frequency, waits are derived from the intervals seen on earlier scans of it */
+    tableTimingLoad(config->transponder.frequency);
+    tableTimingArm(TABLE_TIMING_TUNER_LOCK);
+    pthread_mutex_lock(&statusMutex);
+    tunerLockWaiting = 1;
+    pthread_mutex_unlock(&statusMutex);
     result = Tuner_Lock_To_Frequency(config->transponder.frequency * 1000000, config->transponder.bandwidth, config->transponder.module);
     ASSERT_TDP_RESULT(result, "streamControllerInit: Tuner_Lock_To_Frequency");
 
-    /* set 10 second mutex lock until tunex is locked to frequency */
-    timedWaitForCondition(10);
+    /* wait until tuner is locked to frequency, a lock arriving after this must not wake a table wait */
+    result = waitForTable(TABLE_TIMING_TUNER_LOCK, TUNER_LOCK_TIMEOUT_MS);
+    pthread_mutex_lock(&statusMutex);
+    tunerLockWaiting = 0;
+    statusSignalled = 0;
+    pthread_mutex_unlock(&statusMutex);
+    ASSERT_TDP_RESULT(result, "streamControllerInit: tuner not locked");
 
     /* Initialize player (demux is a part of player) */
     result = Player_Init(&playerHandle);
@@ -112,6 +318,22 @@ streamControllerStatus streamControllerDeinit()
 {
     uint8_t result;
 
+    timerStopAndDelete(&timerTune);
+    timerStopAndDelete(&timerVolume);
+
+    /* a zap the worker has not started yet is dropped, one in progress is finished */
+    if (zapWorkerRunning)
+    {
+        pthread_mutex_lock(&zapMutex);
+        zapWorkerRunning = 0;
+        pthread_cond_signal(&zapCondition);
+        pthread_mutex_unlock(&zapMutex);
+        pthread_join(zapWorkerThread, NULL);
+    }
+
+    printf("Channel changes: %u tuned (%u predicted, %u streams kept), %u avoided by coalescing, %u volume sets avoided\n",
+           tunesDone, zapsPredicted, streamsKept, tunesAvoidedTotal, volumeSetsAvoided);
+
     stopPlayerStream();
 
     /* Close previously opened source */
@@ -127,6 +349,10 @@ streamControllerStatus streamControllerDeinit()
     ASSERT_TDP_RESULT(result, "streamControllerDeinit: Tuner_Deinit");
 
     /* Free channels memory */
+    pthread_mutex_lock(&pmtScanMutex);
+    free(pmtScan);
+    pmtScan = NULL;
+    pthread_mutex_unlock(&pmtScanMutex);
     free((channels.channel)->subtitles);
     free(channels.channel);
 
@@ -138,29 +364,19 @@ streamControllerStatus streamControllerDeinit()
 
 streamControllerStatus startPlayerStream(startingChannelInit *channel)
 {
-    uint8_t result;
-
-    stopPlayerStream();
-
-    if (channel->videoPID != CONFIGURATION_PARSER_NOT_SET && channel->videoType != CONFIGURATION_PARSER_NOT_SET)
-    {
-        result = Player_Stream_Create(playerHandle, sourceHandle, channel->videoPID, channel->videoType, &videoHandle);
-        ASSERT_TDP_RESULT(result, "startPlayerStream: Video Player_Stream_Create");
-    }
+    zapPlan plan;
 
-    if (channel->audioPID != CONFIGURATION_PARSER_NOT_SET && channel->audioType != CONFIGURATION_PARSER_NOT_SET)
-    {
-        result = Player_Stream_Create(playerHandle, sourceHandle, channel->audioPID, channel->audioType, &audioHandle);
-        ASSERT_TDP_RESULT(result, "startPlayerStream: Audio Player_Stream_Create");
-    }
+    pthread_mutex_lock(&zapMutex);
+    prepareZapPlan(&plan, -1, channel, TS_NULL_PID);
+    pthread_mutex_unlock(&zapMutex);
 
-    if (!volumeMuted)
+    /* played before the event loop runs, no key can change the volume meanwhile */
+    if (startPlannedStream(&plan, 0))
     {
-        result = Player_Volume_Set(playerHandle, currentVolume);
-        ASSERT_TDP_RESULT(result, "startPlayerStream: Player_Volume_Set");
+        return STREAM_CONTROLLER_ERROR;
     }
 
-    return STREAM_CONTROLLER_NO_ERROR;
+    return setPlayerVolume();
 }
 
 streamControllerStatus stopPlayerStream()
@@ -172,6 +388,7 @@ streamControllerStatus stopPlayerStream()
         result = Player_Stream_Remove(playerHandle, sourceHandle, videoHandle);
         ASSERT_TDP_RESULT(result, "stopPlayerStream: Video Player_Stream_Remove");
         videoHandle = 0;
+        playingStreams.videoPID = CONFIGURATION_PARSER_NOT_SET;
     }
 
     if (audioHandle)
@@ -179,6 +396,7 @@ streamControllerStatus stopPlayerStream()
         result = Player_Stream_Remove(playerHandle, sourceHandle, audioHandle);
         ASSERT_TDP_RESULT(result, "stopPlayerStream: Audio Player_Stream_Remove");
         audioHandle = 0;
+        playingStreams.audioPID = CONFIGURATION_PARSER_NOT_SET;
     }
 
     return STREAM_CONTROLLER_NO_ERROR;
@@ -188,187 +406,172 @@ void *channelsSetup()
 {
     uint8_t result;
 
-    /* PMT table parsing setup */
+    TRACE_BEGIN("channelsSetup");
+
+    /* PAT table parsing setup */
     result = setFilterAndRegister(PAT_ID, PAT_PID);
-    /* Wait for PAT table */
-    timedWaitForCondition(3);
+    ASSERT_TDP_RESULT(result, "channelsSetup: PAT setFilterAndRegister");
+    /* Wait for PAT table, the filter is freed here so the next one is never set before it */
+    result = waitForTable(PAT_PID, TABLE_TIMEOUT_MS);
+    freeFilter(patCallback);
+    if (result != STREAM_CONTROLLER_NO_ERROR || !pat)
+    {
+        LOG_ERROR("No PAT received, channel scan stopped!");
+        return (void *)STREAM_CONTROLLER_ERROR;
+    }
 
-    channels.channelCount = pat->programCount;
-    channels.channel = (channelData *)malloc(channels.channelCount * sizeof(channelData));
+    result = initChannels();
+    ASSERT_TDP_RESULT(result, "channelsSetup: initChannels");
 
     int32_t i;
-    /* PMT table parsing setup */
-    for (i = 0; i < pat->sectionCount; i++)
+    /* PMT table parsing setup, in PAT order unless a channel is zapped to before its PMT is acquired */
+    while ((i = nextPmtToAcquire()) >= 0)
     {
-        if (pat->programInformation[i].programNumber)
-        {
-            result = setFilterAndRegister(PMT_ID, pat->programInformation[i].programMapPid);
-            /* Wait for PMT table */
-            timedWaitForCondition(3);
-        }
+        result = acquirePmt(i);
+        ASSERT_TDP_RESULT(result, "channelsSetup: acquirePmt");
     }
 
     free(pat->programInformation);
-    free(pat);
-
     pat->programInformation = NULL;
+
+    free(pat);
     pat = NULL;
 
     /* EIT table parsing setup */
-    if (filterHandle)
-    {
-        ASSERT_TDP_RESULT(STREAM_CONTROLLER_ERROR, "channelsSetup: EIT Filter already set.");
-    }
+    result = setEitFilter();
+    ASSERT_TDP_RESULT(result, "channelsSetup: setEitFilter");
 
-    result = Demux_Set_Filter(playerHandle, EIT_PID, EIT_ID, &filterHandle);
-    ASSERT_TDP_RESULT(result, "channelsSetup: EIT Demux_Set_Filter ");
+    /* Wait for EIT table */
+    waitForTable(EIT_PID, TABLE_TIMEOUT_MS);
+    metricsSet(channelsMetric, channels.channelCount);
 
-    result = Demux_Register_Section_Filter_Callback(eitCallback);
-    ASSERT_TDP_RESULT(result, "channelsSetup: EIT Demux_Register_Section_Filter_Callback");
+    tableTimingSave();
 
-    /* Wait for EIT table */
-    timedWaitForCondition(3);
+    /* the EIT filter stays set, a channel zapped to from now on without a PMT gets one of its own */
+    pthread_mutex_lock(&pmtScanMutex);
+    pmtScanFinished = 1;
+    pthread_mutex_unlock(&pmtScanMutex);
+    startLatePmtAcquisition();
+
+    TRACE_END("channelsSetup");
 
     return (void *)STREAM_CONTROLLER_NO_ERROR;
 }
 
 streamControllerStatus playChannel(uint16_t channelNumber)
 {
-    int8_t result;
-
     if (channelNumber > channels.channelCount || channelNumber < 1)
     {
         showChannelNumberMessage(channelNumber);
         return STREAM_CONTROLLER_ERROR;
     }
 
-    currentChannel = channelNumber - 1;
-    result = startPlayerStream(&channels.channel[currentChannel].channelInit);
-    ASSERT_TDP_RESULT(result, "playChannel: startPlayerStream");
-
-    showChannelInfo();
+    /* number entry is already settled by its own timeout, tune at once */
+    selectChannel(channelNumber - 1, 1);
 
     return STREAM_CONTROLLER_NO_ERROR;
 }
 
 streamControllerStatus playNextChannel()
 {
-    uint8_t result;
+    if (!channels.channelCount)
+    {
+        return STREAM_CONTROLLER_ERROR;
+    }
 
     if (currentChannel == channels.channelCount - 1)
     {
-        currentChannel = 0;
+        selectChannel(0, 0);
     }
     else
     {
-        currentChannel++;
+        selectChannel(currentChannel + 1, 0);
     }
 
-    result = startPlayerStream(&channels.channel[currentChannel].channelInit);
-    ASSERT_TDP_RESULT(result, "playNextChannel: startPlayerStream");
-
-    showChannelInfo();
-
     return STREAM_CONTROLLER_NO_ERROR;
 }
 
 streamControllerStatus playPreviousChannel()
 {
-    uint8_t result;
+    if (!channels.channelCount)
+    {
+        return STREAM_CONTROLLER_ERROR;
+    }
 
     if (currentChannel == 0)
     {
-        currentChannel = channels.channelCount - 1;
+        selectChannel(channels.channelCount - 1, 0);
     }
     else
     {
-        currentChannel--;
+        selectChannel(currentChannel - 1, 0);
     }
 
-    result = startPlayerStream(&channels.channel[currentChannel].channelInit);
-    ASSERT_TDP_RESULT(result, "playPreviousChannel: startPlayerStream");
-
-    showChannelInfo();
-
     return STREAM_CONTROLLER_NO_ERROR;
 }
 
 streamControllerStatus volumeMute()
 {
-    uint8_t result;
-
-    if (volumeMuted)
-    {
-        result = Player_Volume_Set(playerHandle, currentVolume);
-        ASSERT_TDP_RESULT(result, "volumeMute: Player_Volume_Set");
-    }
-    else
-    {
-        result = Player_Volume_Set(playerHandle, VOLUME_MIN);
-        ASSERT_TDP_RESULT(result, "volumeMute: Player_Volume_Set");
-    }
-
     volumeMuted = !volumeMuted;
+    requestVolumeApply();
 
-    showVolumeInfo();
     return STREAM_CONTROLLER_NO_ERROR;
 }
 
 streamControllerStatus volumeUp()
 {
-    uint8_t result;
+    uint32_t step = VOLUME_MAX * VOLUME_STEP;
 
+    /* volume is owned by this module, no need to read it back from the player on every press */
     if (!volumeMuted)
     {
-        result = Player_Volume_Get(playerHandle, &currentVolume);
-        ASSERT_TDP_RESULT(result, "volumeUp: Player_Volume_Get");
-
-        currentVolume += VOLUME_MAX * VOLUME_STEP;
-        if (currentVolume >= VOLUME_MAX)
+        if (currentVolume > VOLUME_MAX - step)
         {
             currentVolume = VOLUME_MAX;
         }
+        else
+        {
+            currentVolume += step;
+        }
     }
 
     volumeMuted = 0;
-    result = Player_Volume_Set(playerHandle, currentVolume);
-    ASSERT_TDP_RESULT(result, "volumeUp: Player_Volume_Set");
+    requestVolumeApply();
 
-    showVolumeInfo();
     return STREAM_CONTROLLER_NO_ERROR;
 }
 
 streamControllerStatus volumeDown()
 {
-    uint8_t result;
+    uint32_t step = VOLUME_MAX * VOLUME_STEP;
 
     if (!volumeMuted)
     {
-        result = Player_Volume_Get(playerHandle, &currentVolume);
-        ASSERT_TDP_RESULT(result, "volumeDown: Player_Volume_Get");
-
-        currentVolume -= VOLUME_MAX * VOLUME_STEP;
-
-        if (currentVolume <= VOLUME_MIN)
+        if (currentVolume < VOLUME_MIN + step)
         {
             currentVolume = VOLUME_MIN;
         }
+        else
+        {
+            currentVolume -= step;
+        }
     }
 
     volumeMuted = 0;
-    result = Player_Volume_Set(playerHandle, currentVolume);
-    ASSERT_TDP_RESULT(result, "volumeDown: Player_Volume_Set");
+    requestVolumeApply();
 
-    showVolumeInfo();
     return STREAM_CONTROLLER_NO_ERROR;
 }
 
 streamControllerStatus showChannelInfo()
 {
     uint8_t result;
+    uint64_t drawStart;
 
+    drawStart = latencyNowNs();
     result = drawChannelInfo(currentChannel + 1, channels.channel[currentChannel].subtitleCount, channels.channel[currentChannel].subtitles);
     ASSERT_TDP_RESULT(result, "showChannelInfo: drawChannelInfo");
+    latencyRecordSince(LATENCY_STAGE_DRAW, drawStart);
 
     drawOnScreen();
 
@@ -378,6 +581,7 @@ streamControllerStatus showChannelInfo()
 streamControllerStatus showVolumeInfo()
 {
     uint8_t result;
+    uint64_t drawStart;
 
     float volumePercent;
 
@@ -386,8 +590,10 @@ streamControllerStatus showVolumeInfo()
     else
         volumePercent = (float)currentVolume / VOLUME_MAX;
 
+    drawStart = latencyNowNs();
     result = drawVolumeInfo(volumePercent);
     ASSERT_TDP_RESULT(result, "showVolumeInfo: drawVolumeInfo");
+    latencyRecordSince(LATENCY_STAGE_DRAW, drawStart);
 
     drawOnScreen();
 
@@ -397,13 +603,16 @@ streamControllerStatus showVolumeInfo()
 streamControllerStatus showMenuInfo(uint8_t channelFlag)
 {
     uint8_t result;
+    uint64_t drawStart;
 
+    drawStart = latencyNowNs();
     result = drawMenuInfo(channels.channel[currentChannel].presentShowStartTime, channels.channel[currentChannel].presentShowDuration,
                           channels.channel[currentChannel].presentShowName, channels.channel[currentChannel].presentShowDescription,
                           channels.channel[currentChannel].followingShowStartTime, channels.channel[currentChannel].followingShowDuration,
                           channels.channel[currentChannel].followingShowName, channels.channel[currentChannel].followingShowDescription,
                           channelFlag);
     ASSERT_TDP_RESULT(result, "showMenuInfo: drawMenuInfo");
+    latencyRecordSince(LATENCY_STAGE_DRAW, drawStart);
 
     drawOnScreen();
 
@@ -413,9 +622,12 @@ streamControllerStatus showMenuInfo(uint8_t channelFlag)
 streamControllerStatus showChannelNumber(uint16_t channelNumberValue)
 {
     uint8_t result;
+    uint64_t drawStart;
 
+    drawStart = latencyNowNs();
     result = drawChannelNumber(channelNumberValue);
     ASSERT_TDP_RESULT(result, "showChannelNumber: drawChannelNumber");
+    latencyRecordSince(LATENCY_STAGE_DRAW, drawStart);
 
     drawOnScreen();
 
@@ -429,15 +641,94 @@ streamControllerStatus showChannelNumberMessage(uint16_t channelNumberValue)
     clearScreen(COLOUR_BLACK);
 
     uint8_t result;
+    uint64_t drawStart;
 
+    drawStart = latencyNowNs();
     result = drawChannelNumberMessage(channelNumberValue);
     ASSERT_TDP_RESULT(result, "showChannelNumberMessage: drawChannelNumberMessage");
+    latencyRecordSince(LATENCY_STAGE_DRAW, drawStart);
 
     drawOnScreen();
 
     return STREAM_CONTROLLER_NO_ERROR;
 }
 
+streamControllerStatus togglePause()
+{
+    timeshiftStatistics statistics;
+
+    timeshiftGetStatistics(&statistics);
+    if (statistics.state == TIMESHIFT_PAUSED)
+    {
+        ASSERT_TDP_RESULT(timeshiftResume(), "togglePause: timeshiftResume");
+    }
+    else
+    {
+        ASSERT_TDP_RESULT(timeshiftPause(), "togglePause: timeshiftPause");
+    }
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+streamControllerStatus jumpBackward()
+{
+    ASSERT_TDP_RESULT(timeshiftSeek(-TIMESHIFT_JUMP_SECONDS), "jumpBackward: timeshiftSeek");
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+streamControllerStatus catchUpWithLive()
+{
+    ASSERT_TDP_RESULT(timeshiftCatchUp(), "catchUpWithLive: timeshiftCatchUp");
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+streamControllerStatus toggleRecording()
+{
+    pvrService service;
+    channelData *channel;
+    char path[PATH_MAX];
+    uint8_t acquired;
+    int32_t recordingId;
+
+    if (!channels.channelCount)
+    {
+        return STREAM_CONTROLLER_ERROR;
+    }
+
+    /* channels are recorded independently, the key only affects the current one */
+    if (!pvrRecorderFind(channels.channel[currentChannel].pmtProgramNumber, &recordingId))
+    {
+        ASSERT_TDP_RESULT(pvrRecorderStop(recordingId), "toggleRecording: pvrRecorderStop");
+        return STREAM_CONTROLLER_NO_ERROR;
+    }
+
+    pthread_mutex_lock(&pmtScanMutex);
+    acquired = pmtScan[currentChannel].acquired;
+    service.pmtPid = pmtScan[currentChannel].pmtPid;
+    pthread_mutex_unlock(&pmtScanMutex);
+
+    if (!acquired)
+    {
+        LOG_ERROR("PMT of channel %u not received yet, nothing to record!", currentChannel + 1);
+        return STREAM_CONTROLLER_ERROR;
+    }
+
+    channel = &channels.channel[currentChannel];
+    service.programNumber = channel->pmtProgramNumber;
+    service.pcrPid = channel->pcrPID;
+    service.videoPid = channel->channelInit.videoPID == CONFIGURATION_PARSER_NOT_SET ? TS_NULL_PID : channel->channelInit.videoPID;
+    service.videoStreamType = channel->videoStreamType;
+    service.audioPid = channel->channelInit.audioPID == CONFIGURATION_PARSER_NOT_SET ? TS_NULL_PID : channel->channelInit.audioPID;
+    service.audioStreamType = channel->audioStreamType;
+
+    snprintf(path, sizeof(path), "%s/tv_app_recording_%u_%ld.ts", PVR_RECORDER_DIRECTORY, service.programNumber, (long)time(NULL));
+    ASSERT_TDP_RESULT(pvrRecorderStart(path, &service, &recordingId), "toggleRecording: pvrRecorderStart");
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
 /* -------------------- HELPER FUNCTIONS -------------------- */
 /****************************************************************************
  * @brief    Function for setting demux filter and registering corresponding callback.
@@ -456,7 +747,15 @@ static streamControllerStatus setFilterAndRegister(uint32_t tableId, uint32_t ta
         ASSERT_TDP_RESULT(STREAM_CONTROLLER_ERROR, "setFilterAndRegister: Filter already set.");
     }
 
+    /* a wake left by an earlier table must not satisfy the wait for this one */
+    pthread_mutex_lock(&statusMutex);
+    statusSignalled = 0;
+    pthread_mutex_unlock(&statusMutex);
+
     /* Set filter to demux */
+    filterPid = tablePid;
+    __atomic_store_n(&filterSectionTaken, 0, __ATOMIC_RELEASE);
+    tableTimingArm(tablePid);
     result = Demux_Set_Filter(playerHandle, tablePid, tableId, &filterHandle);
     ASSERT_TDP_RESULT(result, "setFilterAndRegister: Demux_Set_Filter");
 
@@ -501,7 +800,8 @@ static streamControllerStatus freeFilter(int32_t (*callback)(uint8_t *buffer))
 }
 
 /****************************************************************************
- * @brief    Function for saving channel read from PMT table.
+ * @brief    Function for saving channel read from PMT table. Channels keep their PAT order
+ *           whatever order their PMTs arrive in.
  *
  * @param    pmt - [in] Pointer to structure variable in which loaded parameters are stored.
  *
@@ -511,26 +811,22 @@ static streamControllerStatus freeFilter(int32_t (*callback)(uint8_t *buffer))
 static void pmtSaveChannel(pmtTable *pmt)
 {
     int32_t streamType;
+    int32_t channelIndex = findChannel(pmt->pmtHeader.programNumber);
 
-    channels.channel[channelCounter].pmtProgramNumber = pmt->pmtHeader.programNumber;
-
-    channels.channel[channelCounter].channelInit.audioType = CONFIGURATION_PARSER_NOT_SET;
-    channels.channel[channelCounter].channelInit.videoType = CONFIGURATION_PARSER_NOT_SET;
-    channels.channel[channelCounter].channelInit.audioPID = CONFIGURATION_PARSER_NOT_SET;
-    channels.channel[channelCounter].channelInit.videoPID = CONFIGURATION_PARSER_NOT_SET;
-
-    channels.channel[channelCounter].presentShowStartTime = CONFIGURATION_PARSER_NOT_SET;
-    channels.channel[channelCounter].presentShowDuration = CONFIGURATION_PARSER_NOT_SET;
-    channels.channel[channelCounter].presentShowName = NULL;
-    channels.channel[channelCounter].presentShowDescription = NULL;
+    if (channelIndex < 0)
+    {
+        /* program not listed in the PAT */
+        return;
+    }
 
-    channels.channel[channelCounter].followingShowStartTime = CONFIGURATION_PARSER_NOT_SET;
-    channels.channel[channelCounter].followingShowDuration = CONFIGURATION_PARSER_NOT_SET;
-    channels.channel[channelCounter].followingShowName = NULL;
-    channels.channel[channelCounter].followingShowDescription = NULL;
+    channels.channel[channelIndex].channelInit.audioType = CONFIGURATION_PARSER_NOT_SET;
+    channels.channel[channelIndex].channelInit.videoType = CONFIGURATION_PARSER_NOT_SET;
+    channels.channel[channelIndex].channelInit.audioPID = CONFIGURATION_PARSER_NOT_SET;
+    channels.channel[channelIndex].channelInit.videoPID = CONFIGURATION_PARSER_NOT_SET;
+    channels.channel[channelIndex].pcrPID = pmt->pmtHeader.pcrPid;
 
-    channels.channel[channelCounter].subtitleCount = 0;
-    channels.channel[channelCounter].subtitles = NULL;
+    channels.channel[channelIndex].subtitleCount = 0;
+    channels.channel[channelIndex].subtitles = NULL;
 
     int32_t i;
     for (i = 0; i < pmt->elementaryInformationCount; i++)
@@ -539,203 +835,1166 @@ static void pmtSaveChannel(pmtTable *pmt)
         if (streamType >= AUDIO_TYPE_DOLBY_AC3 && streamType <= AUDIO_TYPE_UNSUPPORTED)
         {
             /* Audio stream type */
-            if (channels.channel[channelCounter].channelInit.audioType == CONFIGURATION_PARSER_NOT_SET)
+            if (channels.channel[channelIndex].channelInit.audioType == CONFIGURATION_PARSER_NOT_SET)
             {
-                channels.channel[channelCounter].channelInit.audioType = streamType;
-                channels.channel[channelCounter].channelInit.audioPID = pmt->elementaryInformation[i].elementaryPid;
+                channels.channel[channelIndex].channelInit.audioType = streamType;
+                channels.channel[channelIndex].channelInit.audioPID = pmt->elementaryInformation[i].elementaryPid;
+                channels.channel[channelIndex].audioStreamType = pmt->elementaryInformation[i].streamType;
             }
         }
         else if (streamType >= VIDEO_TYPE_H264 && streamType <= VIDEO_TYPE_VP6F)
         {
             /* Video stream type */
-            channels.channel[channelCounter].channelInit.videoType = streamType;
-            channels.channel[channelCounter].channelInit.videoPID = pmt->elementaryInformation[i].elementaryPid;
+            channels.channel[channelIndex].channelInit.videoType = streamType;
+            channels.channel[channelIndex].channelInit.videoPID = pmt->elementaryInformation[i].elementaryPid;
+            channels.channel[channelIndex].videoStreamType = pmt->elementaryInformation[i].streamType;
         }
 
         if (pmt->subtitleCount)
         {
-            channels.channel[channelCounter].subtitleCount = pmt->subtitleCount;
-            channels.channel[channelCounter].subtitles = pmt->subtitles;
+            channels.channel[channelIndex].subtitleCount = pmt->subtitleCount;
+            channels.channel[channelIndex].subtitles = pmt->subtitles;
         }
     }
-    channelCounter++;
+
+    pthread_mutex_lock(&pmtScanMutex);
+    pmtScan[channelIndex].acquired = 1;
+    pthread_mutex_unlock(&pmtScanMutex);
+
+    pcrAnalyzerWatchProgram(pmt->pmtHeader.programNumber, pmt->pmtHeader.pcrPid);
+
+    /* the zap to this channel was started before its streams were known, start them now */
+    if (channelIndex == currentChannel && channelIndex == tunedChannel)
+    {
+        tuneCurrentChannel();
+    }
 }
 
 /****************************************************************************
- * @brief    Function for saving channel read from EIT table.
+ * @brief    Function for finding the channel of a program.
  *
- * @param    eit - [in] Pointer to structure variable in which loaded parameters are stored.
+ * @param    programNumber - [in] Program number from the PAT.
  *
- * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
- *           STREAM_CONTROLLER_ERROR, in case of an error.
+ * @return   Channel index, -1 if there is no such channel.
 ****************************************************************************/
-static void eitSaveChannel(eitTable *eit)
+static int32_t findChannel(uint16_t programNumber)
 {
-    int i;
-    int j;
+    uint32_t i;
+
     for (i = 0; i < channels.channelCount; i++)
     {
-        if (eit->eitHeader.serviceId == channels.channel[i].pmtProgramNumber)
+        if (channels.channel[i].pmtProgramNumber == programNumber)
         {
-            for (j = 0; j < eit->eventInformationCount; j++)
-            {
-                if (eit->eventInformation[j].runningStatus == CHANNEL_RUNNING_STATUS)
-                {
-                    channels.channel[i].presentShowStartTime = eit->eventInformation[j].startTime;
-                    channels.channel[i].presentShowDuration = eit->eventInformation[j].duration;
-
-                    if (channels.channel[i].presentShowName != NULL)
-                    {
-                        free(channels.channel[i].presentShowName);
-                        channels.channel[i].presentShowName = NULL;
-                    }
-                    if (channels.channel[i].presentShowDescription != NULL)
-                    {
-                        free(channels.channel[i].presentShowDescription);
-                        channels.channel[i].presentShowDescription = NULL;
-                    }
+            return i;
+        }
+    }
 
-                    channels.channel[i].presentShowName = eit->eventInformation[j].eventNameChar;
-                    channels.channel[i].presentShowDescription = eit->eventInformation[j].textChar;
-                }
-                else
-                {
-                    channels.channel[i].followingShowStartTime = eit->eventInformation[j].startTime;
-                    channels.channel[i].followingShowDuration = eit->eventInformation[j].duration;
+    return -1;
+}
 
-                    if (channels.channel[i].followingShowName != NULL)
-                    {
-                        free(channels.channel[i].followingShowName);
-                        channels.channel[i].followingShowName = NULL;
-                    }
-                    if (channels.channel[i].followingShowDescription != NULL)
-                    {
-                        free(channels.channel[i].followingShowDescription);
-                        channels.channel[i].followingShowDescription = NULL;
-                    }
+/****************************************************************************
+ * @brief    Function for creating the channel list from the PAT, in PAT order and without
+ *           streams until their PMT is acquired.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static streamControllerStatus initChannels()
+{
+    channelData *channel;
+    pmtScanEntry *scan;
+    uint32_t channelCount = 0;
+    int32_t i;
 
-                    channels.channel[i].followingShowName = eit->eventInformation[j].eventNameChar;
-                    channels.channel[i].followingShowDescription = eit->eventInformation[j].textChar;
-                }
-            } // eit->eventInformationCount for loop end
-        }     //if eit->eitHeader.serviceId == channels.channel[i].pmtProgramNumber end
-    }         // channels.channelCount for loop end
+    channel = (channelData *)calloc(pat->programCount, sizeof(channelData));
+    scan = (pmtScanEntry *)calloc(pat->programCount, sizeof(pmtScanEntry));
+    if (!channel || !scan)
+    {
+        free(channel);
+        free(scan);
+        return STREAM_CONTROLLER_ERROR;
+    }
 
-    for (i = 0; i < eit->eventInformationCount; i++)
+    for (i = 0; i < pat->sectionCount && channelCount < pat->programCount; i++)
     {
-        eit->eventInformation[i].eventNameChar = NULL;
-        eit->eventInformation[i].textChar = NULL;
+        if (!pat->programInformation[i].programNumber)
+        {
+            /* network information, not a channel */
+            continue;
+        }
+
+        channel[channelCount].pmtProgramNumber = pat->programInformation[i].programNumber;
+
+        channel[channelCount].channelInit.audioType = CONFIGURATION_PARSER_NOT_SET;
+        channel[channelCount].channelInit.videoType = CONFIGURATION_PARSER_NOT_SET;
+        channel[channelCount].channelInit.audioPID = CONFIGURATION_PARSER_NOT_SET;
+        channel[channelCount].channelInit.videoPID = CONFIGURATION_PARSER_NOT_SET;
+        channel[channelCount].pcrPID = TS_NULL_PID;
+
+        channel[channelCount].presentShowStartTime = CONFIGURATION_PARSER_NOT_SET;
+        channel[channelCount].presentShowDuration = CONFIGURATION_PARSER_NOT_SET;
+        channel[channelCount].followingShowStartTime = CONFIGURATION_PARSER_NOT_SET;
+        channel[channelCount].followingShowDuration = CONFIGURATION_PARSER_NOT_SET;
+
+        scan[channelCount].pmtPid = pat->programInformation[i].programMapPid;
+        channelCount++;
     }
-    free(eit->eventInformation);
-    eit->eventInformation = NULL;
-} // eitSaveChannel end
+
+    pthread_mutex_lock(&pmtScanMutex);
+    pmtScan = scan;
+    pthread_mutex_unlock(&pmtScanMutex);
+
+    /* the list is complete before the event loop can see its size */
+    channels.channel = channel;
+    __atomic_store_n(&channels.channelCount, channelCount, __ATOMIC_RELEASE);
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
 
 /****************************************************************************
- * @brief    Function for converting DVB stream type to TDP stream type.
+ * @brief    Function for choosing the next PMT of the channel scan. A channel zapped to
+ *           goes first, then the remaining ones in PAT order.
  *
- * @param    dvbStreamType - [in] DVB standard stream type value.
- *
- * @return   TDP standard stream type value.
- *           CONFIGURATION_PARSER_NOT_SET, in case of an unknown value.
+ * @return   Channel index, -1 when every PMT has been acquired or attempted.
 ****************************************************************************/
-static streamControllerStatus streamTypeDVBtoTDP(uint32_t dvbStreamType)
+static int32_t nextPmtToAcquire()
 {
-    switch (dvbStreamType)
+    int32_t channelIndex = -1;
+    uint32_t i;
+
+    pthread_mutex_lock(&pmtScanMutex);
+    if (!pmtScan)
     {
-    case dvbVideoMPEG2:
-        return VIDEO_TYPE_MPEG2;
+        pthread_mutex_unlock(&pmtScanMutex);
+        return -1;
+    }
+    if (pmtPriorityChannel >= 0 && !pmtScan[pmtPriorityChannel].acquired)
+    {
+        channelIndex = pmtPriorityChannel;
+        metricsAdd(pmtPriorityMetric, 1);
+        LOG_INFO("Channel %d PMT acquired ahead of PAT order", channelIndex + 1);
+    }
+    pmtPriorityChannel = -1;
 
-    case dvbAudioMPEG:
-        return AUDIO_TYPE_MPEG_AUDIO;
+    for (i = 0; i < channels.channelCount && channelIndex < 0; i++)
+    {
+        if (!pmtScan[i].acquired && !pmtScan[i].attempted)
+        {
+            channelIndex = i;
+        }
     }
+    pthread_mutex_unlock(&pmtScanMutex);
 
-    return CONFIGURATION_PARSER_NOT_SET;
+    return channelIndex;
 }
 
 /****************************************************************************
- * @brief    Function for locking mutex and waiting for condition.
- *
- * @param    seconds - [in] Mutex lock time in seconds.
+ * @brief    Function for moving the PMT of a selected channel to the front of the scan.
+ *           A PMT which timed out earlier is tried again.
  *
- * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
- *           STREAM_CONTROLLER_ERROR, in case of an error.
+ * @param    channelIndex - [in] Index of the selected channel.
 ****************************************************************************/
-static streamControllerStatus timedWaitForCondition(uint8_t seconds)
+static void requestPmtPriority(uint16_t channelIndex)
 {
-    struct timespec lockStatusWaitTime;
-    struct timeval now;
+    pthread_mutex_lock(&pmtScanMutex);
+    if (pmtScan && !pmtScan[channelIndex].acquired)
+    {
+        pmtPriorityChannel = channelIndex;
+    }
+    pthread_mutex_unlock(&pmtScanMutex);
+}
 
-    gettimeofday(&now, NULL);
-    lockStatusWaitTime.tv_sec = now.tv_sec + seconds;
+/****************************************************************************
+ * @brief    Function for setting the PMT filter of a channel and waiting for its PMT, called
+ *           on the channel setup or late acquisition thread.
+ *
+ * @param    channelIndex - [in] Index of the channel.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if the PMT arrived or timed out.
+ *           STREAM_CONTROLLER_ERROR, if the filter could not be set.
+****************************************************************************/
+static streamControllerStatus acquirePmt(int32_t channelIndex)
+{
+    uint8_t result;
 
-    ASSERT_TDP_RESULT(pthread_mutex_lock(&statusMutex), "threadMutexUnlock: pthread_mutex_lock");
-    if (ETIMEDOUT == pthread_cond_timedwait(&statusCondition, &statusMutex, &lockStatusWaitTime))
+    result = setFilterAndRegister(PMT_ID, pmtScan[channelIndex].pmtPid);
+    ASSERT_TDP_RESULT(result, "acquirePmt: setFilterAndRegister");
+    /* Wait for PMT table */
+    result = waitForTable(pmtScan[channelIndex].pmtPid, TABLE_TIMEOUT_MS);
+    freeFilter(pmtCallback);
+    if (result != STREAM_CONTROLLER_NO_ERROR)
     {
-        printf("\n\nLock timeout exceeded!\n\n");
-        return STREAM_CONTROLLER_ERROR;
+        pthread_mutex_lock(&pmtScanMutex);
+        pmtScan[channelIndex].attempted = 1;
+        pthread_mutex_unlock(&pmtScanMutex);
+        LOG_ERROR("No PMT received for channel %d!", channelIndex + 1);
     }
-    ASSERT_TDP_RESULT(pthread_mutex_unlock(&statusMutex), "timedWaitForCondition: pthread_mutex_unlock");
 
     return STREAM_CONTROLLER_NO_ERROR;
 }
 
 /****************************************************************************
- * @brief    Function for signaling condition.
+ * @brief    Function for setting the EIT filter, which stays set after the channel scan.
  *
  * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
  *           STREAM_CONTROLLER_ERROR, in case of an error.
 ****************************************************************************/
-static streamControllerStatus threadMutexUnlock()
+static streamControllerStatus setEitFilter()
 {
-    ASSERT_TDP_RESULT(pthread_mutex_lock(&statusMutex), "threadMutexUnlock: pthread_mutex_lock");
-    ASSERT_TDP_RESULT(pthread_cond_signal(&statusCondition), "threadMutexUnlock: pthread_cond_signal");
-    ASSERT_TDP_RESULT(pthread_mutex_unlock(&statusMutex), "threadMutexUnlock: pthread_mutex_unlock");
+    uint8_t result;
+
+    if (filterHandle)
+    {
+        ASSERT_TDP_RESULT(STREAM_CONTROLLER_ERROR, "setEitFilter: Filter already set.");
+    }
+
+    /* a PMT parsed after its wait expired must not satisfy the wait for the EIT */
+    pthread_mutex_lock(&statusMutex);
+    statusSignalled = 0;
+    pthread_mutex_unlock(&statusMutex);
+
+    tableTimingArm(EIT_PID);
+    result = Demux_Set_Filter(playerHandle, EIT_PID, EIT_ID, &filterHandle);
+    ASSERT_TDP_RESULT(result, "setEitFilter: Demux_Set_Filter");
+
+    result = Demux_Register_Section_Filter_Callback(eitCallback);
+    ASSERT_TDP_RESULT(result, "setEitFilter: Demux_Register_Section_Filter_Callback");
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+/****************************************************************************
+ * @brief    Function for starting the late PMT acquisition of a channel zapped to after the
+ *           channel scan, if one is requested and none is running.
+****************************************************************************/
+static void startLatePmtAcquisition()
+{
+    pthread_t thread;
+
+    pthread_mutex_lock(&pmtScanMutex);
+    if (!pmtScanFinished || pmtLateAcquiring || pmtPriorityChannel < 0)
+    {
+        pthread_mutex_unlock(&pmtScanMutex);
+        return;
+    }
+    pmtLateAcquiring = 1;
+    pthread_mutex_unlock(&pmtScanMutex);
+
+    if (pthread_create(&thread, NULL, latePmtAcquisition, NULL))
+    {
+        LOG_ERROR("Late PMT acquisition not started!");
+        pthread_mutex_lock(&pmtScanMutex);
+        pmtLateAcquiring = 0;
+        pthread_mutex_unlock(&pmtScanMutex);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+/****************************************************************************
+ * @brief    Late PMT acquisition thread. The EIT filter is lent to the PMTs of the channels
+ *           zapped to meanwhile and set again once they were tried.
+ *
+ * @param    arg - [in] Unused.
+****************************************************************************/
+static void *latePmtAcquisition(void *arg)
+{
+    int32_t i;
+    uint8_t requested;
+
+    do
+    {
+        freeFilter(eitCallback);
+        while ((i = nextPmtToAcquire()) >= 0)
+        {
+            acquirePmt(i);
+        }
+        setEitFilter();
+
+        /* a channel zapped to after the last PMT was chosen is acquired in another round */
+        pthread_mutex_lock(&pmtScanMutex);
+        requested = pmtPriorityChannel >= 0;
+        pmtLateAcquiring = requested;
+        pthread_mutex_unlock(&pmtScanMutex);
+    } while (requested);
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for saving channel read from EIT table.
+ *
+ * @param    eit - [in] Pointer to structure variable in which loaded parameters are stored.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static void eitSaveChannel(eitTable *eit)
+{
+    int i;
+    int j;
+    for (i = 0; i < channels.channelCount; i++)
+    {
+        if (eit->eitHeader.serviceId == channels.channel[i].pmtProgramNumber)
+        {
+            for (j = 0; j < eit->eventInformationCount; j++)
+            {
+                if (eit->eventInformation[j].runningStatus == CHANNEL_RUNNING_STATUS)
+                {
+                    channels.channel[i].presentShowStartTime = eit->eventInformation[j].startTime;
+                    channels.channel[i].presentShowDuration = eit->eventInformation[j].duration;
+
+                    if (channels.channel[i].presentShowName != NULL)
+                    {
+                        free(channels.channel[i].presentShowName);
+                        channels.channel[i].presentShowName = NULL;
+                    }
+                    if (channels.channel[i].presentShowDescription != NULL)
+                    {
+                        free(channels.channel[i].presentShowDescription);
+                        channels.channel[i].presentShowDescription = NULL;
+                    }
+
+                    channels.channel[i].presentShowName = eit->eventInformation[j].eventNameChar;
+                    channels.channel[i].presentShowDescription = eit->eventInformation[j].textChar;
+                }
+                else
+                {
+                    channels.channel[i].followingShowStartTime = eit->eventInformation[j].startTime;
+                    channels.channel[i].followingShowDuration = eit->eventInformation[j].duration;
+
+                    if (channels.channel[i].followingShowName != NULL)
+                    {
+                        free(channels.channel[i].followingShowName);
+                        channels.channel[i].followingShowName = NULL;
+                    }
+                    if (channels.channel[i].followingShowDescription != NULL)
+                    {
+                        free(channels.channel[i].followingShowDescription);
+                        channels.channel[i].followingShowDescription = NULL;
+                    }
+
+                    channels.channel[i].followingShowName = eit->eventInformation[j].eventNameChar;
+                    channels.channel[i].followingShowDescription = eit->eventInformation[j].textChar;
+                }
+            } // eit->eventInformationCount for loop end
+
+            metricsAdd(eitUpdatesMetric, 1);
+            if (i == currentChannel)
+            {
+                invalidateMenuInfo();
+            }
+        }     //if eit->eitHeader.serviceId == channels.channel[i].pmtProgramNumber end
+    }         // channels.channelCount for loop end
+
+    for (i = 0; i < eit->eventInformationCount; i++)
+    {
+        eit->eventInformation[i].eventNameChar = NULL;
+        eit->eventInformation[i].textChar = NULL;
+    }
+    free(eit->eventInformation);
+    eit->eventInformation = NULL;
+} // eitSaveChannel end
+
+/****************************************************************************
+ * @brief    Function for converting DVB stream type to TDP stream type.
+ *
+ * @param    dvbStreamType - [in] DVB standard stream type value.
+ *
+ * @return   TDP standard stream type value.
+ *           CONFIGURATION_PARSER_NOT_SET, in case of an unknown value.
+****************************************************************************/
+static streamControllerStatus streamTypeDVBtoTDP(uint32_t dvbStreamType)
+{
+    switch (dvbStreamType)
+    {
+    case dvbVideoMPEG2:
+        return VIDEO_TYPE_MPEG2;
+
+    case dvbAudioMPEG:
+        return AUDIO_TYPE_MPEG_AUDIO;
+    }
+
+    return CONFIGURATION_PARSER_NOT_SET;
+}
+
+/****************************************************************************
+ * @brief    Function for locking mutex and waiting for condition.
+ *
+ * @param    milliseconds - [in] Mutex lock time in milliseconds.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static streamControllerStatus timedWaitForCondition(uint32_t milliseconds)
+{
+    uint64_t deadline = virtualClockNowNs() + milliseconds * 1000000ULL;
+    int32_t waitResult = 0;
+    uint8_t signalled;
+
+    ASSERT_TDP_RESULT(pthread_mutex_lock(&statusMutex), "timedWaitForCondition: pthread_mutex_lock");
+    TRACE_BEGIN("wait for condition");
+
+    /* the section may be parsed before the wait starts, the flag keeps that wake */
+    while (!statusSignalled && waitResult != ETIMEDOUT)
+    {
+        waitResult = virtualClockTimedWait(&statusCondition, &statusMutex, deadline);
+    }
+    signalled = statusSignalled;
+    statusSignalled = 0;
+
+    TRACE_END("wait for condition");
+    ASSERT_TDP_RESULT(pthread_mutex_unlock(&statusMutex), "timedWaitForCondition: pthread_mutex_unlock");
+
+    if (!signalled)
+    {
+        LOG_ERROR("Lock timeout exceeded!");
+        return STREAM_CONTROLLER_ERROR;
+    }
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+/****************************************************************************
+ * @brief    Function for waiting for a table (or the tuner lock) with the timeout learned for
+ *           it. A learned timeout which expires is raised and retried once with the default.
+ *
+ * @param    key - [in] PID, or TABLE_TIMING_TUNER_LOCK.
+ *           defaultMs - [in] Timeout without any learned interval.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static streamControllerStatus waitForTable(uint32_t key, uint32_t defaultMs)
+{
+    uint32_t timeoutMs = tableTimingTimeoutMs(key, defaultMs);
+
+    if (timedWaitForCondition(timeoutMs) == STREAM_CONTROLLER_NO_ERROR)
+    {
+        return STREAM_CONTROLLER_NO_ERROR;
+    }
+    tableTimingExpired(key, timeoutMs);
+
+    if (timeoutMs >= defaultMs)
+    {
+        return STREAM_CONTROLLER_ERROR;
+    }
+    LOG_WARN("Learned timeout of %u ms for %#x expired, retrying with %u ms", timeoutMs, key, defaultMs);
+
+    return timedWaitForCondition(defaultMs);
+}
+
+/****************************************************************************
+ * @brief    Function for signaling condition.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static streamControllerStatus threadMutexUnlock()
+{
+    ASSERT_TDP_RESULT(pthread_mutex_lock(&statusMutex), "threadMutexUnlock: pthread_mutex_lock");
+    statusSignalled = 1;
+    ASSERT_TDP_RESULT(pthread_cond_signal(&statusCondition), "threadMutexUnlock: pthread_cond_signal");
+    ASSERT_TDP_RESULT(pthread_mutex_unlock(&statusMutex), "threadMutexUnlock: pthread_mutex_unlock");
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+/****************************************************************************
+ * @brief    Function for selecting a channel. The banner is drawn at once, streams are
+ *           tuned only after no other channel is selected for TUNE_SETTLE_MS, or at once
+ *           while the banner is drawn.
+ *
+ * @param    channelIndex - [in] Index of the selected channel.
+ *           tuneNow - [in] 1 to tune without waiting for the settle window.
+****************************************************************************/
+static void selectChannel(uint16_t channelIndex, uint8_t tuneNow)
+{
+    if (timerIsArmed(&timerTune))
+    {
+        /* previous selection was never tuned */
+        tunesAvoided++;
+    }
+
+    currentChannel = channelIndex;
+    requestPmtPriority(channelIndex);
+    /* menu pages of the previous channel are no longer valid */
+    invalidateMenuInfo();
+
+    if (tuneNow)
+    {
+        timerStopAndDelete(&timerTune);
+        /* tuned on the entry timeout, there is no key being handled to measure from */
+        selectionKeyTime = 0;
+        tuneCurrentChannel();
+        showChannelInfo();
+        return;
+    }
+
+    selectionKeyTime = latencyInputTimestamp();
+    showChannelInfo();
+
+    timerSetAndStartMs(&timerTune, TUNE_SETTLE_MS, tuneSettled);
+}
+
+/****************************************************************************
+ * @brief    Function for tuning the last selected channel when the settle window expires.
+****************************************************************************/
+static void tuneSettled()
+{
+    if ((int32_t)currentChannel == tunedChannel)
+    {
+        /* zapped back to the playing channel, nothing to tune */
+        tunesAvoided++;
+        tunesAvoidedTotal += tunesAvoided;
+        metricsAdd(tunesAvoidedMetric, tunesAvoided);
+        LOG_INFO("Channel %u kept, %u tunes avoided", currentChannel + 1, tunesAvoided);
+        tunesAvoided = 0;
+        return;
+    }
+
+    tuneCurrentChannel();
+}
+
+/****************************************************************************
+ * @brief    Function for handing the streams of the current channel to the zap worker.
+ *           Returns at once, the event loop is notified when the streams are started.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static streamControllerStatus tuneCurrentChannel()
+{
+    const zapPlan *plan = findZapPlan(currentChannel);
+    uint8_t acquired;
+    uint8_t scanFinished;
+
+    pthread_mutex_lock(&pmtScanMutex);
+    acquired = !pmtScan || pmtScan[currentChannel].acquired;
+    scanFinished = pmtScanFinished;
+    pthread_mutex_unlock(&pmtScanMutex);
+    if (!acquired && !scanFinished)
+    {
+        /* the scan gets to this PMT next, the playing streams are kept until it arrives and pmtSaveChannel tunes */
+        tunedChannel = currentChannel;
+        return STREAM_CONTROLLER_NO_ERROR;
+    }
+    if (!acquired)
+    {
+        /* the streams of the old channel are stopped, this one stays without service until its PMT arrives */
+        LOG_WARN("Channel %u has no PMT yet, acquiring it", currentChannel + 1);
+        startLatePmtAcquisition();
+    }
+
+    pthread_mutex_lock(&zapMutex);
+    if (zapRequestPending)
+    {
+        /* the worker was still busy with an earlier zap, the waiting one is replaced */
+        tunesAvoided++;
+    }
+    if (plan)
+    {
+        zapRequest = *plan;
+    }
+    else
+    {
+        prepareZapPlan(&zapRequest, currentChannel, &channels.channel[currentChannel].channelInit, channels.channel[currentChannel].pcrPID);
+    }
+    zapRequestPredicted = plan != NULL;
+    zapRequestKeyTime = selectionKeyTime;
+    zapRequestSequence++;
+    zapRequestPending = 1;
+    pthread_cond_signal(&zapCondition);
+    pthread_mutex_unlock(&zapMutex);
+
+    selectionKeyTime = 0;
+
+    tunedChannel = currentChannel;
+    tunesAvoidedTotal += tunesAvoided;
+    metricsAdd(tunesAvoidedMetric, tunesAvoided);
+    if (tunesAvoided)
+    {
+        LOG_INFO("Channel %u tuned, %u tunes avoided", currentChannel + 1, tunesAvoided);
+    }
+    tunesAvoided = 0;
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+/****************************************************************************
+ * @brief    Zap worker thread, starts the streams of the latest requested zap.
+ *           Keep flags decided before an earlier zap completed are decided again. While
+ *           idle, sets up the streams of the predicted zaps ahead.
+ *
+ * @param    arg - [in] Unused.
+****************************************************************************/
+static void *zapWorker(void *arg)
+{
+    zapPlan plan;
+    uint8_t predicted;
+    uint64_t keyTime;
+    uint32_t sequence;
+    uint8_t result;
+
+    pthread_mutex_lock(&zapMutex);
+    while (1)
+    {
+        while (zapWorkerRunning && !zapRequestPending && !zapWarmPending)
+        {
+            pthread_cond_wait(&zapCondition, &zapMutex);
+        }
+        if (!zapWorkerRunning)
+        {
+            break;
+        }
+        if (!zapRequestPending)
+        {
+            zapWarmPending = 0;
+            warmPredictedStreams();
+            continue;
+        }
+
+        plan = zapRequest;
+        predicted = zapRequestPredicted;
+        keyTime = zapRequestKeyTime;
+        sequence = zapRequestSequence;
+        zapRequestPending = 0;
+        if (plan.generation != zapGeneration)
+        {
+            prepareZapPlan(&plan, plan.channelIndex, &plan.streams, plan.pcrPid);
+        }
+        pthread_mutex_unlock(&zapMutex);
+
+        result = startPlannedStream(&plan, predicted);
+        if (result == STREAM_CONTROLLER_NO_ERROR)
+        {
+            latencyRecordSince(LATENCY_STAGE_KEY_TO_ZAP, keyTime);
+        }
+
+        pthread_mutex_lock(&zapMutex);
+        zapCompletedChannel = result == STREAM_CONTROLLER_NO_ERROR ? plan.channelIndex : -1;
+        zapCompletedSequence = sequence;
+        pthread_mutex_unlock(&zapMutex);
+        eventReactorNotify(zapNotification);
+
+        pthread_mutex_lock(&zapMutex);
+    }
+    pthread_mutex_unlock(&zapMutex);
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Event loop handler of completed zaps, prepares the next predicted zaps. After a
+ *           failed zap no channel counts as tuned.
+ *
+ * @param    fileDesc - [in] Unused.
+ *           events - [in] Unused.
+ *           context - [in] Unused.
+****************************************************************************/
+static void zapCompleted(int32_t fileDesc, uint32_t events, void *context)
+{
+    int32_t channelIndex;
+    uint8_t latest;
+
+    pthread_mutex_lock(&zapMutex);
+    channelIndex = zapCompletedChannel;
+    latest = zapCompletedSequence == zapRequestSequence;
+    pthread_mutex_unlock(&zapMutex);
+
+    if (channelIndex < 0)
+    {
+        /* what plays is unknown after a failed zap, selecting the channel again tunes it again;
+           a later request still in progress decides for itself */
+        if (latest)
+        {
+            tunedChannel = -1;
+        }
+        return;
+    }
+
+    /* volume is only set on the event loop, a key pressed during the zap is not undone by it */
+    setPlayerVolume();
+
+    tunesDone++;
+    rememberChannel(channelIndex);
+    predictZaps();
+}
+
+/****************************************************************************
+ * @brief    Function for switching the player to the streams of a plan and publishing the
+ *           streams playing afterwards, also when the switch failed half way. The volume is
+ *           left to the caller, on the thread that handles the volume keys.
+ *
+ * @param    plan - [in] Streams to play, prepared by prepareZapPlan.
+ *           predicted - [in] 1 if the plan was prepared by the zap predictor before the zap.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static streamControllerStatus startPlannedStream(const zapPlan *plan, uint8_t predicted)
+{
+    streamControllerStatus result;
+    startingChannelInit playing = playingStreams; // streams are never started or stopped on two threads at once
+    uint64_t zapStart = latencyNowNs();
+    uint64_t zapEnd;
+
+    TRACE_BEGIN("startPlayerStream");
+    result = switchStreams(plan, &playing, zapStart);
+
+    /* plans prepared against the streams played before are decided again */
+    pthread_mutex_lock(&zapMutex);
+    playingStreams = playing;
+    zapGeneration++;
+    pthread_mutex_unlock(&zapMutex);
+
+    if (result == STREAM_CONTROLLER_NO_ERROR)
+    {
+        setTimeshiftService(plan);
+
+        latencyRecordSince(LATENCY_STAGE_ZAP, zapStart);
+        latencyRecordSince(predicted ? LATENCY_STAGE_ZAP_PREDICTED : LATENCY_STAGE_ZAP_COLD, zapStart);
+        zapEnd = latencyNowNs();
+        metricsAdd(zapsMetric, 1);
+        metricsObserve(zapDurationMetric, (zapEnd - zapStart) / 1000);
+        metricsObserve(predicted ? zapPredictedDurationMetric : zapColdDurationMetric, (zapEnd - zapStart) / 1000);
+        metricsSet(zapTimeMetric, zapEnd);
+        if (predicted)
+        {
+            zapsPredicted++;
+            metricsAdd(zapsPredictedMetric, 1);
+        }
+    }
+    TRACE_END("startPlayerStream");
+
+    return result;
+}
+
+/****************************************************************************
+ * @brief    Function for removing the streams a plan does not keep and creating its new ones.
+ *
+ * @param    plan - [in] Streams to play.
+ *           playing - [in/out] Streams playing, updated after every removed or created stream.
+ *           zapStart - [in] Time the zap started.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static streamControllerStatus switchStreams(const zapPlan *plan, startingChannelInit *playing, uint64_t zapStart)
+{
+    uint8_t result;
+    uint64_t stageStart;
+    /* a stream lost after a failed zap is created again even if the plan keeps it */
+    uint8_t keepVideo = plan->keepVideo && videoHandle;
+    uint8_t keepAudio = plan->keepAudio && audioHandle;
+
+    if (videoHandle && !keepVideo)
+    {
+        result = Player_Stream_Remove(playerHandle, sourceHandle, videoHandle);
+        ASSERT_TDP_RESULT(result, "switchStreams: Video Player_Stream_Remove");
+        videoHandle = 0;
+        playing->videoPID = CONFIGURATION_PARSER_NOT_SET;
+        playing->videoType = CONFIGURATION_PARSER_NOT_SET;
+    }
+    if (audioHandle && !keepAudio)
+    {
+        result = Player_Stream_Remove(playerHandle, sourceHandle, audioHandle);
+        ASSERT_TDP_RESULT(result, "switchStreams: Audio Player_Stream_Remove");
+        audioHandle = 0;
+        playing->audioPID = CONFIGURATION_PARSER_NOT_SET;
+        playing->audioType = CONFIGURATION_PARSER_NOT_SET;
+    }
+    latencyRecordSince(LATENCY_STAGE_STREAM_STOP, zapStart);
+
+    if (keepVideo || keepAudio)
+    {
+        streamsKept += keepVideo + keepAudio;
+        metricsAdd(streamsKeptMetric, keepVideo + keepAudio);
+    }
+
+    if (!keepVideo && plan->streams.videoPID != CONFIGURATION_PARSER_NOT_SET && plan->streams.videoType != CONFIGURATION_PARSER_NOT_SET)
+    {
+        stageStart = latencyNowNs();
+        TRACE_BEGIN("video Player_Stream_Create");
+        result = Player_Stream_Create(playerHandle, sourceHandle, plan->streams.videoPID, plan->streams.videoType, &videoHandle);
+        TRACE_END("video Player_Stream_Create");
+        ASSERT_TDP_RESULT(result, "switchStreams: Video Player_Stream_Create");
+        playing->videoPID = plan->streams.videoPID;
+        playing->videoType = plan->streams.videoType;
+        latencyRecordSince(LATENCY_STAGE_VIDEO_CREATE, stageStart);
+    }
+
+    if (!keepAudio && plan->streams.audioPID != CONFIGURATION_PARSER_NOT_SET && plan->streams.audioType != CONFIGURATION_PARSER_NOT_SET)
+    {
+        stageStart = latencyNowNs();
+        TRACE_BEGIN("audio Player_Stream_Create");
+        result = Player_Stream_Create(playerHandle, sourceHandle, plan->streams.audioPID, plan->streams.audioType, &audioHandle);
+        TRACE_END("audio Player_Stream_Create");
+        ASSERT_TDP_RESULT(result, "switchStreams: Audio Player_Stream_Create");
+        playing->audioPID = plan->streams.audioPID;
+        playing->audioType = plan->streams.audioType;
+        latencyRecordSince(LATENCY_STAGE_AUDIO_CREATE, stageStart);
+    }
 
     return STREAM_CONTROLLER_NO_ERROR;
 }
-/* -------------------- HELPER FUNCTIONS -------------------- */
 
-/* -------------------- CALLBACK FUNCTIONS -------------------- */
 /****************************************************************************
- * @brief    Callback function for setting and calling corresponding functions for PAT table parsing.
+ * @brief    Function for capturing the streams of a started plan into the timeshift buffer.
+ *           Called on the zap worker.
  *
- * @param    status - [in] Tuner locks status value.
+ * @param    plan - [in] Started plan.
+****************************************************************************/
+static void setTimeshiftService(const zapPlan *plan)
+{
+    uint16_t pids[3];
+    uint32_t count = 0;
+
+    if (plan->streams.videoPID != CONFIGURATION_PARSER_NOT_SET)
+    {
+        pids[count++] = plan->streams.videoPID;
+    }
+    if (plan->streams.audioPID != CONFIGURATION_PARSER_NOT_SET)
+    {
+        pids[count++] = plan->streams.audioPID;
+    }
+    /* the PCR usually comes with the video, the starting channel has no PMT to tell */
+    if (plan->pcrPid < TS_NULL_PID && (!count || plan->pcrPid != pids[0]) && (count < 2 || plan->pcrPid != pids[1]))
+    {
+        pids[count++] = plan->pcrPid;
+    }
+
+    timeshiftSetService(pids, count);
+}
+
+/****************************************************************************
+ * @brief    Function for preparing the zap to a channel against the playing streams.
+ *           Called with zapMutex locked.
+ *
+ * @param    plan - [out] Prepared plan.
+ *           channelIndex - [in] Index of the channel, -1 for streams outside the channel list.
+ *           streams - [in] Streams of the channel.
+ *           pcrPid - [in] PCR PID from the PMT of the channel, TS_NULL_PID if unknown.
+****************************************************************************/
+static void prepareZapPlan(zapPlan *plan, int32_t channelIndex, const startingChannelInit *streams, uint16_t pcrPid)
+{
+    plan->channelIndex = channelIndex;
+    plan->streams = *streams;
+    plan->pcrPid = pcrPid;
+    plan->keepVideo = streams->videoPID != CONFIGURATION_PARSER_NOT_SET &&
+                      streams->videoPID == playingStreams.videoPID && streams->videoType == playingStreams.videoType;
+    plan->keepAudio = streams->audioPID != CONFIGURATION_PARSER_NOT_SET &&
+                      streams->audioPID == playingStreams.audioPID && streams->audioType == playingStreams.audioType;
+    plan->generation = zapGeneration;
+}
+
+/****************************************************************************
+ * @brief    Function for looking up the prepared plan of a channel.
+ *
+ * @param    channelIndex - [in] Index of the channel to tune.
+ *
+ * @return   Plan, or NULL if the channel was not predicted or its streams changed since.
+****************************************************************************/
+static const zapPlan *findZapPlan(uint16_t channelIndex)
+{
+    uint32_t i;
+
+    for (i = 0; i < ZAP_PREDICTIONS; i++)
+    {
+        if (zapPlans[i].channelIndex == channelIndex)
+        {
+            return memcmp(&zapPlans[i].streams, &channels.channel[channelIndex].channelInit, sizeof(startingChannelInit)) ||
+                           zapPlans[i].pcrPid != channels.channel[channelIndex].pcrPID
+                       ? NULL
+                       : &zapPlans[i];
+        }
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for preparing plans for the next and previous channel and the
+ *           most recently tuned ones, called after every zap.
+****************************************************************************/
+static void predictZaps()
+{
+    int32_t candidates[ZAP_PREDICTIONS];
+    uint32_t candidateCount = 0;
+    uint32_t i;
+    uint32_t j;
+
+    if (!channels.channelCount)
+    {
+        return;
+    }
+
+    candidates[candidateCount++] = (currentChannel + 1) % channels.channelCount;
+    candidates[candidateCount++] = (currentChannel + channels.channelCount - 1) % channels.channelCount;
+    for (i = 0; i < recentChannelCount; i++)
+    {
+        candidates[candidateCount++] = recentChannels[i];
+    }
+
+    pthread_mutex_lock(&zapMutex);
+    for (i = 0; i < ZAP_PREDICTIONS; i++)
+    {
+        zapPlans[i].channelIndex = -1;
+    }
+    for (i = 0; i < candidateCount; i++)
+    {
+        if (candidates[i] == currentChannel || findZapPlan(candidates[i]))
+        {
+            continue;
+        }
+        for (j = 0; j < ZAP_PREDICTIONS && zapPlans[j].channelIndex != -1; j++)
+        {
+        }
+        prepareZapPlan(&zapPlans[j], candidates[i], &channels.channel[candidates[i]].channelInit, channels.channel[candidates[i]].pcrPID);
+    }
+    zapWarmPending = 1;
+    pthread_cond_signal(&zapCondition);
+    pthread_mutex_unlock(&zapMutex);
+}
+
+/****************************************************************************
+ * @brief    Function for setting up the streams of the predicted zaps ahead, next and previous
+ *           channel first, so a predicted zap skips the stream setup. Called on the idle zap
+ *           worker with zapMutex locked, stops as soon as a zap is requested. Only the file
+ *           source player has spare decoders, with the SDK player a predicted zap saves only
+ *           the plan and the split zap metrics show it.
+****************************************************************************/
+static void warmPredictedStreams()
+{
+#ifdef TDP_FILE_SOURCE
+    zapPlan plans[ZAP_PREDICTIONS];
+    uint32_t i;
+
+    memcpy(plans, zapPlans, sizeof(plans));
+    for (i = 0; i < ZAP_PREDICTIONS && zapWorkerRunning && !zapRequestPending; i++)
+    {
+        if (plans[i].channelIndex < 0)
+        {
+            continue;
+        }
+
+        pthread_mutex_unlock(&zapMutex);
+        if (!plans[i].keepVideo && plans[i].streams.videoPID != CONFIGURATION_PARSER_NOT_SET && plans[i].streams.videoType != CONFIGURATION_PARSER_NOT_SET)
+        {
+            fileSourceStreamWarm(plans[i].streams.videoPID, plans[i].streams.videoType);
+        }
+        if (!plans[i].keepAudio && plans[i].streams.audioPID != CONFIGURATION_PARSER_NOT_SET && plans[i].streams.audioType != CONFIGURATION_PARSER_NOT_SET)
+        {
+            fileSourceStreamWarm(plans[i].streams.audioPID, plans[i].streams.audioType);
+        }
+        pthread_mutex_lock(&zapMutex);
+    }
+#endif
+}
+
+/****************************************************************************
+ * @brief    Function for moving a tuned channel to the front of the recent channels.
+ *
+ * @param    channelIndex - [in] Index of the tuned channel.
+****************************************************************************/
+static void rememberChannel(uint16_t channelIndex)
+{
+    uint32_t i;
+
+    for (i = 0; i < recentChannelCount && recentChannels[i] != channelIndex; i++)
+    {
+    }
+    if (i == recentChannelCount && recentChannelCount < ZAP_RECENT_CHANNELS)
+    {
+        recentChannelCount++;
+    }
+    if (i == ZAP_RECENT_CHANNELS)
+    {
+        i--;
+    }
+
+    memmove(&recentChannels[1], &recentChannels[0], i * sizeof(uint16_t));
+    recentChannels[0] = channelIndex;
+}
+
+/****************************************************************************
+ * @brief    Function for applying volume change. The first change is applied at once,
+ *           changes arriving within the next VOLUME_APPLY_MS are merged into one set.
+****************************************************************************/
+static void requestVolumeApply()
+{
+    if (timerIsArmed(&timerVolume))
+    {
+        if (volumePending)
+        {
+            volumeSetsAvoided++;
+        }
+        volumePending = 1;
+        return;
+    }
+
+    applyVolume();
+    timerSetAndStartMs(&timerVolume, VOLUME_APPLY_MS, volumeApplyExpired);
+}
+
+/****************************************************************************
+ * @brief    Function for applying volume merged during the last frame.
+****************************************************************************/
+static void volumeApplyExpired()
+{
+    if (volumePending)
+    {
+        volumePending = 0;
+        applyVolume();
+        /* keep throttling while the key is held */
+        timerSetAndStartMs(&timerVolume, VOLUME_APPLY_MS, volumeApplyExpired);
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for setting absolute player volume and drawing it.
  *
  * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
  *           STREAM_CONTROLLER_ERROR, in case of an error.
 ****************************************************************************/
-static int32_t tunerStatusCallback(t_LockStatus status)
+static streamControllerStatus applyVolume()
 {
-    if (status == STATUS_LOCKED)
+    ASSERT_TDP_RESULT(setPlayerVolume(), "applyVolume: setPlayerVolume");
+
+    showVolumeInfo();
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+/****************************************************************************
+ * @brief    Function for setting the current or muted volume on the player, called on the
+ *           event loop only.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static streamControllerStatus setPlayerVolume()
+{
+    uint8_t result;
+
+    result = Player_Volume_Set(playerHandle, volumeMuted ? VOLUME_MIN : currentVolume);
+    ASSERT_TDP_RESULT(result, "setPlayerVolume: Player_Volume_Set");
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+/****************************************************************************
+ * @brief    Function for copying a section out of demux buffer and posting it to the event loop.
+ *
+ * @param    tableId - [in] Table ID of the filter the section was received on.
+ *           buffer - [in] Section buffer owned by demux.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, if the queue is full and the section is dropped.
+****************************************************************************/
+static streamControllerStatus queueSection(uint8_t tableId, uint8_t *buffer)
+{
+    queuedSection *section;
+    uint32_t length = 3 + (((buffer[1] & 0x0F) << 8) | buffer[2]);
+
+    if (length > SECTION_MAX_SIZE)
     {
-        threadMutexUnlock();
+        length = SECTION_MAX_SIZE;
     }
-    else
+
+    pthread_mutex_lock(&sectionQueueMutex);
+    if (sectionQueueCount == SECTION_QUEUE_SIZE)
     {
-        printf("\n\n\tCALLBACK NOT LOCKED\n\n");
+        sectionsDropped++;
+        metricsAdd(sectionsDroppedMetric, 1);
+        pthread_mutex_unlock(&sectionQueueMutex);
+        return STREAM_CONTROLLER_ERROR;
     }
+
+    section = &sectionQueue[(sectionQueueHead + sectionQueueCount) % SECTION_QUEUE_SIZE];
+    section->tableId = tableId;
+    section->length = length;
+    memcpy(section->data, buffer, length);
+    sectionQueueCount++;
+    TRACE_COUNTER("section queue", sectionQueueCount);
+    pthread_mutex_unlock(&sectionQueueMutex);
+
+    eventReactorNotify(sectionNotification);
+
     return STREAM_CONTROLLER_NO_ERROR;
 }
 
 /****************************************************************************
- * @brief    Callback function for setting and calling corresponding functions for PAT table parsing.
+ * @brief    Function for parsing queued sections, called on the event loop thread.
+ *           Channel list is modified only here, so remote key handlers never see it half updated.
  *
- * @param    buffer - [in] Input buffer.
+ * @param    fileDesc - [in] Notification file descriptor.
+ *           events - [in] Ready epoll events.
+ *           context - [in] Unused.
+****************************************************************************/
+static void sectionHandler(int32_t fileDesc, uint32_t events, void *context)
+{
+    static queuedSection section;
+
+    while (1)
+    {
+        pthread_mutex_lock(&sectionQueueMutex);
+        if (sectionQueueCount == 0)
+        {
+            pthread_mutex_unlock(&sectionQueueMutex);
+            break;
+        }
+
+        section.tableId = sectionQueue[sectionQueueHead].tableId;
+        section.length = sectionQueue[sectionQueueHead].length;
+        memcpy(section.data, sectionQueue[sectionQueueHead].data, section.length);
+        sectionQueueHead = (sectionQueueHead + 1) % SECTION_QUEUE_SIZE;
+        sectionQueueCount--;
+        pthread_mutex_unlock(&sectionQueueMutex);
+
+        TRACE_BEGIN("parse section");
+        switch (section.tableId)
+        {
+        case PAT_ID:
+            patSectionReceived(section.data);
+            break;
+
+        case PMT_ID:
+            pmtSectionReceived(section.data);
+            break;
+
+        case EIT_ID:
+            eitSectionReceived(section.data);
+            break;
+        }
+        TRACE_END("parse section");
+    }
+
+    if (sectionsDropped)
+    {
+        LOG_WARN("%u sections dropped, event loop is not keeping up!", sectionsDropped);
+        sectionsDropped = 0;
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for parsing PAT section and waking up channel setup.
+ *
+ * @param    buffer - [in] Section buffer.
  *
  * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
  *           STREAM_CONTROLLER_ERROR, in case of an error.
 ****************************************************************************/
-static int32_t patCallback(uint8_t *buffer)
+static streamControllerStatus patSectionReceived(uint8_t *buffer)
 {
     uint8_t result;
 
     pat = (patTable *)malloc(sizeof(patTable));
 
     result = parsePAT(buffer, pat);
-    ASSERT_TDP_RESULT(result, "patCallback: parsePAT");
+    ASSERT_TDP_RESULT(result, "patSectionReceived: parsePAT");
 
-    result = freeFilter(patCallback);
-    ASSERT_TDP_RESULT(result, "patCallback: freeFilter");
+    tableTimingSetTransportStream(pat->patHeader.transportStreamId);
 
     threadMutexUnlock();
 
@@ -743,20 +2002,20 @@ static int32_t patCallback(uint8_t *buffer)
 }
 
 /****************************************************************************
- * @brief    Callback function for setting and calling corresponding functions for PMT table parsing.
+ * @brief    Function for parsing PMT section, saving the channel and waking up channel setup.
  *
- * @param    buffer - [in] Input buffer.
+ * @param    buffer - [in] Section buffer.
  *
  * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
  *           STREAM_CONTROLLER_ERROR, in case of an error.
 ****************************************************************************/
-static int32_t pmtCallback(uint8_t *buffer)
+static streamControllerStatus pmtSectionReceived(uint8_t *buffer)
 {
     uint8_t result;
     pmtTable pmt;
 
     result = parsePMT(buffer, &pmt);
-    ASSERT_TDP_RESULT(result, "pmtCallback: parsePMT");
+    ASSERT_TDP_RESULT(result, "pmtSectionReceived: parsePMT");
 
     pmtSaveChannel(&pmt);
     free(pmt.elementaryInformation);
@@ -764,29 +2023,26 @@ static int32_t pmtCallback(uint8_t *buffer)
     pmt.elementaryInformation = NULL;
     pmt.subtitles = NULL;
 
-    result = freeFilter(pmtCallback);
-    ASSERT_TDP_RESULT(result, "pmtCallback: freeFilter");
-
     threadMutexUnlock();
 
     return STREAM_CONTROLLER_NO_ERROR;
 }
 
 /****************************************************************************
- * @brief    Callback function for setting and calling corresponding functions for EIT table parsing.
+ * @brief    Function for parsing EIT section and saving show information.
  *
- * @param    buffer - [in] Input buffer.
+ * @param    buffer - [in] Section buffer.
  *
  * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
  *           STREAM_CONTROLLER_ERROR, in case of an error.
 ****************************************************************************/
-static int32_t eitCallback(uint8_t *buffer)
+static streamControllerStatus eitSectionReceived(uint8_t *buffer)
 {
     eitTable eit;
 
     uint8_t result;
     result = parseEIT(buffer, &eit);
-    ASSERT_TDP_RESULT(result, "eitCallback: parseEIT");
+    ASSERT_TDP_RESULT(result, "eitSectionReceived: parseEIT");
 
     //printEIT(&eit);
 
@@ -796,4 +2052,121 @@ static int32_t eitCallback(uint8_t *buffer)
 
     return STREAM_CONTROLLER_NO_ERROR;
 }
+/* -------------------- HELPER FUNCTIONS -------------------- */
+
+/* -------------------- CALLBACK FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Callback function for setting and calling corresponding functions for PAT table parsing.
+ *
+ * @param    status - [in] Tuner locks status value.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static int32_t tunerStatusCallback(t_LockStatus status)
+{
+    if (status == STATUS_LOCKED)
+    {
+        tableTimingArrived(TABLE_TIMING_TUNER_LOCK);
+
+        /* a lock after the wait expired, or a relock, is not the section a later wait is for */
+        pthread_mutex_lock(&statusMutex);
+        if (tunerLockWaiting)
+        {
+            statusSignalled = 1;
+            pthread_cond_signal(&statusCondition);
+        }
+        pthread_mutex_unlock(&statusMutex);
+    }
+    else
+    {
+        LOG_WARN("Tuner callback: not locked");
+    }
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+/****************************************************************************
+ * @brief    Callback function for queueing PAT section, parsing is done on the event loop.
+ *
+ * @param    buffer - [in] Input buffer.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static int32_t patCallback(uint8_t *buffer)
+{
+    /* corrupted sections are dropped, the filter stays set for the next repetition */
+    if (checkSectionCrc(buffer))
+    {
+        return STREAM_CONTROLLER_ERROR;
+    }
+
+    /* repetitions arriving before channel setup frees the filter are not parsed again */
+    if (__atomic_exchange_n(&filterSectionTaken, 1, __ATOMIC_ACQ_REL))
+    {
+        return STREAM_CONTROLLER_NO_ERROR;
+    }
+    tableTimingArrived(filterPid);
+
+    TRACE_BEGIN("patCallback");
+    queueSection(PAT_ID, buffer);
+    TRACE_END("patCallback");
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+/****************************************************************************
+ * @brief    Callback function for queueing PMT section, parsing is done on the event loop.
+ *
+ * @param    buffer - [in] Input buffer.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static int32_t pmtCallback(uint8_t *buffer)
+{
+    /* corrupted sections are dropped, the filter stays set for the next repetition */
+    if (checkSectionCrc(buffer))
+    {
+        return STREAM_CONTROLLER_ERROR;
+    }
+
+    /* repetitions arriving before channel setup frees the filter are not parsed again */
+    if (__atomic_exchange_n(&filterSectionTaken, 1, __ATOMIC_ACQ_REL))
+    {
+        return STREAM_CONTROLLER_NO_ERROR;
+    }
+    tableTimingArrived(filterPid);
+
+    TRACE_BEGIN("pmtCallback");
+    queueSection(PMT_ID, buffer);
+    TRACE_END("pmtCallback");
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
+
+/****************************************************************************
+ * @brief    Callback function for queueing EIT section, parsing is done on the event loop.
+ *
+ * @param    buffer - [in] Input buffer.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+static int32_t eitCallback(uint8_t *buffer)
+{
+    if (checkSectionCrc(buffer))
+    {
+        return STREAM_CONTROLLER_ERROR;
+    }
+
+    /* the filter stays set, arrivals after the first one measure the repetition interval */
+    tableTimingArrived(EIT_PID);
+
+    TRACE_BEGIN("eitCallback");
+    queueSection(EIT_ID, buffer);
+    TRACE_END("eitCallback");
+
+    return STREAM_CONTROLLER_NO_ERROR;
+}
 /* -------------------- CALLBACK FUNCTIONS -------------------- */
@@ -20,6 +20,7 @@
 #define _STREAM_CONTROLLER_H_
 
 #include "configuration_parser.h"
+#include "logger.h"
 
 typedef enum _streamControllerStatus
 {
@@ -27,17 +28,17 @@ typedef enum _streamControllerStatus
     STREAM_CONTROLLER_ERROR
 } streamControllerStatus;
 
-#define ASSERT_TDP_RESULT(x, y)              \
-    {                                        \
-        if (STREAM_CONTROLLER_NO_ERROR == x) \
-            printf("%s success\n", y);       \
-        else                                 \
-        {                                    \
-            textColor(1, 1, 0);              \
-            printf("%s fail\n", y);          \
-            textColor(0, 7, 0);              \
-            return STREAM_CONTROLLER_ERROR;  \
-        }                                    \
+/* success is logged only in LOG_LEVEL=DEBUG builds, failures are queued to the logger with the result code */
+#define ASSERT_TDP_RESULT(x, y)                                   \
+    {                                                             \
+        int32_t assertResult = (int32_t)(x);                      \
+        if (STREAM_CONTROLLER_NO_ERROR == assertResult)           \
+            LOG_DEBUG("%s success", y);                           \
+        else                                                      \
+        {                                                         \
+            LOG_ERROR("%s fail (%d)", y, (int)assertResult);      \
+            return STREAM_CONTROLLER_ERROR;                       \
+        }                                                         \
     }
 
 typedef struct _channelData
@@ -45,6 +46,9 @@ typedef struct _channelData
     uint16_t pmtProgramNumber;
 
     startingChannelInit channelInit;
+    uint16_t pcrPID;
+    uint8_t videoStreamType; // DVB stream_type of the video and audio PIDs, written to recordings
+    uint8_t audioStreamType;
 
     uint32_t presentShowStartTime;
     uint32_t presentShowDuration;
@@ -92,7 +96,8 @@ streamControllerStatus streamControllerInit(initialConfig *config);
 streamControllerStatus streamControllerDeinit();
 
 /****************************************************************************
- * @brief    Function for creating player stream and setting volume.
+ * @brief    Function for creating player stream and setting volume on the calling thread,
+ *           used for the starting channel before channel changes are handled.
  *
  * @param    config - [in] Pointer to structure variable in which channel parameters are stored.
  *
@@ -118,7 +123,8 @@ streamControllerStatus stopPlayerStream();
 void *channelsSetup();
 
 /****************************************************************************
- * @brief    Function for starting player stream.
+ * @brief    Function for starting player stream. Streams are started by the zap worker
+ *           while the banner is drawn, the function does not wait for the player.
  *
  * @param    channelNumber - [in] Number of channel to play.
  *
@@ -128,7 +134,8 @@ void *channelsSetup();
 streamControllerStatus playChannel(uint16_t channelNumber);
 
 /****************************************************************************
- * @brief    Function for starting player stream for next channel.
+ * @brief    Function for selecting next channel. Banner is drawn at once, the stream is started
+ *           after the selection settles, so a burst of presses tunes only the last channel.
  *
  * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
  *           STREAM_CONTROLLER_ERROR, in case of an error.
@@ -136,7 +143,8 @@ streamControllerStatus playChannel(uint16_t channelNumber);
 streamControllerStatus playNextChannel();
 
 /****************************************************************************
- * @brief    Function for starting player stream for previous channel.
+ * @brief    Function for selecting previous channel. Banner is drawn at once, the stream is started
+ *           after the selection settles, so a burst of presses tunes only the last channel.
  *
  * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
  *           STREAM_CONTROLLER_ERROR, in case of an error.
@@ -152,7 +160,7 @@ streamControllerStatus playPreviousChannel();
 streamControllerStatus volumeMute();
 
 /****************************************************************************
- * @brief    Function for increasing volume.
+ * @brief    Function for increasing volume. Auto-repeated presses are applied at most once per frame.
  *
  * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
  *           STREAM_CONTROLLER_ERROR, in case of an error.
@@ -160,7 +168,7 @@ streamControllerStatus volumeMute();
 streamControllerStatus volumeUp();
 
 /****************************************************************************
- * @brief    Function for decreasing volume.
+ * @brief    Function for decreasing volume. Auto-repeated presses are applied at most once per frame.
  *
  * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
  *           STREAM_CONTROLLER_ERROR, in case of an error.
@@ -213,4 +221,40 @@ streamControllerStatus showChannelNumber(uint16_t channelNumberValue);
 ****************************************************************************/
 streamControllerStatus showChannelNumberMessage(uint16_t channelNumberValue);
 
+/****************************************************************************
+ * @brief    Function for pausing the current channel, or resuming it from where it was paused.
+ *           Bound to a key only in the file source build, the only one with timeshift.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, if nothing was captured for timeshift yet.
+****************************************************************************/
+streamControllerStatus togglePause();
+
+/****************************************************************************
+ * @brief    Function for playing the current channel TIMESHIFT_JUMP_SECONDS further back, live included.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, if nothing was captured for timeshift yet.
+****************************************************************************/
+streamControllerStatus jumpBackward();
+
+/****************************************************************************
+ * @brief    Function for playing faster until the timeshifted channel is live again.
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, if the channel is already live.
+****************************************************************************/
+streamControllerStatus catchUpWithLive();
+
+/****************************************************************************
+ * @brief    Function for starting to record the current channel, or stopping its recording. Other
+ *           channels of the multiplex keep recording while the current one changes. Recordings are written to PVR_RECORDER_DIRECTORY, named by program number and start time.
+ *           Needs the recorder, which is initialized only in the file source build (TDP_FILE_SOURCE).
+ *
+ * @return   STREAM_CONTROLLER_NO_ERROR, if there are no errors.
+ *           STREAM_CONTROLLER_ERROR, if the channel PMT is not known yet, every recording is running
+ *           or the recorder failed.
+****************************************************************************/
+streamControllerStatus toggleRecording();
+
 #endif
@@ -0,0 +1,291 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file table_timing.c
+ *
+ * \brief
+ * Implementation of the table timing module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "table_timing.h"
+#include "virtual_clock.h"
+#include "logger.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+/* helper keywords needed only for table timing module */
+#define PATH_LENGTH 64
+#define TRANSPORT_STREAM_UNKNOWN -1
+
+typedef struct _timingEntry
+{
+    uint32_t key;
+    uint64_t intervalUs; // 0 until the first arrival
+    uint64_t armedNs;    // filter set, 0 once the first section arrived
+    uint64_t lastNs;     // last arrival while the filter stays set
+} timingEntry;
+
+/* helper variables needed only for table timing module */
+static timingEntry entries[TABLE_TIMING_MAX_ENTRIES];
+static uint32_t entryCount;
+static uint32_t loadedFrequency;
+static int32_t transportStream = TRANSPORT_STREAM_UNKNOWN;
+static pthread_mutex_t timingMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* helper functions needed only for table timing module */
+static timingEntry *findEntry(uint32_t key, uint8_t create);
+static void filePath(char *path);
+
+tableTimingStatus tableTimingLoad(uint32_t frequency)
+{
+    char path[PATH_LENGTH];
+    FILE *file;
+    unsigned int key;
+    unsigned long long intervalUs;
+    int transportStreamId;
+    timingEntry *entry;
+
+    pthread_mutex_lock(&timingMutex);
+    entryCount = 0;
+    loadedFrequency = frequency;
+    transportStream = TRANSPORT_STREAM_UNKNOWN;
+
+    filePath(path);
+    file = fopen(path, "r");
+    if (!file)
+    {
+        pthread_mutex_unlock(&timingMutex);
+        return TABLE_TIMING_ERROR;
+    }
+
+    if (fscanf(file, "transport_stream_id %d", &transportStreamId) == 1)
+    {
+        transportStream = transportStreamId;
+    }
+    while (fscanf(file, "%x %llu", &key, &intervalUs) == 2)
+    {
+        entry = findEntry(key, 1);
+        if (entry)
+        {
+            entry->intervalUs = intervalUs;
+        }
+    }
+    fclose(file);
+    pthread_mutex_unlock(&timingMutex);
+
+    LOG_INFO("Table intervals of %u loaded from %s", frequency, path);
+
+    return TABLE_TIMING_NO_ERROR;
+}
+
+tableTimingStatus tableTimingSave()
+{
+    char path[PATH_LENGTH];
+    char temporaryPath[PATH_LENGTH + 4];
+    FILE *file;
+    uint32_t i;
+
+    pthread_mutex_lock(&timingMutex);
+    filePath(path);
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.new", path);
+
+    /* written aside and renamed, a power cut never leaves a truncated file */
+    file = fopen(temporaryPath, "w");
+    if (!file)
+    {
+        pthread_mutex_unlock(&timingMutex);
+        LOG_WARN("Table intervals not saved, %s can not be created", temporaryPath);
+        return TABLE_TIMING_ERROR;
+    }
+
+    fprintf(file, "transport_stream_id %d\n", transportStream);
+    for (i = 0; i < entryCount; i++)
+    {
+        if (entries[i].intervalUs)
+        {
+            fprintf(file, "%x %llu\n", entries[i].key, (unsigned long long)entries[i].intervalUs);
+        }
+    }
+
+    if (fclose(file) || rename(temporaryPath, path))
+    {
+        pthread_mutex_unlock(&timingMutex);
+        return TABLE_TIMING_ERROR;
+    }
+    pthread_mutex_unlock(&timingMutex);
+
+    return TABLE_TIMING_NO_ERROR;
+}
+
+void tableTimingSetTransportStream(uint16_t transportStreamId)
+{
+    uint32_t i;
+    uint32_t kept = 0;
+
+    pthread_mutex_lock(&timingMutex);
+    if (transportStream != TRANSPORT_STREAM_UNKNOWN && transportStream != transportStreamId)
+    {
+        /* the tuner lock time belongs to the frequency, everything else to the old stream */
+        for (i = 0; i < entryCount; i++)
+        {
+            if (entries[i].key == TABLE_TIMING_TUNER_LOCK)
+            {
+                entries[kept++] = entries[i];
+            }
+        }
+        entryCount = kept;
+        LOG_INFO("Transport stream changed from %d to %u, table intervals relearned", transportStream, transportStreamId);
+    }
+    transportStream = transportStreamId;
+    pthread_mutex_unlock(&timingMutex);
+}
+
+void tableTimingArm(uint32_t key)
+{
+    timingEntry *entry;
+
+    pthread_mutex_lock(&timingMutex);
+    entry = findEntry(key, 1);
+    if (entry)
+    {
+        entry->armedNs = virtualClockNowNs();
+        entry->lastNs = 0;
+    }
+    pthread_mutex_unlock(&timingMutex);
+}
+
+void tableTimingArrived(uint32_t key)
+{
+    timingEntry *entry;
+    uint64_t now = virtualClockNowNs();
+    uint64_t since;
+    uint64_t intervalUs;
+
+    pthread_mutex_lock(&timingMutex);
+    entry = findEntry(key, 0);
+    since = entry ? (entry->lastNs ? entry->lastNs : entry->armedNs) : 0;
+    if (since && now >= since)
+    {
+        intervalUs = (now - since) / 1000;
+
+        /* longer intervals are taken at once, shorter ones only lower the estimate slowly */
+        if (intervalUs > entry->intervalUs || !entry->intervalUs)
+        {
+            entry->intervalUs = intervalUs;
+        }
+        else
+        {
+            entry->intervalUs = (7 * entry->intervalUs + intervalUs) / 8;
+        }
+
+        entry->armedNs = 0;
+        entry->lastNs = now;
+    }
+    pthread_mutex_unlock(&timingMutex);
+}
+
+void tableTimingExpired(uint32_t key, uint32_t waitedMs)
+{
+    timingEntry *entry;
+
+    pthread_mutex_lock(&timingMutex);
+    entry = findEntry(key, 1);
+    if (entry && entry->intervalUs < waitedMs * 1000ULL)
+    {
+        entry->intervalUs = waitedMs * 1000ULL;
+    }
+    pthread_mutex_unlock(&timingMutex);
+}
+
+uint32_t tableTimingTimeoutMs(uint32_t key, uint32_t defaultMs)
+{
+    timingEntry *entry;
+    uint64_t intervalUs = 0;
+    uint64_t timeoutMs;
+    uint32_t i;
+
+    pthread_mutex_lock(&timingMutex);
+    entry = findEntry(key, 0);
+    if (entry && entry->intervalUs)
+    {
+        intervalUs = entry->intervalUs;
+    }
+    else if (key != TABLE_TIMING_TUNER_LOCK)
+    {
+        for (i = 0; i < entryCount; i++)
+        {
+            if (entries[i].key != TABLE_TIMING_TUNER_LOCK && entries[i].intervalUs > intervalUs)
+            {
+                intervalUs = entries[i].intervalUs;
+            }
+        }
+    }
+    pthread_mutex_unlock(&timingMutex);
+
+    if (!intervalUs)
+    {
+        return defaultMs;
+    }
+
+    timeoutMs = TABLE_TIMING_FACTOR * intervalUs / 1000;
+    if (timeoutMs < TABLE_TIMING_MIN_MS)
+    {
+        timeoutMs = TABLE_TIMING_MIN_MS;
+    }
+
+    return timeoutMs < defaultMs ? timeoutMs : defaultMs;
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for finding the entry of a key. Called with the timing mutex locked.
+ *
+ * @param    key - [in] PID, or TABLE_TIMING_TUNER_LOCK.
+ *           create - [in] 1 to add the entry if it does not exist.
+ *
+ * @return   Entry, NULL if it does not exist or there is no room.
+****************************************************************************/
+static timingEntry *findEntry(uint32_t key, uint8_t create)
+{
+    uint32_t i;
+
+    for (i = 0; i < entryCount; i++)
+    {
+        if (entries[i].key == key)
+        {
+            return &entries[i];
+        }
+    }
+
+    if (!create || entryCount == TABLE_TIMING_MAX_ENTRIES)
+    {
+        return NULL;
+    }
+
+    memset(&entries[entryCount], 0, sizeof(timingEntry));
+    entries[entryCount].key = key;
+
+    return &entries[entryCount++];
+}
+
+/****************************************************************************
+ * @brief    Function for building the file path of the loaded transponder.
+ *
+ * @param    path - [out] Buffer of PATH_LENGTH bytes.
+****************************************************************************/
+static void filePath(char *path)
+{
+    snprintf(path, PATH_LENGTH, TABLE_TIMING_FILE_FORMAT, loadedFrequency);
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
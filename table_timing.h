@@ -0,0 +1,101 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file table_timing.h
+ *
+ * \brief
+ * Header of the table timing module. The time between setting a section filter and the
+ * section arriving, and between repetitions while a filter stays set, is measured per PID.
+ * Waits for tables and for the tuner lock use a multiple of the learned interval instead of
+ * a fixed timeout. Intervals are saved per transponder and reused by the next scan, so
+ * absent tables time out quickly.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _TABLE_TIMING_H_
+#define _TABLE_TIMING_H_
+
+#include <stdint.h>
+
+#define TABLE_TIMING_TUNER_LOCK 0xFFFF // key of the tuner lock time, PIDs are 13-bit
+#define TABLE_TIMING_FACTOR 3          // deadline is this many learned intervals
+#define TABLE_TIMING_MIN_MS 500        // PSI repeats at least every 0.5 s, deadlines are never shorter
+#define TABLE_TIMING_MAX_ENTRIES 64
+#define TABLE_TIMING_FILE_FORMAT "/var/tmp/tv_app_table_timing_%u.txt" // per transponder frequency
+
+typedef enum _tableTimingStatus
+{
+    TABLE_TIMING_NO_ERROR = 0,
+    TABLE_TIMING_ERROR
+} tableTimingStatus;
+
+/****************************************************************************
+ * @brief    Function for loading the intervals learned on a transponder by earlier scans.
+ *
+ * @param    frequency - [in] Transponder frequency, selects the file.
+ *
+ * @return   TABLE_TIMING_NO_ERROR, if intervals were loaded.
+ *           TABLE_TIMING_ERROR, if there are none, the scan then starts with default timeouts.
+****************************************************************************/
+tableTimingStatus tableTimingLoad(uint32_t frequency);
+
+/****************************************************************************
+ * @brief    Function for saving the learned intervals of the loaded transponder.
+ *
+ * @return   TABLE_TIMING_NO_ERROR, if there are no errors.
+ *           TABLE_TIMING_ERROR, in case of an error.
+****************************************************************************/
+tableTimingStatus tableTimingSave();
+
+/****************************************************************************
+ * @brief    Function for checking the transport stream on the transponder. Table intervals
+ *           learned on a different transport stream are forgotten.
+ *
+ * @param    transportStreamId - [in] Transport stream id from the PAT.
+****************************************************************************/
+void tableTimingSetTransportStream(uint16_t transportStreamId);
+
+/****************************************************************************
+ * @brief    Function for noting that a filter for the PID was set (or the tuner asked to lock).
+ *
+ * @param    key - [in] PID, or TABLE_TIMING_TUNER_LOCK.
+****************************************************************************/
+void tableTimingArm(uint32_t key);
+
+/****************************************************************************
+ * @brief    Function for recording the arrival of a section on the PID (or the tuner lock).
+ *           Safe to call from demux and tuner callbacks.
+ *
+ * @param    key - [in] PID, or TABLE_TIMING_TUNER_LOCK.
+****************************************************************************/
+void tableTimingArrived(uint32_t key);
+
+/****************************************************************************
+ * @brief    Function for noting that a wait for the PID (or the tuner lock) expired. The
+ *           interval is at least the time waited, it is raised to that.
+ *
+ * @param    key - [in] PID, or TABLE_TIMING_TUNER_LOCK.
+ *           waitedMs - [in] Timeout which expired.
+****************************************************************************/
+void tableTimingExpired(uint32_t key, uint32_t waitedMs);
+
+/****************************************************************************
+ * @brief    Function for deriving the timeout of a wait. A PID never seen on the transport
+ *           stream uses the longest interval learned for the other tables.
+ *
+ * @param    key - [in] PID, or TABLE_TIMING_TUNER_LOCK.
+ *           defaultMs - [in] Timeout without any learned interval, also the cap.
+ *
+ * @return   Timeout in milliseconds.
+****************************************************************************/
+uint32_t tableTimingTimeoutMs(uint32_t key, uint32_t defaultMs);
+
+#endif // _TABLE_TIMING_H_
@@ -17,10 +17,57 @@
  ***************************************************************************************/
 
 #include "tables_parser.h"
+#include "metrics.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 
+/* helper keywords needed only for tables parser module */
+#define CRC32_POLYNOMIAL 0x04C11DB7 // MPEG-2 CRC_32, most significant bit first, no final inversion
+
+/* helper variables needed only for tables parser module */
+static uint32_t crcTable[256];
+static int32_t patParsedMetric = -1;
+static int32_t pmtParsedMetric = -1;
+static int32_t eitParsedMetric = -1;
+static int32_t crcErrorMetric = -1;
+
+/* helper functions needed only for tables parser module */
+static void buildCrcTable();
+
+tablesParserStatus tablesParserInit()
+{
+    buildCrcTable();
+
+    /* one family, registered next to each other so it is exported under one header */
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_sections_parsed_total{table=\"pat\"}", "Sections parsed per table", &patParsedMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_sections_parsed_total{table=\"pmt\"}", "Sections parsed per table", &pmtParsedMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_sections_parsed_total{table=\"eit\"}", "Sections parsed per table", &eitParsedMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_section_crc_errors_total", "Sections dropped because of a CRC_32 mismatch", &crcErrorMetric);
+
+    return TABLES_PARSER_NO_ERROR;
+}
+
+tablesParserStatus checkSectionCrc(const uint8_t *buffer)
+{
+    uint16_t sectionLength = (uint16_t)((*(buffer + 1) << 8) + *(buffer + 2)) & 0x0FFF;
+
+    /* short form sections have no CRC_32 */
+    if (!((*(buffer + 1) >> 7) & 0x01))
+    {
+        return TABLES_PARSER_NO_ERROR;
+    }
+
+    /* running the CRC over the section including its CRC_32 field leaves zero */
+    if (calculateSectionCrc(buffer, 3 + (uint32_t)sectionLength) || sectionLength < 4)
+    {
+        metricsAdd(crcErrorMetric, 1);
+        return TABLES_PARSER_ERROR;
+    }
+
+    return TABLES_PARSER_NO_ERROR;
+}
+
 tablesParserStatus parsePAT(uint8_t *buffer, patTable *pat)
 {
     pat->patHeader.tableId = (uint8_t)*buffer;
@@ -59,6 +106,7 @@ tablesParserStatus parsePAT(uint8_t *buffer, patTable *pat)
 
     //printPAT(pat);
 
+    metricsAdd(patParsedMetric, 1);
     return TABLES_PARSER_NO_ERROR;
 }
 
@@ -121,6 +169,7 @@ tablesParserStatus parsePMT(uint8_t *buffer, pmtTable *pmt)
 
     //printPMT(pmt);
 
+    metricsAdd(pmtParsedMetric, 1);
     return TABLES_PARSER_NO_ERROR;
 }
 
@@ -236,6 +285,7 @@ tablesParserStatus parseEIT(uint8_t *buffer, eitTable *eit)
         i += eit->eventInformation[eit->eventInformationCount - 1].descriptorsLoopLength;
     }
 
+    metricsAdd(eitParsedMetric, 1);
     return TABLES_PARSER_NO_ERROR;
 }
 
@@ -352,3 +402,43 @@ tablesParserStatus printEIT(eitTable *eit)
 
     return TABLES_PARSER_NO_ERROR;
 }
+
+uint32_t calculateSectionCrc(const uint8_t *buffer, uint32_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    uint32_t i;
+
+    if (!crcTable[1])
+    {
+        buildCrcTable();
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        crc = (crc << 8) ^ crcTable[((crc >> 24) ^ buffer[i]) & 0xFF];
+    }
+
+    return crc;
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for filling the byte-wise CRC_32 lookup table.
+****************************************************************************/
+static void buildCrcTable()
+{
+    uint32_t i;
+    uint32_t bit;
+
+    for (i = 0; i < 256; i++)
+    {
+        uint32_t crc = i << 24;
+
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ CRC32_POLYNOMIAL : crc << 1;
+        }
+        crcTable[i] = crc;
+    }
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
@@ -136,6 +136,35 @@ typedef struct _eitTable
 } eitTable;
 /* ---- EIT table ---- */
 
+/****************************************************************************
+ * @brief    Function for registering table metrics and preparing the CRC table.
+ *
+ * @return   TABLES_PARSER_NO_ERROR, if there are no errors.
+ *           TABLES_PARSER_ERROR, in case of an error.
+****************************************************************************/
+tablesParserStatus tablesParserInit();
+
+/****************************************************************************
+ * @brief    Function for checking the CRC_32 of a section with section_syntax_indicator set.
+ *           Failures are counted in the tv_section_crc_errors_total metric.
+ *
+ * @param    buffer - [in] Section starting with table_id, 3 + section_length bytes long.
+ *
+ * @return   TABLES_PARSER_NO_ERROR, if the CRC matches or the section carries none.
+ *           TABLES_PARSER_ERROR, if the section is corrupted.
+****************************************************************************/
+tablesParserStatus checkSectionCrc(const uint8_t *buffer);
+
+/****************************************************************************
+ * @brief    Function for calculating the MPEG-2 CRC_32 of a buffer, used to close generated sections.
+ *
+ * @param    buffer - [in] Section bytes, starting with table_id.
+ *           length - [in] Number of bytes to run the CRC over.
+ *
+ * @return   CRC_32 value, zero for a section run including its correct CRC_32 field.
+****************************************************************************/
+uint32_t calculateSectionCrc(const uint8_t *buffer, uint32_t length);
+
 /****************************************************************************
  * @brief    Function for parsing PAT table from transport stream.
  *
@@ -0,0 +1,610 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file tdp_file_source.c
+ *
+ * \brief
+ * File-backed stand-in for the tdp_api tuner, player and demux, linked instead of libtdp
+ * by make zap_benchmark. The recorded multiplex named by TDP_FILE_SOURCE is played in a
+ * loop at TDP_FILE_SOURCE_BITRATE bits per second (20 Mbit/s by default) and sections
+ * matching the set filters are passed to the registered callback, as the SDK does.
+ * TDP_FILE_SOURCE_STREAM_CREATE_MS adds a decoder setup delay to Player_Stream_Create,
+ * which a stream set up ahead on a spare decoder with fileSourceStreamWarm skips.
+ * Unlike the SDK player, the stand-in player can be fed from memory, which the timeshift
+ * playback does while it is behind live; packets on the PIDs of created streams are
+ * counted as decoded from either input.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "tdp_api.h"
+#include "tdp_file_source.h"
+#include "ts_input.h"
+#include "virtual_clock.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* helper keywords needed only for file source module */
+#define PACKETS_PER_READ 64
+#define MAX_FILTERS 4
+#define SECTION_MAX_SIZE 4096
+#define DEFAULT_BITRATE 20000000
+#define MAX_STREAMS 8
+#define MAX_WARM_STREAMS 12 // spare decoders, the video and audio of every predicted zap
+
+typedef struct _sectionFilter
+{
+    uint8_t used;
+    uint32_t pid;
+    uint32_t tableId;
+    uint32_t length; // bytes collected, 0 while waiting for a section start
+    uint8_t section[SECTION_MAX_SIZE];
+} sectionFilter;
+
+/* helper variables needed only for file source module */
+static int32_t (*statusCallback)(t_LockStatus status);
+static int32_t (*sectionCallback)(uint8_t *buffer);
+static sectionFilter filters[MAX_FILTERS];
+static pthread_mutex_t filterMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static FILE *transportFile;
+static pthread_t demuxThread;
+static volatile uint8_t demuxRunning;
+static uint32_t nextStreamHandle = 1;
+static uint32_t playerVolume;
+static uint32_t streamPids[MAX_STREAMS];
+static uint32_t streamHandles[MAX_STREAMS];
+static pthread_mutex_t streamMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t streamedPids[TS_PID_COUNT]; // streams created on each PID, read by the demux and memory input
+static uint32_t warmPids[MAX_WARM_STREAMS];
+static uint32_t warmTypes[MAX_WARM_STREAMS];
+static uint8_t warmUsed[MAX_WARM_STREAMS];
+static uint32_t nextWarm; // spare decoder set up next, the oldest one
+static uint64_t warmStreamsCreated;
+static uint64_t coldStreamsCreated;
+static uint8_t memoryInput;               // 1 while the player decodes packets fed from memory
+static uint64_t liveDecodedPackets;
+static uint64_t memoryDecodedPackets;
+
+/* helper functions needed only for file source module */
+static void *demuxThreadFunction(void *arg);
+static void handlePacket(const uint8_t *packet);
+static uint8_t packetDecoded(const uint8_t *packet);
+static uint8_t takeWarmStream(uint32_t PID, tStreamType streamType);
+static void collectSection(sectionFilter *filter, const uint8_t *data, uint32_t length, uint8_t start);
+static void sleepNs(uint64_t durationNs);
+static void sleepUntilNs(struct timespec *deadline, uint64_t periodNs);
+static uint32_t environmentValue(const char *name, uint32_t defaultValue);
+
+int32_t Tuner_Init()
+{
+    return 0;
+}
+
+int32_t Tuner_Deinit()
+{
+    if (demuxRunning)
+    {
+        demuxRunning = 0;
+        pthread_join(demuxThread, NULL);
+    }
+    if (transportFile)
+    {
+        fclose(transportFile);
+        transportFile = NULL;
+    }
+
+    return 0;
+}
+
+int32_t Tuner_Register_Status_Callback(int32_t (*tunerStatusCallback)(t_LockStatus status))
+{
+    statusCallback = tunerStatusCallback;
+    return 0;
+}
+
+int32_t Tuner_Lock_To_Frequency(uint32_t tuneFrequency, uint32_t bandwidth, t_Module module)
+{
+    const char *path = getenv("TDP_FILE_SOURCE");
+
+    if (!path)
+    {
+        printf("TDP_FILE_SOURCE is not set, no multiplex to play!\n");
+        return -1;
+    }
+
+    transportFile = fopen(path, "rb");
+    if (!transportFile)
+    {
+        printf("Error while opening multiplex %s!\n", path);
+        return -1;
+    }
+
+    /* lock is reported from the demux thread, like the SDK reports it from its own */
+    demuxRunning = 1;
+    if (pthread_create(&demuxThread, NULL, demuxThreadFunction, NULL))
+    {
+        demuxRunning = 0;
+        fclose(transportFile);
+        transportFile = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int32_t Player_Init(uint32_t *playerHandle)
+{
+    *playerHandle = 1;
+    return 0;
+}
+
+int32_t Player_Deinit(uint32_t playerHandle)
+{
+    printf("File source player decoded %llu live packets and %llu packets fed from memory\n",
+           (unsigned long long)__atomic_load_n(&liveDecodedPackets, __ATOMIC_RELAXED),
+           (unsigned long long)__atomic_load_n(&memoryDecodedPackets, __ATOMIC_RELAXED));
+    printf("File source player created %llu streams on spare decoders and %llu without\n",
+           (unsigned long long)warmStreamsCreated, (unsigned long long)coldStreamsCreated);
+    return 0;
+}
+
+int32_t Player_Source_Open(uint32_t playerHandle, uint32_t *sourceHandle)
+{
+    *sourceHandle = 1;
+    return 0;
+}
+
+int32_t Player_Source_Close(uint32_t playerHandle, uint32_t sourceHandle)
+{
+    return 0;
+}
+
+int32_t Player_Stream_Create(uint32_t playerHandle, uint32_t sourceHandle, uint32_t PID, tStreamType streamType, uint32_t *streamHandle)
+{
+    uint32_t i;
+
+    if (!takeWarmStream(PID, streamType))
+    {
+        sleepNs(environmentValue("TDP_FILE_SOURCE_STREAM_CREATE_MS", 0) * 1000000ULL);
+    }
+
+    *streamHandle = __sync_fetch_and_add(&nextStreamHandle, 1);
+
+    pthread_mutex_lock(&streamMutex);
+    for (i = 0; i < MAX_STREAMS; i++)
+    {
+        if (!streamHandles[i])
+        {
+            streamHandles[i] = *streamHandle;
+            streamPids[i] = PID % TS_PID_COUNT;
+            __atomic_add_fetch(&streamedPids[streamPids[i]], 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&streamMutex);
+
+    return 0;
+}
+
+void fileSourceStreamWarm(uint32_t PID, uint32_t streamType)
+{
+    uint32_t i;
+
+    pthread_mutex_lock(&streamMutex);
+    for (i = 0; i < MAX_WARM_STREAMS; i++)
+    {
+        if (warmUsed[i] && warmPids[i] == PID && warmTypes[i] == streamType)
+        {
+            pthread_mutex_unlock(&streamMutex);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&streamMutex);
+
+    sleepNs(environmentValue("TDP_FILE_SOURCE_STREAM_CREATE_MS", 0) * 1000000ULL);
+
+    pthread_mutex_lock(&streamMutex);
+    i = nextWarm;
+    nextWarm = (nextWarm + 1) % MAX_WARM_STREAMS;
+    warmPids[i] = PID;
+    warmTypes[i] = streamType;
+    warmUsed[i] = 1;
+    pthread_mutex_unlock(&streamMutex);
+}
+
+int32_t Player_Stream_Remove(uint32_t playerHandle, uint32_t sourceHandle, uint32_t streamHandle)
+{
+    uint32_t i;
+
+    pthread_mutex_lock(&streamMutex);
+    for (i = 0; i < MAX_STREAMS; i++)
+    {
+        if (streamHandles[i] == streamHandle)
+        {
+            streamHandles[i] = 0;
+            __atomic_sub_fetch(&streamedPids[streamPids[i]], 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&streamMutex);
+
+    return 0;
+}
+
+int32_t Player_Volume_Get(uint32_t playerHandle, uint32_t *volume)
+{
+    *volume = playerVolume;
+    return 0;
+}
+
+int32_t Player_Volume_Set(uint32_t playerHandle, uint32_t volume)
+{
+    playerVolume = volume;
+    return 0;
+}
+
+int32_t Demux_Set_Filter(uint32_t playerHandle, uint32_t PID, uint32_t tableId, uint32_t *filterHandle)
+{
+    uint32_t i;
+
+    pthread_mutex_lock(&filterMutex);
+    for (i = 0; i < MAX_FILTERS; i++)
+    {
+        if (!filters[i].used)
+        {
+            filters[i].used = 1;
+            filters[i].pid = PID;
+            filters[i].tableId = tableId;
+            filters[i].length = 0;
+            *filterHandle = i + 1;
+            pthread_mutex_unlock(&filterMutex);
+            return 0;
+        }
+    }
+    pthread_mutex_unlock(&filterMutex);
+
+    return -1;
+}
+
+int32_t Demux_Free_Filter(uint32_t playerHandle, uint32_t filterHandle)
+{
+    if (filterHandle < 1 || filterHandle > MAX_FILTERS)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&filterMutex);
+    filters[filterHandle - 1].used = 0;
+    pthread_mutex_unlock(&filterMutex);
+
+    return 0;
+}
+
+int32_t Demux_Register_Section_Filter_Callback(int32_t (*demuxSectionFilterCallback)(uint8_t *buffer))
+{
+    pthread_mutex_lock(&filterMutex);
+    sectionCallback = demuxSectionFilterCallback;
+    pthread_mutex_unlock(&filterMutex);
+
+    return 0;
+}
+
+int32_t Demux_Unregister_Section_Filter_Callback(int32_t (*demuxSectionFilterCallback)(uint8_t *buffer))
+{
+    pthread_mutex_lock(&filterMutex);
+    if (sectionCallback == demuxSectionFilterCallback)
+    {
+        sectionCallback = NULL;
+    }
+    pthread_mutex_unlock(&filterMutex);
+
+    return 0;
+}
+
+void fileSourcePlayerInput(const uint8_t *packets, uint32_t count)
+{
+    uint32_t decoded = 0;
+    uint32_t i;
+
+    /* no packets, the player decodes the tuner again */
+    __atomic_store_n(&memoryInput, packets != NULL, __ATOMIC_RELAXED);
+
+    for (i = 0; i < count; i++)
+    {
+        decoded += packetDecoded(&packets[i * TS_PACKET_SIZE]);
+    }
+    __atomic_add_fetch(&memoryDecodedPackets, decoded, __ATOMIC_RELAXED);
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Demux thread, reports the tuner lock and plays the multiplex in a loop at the configured bitrate.
+ *
+ * @param    arg - [in] Unused.
+****************************************************************************/
+static void *demuxThreadFunction(void *arg)
+{
+    uint8_t packets[PACKETS_PER_READ * TS_PACKET_SIZE];
+    uint64_t readPeriodNs = PACKETS_PER_READ * TS_PACKET_SIZE * 8 * 1000000000ULL / environmentValue("TDP_FILE_SOURCE_BITRATE", DEFAULT_BITRATE);
+    struct timespec deadline;
+    uint32_t decoded;
+    uint32_t i;
+
+    (void)arg;
+    if (statusCallback)
+    {
+        statusCallback(STATUS_LOCKED);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    while (demuxRunning)
+    {
+        size_t count = fread(packets, TS_PACKET_SIZE, PACKETS_PER_READ, transportFile);
+
+        if (!count)
+        {
+            /* end of the recording, play it again */
+            rewind(transportFile);
+            continue;
+        }
+
+        /* every packet the tuner receives goes through the input statistics, as a capture device would feed them */
+        tsInputPackets(packets, count, virtualClockNowNs());
+        decoded = 0;
+        for (i = 0; i < count; i++)
+        {
+            handlePacket(&packets[i * TS_PACKET_SIZE]);
+            decoded += packetDecoded(&packets[i * TS_PACKET_SIZE]);
+        }
+        if (!__atomic_load_n(&memoryInput, __ATOMIC_RELAXED))
+        {
+            __atomic_add_fetch(&liveDecodedPackets, decoded, __ATOMIC_RELAXED);
+        }
+
+        /* paced against absolute deadlines, the time spent on the packets does not lower the bitrate */
+        sleepUntilNs(&deadline, readPeriodNs * count / PACKETS_PER_READ);
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for taking the spare decoder set up for a stream, and counting streams
+ *           created with and without one.
+ *
+ * @param    PID - [in] Stream PID.
+ *           streamType - [in] Stream type.
+ *
+ * @return   1 if a spare decoder was set up for the stream, 0 otherwise.
+****************************************************************************/
+static uint8_t takeWarmStream(uint32_t PID, tStreamType streamType)
+{
+    uint32_t i;
+    uint8_t warm = 0;
+
+    pthread_mutex_lock(&streamMutex);
+    for (i = 0; i < MAX_WARM_STREAMS && !warm; i++)
+    {
+        if (warmUsed[i] && warmPids[i] == PID && warmTypes[i] == streamType)
+        {
+            warmUsed[i] = 0;
+            warm = 1;
+        }
+    }
+    if (warm)
+    {
+        warmStreamsCreated++;
+    }
+    else
+    {
+        coldStreamsCreated++;
+    }
+    pthread_mutex_unlock(&streamMutex);
+
+    return warm;
+}
+
+/****************************************************************************
+ * @brief    Function for telling whether the player decodes a packet, i.e. a stream was created on its PID.
+ *
+ * @param    packet - [in] Transport stream packet.
+ *
+ * @return   1 if a stream plays the packet, 0 otherwise.
+****************************************************************************/
+static uint8_t packetDecoded(const uint8_t *packet)
+{
+    return packet[0] == TS_SYNC_BYTE && __atomic_load_n(&streamedPids[((packet[1] & 0x1F) << 8) | packet[2]], __ATOMIC_RELAXED) > 0;
+}
+
+/****************************************************************************
+ * @brief    Function for passing one transport stream packet to the filters set on its PID.
+ *
+ * @param    packet - [in] Transport stream packet.
+****************************************************************************/
+static void handlePacket(const uint8_t *packet)
+{
+    uint32_t pid = ((packet[1] & 0x1F) << 8) | packet[2];
+    uint8_t payloadStart = (packet[1] >> 6) & 0x01;
+    uint8_t adaptation = (packet[3] >> 4) & 0x03;
+    uint32_t offset = 4;
+    uint32_t i;
+
+    if (packet[0] != TS_SYNC_BYTE || !(adaptation & 0x01))
+    {
+        return;
+    }
+    if (adaptation & 0x02)
+    {
+        offset += 1 + packet[4];
+    }
+    if (offset >= TS_PACKET_SIZE)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&filterMutex);
+    for (i = 0; i < MAX_FILTERS; i++)
+    {
+        if (!filters[i].used || filters[i].pid != pid)
+        {
+            continue;
+        }
+
+        if (payloadStart)
+        {
+            uint32_t pointer = packet[offset];
+
+            /* the tail of the previous section comes before the pointer field target */
+            if (filters[i].length && offset + 1 + pointer <= TS_PACKET_SIZE)
+            {
+                collectSection(&filters[i], &packet[offset + 1], pointer, 0);
+            }
+            if (offset + 1 + pointer < TS_PACKET_SIZE)
+            {
+                collectSection(&filters[i], &packet[offset + 1 + pointer], TS_PACKET_SIZE - offset - 1 - pointer, 1);
+            }
+        }
+        else if (filters[i].length)
+        {
+            collectSection(&filters[i], &packet[offset], TS_PACKET_SIZE - offset, 0);
+        }
+    }
+    pthread_mutex_unlock(&filterMutex);
+}
+
+/****************************************************************************
+ * @brief    Function for adding packet payload to the section being collected and
+ *           delivering complete sections of the filtered table. Called with the filter mutex held,
+ *           which is released around the callback so it can free its filter.
+ *
+ * @param    filter - [in] Filter collecting the section.
+ *           data - [in] Payload bytes.
+ *           length - [in] Payload length.
+ *           start - [in] 1 if data starts a new section.
+****************************************************************************/
+static void collectSection(sectionFilter *filter, const uint8_t *data, uint32_t length, uint8_t start)
+{
+    while (length)
+    {
+        uint32_t sectionLength;
+        uint32_t copy;
+
+        if (start)
+        {
+            /* stuffing after the last section of the packet */
+            if (data[0] == 0xFF)
+            {
+                filter->length = 0;
+                return;
+            }
+            filter->length = 0;
+        }
+
+        copy = length < SECTION_MAX_SIZE - filter->length ? length : SECTION_MAX_SIZE - filter->length;
+        memcpy(&filter->section[filter->length], data, copy);
+        filter->length += copy;
+
+        if (filter->length < 3)
+        {
+            return;
+        }
+
+        sectionLength = 3 + (((filter->section[1] & 0x0F) << 8) | filter->section[2]);
+        if (sectionLength > SECTION_MAX_SIZE)
+        {
+            filter->length = 0;
+            return;
+        }
+        if (filter->length < sectionLength)
+        {
+            return;
+        }
+
+        /* bytes past this section start the next one in the same packet */
+        data += copy - (filter->length - sectionLength);
+        length -= copy - (filter->length - sectionLength);
+        filter->length = 0;
+
+        if (filter->section[0] == filter->tableId && sectionCallback)
+        {
+            int32_t (*callback)(uint8_t *buffer) = sectionCallback;
+            uint32_t pid = filter->pid;
+            uint8_t section[SECTION_MAX_SIZE];
+
+            memcpy(section, filter->section, sectionLength);
+            pthread_mutex_unlock(&filterMutex);
+            callback(section);
+            pthread_mutex_lock(&filterMutex);
+
+            /* the callback freed or replaced the filter, the rest of the packet is not for it */
+            if (!filter->used || filter->pid != pid)
+            {
+                return;
+            }
+        }
+        start = 1;
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for sleeping without being cut short by signals.
+ *
+ * @param    durationNs - [in] Sleep duration in nanoseconds.
+****************************************************************************/
+static void sleepNs(uint64_t durationNs)
+{
+    struct timespec duration;
+
+    duration.tv_sec = durationNs / 1000000000ULL;
+    duration.tv_nsec = durationNs % 1000000000ULL;
+    while (nanosleep(&duration, &duration))
+    {
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for sleeping until the next period of a deadline on CLOCK_MONOTONIC.
+ *
+ * @param    deadline - [in/out] Previous deadline, moved on by the period.
+ *           periodNs - [in] Period in nanoseconds.
+****************************************************************************/
+static void sleepUntilNs(struct timespec *deadline, uint64_t periodNs)
+{
+    uint64_t deadlineNs = deadline->tv_sec * 1000000000ULL + deadline->tv_nsec + periodNs;
+
+    deadline->tv_sec = deadlineNs / 1000000000ULL;
+    deadline->tv_nsec = deadlineNs % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR)
+    {
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for reading a numeric environment variable.
+ *
+ * @param    name - [in] Variable name.
+ *           defaultValue - [in] Value used if the variable is not set or is zero.
+ *
+ * @return   Variable value.
+****************************************************************************/
+static uint32_t environmentValue(const char *name, uint32_t defaultValue)
+{
+    const char *value = getenv(name);
+    uint32_t number = value ? strtoul(value, NULL, 10) : 0;
+
+    return number ? number : defaultValue;
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
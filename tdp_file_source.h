@@ -0,0 +1,44 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file tdp_file_source.h
+ *
+ * \brief
+ * Header of the file-backed tdp_api stand-in, for what it offers beyond the SDK API.
+ * Included only by builds linked against it, which define TDP_FILE_SOURCE.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _TDP_FILE_SOURCE_H_
+#define _TDP_FILE_SOURCE_H_
+
+#include <stdint.h>
+
+/****************************************************************************
+ * @brief    Function for feeding the player from memory instead of the tuner, a timeshiftSink.
+ *           Called with no packets, the player decodes the tuner again.
+ *
+ * @param    packets - [in] Consecutive 188 byte packets, NULL to return to the tuner.
+ *           count - [in] Number of packets.
+****************************************************************************/
+void fileSourcePlayerInput(const uint8_t *packets, uint32_t count);
+
+/****************************************************************************
+ * @brief    Function for setting up a spare decoder for a stream ahead of its Player_Stream_Create,
+ *           which then skips the setup delay. The SDK player has no spare decoders. Takes as long
+ *           as Player_Stream_Create, the oldest spare decoder is reused when all are set up.
+ *
+ * @param    PID - [in] Stream PID.
+ *           streamType - [in] tStreamType of the stream.
+****************************************************************************/
+void fileSourceStreamWarm(uint32_t PID, uint32_t streamType);
+
+#endif // _TDP_FILE_SOURCE_H_
@@ -0,0 +1,377 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file text_layout.c
+ *
+ * \brief
+ * Implementation of the module for measuring strings and breaking them into lines by pixel width.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "text_layout.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* helper keywords needed only for text layout module */
+#define GLYPH_COUNT 256
+#define ADVANCE_CACHE_SIZE 8
+#define LAYOUT_CACHE_SIZE 16
+#define ELLIPSIS_CHARACTER '.'
+#define ELLIPSIS_LENGTH 3
+
+typedef struct _advanceCache
+{
+    IDirectFBFont *font;
+    int advance[GLYPH_COUNT]; // -1 until the glyph is measured
+} advanceCache;
+
+typedef struct _layoutCacheEntry
+{
+    uint8_t used;
+    IDirectFBFont *font;
+    int maxWidth;
+    uint32_t maxLines;
+    uint64_t hash;
+    uint32_t textLength;
+    char *text;
+    uint32_t lastUse;
+    textLayout layout;
+} layoutCacheEntry;
+
+/* helper variables needed only for text layout module */
+static advanceCache advanceCaches[ADVANCE_CACHE_SIZE];
+static uint32_t nextAdvanceCache;
+
+static layoutCacheEntry layoutCache[LAYOUT_CACHE_SIZE];
+static uint32_t layoutUseCounter;
+
+/* helper functions needed only for text layout module */
+static advanceCache *getAdvanceCache(IDirectFBFont *font);
+static int glyphAdvance(advanceCache *cache, uint8_t character);
+static uint64_t hashString(const char *text, uint32_t *length);
+static uint32_t breakLine(advanceCache *cache, const char *text, uint32_t length, uint32_t start, int maxWidth, textLayoutLine *line);
+static void layoutText(advanceCache *cache, const char *text, uint32_t length, int maxWidth, uint32_t maxLines, textLayout *layout);
+
+textLayoutStatus textLayoutMeasure(IDirectFBFont *font, const char *text, int bytes, int *width)
+{
+    advanceCache *cache;
+    int i;
+
+    if (!font || !text || !width)
+    {
+        return TEXT_LAYOUT_ERROR;
+    }
+
+    cache = getAdvanceCache(font);
+    if (bytes < 0)
+    {
+        bytes = strlen(text);
+    }
+
+    *width = 0;
+    for (i = 0; i < bytes; i++)
+    {
+        *width += glyphAdvance(cache, (uint8_t)text[i]);
+    }
+
+    return TEXT_LAYOUT_NO_ERROR;
+}
+
+textLayoutStatus textLayoutBreakLines(IDirectFBFont *font, const char *text, int maxWidth, uint32_t maxLines, const textLayout **layout)
+{
+    layoutCacheEntry *entry = NULL;
+    uint32_t length;
+    uint64_t hash;
+    uint32_t i;
+
+    if (!font || !text || !layout || maxWidth <= 0 || maxLines == 0 || maxLines > TEXT_LAYOUT_MAX_LINES)
+    {
+        return TEXT_LAYOUT_ERROR;
+    }
+
+    hash = hashString(text, &length);
+
+    /* look for the same string laid out with the same font and width */
+    for (i = 0; i < LAYOUT_CACHE_SIZE; i++)
+    {
+        layoutCacheEntry *candidate = &layoutCache[i];
+        if (candidate->used && candidate->hash == hash && candidate->font == font && candidate->maxWidth == maxWidth &&
+            candidate->maxLines == maxLines && candidate->textLength == length && memcmp(candidate->text, text, length) == 0)
+        {
+            candidate->lastUse = ++layoutUseCounter;
+            *layout = &candidate->layout;
+            return TEXT_LAYOUT_NO_ERROR;
+        }
+    }
+
+    /* reuse a free entry or the least recently used one */
+    for (i = 0; i < LAYOUT_CACHE_SIZE; i++)
+    {
+        if (!layoutCache[i].used)
+        {
+            entry = &layoutCache[i];
+            break;
+        }
+        if (!entry || layoutCache[i].lastUse < entry->lastUse)
+        {
+            entry = &layoutCache[i];
+        }
+    }
+
+    free(entry->text);
+    entry->used = 0;
+    entry->text = (char *)malloc(length + 1);
+    if (!entry->text)
+    {
+        return TEXT_LAYOUT_ERROR;
+    }
+    memcpy(entry->text, text, length + 1);
+
+    entry->font = font;
+    entry->maxWidth = maxWidth;
+    entry->maxLines = maxLines;
+    entry->hash = hash;
+    entry->textLength = length;
+    entry->lastUse = ++layoutUseCounter;
+    layoutText(getAdvanceCache(font), text, length, maxWidth, maxLines, &entry->layout);
+    entry->used = 1;
+
+    *layout = &entry->layout;
+    return TEXT_LAYOUT_NO_ERROR;
+}
+
+void textLayoutForgetFont(IDirectFBFont *font)
+{
+    uint32_t i;
+
+    for (i = 0; i < ADVANCE_CACHE_SIZE; i++)
+    {
+        if (advanceCaches[i].font == font)
+        {
+            advanceCaches[i].font = NULL;
+        }
+    }
+
+    for (i = 0; i < LAYOUT_CACHE_SIZE; i++)
+    {
+        if (layoutCache[i].used && layoutCache[i].font == font)
+        {
+            free(layoutCache[i].text);
+            layoutCache[i].text = NULL;
+            layoutCache[i].used = 0;
+        }
+    }
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for finding glyph advance cache of a font, creating it on first use.
+ *
+ * @param    font - [in] Font whose advances are cached.
+ *
+ * @return   Pointer to advance cache.
+****************************************************************************/
+static advanceCache *getAdvanceCache(IDirectFBFont *font)
+{
+    advanceCache *cache;
+    uint32_t i;
+
+    for (i = 0; i < ADVANCE_CACHE_SIZE; i++)
+    {
+        if (advanceCaches[i].font == font)
+        {
+            return &advanceCaches[i];
+        }
+    }
+
+    /* fonts are few and long lived, replace caches in round robin order */
+    cache = &advanceCaches[nextAdvanceCache];
+    nextAdvanceCache = (nextAdvanceCache + 1) % ADVANCE_CACHE_SIZE;
+
+    cache->font = font;
+    for (i = 0; i < GLYPH_COUNT; i++)
+    {
+        cache->advance[i] = -1;
+    }
+
+    return cache;
+}
+
+/****************************************************************************
+ * @brief    Function for getting glyph advance, the font is asked only the first time.
+ *
+ * @param    cache - [in] Advance cache of the font.
+ *           character - [in] Character to measure.
+ *
+ * @return   Glyph advance in pixels, 0 for characters missing in font.
+****************************************************************************/
+static int glyphAdvance(advanceCache *cache, uint8_t character)
+{
+    int advance;
+
+    if (cache->advance[character] < 0)
+    {
+        if (cache->font->GetGlyphExtents(cache->font, character, NULL, &advance) != DFB_OK)
+        {
+            advance = 0;
+        }
+        cache->advance[character] = advance;
+    }
+
+    return cache->advance[character];
+}
+
+/****************************************************************************
+ * @brief    Function for hashing string with 64-bit FNV-1a.
+ *
+ * @param    text - [in] String to hash.
+ *           length - [out] String length.
+ *
+ * @return   String hash value.
+****************************************************************************/
+static uint64_t hashString(const char *text, uint32_t *length)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint32_t i;
+
+    for (i = 0; text[i] != '\0'; i++)
+    {
+        hash ^= (uint8_t)text[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    *length = i;
+    return hash;
+}
+
+/****************************************************************************
+ * @brief    Function for filling one line starting at passed offset.
+ *
+ * @param    cache - [in] Advance cache of the font.
+ *           text - [in] String to lay out.
+ *           length - [in] String length.
+ *           start - [in] Offset of the first character of the line.
+ *           maxWidth - [in] Maximum line width in pixels.
+ *           line - [out] Laid out line.
+ *
+ * @return   Offset from which the next line continues.
+****************************************************************************/
+static uint32_t breakLine(advanceCache *cache, const char *text, uint32_t length, uint32_t start, int maxWidth, textLayoutLine *line)
+{
+    uint32_t position = start;
+    uint32_t lastSpace = start;
+    int lastSpaceWidth = 0;
+    int width = 0;
+
+    while (position < length && text[position] != '\n')
+    {
+        int advance = glyphAdvance(cache, (uint8_t)text[position]);
+        if (width + advance > maxWidth)
+        {
+            break;
+        }
+
+        if (text[position] == ' ')
+        {
+            lastSpace = position;
+            lastSpaceWidth = width;
+        }
+
+        width += advance;
+        position++;
+    }
+
+    line->start = start;
+
+    if (position < length && text[position] != '\n' && text[position] != ' ' && lastSpace > start)
+    {
+        /* line is full in the middle of a word, move the word to the next line */
+        line->length = lastSpace - start;
+        line->width = lastSpaceWidth;
+        position = lastSpace;
+    }
+    else if (position == start && position < length && text[position] != '\n')
+    {
+        /* a single character wider than the line, draw it anyway to make progress */
+        line->length = 1;
+        line->width = glyphAdvance(cache, (uint8_t)text[position]);
+        position++;
+    }
+    else
+    {
+        line->length = position - start;
+        line->width = width;
+    }
+
+    /* trailing spaces are not drawn */
+    while (line->length && text[start + line->length - 1] == ' ')
+    {
+        line->length--;
+        line->width -= glyphAdvance(cache, ' ');
+    }
+
+    return position;
+}
+
+/****************************************************************************
+ * @brief    Function for breaking the whole string into lines.
+ *
+ * @param    cache - [in] Advance cache of the font.
+ *           text - [in] String to lay out.
+ *           length - [in] String length.
+ *           maxWidth - [in] Maximum line width in pixels.
+ *           maxLines - [in] Maximum number of lines.
+ *           layout - [out] Laid out lines.
+****************************************************************************/
+static void layoutText(advanceCache *cache, const char *text, uint32_t length, int maxWidth, uint32_t maxLines, textLayout *layout)
+{
+    uint32_t position = 0;
+    int ellipsisWidth;
+
+    layout->lineCount = 0;
+    layout->truncated = 0;
+
+    while (layout->lineCount < maxLines)
+    {
+        /* lines never start with a space */
+        while (position < length && text[position] == ' ')
+        {
+            position++;
+        }
+        if (position >= length)
+        {
+            break;
+        }
+
+        position = breakLine(cache, text, length, position, maxWidth, &layout->line[layout->lineCount++]);
+        if (position < length && text[position] == '\n')
+        {
+            position++;
+        }
+    }
+
+    while (position < length && (text[position] == ' ' || text[position] == '\n'))
+    {
+        position++;
+    }
+
+    if (position < length && layout->lineCount)
+    {
+        /* text does not fit, break the last line again leaving room for an ellipsis */
+        textLayoutLine *last = &layout->line[layout->lineCount - 1];
+
+        ellipsisWidth = ELLIPSIS_LENGTH * glyphAdvance(cache, ELLIPSIS_CHARACTER);
+        breakLine(cache, text, length, last->start, maxWidth > ellipsisWidth ? maxWidth - ellipsisWidth : 1, last);
+        layout->truncated = 1;
+    }
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
@@ -0,0 +1,88 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file text_layout.h
+ *
+ * \brief
+ * Header of the module for measuring strings and breaking them into lines by pixel width.
+ * Glyph advances are cached per font and computed line breaks are cached per
+ * (string, width, font), so laying out the same text again costs only a lookup.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _TEXT_LAYOUT_H_
+#define _TEXT_LAYOUT_H_
+
+#include <stdint.h>
+#ifdef GRAPHICS_SOFTWARE_BACKEND
+#include "software_framebuffer.h"
+#else
+#include <directfb.h>
+#endif
+
+#define TEXT_LAYOUT_MAX_LINES 16
+
+typedef enum _textLayoutStatus
+{
+    TEXT_LAYOUT_NO_ERROR = 0,
+    TEXT_LAYOUT_ERROR
+} textLayoutStatus;
+
+typedef struct _textLayoutLine
+{
+    uint32_t start;  // offset of the first character in laid out string
+    uint32_t length; // number of characters to draw
+    int width;       // line width in pixels
+} textLayoutLine;
+
+typedef struct _textLayout
+{
+    textLayoutLine line[TEXT_LAYOUT_MAX_LINES];
+    uint32_t lineCount;
+    uint8_t truncated; // 1 if the text did not fit, space for an ellipsis is left after the last line
+} textLayout;
+
+/****************************************************************************
+ * @brief    Function for measuring string width from cached glyph advances.
+ *
+ * @param    font - [in] Font the string is drawn with.
+ *           text - [in] String to measure.
+ *           bytes - [in] Number of characters to measure, -1 for the whole string.
+ *           width - [out] String width in pixels.
+ *
+ * @return   TEXT_LAYOUT_NO_ERROR, if there are no errors.
+ *           TEXT_LAYOUT_ERROR, in case of an error.
+****************************************************************************/
+textLayoutStatus textLayoutMeasure(IDirectFBFont *font, const char *text, int bytes, int *width);
+
+/****************************************************************************
+ * @brief    Function for breaking string into lines not wider than passed width.
+ *           Lines are broken at spaces, words wider than a line are broken at any character.
+ *
+ * @param    font - [in] Font the string is drawn with.
+ *           text - [in] String to lay out.
+ *           maxWidth - [in] Maximum line width in pixels.
+ *           maxLines - [in] Maximum number of lines, at most TEXT_LAYOUT_MAX_LINES.
+ *           layout - [out] Pointer to cached layout, valid until the next call.
+ *
+ * @return   TEXT_LAYOUT_NO_ERROR, if there are no errors.
+ *           TEXT_LAYOUT_ERROR, in case of an error.
+****************************************************************************/
+textLayoutStatus textLayoutBreakLines(IDirectFBFont *font, const char *text, int maxWidth, uint32_t maxLines, const textLayout **layout);
+
+/****************************************************************************
+ * @brief    Function for dropping cached advances and layouts of a font. Has to be called before the font is released.
+ *
+ * @param    font - [in] Font which will be released.
+****************************************************************************/
+void textLayoutForgetFont(IDirectFBFont *font);
+
+#endif // _TEXT_LAYOUT_H_
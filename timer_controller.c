@@ -17,43 +17,525 @@
  ***************************************************************************************/
 
 #include "timer_controller.h"
+#include "trace.h"
+#include "metrics.h"
+#include "virtual_clock.h"
 
-#include <signal.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
-void timerSetAndStart(timer_t *timerId, time_t triggerSec, void *callback)
+/* helper keywords needed only for timer controller module */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_MAX_TICKS ((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1) // about 46 hours
+
+/* helper variables needed only for timer controller module */
+static timerHandle *wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static uint64_t wheelTick; // next tick to process
+static uint32_t pendingTimers;
+static uint64_t armedTick; // tick the timerfd expires at, 0 while disarmed
+
+static int32_t timerFileDesc = -1;
+static pthread_t timerThread;
+static pthread_mutex_t timerMutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile uint8_t timerThreadRunning;
+static timerControllerMode timerMode;
+
+static uint64_t timersArmed;
+static uint64_t timersFired;
+
+static int32_t threadsStartedMetric = -1;
+static int32_t callbacksMetric = -1;
+static int32_t pendingMetric = -1;
+
+/* helper functions needed only for timer controller module */
+static uint64_t currentTick();
+static void linkTimer(timerHandle *timer);
+static void addTimer(timerHandle *timer);
+static void removeTimer(timerHandle *timer);
+static uint32_t cascade(uint32_t level);
+static void runExpiredTimers(uint64_t targetTick);
+static uint8_t cascadesAt(uint64_t tick);
+static uint64_t nextEventTick();
+static void armTickSource();
+static void *timerThreadFunction();
+static void clockAdvanced();
+
+timerControllerStatus timerControllerInit(timerControllerMode mode)
+{
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_timer_threads_started_total", "Timer threads started", &threadsStartedMetric);
+    metricsRegister(METRICS_TYPE_COUNTER, "tv_timer_callbacks_total", "Timer callbacks run", &callbacksMetric);
+    metricsRegister(METRICS_TYPE_GAUGE, "tv_timers_pending", "Timers armed and not yet expired", &pendingMetric);
+
+    /* event loop must never block on a spurious wakeup */
+    if (virtualClockIsSimulated())
+    {
+        /* simulated time has no timerfd, every clock advance posts the eventfd instead */
+        timerFileDesc = eventfd(0, EFD_CLOEXEC | (mode == TIMER_CONTROLLER_EXTERNAL_LOOP ? EFD_NONBLOCK : 0));
+        virtualClockAddListener(clockAdvanced);
+    }
+    else
+    {
+        timerFileDesc = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | (mode == TIMER_CONTROLLER_EXTERNAL_LOOP ? TFD_NONBLOCK : 0));
+    }
+    if (timerFileDesc == -1)
+    {
+        printf("Error while creating timer file descriptor!\n");
+        return TIMER_CONTROLLER_ERROR;
+    }
+
+    wheelTick = currentTick();
+    armedTick = 0;
+    timerMode = mode;
+    timerThreadRunning = 1;
+    if (mode == TIMER_CONTROLLER_EXTERNAL_LOOP)
+    {
+        return TIMER_CONTROLLER_NO_ERROR;
+    }
+
+    if (pthread_create(&timerThread, NULL, timerThreadFunction, NULL))
+    {
+        timerThreadRunning = 0;
+        close(timerFileDesc);
+        timerFileDesc = -1;
+        return TIMER_CONTROLLER_ERROR;
+    }
+    metricsAdd(threadsStartedMetric, 1);
+
+    return TIMER_CONTROLLER_NO_ERROR;
+}
+
+timerControllerStatus timerControllerDeinit()
 {
-    struct sigevent signalEvent;
     struct itimerspec timerSpec;
+    uint32_t level;
+    uint32_t slot;
 
-    /* tell OS to send notification by calling specific function from specific thread*/
-    signalEvent.sigev_notify = SIGEV_THREAD;
+    if (timerFileDesc == -1)
+    {
+        return TIMER_CONTROLLER_ERROR;
+    }
 
-    /* function which OS will call when interval expires */
-    signalEvent.sigev_notify_function = callback;
+    /* wake the timer thread up immediately so it can see the stop request */
+    pthread_mutex_lock(&timerMutex);
+    timerThreadRunning = 0;
+    if (timerMode == TIMER_CONTROLLER_OWN_THREAD && virtualClockIsSimulated())
+    {
+        uint64_t one = 1;
 
-    /* function arguments */
-    signalEvent.sigev_value.sival_ptr = NULL;
+        if (write(timerFileDesc, &one, sizeof(one)) != sizeof(one))
+        {
+            printf("Error while waking the timer thread!\n");
+        }
+    }
+    else if (timerMode == TIMER_CONTROLLER_OWN_THREAD)
+    {
+        memset(&timerSpec, 0, sizeof(timerSpec));
+        timerSpec.it_value.tv_nsec = 1;
+        timerfd_settime(timerFileDesc, 0, &timerSpec, NULL);
+    }
+    pthread_mutex_unlock(&timerMutex);
 
-    /* thread attributes - if NULL default attributes are applied */
-    signalEvent.sigev_notify_attributes = NULL;
+    if (timerMode == TIMER_CONTROLLER_OWN_THREAD)
+    {
+        pthread_join(timerThread, NULL);
+    }
 
-    /*parameters: system clock for time measurement, timer setup, where to put new timer ID*/
-    timer_create(CLOCK_REALTIME, &signalEvent, timerId);
+    pthread_mutex_lock(&timerMutex);
+    for (level = 0; level < WHEEL_LEVELS; level++)
+    {
+        for (slot = 0; slot < WHEEL_SIZE; slot++)
+        {
+            while (wheel[level][slot])
+            {
+                removeTimer(wheel[level][slot]);
+            }
+        }
+    }
+    close(timerFileDesc);
+    timerFileDesc = -1;
+    pthread_mutex_unlock(&timerMutex);
 
-    memset(&timerSpec, 0, sizeof(timerSpec));
-    /* timer initial value */
-    timerSpec.it_value.tv_sec = triggerSec;
-    timerSpec.it_value.tv_nsec = 0;
+    return TIMER_CONTROLLER_NO_ERROR;
+}
+
+int32_t timerControllerFileDesc()
+{
+    return timerFileDesc;
+}
+
+void timerControllerProcess()
+{
+    uint64_t expirations;
+
+    if (read(timerFileDesc, &expirations, sizeof(expirations)) != sizeof(expirations))
+    {
+        return;
+    }
+
+    runExpiredTimers(currentTick());
+}
+
+void timerSetAndStart(timerHandle *timerId, time_t triggerSec, timerCallback callback)
+{
+    timerSetAndStartMs(timerId, triggerSec * 1000, callback);
+}
+
+void timerSetAndStartMs(timerHandle *timerId, uint32_t triggerMs, timerCallback callback)
+{
+    uint64_t ticks = (triggerMs + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+
+    pthread_mutex_lock(&timerMutex);
+
+    if (timerId->pprev)
+    {
+        removeTimer(timerId);
+    }
+
+    /* the wheel is not advanced while empty, move it to the current tick before adding */
+    if (pendingTimers == 0)
+    {
+        wheelTick = currentTick();
+    }
+
+    timerId->callback = callback;
+    timerId->expiry = currentTick() + (ticks ? ticks : 1);
+    addTimer(timerId);
+    timersArmed++;
+
+    pthread_mutex_unlock(&timerMutex);
+}
+
+void timerStopAndDelete(timerHandle *timerId)
+{
+    pthread_mutex_lock(&timerMutex);
+    if (timerId->pprev)
+    {
+        removeTimer(timerId);
+    }
+    pthread_mutex_unlock(&timerMutex);
+}
+
+uint8_t timerIsArmed(timerHandle *timerId)
+{
+    uint8_t armed;
+
+    pthread_mutex_lock(&timerMutex);
+    armed = timerId->pprev != NULL;
+    pthread_mutex_unlock(&timerMutex);
+
+    return armed;
+}
+
+void timerGetStatistics(uint64_t *armed, uint64_t *fired)
+{
+    pthread_mutex_lock(&timerMutex);
+    *armed = timersArmed;
+    *fired = timersFired;
+    pthread_mutex_unlock(&timerMutex);
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for reading monotonic time in wheel ticks.
+ *
+ * @return   Current tick.
+****************************************************************************/
+static uint64_t currentTick()
+{
+    return virtualClockNowNs() / 1000000 / TIMER_TICK_MS;
+}
+
+/****************************************************************************
+ * @brief    Function for adding a timer to the wheel and moving the wake up earlier if it expires first. Called with the mutex held.
+ *
+ * @param    timer - [in] Timer to add.
+****************************************************************************/
+static void addTimer(timerHandle *timer)
+{
+    linkTimer(timer);
+
+    pendingTimers++;
+    armTickSource();
+    metricsSet(pendingMetric, pendingTimers);
+}
+
+/****************************************************************************
+ * @brief    Function for linking a timer into the wheel slot of its expiry. Called with the mutex held.
+ *           Timers expiring within WHEEL_SIZE ticks go to the first level, every next level
+ *           covers WHEEL_SIZE times longer range and is cascaded down as the wheel turns.
+ *
+ * @param    timer - [in] Timer to add.
+****************************************************************************/
+static void linkTimer(timerHandle *timer)
+{
+    int64_t delta = (int64_t)(timer->expiry - wheelTick);
+    timerHandle **slot;
+    uint32_t level;
+
+    if (delta < 0)
+    {
+        /* already expired, fire at the next processed tick */
+        slot = &wheel[0][wheelTick & WHEEL_MASK];
+    }
+    else
+    {
+        if ((uint64_t)delta > WHEEL_MAX_TICKS)
+        {
+            timer->expiry = wheelTick + WHEEL_MAX_TICKS;
+            delta = WHEEL_MAX_TICKS;
+        }
+
+        for (level = 0; level < WHEEL_LEVELS - 1; level++)
+        {
+            if ((uint64_t)delta < (1ULL << (WHEEL_BITS * (level + 1))))
+            {
+                break;
+            }
+        }
+        slot = &wheel[level][(timer->expiry >> (WHEEL_BITS * level)) & WHEEL_MASK];
+    }
+
+    timer->next = *slot;
+    if (timer->next)
+    {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = slot;
+    *slot = timer;
+}
+
+/****************************************************************************
+ * @brief    Function for unlinking a timer from its wheel slot. Called with the mutex held.
+ *
+ * @param    timer - [in] Armed timer to remove.
+****************************************************************************/
+static void removeTimer(timerHandle *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next)
+    {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+
+    /* a wake up left for a removed timer only finds nothing to do */
+    if (--pendingTimers == 0)
+    {
+        armTickSource();
+    }
+    metricsSet(pendingMetric, pendingTimers);
+}
+
+/****************************************************************************
+ * @brief    Function for moving timers of the current slot of a level to lower levels. Called with the mutex held.
+ *
+ * @param    level - [in] Wheel level to cascade from.
+ *
+ * @return   Index of the cascaded slot, 0 means the level wrapped and the next level has to be cascaded too.
+****************************************************************************/
+static uint32_t cascade(uint32_t level)
+{
+    uint32_t index = (wheelTick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    timerHandle *timer = wheel[level][index];
+
+    wheel[level][index] = NULL;
+    while (timer)
+    {
+        timerHandle *next = timer->next;
+        linkTimer(timer);
+        timer = next;
+    }
+
+    return index;
+}
+
+/****************************************************************************
+ * @brief    Function for turning the wheel up to the passed tick and running expired timers.
+ *           Callbacks are called without the mutex held, so they may arm and stop timers.
+ *
+ * @param    targetTick - [in] Last tick to process.
+****************************************************************************/
+static void runExpiredTimers(uint64_t targetTick)
+{
+    pthread_mutex_lock(&timerMutex);
+
+    while (pendingTimers && (int64_t)(targetTick - wheelTick) >= 0)
+    {
+        uint32_t index = wheelTick & WHEEL_MASK;
+        uint32_t level;
+        timerHandle **slot = &wheel[0][index];
+
+        /* first level wrapped, bring the timers of the next range down */
+        for (level = 1; !index && level < WHEEL_LEVELS; level++)
+        {
+            index = cascade(level);
+        }
+        wheelTick++;
+
+        while (*slot)
+        {
+            timerHandle *timer = *slot;
+            timerCallback callback = timer->callback;
+
+            removeTimer(timer);
+            timersFired++;
+
+            pthread_mutex_unlock(&timerMutex);
+            TRACE_BEGIN("timer callback");
+            callback();
+            TRACE_END("timer callback");
+            metricsAdd(callbacksMetric, 1);
+            pthread_mutex_lock(&timerMutex);
+        }
+    }
+
+    TRACE_COUNTER("pending timers", pendingTimers);
+
+    /* nothing is pending, keep the wheel in sync with the clock */
+    if (!pendingTimers && (int64_t)(targetTick - wheelTick) >= 0)
+    {
+        wheelTick = targetTick + 1;
+    }
+    armTickSource();
+
+    pthread_mutex_unlock(&timerMutex);
+}
+
+/****************************************************************************
+ * @brief    Function for checking if the wheel cascades a non-empty slot when it reaches a tick. Called with the mutex held.
+ *
+ * @param    tick - [in] Tick to check.
+ *
+ * @return   1 if timers are moved to lower levels at the tick, 0 otherwise.
+****************************************************************************/
+static uint8_t cascadesAt(uint64_t tick)
+{
+    uint32_t level;
+
+    /* a level is cascaded when every level below it wraps */
+    for (level = 1; level < WHEEL_LEVELS && !(tick & ((1ULL << (WHEEL_BITS * level)) - 1)); level++)
+    {
+        if (wheel[level][(tick >> (WHEEL_BITS * level)) & WHEEL_MASK])
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/****************************************************************************
+ * @brief    Function for finding the first tick the wheel has work at, a non-empty first level slot
+ *           or a cascade of a non-empty slot. Called with the mutex held.
+ *
+ * @return   Tick to wake up at, at most one turn of the second level ahead.
+****************************************************************************/
+static uint64_t nextEventTick()
+{
+    uint64_t tick;
+    uint32_t i;
 
-    /* arms or disarms the timer identified by timerId */
-    timer_settime(*timerId, 0, &timerSpec, NULL);
+    /* first level slots hold the timers of the next WHEEL_SIZE ticks */
+    for (tick = wheelTick; tick < wheelTick + WHEEL_SIZE; tick++)
+    {
+        if (wheel[0][tick & WHEEL_MASK] || (!(tick & WHEEL_MASK) && cascadesAt(tick)))
+        {
+            return tick;
+        }
+    }
+
+    /* later timers only come down at slot boundaries, waking at the last one checked is harmless */
+    tick = (tick + WHEEL_MASK) & ~(uint64_t)WHEEL_MASK;
+    for (i = 0; i < WHEEL_SIZE - 1 && !cascadesAt(tick); i++)
+    {
+        tick += WHEEL_SIZE;
+    }
+
+    return tick;
 }
 
-void timerStopAndDelete(timer_t *timerId)
+/****************************************************************************
+ * @brief    Function for arming the timerfd once, at the next tick with work, or disarming it when
+ *           no timer is pending. Called with the mutex held.
+****************************************************************************/
+static void armTickSource()
 {
     struct itimerspec timerSpec;
+    uint64_t tick;
+    uint64_t tickNs;
+
+    if (timerFileDesc == -1 || !timerThreadRunning || virtualClockIsSimulated())
+    {
+        return;
+    }
+
+    tick = pendingTimers ? nextEventTick() : 0;
+    if (tick == armedTick)
+    {
+        return;
+    }
+
+    /* an absolute time already passed expires at once */
     memset(&timerSpec, 0, sizeof(timerSpec));
-    timer_settime(timerId, 0, &timerSpec, NULL);
-    timer_delete(*timerId);
+    if (tick)
+    {
+        tickNs = tick * TIMER_TICK_MS * 1000000ULL;
+        timerSpec.it_value.tv_sec = tickNs / 1000000000ULL;
+        timerSpec.it_value.tv_nsec = tickNs % 1000000000ULL;
+    }
+    timerfd_settime(timerFileDesc, TFD_TIMER_ABSTIME, &timerSpec, NULL);
+    armedTick = tick;
+}
+
+/****************************************************************************
+ * @brief    Function executed by the timer thread, turns the wheel on every timerfd expiration.
+****************************************************************************/
+static void *timerThreadFunction()
+{
+    uint64_t expirations;
+
+    while (timerThreadRunning)
+    {
+        if (read(timerFileDesc, &expirations, sizeof(expirations)) != sizeof(expirations))
+        {
+            continue;
+        }
+
+        if (!timerThreadRunning)
+        {
+            break;
+        }
+
+        /* missed ticks are caught up by processing every tick up to the current one */
+        runExpiredTimers(currentTick());
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function called when simulated time advances, wakes whoever turns the wheel.
+****************************************************************************/
+static void clockAdvanced()
+{
+    uint64_t one = 1;
+
+    if (timerFileDesc == -1 || !timerThreadRunning)
+    {
+        return;
+    }
+
+    if (write(timerFileDesc, &one, sizeof(one)) != sizeof(one))
+    {
+        printf("Error while posting simulated clock tick!\n");
+    }
 }
+/* -------------------- HELPER FUNCTIONS -------------------- */
@@ -9,7 +9,9 @@
  * \file timer_controller.h
  *
  * \brief
- * Header of the module for timers.
+ * Header of the module for timers. All timers are kept in a hierarchical timing wheel
+ * driven by one CLOCK_MONOTONIC timerfd. Callbacks run either on the timer thread or,
+ * when the timerfd is watched by an event loop, on the loop thread calling timerControllerProcess.
  *
  * Last updated on 4 June 2018
  *
@@ -19,22 +21,108 @@
 #ifndef _TIMER_CONTROLLER_H_
 #define _TIMER_CONTROLLER_H_
 
+#include <stdint.h>
 #include <time.h>
 
+/* timing wheel resolution */
+#define TIMER_TICK_MS 10
+
+typedef enum _timerControllerStatus
+{
+    TIMER_CONTROLLER_NO_ERROR = 0,
+    TIMER_CONTROLLER_ERROR
+} timerControllerStatus;
+
+typedef enum _timerControllerMode
+{
+    TIMER_CONTROLLER_OWN_THREAD = 0, // timer thread reads the timerfd
+    TIMER_CONTROLLER_EXTERNAL_LOOP   // caller watches timerControllerFileDesc and calls timerControllerProcess
+} timerControllerMode;
+
+typedef void (*timerCallback)();
+
+/* timer handle, embedded in the module owning the timer, must be zero initialized */
+typedef struct _timerHandle
+{
+    struct _timerHandle *next;
+    struct _timerHandle **pprev; // NULL while the timer is not armed
+    uint64_t expiry;             // wheel tick at which the timer fires
+    timerCallback callback;
+} timerHandle;
+
+/****************************************************************************
+ * @brief    Function for timer controller initialization. Timers follow the clock module,
+ *           in simulated mode they expire only when the simulated clock is advanced.
+ *
+ * @param    mode - [in] TIMER_CONTROLLER_OWN_THREAD to start the timer thread,
+ *                       TIMER_CONTROLLER_EXTERNAL_LOOP if the timerfd is read by an event loop.
+ *
+ * @return   TIMER_CONTROLLER_NO_ERROR, if there are no errors.
+ *           TIMER_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+timerControllerStatus timerControllerInit(timerControllerMode mode);
+
+/****************************************************************************
+ * @brief    Function for timer controller deinitialization. Pending timers are dropped.
+ *
+ * @return   TIMER_CONTROLLER_NO_ERROR, if there are no errors.
+ *           TIMER_CONTROLLER_ERROR, in case of an error.
+****************************************************************************/
+timerControllerStatus timerControllerDeinit();
+
 /****************************************************************************
- * @brief    Function for timer initialization.
+ * @brief    Function for getting the timerfd, readable whenever the wheel has to be turned.
  *
- * @param    timerId - [in] Pointer to timer variable.
+ * @return   Timer file descriptor, -1 if the module is not initialized.
+****************************************************************************/
+int32_t timerControllerFileDesc();
+
+/****************************************************************************
+ * @brief    Function for turning the wheel and running expired timers in TIMER_CONTROLLER_EXTERNAL_LOOP mode.
+ *           Called from the event loop when the timerfd is readable.
+****************************************************************************/
+void timerControllerProcess();
+
+/****************************************************************************
+ * @brief    Function for arming a timer. An armed timer is re-armed with the new timeout.
+ *
+ * @param    timerId - [in] Pointer to timer handle.
  *           triggerSec - [in] Number of seconds after which timer should trigger.
  *           callback - [in] Pointer to function that should execute on timer trigger.
 ****************************************************************************/
-void timerSetAndStart(timer_t *timerId, time_t triggerSec, void *callback);
+void timerSetAndStart(timerHandle *timerId, time_t triggerSec, timerCallback callback);
+
+/****************************************************************************
+ * @brief    Function for arming a timer with millisecond timeout, rounded up to TIMER_TICK_MS.
+ *
+ * @param    timerId - [in] Pointer to timer handle.
+ *           triggerMs - [in] Number of milliseconds after which timer should trigger.
+ *           callback - [in] Pointer to function that should execute on timer trigger.
+****************************************************************************/
+void timerSetAndStartMs(timerHandle *timerId, uint32_t triggerMs, timerCallback callback);
+
+/****************************************************************************
+ * @brief    Function for stopping a timer. Does nothing if the timer is not armed.
+ *
+ * @param    timerId - [in] Pointer to timer handle.
+****************************************************************************/
+void timerStopAndDelete(timerHandle *timerId);
+
+/****************************************************************************
+ * @brief    Function for checking whether a timer is armed.
+ *
+ * @param    timerId - [in] Pointer to timer handle.
+ *
+ * @return   1 if the timer is armed, 0 otherwise.
+****************************************************************************/
+uint8_t timerIsArmed(timerHandle *timerId);
 
 /****************************************************************************
- * @brief    Function for timer deinitialization.
+ * @brief    Function for reading timer statistics.
  *
- * @param    timerId - [in] Pointer to timer variable.
+ * @param    armed - [out] Number of times timers were armed.
+ *           fired - [out] Number of timer callbacks executed.
 ****************************************************************************/
-void timerStopAndDelete(timer_t *timerId);
+void timerGetStatistics(uint64_t *armed, uint64_t *fired);
 
 #endif
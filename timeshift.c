@@ -0,0 +1,617 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file timeshift.c
+ *
+ * \brief
+ * Implementation of the timeshift module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "timeshift.h"
+#include "ts_input.h"
+#include "virtual_clock.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* helper keywords needed only for timeshift module */
+#define LIVE_WAIT_NS 10000000ULL // real time playback waiting for the capture
+
+/* helper variables needed only for timeshift module */
+static uint8_t *buffer;         // bufferSize bytes mapped twice in a row, a packet at any offset is contiguous
+static uint32_t bufferSize;
+static uint64_t capacity;       // packets the buffer holds, writing packet p + capacity overwrites packet p
+static uint64_t *arrivalIndex;  // arrival time of every TIMESHIFT_INDEX_PACKETS-th packet
+static uint64_t indexEntries;
+
+/* written by the packet source only, a packet p is intact while claimed <= p + capacity */
+static uint64_t claimed;        // packets whose writing has started
+static uint64_t head;           // packets completely written
+static uint64_t oldest;         // first packet of the current service
+static uint64_t lastArrivalNs;
+static uint32_t capturedGeneration;
+static uint8_t capturePids[TS_PID_COUNT];
+static uint32_t serviceGeneration; // incremented by timeshiftSetService, the packet source then forgets the window
+
+/* guarded by controlMutex, the packet source never takes it */
+static pthread_mutex_t controlMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t controlCondition; // initialized on CLOCK_MONOTONIC by timeshiftInit
+static uint16_t servicePids[TIMESHIFT_MAX_PIDS];
+static uint32_t servicePidCount;
+static timeshiftState state;
+static uint32_t controlGeneration; // incremented by every control call, a batch read across one is discarded
+static uint64_t cursor;            // next packet to play
+static uint64_t anchorNs;          // time playback (re)started at the anchor packet
+static uint64_t anchorArrivalNs;   // arrival time of the anchor packet
+static uint8_t anchorPending;      // the playback clock restarts once the cursor packet is captured
+static uint64_t playedPackets;
+static uint64_t overruns;
+static uint8_t playbackRunning;
+static pthread_t playbackThread;
+static timeshiftSink playbackSink;
+
+static const char *stateNames[] = {"live", "paused", "playing", "catching up"};
+
+/* helper functions needed only for timeshift module */
+static void *playbackWorker(void *arg);
+static uint64_t windowStart();
+static uint64_t packetArrival(uint64_t position);
+static uint64_t findPacket(uint64_t arrivalNs, uint64_t start, uint64_t end);
+static void anchorPlayback();
+static int64_t delayNanoseconds();
+static int64_t overrunsTotal();
+
+timeshiftStatus timeshiftInit(uint32_t size, timeshiftSink sink)
+{
+    char path[PATH_MAX];
+    long pageSize = sysconf(_SC_PAGESIZE);
+    int32_t fileDesc;
+    uint8_t *mapping;
+
+    if (virtualClockConditionInit(&controlCondition))
+    {
+        LOG_ERROR("Error while initializing the timeshift condition!");
+        return TIMESHIFT_ERROR;
+    }
+
+    size = (size + pageSize - 1) / pageSize * pageSize;
+    snprintf(path, sizeof(path), "%s/tv_app_timeshift_%d.buf", TIMESHIFT_DIRECTORY, (int)getpid());
+    fileDesc = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fileDesc < 0)
+    {
+        LOG_ERROR("Error while creating the timeshift buffer %s!", path);
+        return TIMESHIFT_ERROR;
+    }
+
+    /* the buffer lives as long as it is mapped, nothing is left behind after a crash */
+    unlink(path);
+    if (ftruncate(fileDesc, size))
+    {
+        close(fileDesc);
+        LOG_ERROR("Error while sizing the timeshift buffer!");
+        return TIMESHIFT_ERROR;
+    }
+
+    /* reserve twice the size, then map the file over both halves */
+    mapping = mmap(NULL, 2 * (size_t)size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED ||
+        mmap(mapping, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fileDesc, 0) == MAP_FAILED ||
+        mmap(mapping + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fileDesc, 0) == MAP_FAILED)
+    {
+        if (mapping != MAP_FAILED)
+        {
+            munmap(mapping, 2 * (size_t)size);
+        }
+        close(fileDesc);
+        LOG_ERROR("Error while mapping the timeshift buffer!");
+        return TIMESHIFT_ERROR;
+    }
+    close(fileDesc);
+
+    bufferSize = size;
+    capacity = size / TS_PACKET_SIZE;
+    /* the index slot of a group is reused only after every packet of the group was overwritten */
+    indexEntries = capacity / TIMESHIFT_INDEX_PACKETS + 2;
+    arrivalIndex = (uint64_t *)calloc(indexEntries, sizeof(uint64_t));
+    if (!arrivalIndex)
+    {
+        munmap(mapping, 2 * (size_t)size);
+        return TIMESHIFT_ERROR;
+    }
+
+    claimed = 0;
+    head = 0;
+    oldest = 0;
+    state = TIMESHIFT_LIVE;
+    cursor = 0;
+    playedPackets = 0;
+    overruns = 0;
+    playbackSink = sink;
+    buffer = mapping;
+
+    playbackRunning = 1;
+    if (pthread_create(&playbackThread, NULL, playbackWorker, NULL))
+    {
+        playbackRunning = 0;
+        timeshiftDeinit();
+        LOG_ERROR("Error while starting the timeshift playback thread!");
+        return TIMESHIFT_ERROR;
+    }
+
+    metricsRegisterCallback(METRICS_TYPE_GAUGE, "tv_timeshift_delay_nanoseconds", "How far timeshift playback is behind live", delayNanoseconds);
+    metricsRegisterCallback(METRICS_TYPE_COUNTER, "tv_timeshift_overruns_total", "Times the paused or played position was overwritten by the capture", overrunsTotal);
+
+    return TIMESHIFT_NO_ERROR;
+}
+
+void timeshiftDeinit()
+{
+    uint32_t i;
+
+    pthread_mutex_lock(&controlMutex);
+    for (i = 0; i < servicePidCount; i++)
+    {
+        __atomic_store_n(&capturePids[servicePids[i]], 0, __ATOMIC_RELAXED);
+    }
+    servicePidCount = 0;
+    pthread_mutex_unlock(&controlMutex);
+
+    if (playbackRunning)
+    {
+        pthread_mutex_lock(&controlMutex);
+        playbackRunning = 0;
+        pthread_cond_broadcast(&controlCondition);
+        pthread_mutex_unlock(&controlMutex);
+        pthread_join(playbackThread, NULL);
+    }
+
+    if (buffer)
+    {
+        munmap(buffer, 2 * (size_t)bufferSize);
+        buffer = NULL;
+    }
+    free(arrivalIndex);
+    arrivalIndex = NULL;
+}
+
+void timeshiftSetService(const uint16_t *pids, uint32_t count)
+{
+    uint32_t i;
+
+    if (count > TIMESHIFT_MAX_PIDS)
+    {
+        count = TIMESHIFT_MAX_PIDS;
+    }
+
+    pthread_mutex_lock(&controlMutex);
+    if (!buffer || (count == servicePidCount && !memcmp(pids, servicePids, count * sizeof(uint16_t))))
+    {
+        /* streams kept across the zap, so is the buffer */
+        pthread_mutex_unlock(&controlMutex);
+        return;
+    }
+
+    for (i = 0; i < servicePidCount; i++)
+    {
+        __atomic_store_n(&capturePids[servicePids[i]], 0, __ATOMIC_RELAXED);
+    }
+    for (i = 0; i < count; i++)
+    {
+        servicePids[i] = pids[i];
+        __atomic_store_n(&capturePids[pids[i] % TS_PID_COUNT], 1, __ATOMIC_RELAXED);
+    }
+    servicePidCount = count;
+    __atomic_add_fetch(&serviceGeneration, 1, __ATOMIC_RELEASE);
+
+    state = TIMESHIFT_LIVE;
+    controlGeneration++;
+    pthread_cond_broadcast(&controlCondition);
+    pthread_mutex_unlock(&controlMutex);
+}
+
+void timeshiftPacket(uint16_t pid, const uint8_t *packet, uint64_t arrivalNs)
+{
+    uint32_t generation = __atomic_load_n(&serviceGeneration, __ATOMIC_ACQUIRE);
+    uint64_t position = head;
+
+    if (generation != capturedGeneration)
+    {
+        /* the window starts over with the new service */
+        capturedGeneration = generation;
+        __atomic_store_n(&oldest, position, __ATOMIC_RELEASE);
+    }
+
+    if (!__atomic_load_n(&capturePids[pid], __ATOMIC_RELAXED))
+    {
+        return;
+    }
+
+    /* readers see the claim before any byte of the packet it overwrites changes */
+    __atomic_store_n(&claimed, position + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(&buffer[position * TS_PACKET_SIZE % bufferSize], packet, TS_PACKET_SIZE);
+    if (position % TIMESHIFT_INDEX_PACKETS == 0)
+    {
+        __atomic_store_n(&arrivalIndex[position / TIMESHIFT_INDEX_PACKETS % indexEntries], arrivalNs, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&lastArrivalNs, arrivalNs, __ATOMIC_RELAXED);
+    __atomic_store_n(&head, position + 1, __ATOMIC_RELEASE);
+}
+
+timeshiftStatus timeshiftPause()
+{
+    uint64_t end;
+
+    pthread_mutex_lock(&controlMutex);
+    end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    if (state == TIMESHIFT_PAUSED || end == windowStart())
+    {
+        pthread_mutex_unlock(&controlMutex);
+        return TIMESHIFT_ERROR;
+    }
+
+    if (state == TIMESHIFT_LIVE)
+    {
+        cursor = end;
+    }
+    state = TIMESHIFT_PAUSED;
+    controlGeneration++;
+    pthread_cond_broadcast(&controlCondition);
+    pthread_mutex_unlock(&controlMutex);
+
+    return TIMESHIFT_NO_ERROR;
+}
+
+timeshiftStatus timeshiftResume()
+{
+    pthread_mutex_lock(&controlMutex);
+    if (state == TIMESHIFT_LIVE)
+    {
+        pthread_mutex_unlock(&controlMutex);
+        return TIMESHIFT_ERROR;
+    }
+
+    state = TIMESHIFT_PLAYING;
+    anchorPlayback();
+    controlGeneration++;
+    pthread_cond_broadcast(&controlCondition);
+    pthread_mutex_unlock(&controlMutex);
+
+    return TIMESHIFT_NO_ERROR;
+}
+
+timeshiftStatus timeshiftSeek(int32_t offsetSeconds)
+{
+    uint64_t end;
+    uint64_t start;
+    uint64_t from;
+    int64_t targetNs;
+    uint64_t target;
+
+    pthread_mutex_lock(&controlMutex);
+    end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    start = windowStart();
+    if (end == start)
+    {
+        pthread_mutex_unlock(&controlMutex);
+        return TIMESHIFT_ERROR;
+    }
+
+    from = state == TIMESHIFT_LIVE || cursor >= end ? end : cursor < start ? start : cursor;
+    targetNs = (int64_t)(from < end ? packetArrival(from) : __atomic_load_n(&lastArrivalNs, __ATOMIC_RELAXED)) +
+               (int64_t)offsetSeconds * 1000000000LL;
+    target = targetNs <= 0 ? start : findPacket(targetNs, start, end);
+
+    if (target >= end)
+    {
+        state = TIMESHIFT_LIVE;
+    }
+    else
+    {
+        cursor = target;
+        if (state == TIMESHIFT_LIVE)
+        {
+            state = TIMESHIFT_PLAYING;
+        }
+        anchorPlayback();
+    }
+    controlGeneration++;
+    pthread_cond_broadcast(&controlCondition);
+    pthread_mutex_unlock(&controlMutex);
+
+    return TIMESHIFT_NO_ERROR;
+}
+
+timeshiftStatus timeshiftCatchUp()
+{
+    pthread_mutex_lock(&controlMutex);
+    if (state == TIMESHIFT_LIVE)
+    {
+        pthread_mutex_unlock(&controlMutex);
+        return TIMESHIFT_ERROR;
+    }
+
+    state = TIMESHIFT_CATCHING_UP;
+    anchorPlayback();
+    controlGeneration++;
+    pthread_cond_broadcast(&controlCondition);
+    pthread_mutex_unlock(&controlMutex);
+
+    return TIMESHIFT_NO_ERROR;
+}
+
+void timeshiftGetStatistics(timeshiftStatistics *statistics)
+{
+    uint64_t end;
+    uint64_t start;
+    uint64_t lastNs;
+
+    pthread_mutex_lock(&controlMutex);
+    end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    start = windowStart();
+    lastNs = __atomic_load_n(&lastArrivalNs, __ATOMIC_RELAXED);
+
+    statistics->state = state;
+    statistics->capturedPackets = end;
+    statistics->playedPackets = playedPackets;
+    statistics->overruns = overruns;
+    statistics->bufferBytes = bufferSize;
+    statistics->windowNs = end > start ? lastNs - packetArrival(start) : 0;
+    statistics->delayNs = 0;
+    if (state != TIMESHIFT_LIVE && cursor < end)
+    {
+        statistics->delayNs = lastNs - packetArrival(cursor < start ? start : cursor);
+    }
+    pthread_mutex_unlock(&controlMutex);
+}
+
+void timeshiftPrintStatistics()
+{
+    timeshiftStatistics statistics;
+
+    if (!buffer)
+    {
+        return;
+    }
+
+    timeshiftGetStatistics(&statistics);
+    printf("\nTimeshift %s: %.1f s buffered in %u MiB, %.1f s behind live, %llu packets captured, %llu played, %llu overruns\n",
+           stateNames[statistics.state], statistics.windowNs / 1e9, statistics.bufferBytes >> 20, statistics.delayNs / 1e9,
+           (unsigned long long)statistics.capturedPackets, (unsigned long long)statistics.playedPackets,
+           (unsigned long long)statistics.overruns);
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for playing packets from the cursor to the sink while playback is not live
+ *           or paused. Packets are copied out of the buffer before they are checked against the
+ *           capture, so a packet overwritten during the copy is never passed on.
+ *
+ * @param    arg - [in] Unused.
+ *
+ * @return   NULL.
+****************************************************************************/
+static void *playbackWorker(void *arg)
+{
+    uint8_t packets[TIMESHIFT_PLAYBACK_PACKETS * TS_PACKET_SIZE];
+    timeshiftState lastState = TIMESHIFT_LIVE;
+    uint64_t end;
+    uint64_t start;
+    uint64_t dueNs;
+    uint64_t position;
+    uint32_t count;
+    uint32_t generation;
+    uint8_t intact;
+
+    pthread_mutex_lock(&controlMutex);
+    while (playbackRunning)
+    {
+        if (state == TIMESHIFT_LIVE && lastState != TIMESHIFT_LIVE)
+        {
+            /* the player goes back to the tuner */
+            lastState = state;
+            pthread_mutex_unlock(&controlMutex);
+            if (playbackSink)
+            {
+                playbackSink(NULL, 0);
+            }
+            pthread_mutex_lock(&controlMutex);
+            continue;
+        }
+        lastState = state;
+
+        if (state == TIMESHIFT_LIVE || state == TIMESHIFT_PAUSED)
+        {
+            pthread_cond_wait(&controlCondition, &controlMutex);
+            continue;
+        }
+
+        end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+        start = windowStart();
+        if (cursor < start)
+        {
+            /* played further behind than the buffer holds */
+            anchorPlayback();
+        }
+
+        if (cursor >= end)
+        {
+            if (state == TIMESHIFT_CATCHING_UP)
+            {
+                state = TIMESHIFT_LIVE;
+            }
+            else
+            {
+                virtualClockTimedWait(&controlCondition, &controlMutex, virtualClockNowNs() + LIVE_WAIT_NS);
+            }
+            continue;
+        }
+
+        if (anchorPending)
+        {
+            anchorPending = 0;
+            anchorNs = virtualClockNowNs();
+            anchorArrivalNs = packetArrival(cursor);
+        }
+
+        /* packets are passed on when the playback clock reaches their arrival time */
+        dueNs = anchorNs;
+        if (packetArrival(cursor) > anchorArrivalNs)
+        {
+            dueNs += (packetArrival(cursor) - anchorArrivalNs) * 100 /
+                     (state == TIMESHIFT_CATCHING_UP ? TIMESHIFT_CATCH_UP_PERCENT : 100);
+        }
+        if (dueNs > virtualClockNowNs())
+        {
+            virtualClockTimedWait(&controlCondition, &controlMutex, dueNs);
+            continue;
+        }
+
+        count = end - cursor < TIMESHIFT_PLAYBACK_PACKETS ? end - cursor : TIMESHIFT_PLAYBACK_PACKETS;
+        position = cursor;
+        generation = controlGeneration;
+        pthread_mutex_unlock(&controlMutex);
+
+        memcpy(packets, &buffer[position * TS_PACKET_SIZE % bufferSize], count * TS_PACKET_SIZE);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        intact = __atomic_load_n(&claimed, __ATOMIC_RELAXED) <= position + capacity;
+        if (intact && playbackSink)
+        {
+            playbackSink(packets, count);
+        }
+
+        pthread_mutex_lock(&controlMutex);
+        if (generation != controlGeneration)
+        {
+            /* the cursor was moved while the packets were copied */
+            continue;
+        }
+        if (!intact)
+        {
+            /* the capture overtook the copy, the cursor is moved to the oldest packet by the next pass */
+            overruns++;
+            continue;
+        }
+        cursor = position + count;
+        playedPackets += count;
+    }
+    pthread_mutex_unlock(&controlMutex);
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for finding the oldest intact packet of the current service.
+ *
+ * @return   Packet position.
+****************************************************************************/
+static uint64_t windowStart()
+{
+    uint64_t written = __atomic_load_n(&claimed, __ATOMIC_ACQUIRE);
+    uint64_t first = __atomic_load_n(&oldest, __ATOMIC_ACQUIRE);
+
+    return written > capacity && written - capacity > first ? written - capacity : first;
+}
+
+/****************************************************************************
+ * @brief    Function for reading the arrival time of a packet, the arrival of the first packet of its index group.
+ *
+ * @param    position - [in] Packet position.
+ *
+ * @return   Arrival time in nanoseconds.
+****************************************************************************/
+static uint64_t packetArrival(uint64_t position)
+{
+    return __atomic_load_n(&arrivalIndex[position / TIMESHIFT_INDEX_PACKETS % indexEntries], __ATOMIC_RELAXED);
+}
+
+/****************************************************************************
+ * @brief    Function for finding the first packet arriving at or after a time, by binary search
+ *           over the arrival index.
+ *
+ * @param    arrivalNs - [in] Arrival time.
+ *           start - [in] First packet of the window.
+ *           end - [in] Packet after the last one of the window.
+ *
+ * @return   Packet position, end if every packet arrived earlier.
+****************************************************************************/
+static uint64_t findPacket(uint64_t arrivalNs, uint64_t start, uint64_t end)
+{
+    uint64_t middle;
+
+    while (start < end)
+    {
+        middle = start + (end - start) / 2;
+        if (packetArrival(middle) < arrivalNs)
+        {
+            start = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+
+    return start;
+}
+
+/****************************************************************************
+ * @brief    Function for restarting the playback clock at the cursor, moved to the oldest packet
+ *           if the capture has overwritten it. Called with controlMutex locked.
+****************************************************************************/
+static void anchorPlayback()
+{
+    uint64_t start = windowStart();
+
+    if (cursor < start)
+    {
+        cursor = start;
+        overruns++;
+    }
+
+    /* the cursor packet may not be captured yet, e.g. on resume right after pausing live */
+    anchorPending = 1;
+}
+
+/****************************************************************************
+ * @brief    Functions for reading timeshift values, called by the metrics server.
+ *
+ * @return   Metric value.
+****************************************************************************/
+static int64_t delayNanoseconds()
+{
+    timeshiftStatistics statistics;
+
+    timeshiftGetStatistics(&statistics);
+
+    return statistics.delayNs;
+}
+
+static int64_t overrunsTotal()
+{
+    int64_t total;
+
+    pthread_mutex_lock(&controlMutex);
+    total = overruns;
+    pthread_mutex_unlock(&controlMutex);
+
+    return total;
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
@@ -0,0 +1,154 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file timeshift.h
+ *
+ * \brief
+ * Header of the timeshift module. Packets of the playing service are captured continuously
+ * into a fixed size circular buffer, a file mapped twice in a row so packets wrapping around
+ * its end are contiguous. The packet source writes without locks and never waits; a playback
+ * thread reads from a cursor anywhere within the buffered window, detects packets overwritten
+ * while it copied them, and passes them to a sink paced by their arrival times. Playback can
+ * pause, jump back and catch up with live faster than real time.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _TIMESHIFT_H_
+#define _TIMESHIFT_H_
+
+#include <stdint.h>
+
+#define TIMESHIFT_DIRECTORY "/var/tmp"
+#define TIMESHIFT_BUFFER_SIZE (128 * 1024 * 1024) // about 4 minutes of a 4 Mbit/s service
+#define TIMESHIFT_MAX_PIDS 8
+#define TIMESHIFT_INDEX_PACKETS 64                // packets sharing one arrival time in the index
+#define TIMESHIFT_PLAYBACK_PACKETS 64             // packets passed to the sink at once
+#define TIMESHIFT_CATCH_UP_PERCENT 150            // playback speed while catching up with live
+#define TIMESHIFT_JUMP_SECONDS 10
+
+typedef enum _timeshiftStatus
+{
+    TIMESHIFT_NO_ERROR = 0,
+    TIMESHIFT_ERROR
+} timeshiftStatus;
+
+typedef enum _timeshiftState
+{
+    TIMESHIFT_LIVE = 0,    // the player decodes the tuner, packets are only captured
+    TIMESHIFT_PAUSED,      // the cursor stays, capture goes on
+    TIMESHIFT_PLAYING,     // real time playback at a constant delay behind live
+    TIMESHIFT_CATCHING_UP  // faster playback, back to live once the cursor reaches it
+} timeshiftState;
+
+/****************************************************************************
+ * @brief    Sink of played packets, called on the playback thread. A call with no packets
+ *           tells that playback has caught up and the player should decode live again.
+ *
+ * @param    packets - [in] Consecutive 188 byte packets, NULL when back to live.
+ *           count - [in] Number of packets.
+****************************************************************************/
+typedef void (*timeshiftSink)(const uint8_t *packets, uint32_t count);
+
+typedef struct _timeshiftStatistics
+{
+    timeshiftState state;
+    uint64_t capturedPackets;
+    uint64_t playedPackets;
+    uint64_t overruns;       // times the cursor was overtaken by the capture and moved to the oldest packet
+    uint64_t windowNs;       // time span held by the buffer
+    uint64_t delayNs;        // how far the cursor is behind live
+    uint32_t bufferBytes;
+} timeshiftStatistics;
+
+/****************************************************************************
+ * @brief    Function for timeshift initialization. Maps the buffer and starts the playback thread.
+ *
+ * @param    bufferSize - [in] Buffer size in bytes, rounded up to whole pages.
+ *           sink - [in] Receiver of played packets, NULL to only count them.
+ *
+ * @return   TIMESHIFT_NO_ERROR, if there are no errors.
+ *           TIMESHIFT_ERROR, if the buffer can not be mapped or the thread not started.
+****************************************************************************/
+timeshiftStatus timeshiftInit(uint32_t bufferSize, timeshiftSink sink);
+
+/****************************************************************************
+ * @brief    Function for timeshift deinitialization. Stops the playback thread and unmaps the buffer.
+****************************************************************************/
+void timeshiftDeinit();
+
+/****************************************************************************
+ * @brief    Function for choosing the PIDs to capture, called when the playing service changes.
+ *           A different set of PIDs empties the buffer and returns playback to live.
+ *
+ * @param    pids - [in] PIDs of the service.
+ *           count - [in] Number of PIDs, at most TIMESHIFT_MAX_PIDS.
+****************************************************************************/
+void timeshiftSetService(const uint16_t *pids, uint32_t count);
+
+/****************************************************************************
+ * @brief    Function for passing a packet to the capture, called by the transport stream input
+ *           for every packet on the packet source thread.
+ *
+ * @param    pid - [in] Packet identifier.
+ *           packet - [in] Transport stream packet.
+ *           arrivalNs - [in] virtualClockNowNs time the packet was received.
+****************************************************************************/
+void timeshiftPacket(uint16_t pid, const uint8_t *packet, uint64_t arrivalNs);
+
+/****************************************************************************
+ * @brief    Function for pausing live or played TV, the cursor stays where it is.
+ *
+ * @return   TIMESHIFT_NO_ERROR, if there are no errors.
+ *           TIMESHIFT_ERROR, if nothing was captured yet or playback is already paused.
+****************************************************************************/
+timeshiftStatus timeshiftPause();
+
+/****************************************************************************
+ * @brief    Function for resuming playback at real time speed from the cursor.
+ *
+ * @return   TIMESHIFT_NO_ERROR, if there are no errors.
+ *           TIMESHIFT_ERROR, if playback is live.
+****************************************************************************/
+timeshiftStatus timeshiftResume();
+
+/****************************************************************************
+ * @brief    Function for moving the cursor by a time offset, clamped to the buffered window.
+ *           Live playback starts playing behind live, reaching live returns to live.
+ *
+ * @param    offsetSeconds - [in] Offset from the cursor, negative to go back.
+ *
+ * @return   TIMESHIFT_NO_ERROR, if there are no errors.
+ *           TIMESHIFT_ERROR, if nothing was captured yet.
+****************************************************************************/
+timeshiftStatus timeshiftSeek(int32_t offsetSeconds);
+
+/****************************************************************************
+ * @brief    Function for catching up with live, playing at TIMESHIFT_CATCH_UP_PERCENT speed
+ *           until the cursor reaches the capture.
+ *
+ * @return   TIMESHIFT_NO_ERROR, if there are no errors.
+ *           TIMESHIFT_ERROR, if playback is live.
+****************************************************************************/
+timeshiftStatus timeshiftCatchUp();
+
+/****************************************************************************
+ * @brief    Function for reading the timeshift statistics, safe to call from any thread.
+ *
+ * @param    statistics - [out] Timeshift statistics.
+****************************************************************************/
+void timeshiftGetStatistics(timeshiftStatistics *statistics);
+
+/****************************************************************************
+ * @brief    Function for printing the timeshift statistics.
+****************************************************************************/
+void timeshiftPrintStatistics();
+
+#endif // _TIMESHIFT_H_
@@ -0,0 +1,571 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file timeshift_benchmark.c
+ *
+ * \brief
+ * Timeshift benchmark. A recorded multiplex is loaded into memory and passed through the
+ * transport stream input in a loop at a given bitrate, its continuity counters renumbered so
+ * the loop stays continuous, while the first program is captured into a small timeshift
+ * buffer that wraps every few seconds. A script of pauses, resumes, seeks and catch-ups is
+ * run against the playback and the sink checks what is played: pausing must hold the cursor,
+ * resuming must play continuously at the paused delay, catching up must reach live, a pause
+ * longer than the buffer must end in an overrun, a zap must empty the buffer and the resident
+ * memory must not grow while the buffer wraps. The exit status is 1 if a check fails.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "timeshift.h"
+#include "ts_input.h"
+#include "tables_parser.h"
+#include "virtual_clock.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* helper keywords needed only for timeshift benchmark module */
+#define DEFAULT_BUFFER_KIB 2048
+#define DEFAULT_BITRATE 20
+#define PACKETS_PER_READ 64    // packets passed to the input at once, as the file source reads them
+#define STEP_NS 100000000ULL   // how often a waiting step looks at the statistics
+#define WAIT_LIMIT_NS 30000000000ULL
+#define RSS_GROWTH_LIMIT_KIB 512
+
+/* helper variables needed only for timeshift benchmark module */
+static uint8_t *multiplex;
+static uint32_t multiplexPackets;
+static uint32_t bitrate;
+static volatile uint8_t feeding = 1;
+
+static uint8_t lastContinuity[TS_PID_COUNT];
+static uint8_t continuitySeen[TS_PID_COUNT];
+static uint64_t sinkPackets;
+static uint64_t continuityErrors;
+static uint64_t liveReturns;
+static uint32_t sinkGeneration; // bumped by the script, the sink then forgets the continuity it saw
+static uint32_t checkedGeneration;
+
+static int32_t failed;
+
+/* helper functions needed only for timeshift benchmark module */
+static int32_t loadMultiplex(const char *path);
+static const uint8_t *findSection(uint16_t pid, uint8_t tableId, uint16_t programNumber);
+static uint32_t findServicePids(uint32_t programIndex, uint16_t *pids);
+static void *feederThread(void *arg);
+static void playedPackets(const uint8_t *packets, uint32_t count);
+static void expect(int32_t condition, const char *description);
+static void printStep(const char *step);
+static int32_t waitForState(timeshiftState expected);
+static void waitForCapture(uint64_t packets);
+static void sleepNs(uint64_t durationNs);
+static long residentKib();
+
+int main(int argc, char **argv)
+{
+    uint32_t bufferKib = DEFAULT_BUFFER_KIB;
+    uint16_t pids[TIMESHIFT_MAX_PIDS];
+    uint16_t otherPids[TIMESHIFT_MAX_PIDS];
+    uint32_t pidCount;
+    uint32_t otherPidCount;
+    timeshiftStatistics statistics;
+    timeshiftStatistics before;
+    uint64_t errorsBefore;
+    uint64_t capacity;
+    pthread_t feeder;
+    long residentBefore;
+
+    if (argc < 2)
+    {
+        printf("Usage: %s <multiplex.ts> [buffer KiB] [bitrate Mbit/s]\n", argv[0]);
+        return 1;
+    }
+    bitrate = DEFAULT_BITRATE;
+    if (argc > 2)
+        bufferKib = atoi(argv[2]);
+    if (argc > 3)
+        bitrate = atoi(argv[3]);
+    if (!bufferKib || !bitrate)
+    {
+        printf("Buffer size and bitrate must not be 0!\n");
+        return 1;
+    }
+
+    virtualClockInit(VIRTUAL_CLOCK_REAL);
+    tablesParserInit();
+    tsInputInit();
+
+    if (loadMultiplex(argv[1]))
+    {
+        return 1;
+    }
+    pidCount = findServicePids(0, pids);
+    otherPidCount = findServicePids(1, otherPids);
+    if (!pidCount)
+    {
+        return 1;
+    }
+    if (!otherPidCount)
+    {
+        /* a single program multiplex zaps to a subset of the same PIDs */
+        otherPids[0] = pids[0];
+        otherPidCount = 1;
+    }
+
+    if (timeshiftInit(bufferKib * 1024, playedPackets))
+    {
+        printf("Error while creating the timeshift buffer!\n");
+        return 1;
+    }
+    timeshiftGetStatistics(&statistics);
+    capacity = statistics.bufferBytes / TS_PACKET_SIZE;
+    printf("Timeshift of %u PIDs in a %u KiB buffer (%llu packets), multiplex of %u packets at %u Mbit/s\n",
+           pidCount, statistics.bufferBytes >> 10, (unsigned long long)capacity, multiplexPackets, bitrate);
+
+    timeshiftSetService(pids, pidCount);
+    if (pthread_create(&feeder, NULL, feederThread, NULL))
+    {
+        printf("Error while starting the feeder!\n");
+        return 1;
+    }
+
+    /* live: the capture fills the buffer, nothing is played */
+    sleepNs(2000000000ULL);
+    printStep("live 2 s");
+    timeshiftGetStatistics(&statistics);
+    expect(statistics.state == TIMESHIFT_LIVE, "live after start");
+    expect(statistics.capturedPackets > 0, "packets captured");
+    expect(statistics.playedPackets == 0, "nothing played while live");
+
+    /* pause: the cursor stays while the capture goes on */
+    expect(!timeshiftPause(), "pause accepted");
+    sleepNs(1000000000ULL);
+    printStep("paused 1 s");
+    timeshiftGetStatistics(&statistics);
+    expect(statistics.state == TIMESHIFT_PAUSED, "paused");
+    expect(statistics.playedPackets == 0, "nothing played while paused");
+    expect(statistics.delayNs >= 900000000ULL, "delay grows while paused");
+
+    /* resume: continuous real time playback at the paused delay */
+    expect(!timeshiftResume(), "resume accepted");
+    sleepNs(200000000ULL);
+    errorsBefore = __atomic_load_n(&continuityErrors, __ATOMIC_RELAXED);
+    timeshiftGetStatistics(&before);
+    sleepNs(2000000000ULL);
+    printStep("playing 2 s");
+    timeshiftGetStatistics(&statistics);
+    expect(statistics.state == TIMESHIFT_PLAYING, "playing");
+    expect(statistics.playedPackets > before.playedPackets, "packets played");
+    expect(__atomic_load_n(&sinkPackets, __ATOMIC_RELAXED) == statistics.playedPackets, "every played packet reached the sink");
+    expect(__atomic_load_n(&continuityErrors, __ATOMIC_RELAXED) == errorsBefore, "played packets continuous");
+    expect(statistics.delayNs > 700000000ULL && statistics.delayNs < 1500000000ULL, "delay kept while playing");
+
+    /* catch up: faster playback until the cursor reaches the capture */
+    expect(!timeshiftCatchUp(), "catch up accepted");
+    expect(!waitForState(TIMESHIFT_LIVE), "live again after catching up");
+    printStep("caught up");
+    expect(__atomic_load_n(&liveReturns, __ATOMIC_RELAXED) == 1, "sink told to return to live");
+
+    /* seek: jumping back from live plays behind live */
+    __atomic_add_fetch(&sinkGeneration, 1, __ATOMIC_RELAXED);
+    expect(!timeshiftSeek(-2), "seek accepted");
+    sleepNs(200000000ULL);
+    printStep("seek -2 s");
+    timeshiftGetStatistics(&statistics);
+    expect(statistics.state == TIMESHIFT_PLAYING, "playing after seek");
+    expect(statistics.delayNs > 1500000000ULL && statistics.delayNs < 2600000000ULL, "delay after seek");
+
+    /* overrun: a pause longer than the buffer holds loses the cursor, playback goes on from the oldest packet */
+    expect(!timeshiftPause(), "pause accepted");
+    timeshiftGetStatistics(&before);
+    waitForCapture(before.capturedPackets + capacity + capacity / 4);
+    expect(!timeshiftResume(), "resume accepted");
+    sleepNs(500000000ULL);
+    printStep("resumed after a pause longer than the buffer");
+    timeshiftGetStatistics(&statistics);
+    expect(statistics.overruns > before.overruns, "overrun counted");
+    expect(statistics.state == TIMESHIFT_PLAYING, "playing after overrun");
+    expect(statistics.delayNs <= statistics.windowNs, "cursor inside the window");
+
+    /* zap: other PIDs empty the buffer and return to live */
+    timeshiftSetService(otherPids, otherPidCount);
+    sleepNs(100000000ULL);
+    printStep("zap");
+    timeshiftGetStatistics(&statistics);
+    expect(statistics.state == TIMESHIFT_LIVE, "live after zap");
+    expect(statistics.windowNs < 500000000ULL, "buffer emptied by zap");
+
+    /* resident memory is taken once the buffer is full and does not grow while it wraps */
+    waitForCapture(statistics.capturedPackets + capacity);
+    residentBefore = residentKib();
+    timeshiftGetStatistics(&statistics);
+    waitForCapture(statistics.capturedPackets + 2 * capacity);
+    printStep("two more wraps");
+    printf("  resident memory %ld KiB, %+ld KiB over two wraps\n", residentKib(), residentKib() - residentBefore);
+    expect(residentKib() - residentBefore < RSS_GROWTH_LIMIT_KIB, "resident memory constant");
+
+    feeding = 0;
+    pthread_join(feeder, NULL);
+    timeshiftDeinit();
+    free(multiplex);
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    return failed;
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for loading the whole multiplex file into memory.
+ *
+ * @param    path - [in] Transport stream file, 188 byte packets.
+ *
+ * @return   0 on success, -1 in case of an error.
+****************************************************************************/
+static int32_t loadMultiplex(const char *path)
+{
+    struct stat fileStat;
+    int32_t fileDesc = open(path, O_RDONLY);
+    ssize_t result;
+    size_t loaded = 0;
+
+    if (fileDesc < 0 || fstat(fileDesc, &fileStat))
+    {
+        printf("Error while opening %s!\n", path);
+        return -1;
+    }
+
+    multiplexPackets = fileStat.st_size / TS_PACKET_SIZE;
+    multiplex = (uint8_t *)malloc((size_t)multiplexPackets * TS_PACKET_SIZE);
+    while (multiplex && loaded < (size_t)multiplexPackets * TS_PACKET_SIZE)
+    {
+        result = read(fileDesc, multiplex + loaded, (size_t)multiplexPackets * TS_PACKET_SIZE - loaded);
+        if (result <= 0)
+        {
+            break;
+        }
+        loaded += result;
+    }
+    close(fileDesc);
+
+    if (multiplexPackets < PACKETS_PER_READ || loaded != (size_t)multiplexPackets * TS_PACKET_SIZE || multiplex[0] != TS_SYNC_BYTE)
+    {
+        printf("Error while reading %s, not a 188 byte packet transport stream!\n", path);
+        return -1;
+    }
+    /* whole reads only, the loop always starts at the first packet */
+    multiplexPackets -= multiplexPackets % PACKETS_PER_READ;
+
+    return 0;
+}
+
+/****************************************************************************
+ * @brief    Function for finding a section starting in a single packet of the multiplex.
+ *
+ * @param    pid - [in] Packet identifier.
+ *           tableId - [in] Table id of the section.
+ *           programNumber - [in] Program number of a PMT, 0 to take any.
+ *
+ * @return   Section starting with table_id, NULL if there is none.
+****************************************************************************/
+static const uint8_t *findSection(uint16_t pid, uint8_t tableId, uint16_t programNumber)
+{
+    const uint8_t *packet;
+    const uint8_t *section;
+    uint32_t i;
+
+    for (i = 0; i < multiplexPackets; i++)
+    {
+        packet = &multiplex[i * TS_PACKET_SIZE];
+        if ((((packet[1] & 0x1F) << 8) | packet[2]) != pid || !(packet[1] & 0x40) || (packet[3] & 0x30) != 0x10)
+        {
+            continue;
+        }
+
+        section = &packet[5 + packet[4]];
+        if (section - packet < TS_PACKET_SIZE - 3 && section[0] == tableId &&
+            (section - packet) + 3 + (((section[1] & 0x0F) << 8) | section[2]) <= TS_PACKET_SIZE &&
+            (!programNumber || ((section[3] << 8) | section[4]) == programNumber))
+        {
+            return section;
+        }
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Function for taking the PCR and elementary PIDs of a program, as the stream
+ *           controller passes them to timeshiftSetService.
+ *
+ * @param    programIndex - [in] Index of the program in the PAT, network PID excluded.
+ *           pids - [out] At most TIMESHIFT_MAX_PIDS PIDs.
+ *
+ * @return   Number of PIDs, 0 if the program or its PMT is not found.
+****************************************************************************/
+static uint32_t findServicePids(uint32_t programIndex, uint16_t *pids)
+{
+    const uint8_t *section = findSection(0, 0x00, 0);
+    patTable pat;
+    pmtTable pmt;
+    uint32_t pidCount = 0;
+    uint32_t i;
+
+    if (!section || parsePAT((uint8_t *)section, &pat))
+    {
+        printf("No PAT in the multiplex!\n");
+        return 0;
+    }
+
+    /* program number 0 is the network PID */
+    for (i = 0; i < pat.programCount; i++)
+    {
+        if (pat.programInformation[i].programNumber && !programIndex--)
+        {
+            break;
+        }
+    }
+
+    section = i < pat.programCount ? findSection(pat.programInformation[i].programMapPid, 0x02,
+                                                 pat.programInformation[i].programNumber) : NULL;
+    free(pat.programInformation);
+    if (!section || parsePMT((uint8_t *)section, &pmt))
+    {
+        return 0;
+    }
+
+    pids[pidCount++] = pmt.pmtHeader.pcrPid;
+    for (i = 0; i < pmt.elementaryInformationCount && pidCount < TIMESHIFT_MAX_PIDS; i++)
+    {
+        if (pmt.elementaryInformation[i].elementaryPid != pmt.pmtHeader.pcrPid)
+        {
+            pids[pidCount++] = pmt.elementaryInformation[i].elementaryPid;
+        }
+    }
+    free(pmt.elementaryInformation);
+    free(pmt.subtitles);
+
+    return pidCount;
+}
+
+/****************************************************************************
+ * @brief    Feeder thread, passes the multiplex through the transport stream input in a loop at
+ *           the benchmark bitrate. Continuity counters of payload packets are renumbered so the
+ *           end of the file continues into its start.
+ *
+ * @param    arg - [in] Unused.
+****************************************************************************/
+static void *feederThread(void *arg)
+{
+    uint8_t packets[PACKETS_PER_READ * TS_PACKET_SIZE];
+    uint8_t continuity[TS_PID_COUNT] = {0};
+    uint64_t periodNs = PACKETS_PER_READ * TS_PACKET_SIZE * 8 * 1000ULL / bitrate;
+    uint64_t dueNs = 0;
+    uint32_t position = 0;
+    uint32_t i;
+    uint8_t *packet;
+
+    while (feeding)
+    {
+        memcpy(packets, &multiplex[(size_t)position * TS_PACKET_SIZE], sizeof(packets));
+        for (i = 0; i < PACKETS_PER_READ; i++)
+        {
+            packet = &packets[i * TS_PACKET_SIZE];
+            if (packet[3] & 0x10)
+            {
+                uint16_t pid = ((packet[1] & 0x1F) << 8) | packet[2];
+
+                packet[3] = (packet[3] & 0xF0) | continuity[pid];
+                continuity[pid] = (continuity[pid] + 1) & 0x0F;
+            }
+        }
+
+        tsInputPackets(packets, PACKETS_PER_READ, virtualClockNowNs());
+        position = (position + PACKETS_PER_READ) % multiplexPackets;
+
+        /* paced against absolute deadlines, the time spent on the packets does not lower the bitrate */
+        dueNs = dueNs ? dueNs + periodNs : virtualClockNowNs() + periodNs;
+        if (dueNs > virtualClockNowNs())
+        {
+            sleepNs(dueNs - virtualClockNowNs());
+        }
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Timeshift sink, counts played packets and checks their continuity.
+ *
+ * @param    packets - [in] Consecutive 188 byte packets, NULL when back to live.
+ *           count - [in] Number of packets.
+****************************************************************************/
+static void playedPackets(const uint8_t *packets, uint32_t count)
+{
+    uint32_t generation = __atomic_load_n(&sinkGeneration, __ATOMIC_RELAXED);
+    const uint8_t *packet;
+    uint16_t pid;
+    uint32_t i;
+
+    if (!packets)
+    {
+        __atomic_add_fetch(&liveReturns, 1, __ATOMIC_RELAXED);
+        memset(continuitySeen, 0, sizeof(continuitySeen));
+        return;
+    }
+    if (generation != checkedGeneration)
+    {
+        checkedGeneration = generation;
+        memset(continuitySeen, 0, sizeof(continuitySeen));
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        packet = &packets[i * TS_PACKET_SIZE];
+        pid = ((packet[1] & 0x1F) << 8) | packet[2];
+        if (packet[0] != TS_SYNC_BYTE)
+        {
+            __atomic_add_fetch(&continuityErrors, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (packet[3] & 0x10)
+        {
+            if (continuitySeen[pid] && (packet[3] & 0x0F) != ((lastContinuity[pid] + 1) & 0x0F))
+            {
+                __atomic_add_fetch(&continuityErrors, 1, __ATOMIC_RELAXED);
+            }
+            continuitySeen[pid] = 1;
+            lastContinuity[pid] = packet[3] & 0x0F;
+        }
+    }
+    __atomic_add_fetch(&sinkPackets, count, __ATOMIC_RELAXED);
+}
+
+/****************************************************************************
+ * @brief    Function for printing the result of a check and remembering a failure.
+ *
+ * @param    condition - [in] Non-zero if the check passed.
+ *           description - [in] What was checked.
+****************************************************************************/
+static void expect(int32_t condition, const char *description)
+{
+    printf("  %-4s %s\n", condition ? "ok" : "FAIL", description);
+    failed |= !condition;
+}
+
+/****************************************************************************
+ * @brief    Function for printing the timeshift statistics after a step of the script.
+ *
+ * @param    step - [in] Step name.
+****************************************************************************/
+static void printStep(const char *step)
+{
+    timeshiftStatistics statistics;
+
+    timeshiftGetStatistics(&statistics);
+    printf("%s: %.2f s buffered, %.2f s behind live, %llu captured, %llu played, %llu overruns\n", step,
+           statistics.windowNs / 1e9, statistics.delayNs / 1e9, (unsigned long long)statistics.capturedPackets,
+           (unsigned long long)statistics.playedPackets, (unsigned long long)statistics.overruns);
+}
+
+/****************************************************************************
+ * @brief    Function for waiting until the playback reaches a state.
+ *
+ * @param    expected - [in] Awaited state.
+ *
+ * @return   0 once it is reached, -1 after WAIT_LIMIT_NS.
+****************************************************************************/
+static int32_t waitForState(timeshiftState expected)
+{
+    timeshiftStatistics statistics;
+    uint64_t waitedNs;
+
+    for (waitedNs = 0; waitedNs < WAIT_LIMIT_NS; waitedNs += STEP_NS)
+    {
+        timeshiftGetStatistics(&statistics);
+        if (statistics.state == expected)
+        {
+            return 0;
+        }
+        sleepNs(STEP_NS);
+    }
+
+    return -1;
+}
+
+/****************************************************************************
+ * @brief    Function for waiting until a number of packets was captured in total.
+ *
+ * @param    packets - [in] Awaited captured packet count.
+****************************************************************************/
+static void waitForCapture(uint64_t packets)
+{
+    timeshiftStatistics statistics;
+    uint64_t waitedNs;
+
+    for (waitedNs = 0; waitedNs < WAIT_LIMIT_NS; waitedNs += STEP_NS)
+    {
+        timeshiftGetStatistics(&statistics);
+        if (statistics.capturedPackets >= packets)
+        {
+            return;
+        }
+        sleepNs(STEP_NS);
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for sleeping on CLOCK_MONOTONIC.
+ *
+ * @param    durationNs - [in] Sleep duration.
+****************************************************************************/
+static void sleepNs(uint64_t durationNs)
+{
+    struct timespec duration;
+
+    duration.tv_sec = durationNs / 1000000000ULL;
+    duration.tv_nsec = durationNs % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, 0, &duration, &duration))
+    {
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for reading the resident memory of the process.
+ *
+ * @return   Resident set size in KiB, 0 if it can not be read.
+****************************************************************************/
+static long residentKib()
+{
+    FILE *status = fopen("/proc/self/status", "r");
+    char line[256];
+    long resident = 0;
+
+    while (status && fgets(line, sizeof(line), status))
+    {
+        if (!strncmp(line, "VmRSS:", 6))
+        {
+            resident = atol(line + 6);
+        }
+    }
+    if (status)
+    {
+        fclose(status);
+    }
+
+    return resident;
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
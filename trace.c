@@ -0,0 +1,214 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file trace.c
+ *
+ * \brief
+ * Implementation of the tracing module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+/* helper keywords needed only for trace module */
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+#define THREAD_NAME_LENGTH 16
+
+typedef struct _traceEvent
+{
+    uint64_t timestampNs;
+    const char *name;
+    int64_t value;
+    uint8_t phase;
+} traceEvent;
+
+typedef struct _traceBuffer
+{
+    struct _traceBuffer *next;
+    uint32_t head; // total number of events written, published after the event is complete
+    int32_t threadId;
+    char threadName[THREAD_NAME_LENGTH];
+    traceEvent events[TRACE_RING_SIZE];
+} traceBuffer;
+
+/* helper variables needed only for trace module */
+static traceBuffer *buffers; // buffers of all threads that ever traced, never freed
+static __thread traceBuffer *threadBuffer;
+
+/* helper functions needed only for trace module */
+static traceBuffer *registerThread();
+static void writeJsonString(FILE *file, const char *text);
+
+void traceRecord(tracePhase phase, const char *name, int64_t value)
+{
+    traceBuffer *buffer = threadBuffer;
+    traceEvent *event;
+    struct timespec now;
+    uint32_t head;
+
+    if (!buffer)
+    {
+        buffer = registerThread();
+        if (!buffer)
+        {
+            return;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    /* only the owning thread writes, the release store publishes the complete event to the dump */
+    head = buffer->head;
+    event = &buffer->events[head & TRACE_RING_MASK];
+    event->timestampNs = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    event->name = name;
+    event->value = value;
+    event->phase = phase;
+    __atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+}
+
+traceStatus traceDump(const char *path)
+{
+    traceBuffer *buffer;
+    uint8_t firstEvent = 1;
+    FILE *file;
+
+    if (!__atomic_load_n(&buffers, __ATOMIC_ACQUIRE))
+    {
+        printf("No trace events recorded, trace points are built in with make TRACE=1\n");
+        return TRACE_NO_ERROR;
+    }
+
+    file = fopen(path, "w");
+    if (!file)
+    {
+        printf("Error while opening trace file %s!\n", path);
+        return TRACE_ERROR;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    for (buffer = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE); buffer; buffer = buffer->next)
+    {
+        uint32_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+        uint32_t index = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        uint32_t depth = 0;
+
+        fprintf(file, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                firstEvent ? "" : ",", (int)getpid(), buffer->threadId);
+        writeJsonString(file, buffer->threadName);
+        fprintf(file, "}}");
+        firstEvent = 0;
+
+        for (; index != head; index++)
+        {
+            const traceEvent *event = &buffer->events[index & TRACE_RING_MASK];
+            static const char phaseNames[] = {'B', 'E', 'i', 'C'};
+
+            /* spans begun before the oldest kept event would end without a start */
+            if (event->phase == TRACE_PHASE_BEGIN)
+            {
+                depth++;
+            }
+            else if (event->phase == TRACE_PHASE_END)
+            {
+                if (!depth)
+                {
+                    continue;
+                }
+                depth--;
+            }
+
+            fprintf(file, ",\n{\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"name\":", phaseNames[event->phase],
+                    (int)getpid(), buffer->threadId, event->timestampNs / 1000.0);
+            writeJsonString(file, event->name);
+            if (event->phase == TRACE_PHASE_COUNTER)
+            {
+                fprintf(file, ",\"args\":{\"value\":%lld}", (long long)event->value);
+            }
+            else if (event->phase == TRACE_PHASE_INSTANT)
+            {
+                fprintf(file, ",\"s\":\"t\"");
+            }
+            fprintf(file, "}");
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Trace written to %s\n", path);
+    return TRACE_NO_ERROR;
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for allocating the ring of the calling thread and adding it to the list of all rings.
+ *
+ * @return   Pointer to the ring, NULL if memory allocation failed.
+****************************************************************************/
+static traceBuffer *registerThread()
+{
+    traceBuffer *buffer = (traceBuffer *)calloc(1, sizeof(traceBuffer));
+
+    if (!buffer)
+    {
+        return NULL;
+    }
+
+    buffer->threadId = syscall(SYS_gettid);
+    prctl(PR_GET_NAME, buffer->threadName, 0, 0, 0);
+
+    /* lock-free push, the dump may walk the list at the same time */
+    do
+    {
+        buffer->next = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE);
+    } while (!__atomic_compare_exchange_n(&buffers, &buffer->next, buffer, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+
+    threadBuffer = buffer;
+    return buffer;
+}
+
+/****************************************************************************
+ * @brief    Function for writing a quoted and escaped JSON string.
+ *
+ * @param    file - [in] Output file.
+ *           text - [in] String to write.
+****************************************************************************/
+static void writeJsonString(FILE *file, const char *text)
+{
+    fputc('"', file);
+    for (; text && *text; text++)
+    {
+        if (*text == '"' || *text == '\\')
+        {
+            fputc('\\', file);
+            fputc(*text, file);
+        }
+        else if ((uint8_t)*text < 0x20)
+        {
+            fprintf(file, "\\u%04x", (uint8_t)*text);
+        }
+        else
+        {
+            fputc(*text, file);
+        }
+    }
+    fputc('"', file);
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
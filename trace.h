@@ -0,0 +1,90 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file trace.h
+ *
+ * \brief
+ * Header of the tracing module. Trace points (begin/end spans, instants and counters) are
+ * written into a ring buffer owned by the calling thread without locking and dumped as
+ * Chrome trace JSON, viewable in chrome://tracing or Perfetto. Trace points compile to
+ * nothing unless TRACE_ENABLED is defined (make TRACE=1).
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+#define TRACE_RING_SIZE 8192 // events kept per thread, must be a power of two
+#define TRACE_OUTPUT_PATH "/tmp/tv_app_trace.json"
+
+typedef enum _traceStatus
+{
+    TRACE_NO_ERROR = 0,
+    TRACE_ERROR
+} traceStatus;
+
+typedef enum _tracePhase
+{
+    TRACE_PHASE_BEGIN = 0,
+    TRACE_PHASE_END,
+    TRACE_PHASE_INSTANT,
+    TRACE_PHASE_COUNTER
+} tracePhase;
+
+/* names are stored by pointer, only string literals or strings living until the dump may be passed */
+#ifdef TRACE_ENABLED
+#define TRACE_BEGIN(name) traceRecord(TRACE_PHASE_BEGIN, name, 0)
+#define TRACE_END(name) traceRecord(TRACE_PHASE_END, name, 0)
+#define TRACE_INSTANT(name) traceRecord(TRACE_PHASE_INSTANT, name, 0)
+#define TRACE_COUNTER(name, value) traceRecord(TRACE_PHASE_COUNTER, name, value)
+#else
+#define TRACE_BEGIN(name) \
+    do                    \
+    {                     \
+    } while (0)
+#define TRACE_END(name) \
+    do                  \
+    {                   \
+    } while (0)
+#define TRACE_INSTANT(name) \
+    do                      \
+    {                       \
+    } while (0)
+#define TRACE_COUNTER(name, value) \
+    do                             \
+    {                              \
+    } while (0)
+#endif
+
+/****************************************************************************
+ * @brief    Function for writing one trace event into the ring of the calling thread.
+ *           The ring is allocated on the first event of a thread, later the oldest events are overwritten.
+ *
+ * @param    phase - [in] Event phase.
+ *           name - [in] Event name.
+ *           value - [in] Counter value, ignored for other phases.
+****************************************************************************/
+void traceRecord(tracePhase phase, const char *name, int64_t value);
+
+/****************************************************************************
+ * @brief    Function for writing events of all threads to a Chrome trace JSON file.
+ *           Threads keep tracing during the dump, events overwritten meanwhile may be lost.
+ *
+ * @param    path - [in] Output file path.
+ *
+ * @return   TRACE_NO_ERROR, if there are no errors.
+ *           TRACE_ERROR, in case of an error.
+****************************************************************************/
+traceStatus traceDump(const char *path);
+
+#endif // _TRACE_H_
@@ -0,0 +1,333 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file ts_fanout.c
+ *
+ * \brief
+ * Implementation of the transport stream fan-out module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "ts_fanout.h"
+#include "metrics.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+/* helper keywords needed only for transport stream fan-out module */
+#define COUNTER_ADD(counter, value) __atomic_store_n(&(counter), (counter) + (value), __ATOMIC_RELAXED)
+#define COUNTER_READ(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+typedef struct _subscriber
+{
+    uint8_t used;
+    uint16_t pids[TS_FANOUT_MAX_PIDS];
+    uint32_t pidCount;
+    sem_t *wake;
+    tsFanoutReference queue[TS_FANOUT_QUEUE_BLOCKS];
+    uint64_t queueHead; // written by the packet source only
+    uint64_t queueTail; // written by the subscriber only
+    uint64_t wakeNs;    // arrival time of the last wake, written by the packet source only
+    uint64_t packets;
+    uint64_t droppedPackets;
+} subscriber;
+
+/* helper variables needed only for transport stream fan-out module */
+static tsFanoutBlock pool[TS_FANOUT_POOL_BLOCKS];
+static uint32_t nextBlock;                   // where the search for a free block starts
+static uint32_t pidSubscribers[TS_PID_COUNT]; // bit s set if subscriber s receives the PID
+static subscriber subscribers[TS_FANOUT_MAX_SUBSCRIBERS];
+static pthread_mutex_t subscriberMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t subscriberCount; // the pool is shared out evenly between the subscribers
+static uint64_t batchEpoch; // odd while the packet source is passing a block out
+static uint64_t poolExhausted;
+static uint64_t blocksShared;
+
+/* helper functions needed only for transport stream fan-out module */
+static void fanoutBlock(const uint8_t *packets, uint32_t count, uint64_t arrivalNs);
+static tsFanoutBlock *allocateBlock();
+static int64_t poolExhaustedTotal();
+static int64_t blocksSharedTotal();
+
+tsFanoutStatus tsFanoutInit()
+{
+    metricsRegisterCallback(METRICS_TYPE_COUNTER, "tv_ts_fanout_blocks_total", "Packet blocks referenced to at least one subscriber", blocksSharedTotal);
+    metricsRegisterCallback(METRICS_TYPE_COUNTER, "tv_ts_fanout_pool_exhausted_total", "Packet blocks dropped because every pool block was referenced", poolExhaustedTotal);
+
+    return TS_FANOUT_NO_ERROR;
+}
+
+tsFanoutStatus tsFanoutSubscribe(const uint16_t *pids, uint32_t pidCount, sem_t *wake, int32_t *subscriberId)
+{
+    subscriber *added = NULL;
+    uint32_t i;
+
+    if (pidCount > TS_FANOUT_MAX_PIDS)
+    {
+        pidCount = TS_FANOUT_MAX_PIDS;
+    }
+
+    pthread_mutex_lock(&subscriberMutex);
+    for (i = 0; i < TS_FANOUT_MAX_SUBSCRIBERS; i++)
+    {
+        if (!subscribers[i].used)
+        {
+            added = &subscribers[i];
+            break;
+        }
+    }
+    if (!added)
+    {
+        pthread_mutex_unlock(&subscriberMutex);
+        return TS_FANOUT_ERROR;
+    }
+
+    added->used = 1;
+    memcpy(added->pids, pids, pidCount * sizeof(uint16_t));
+    added->pidCount = pidCount;
+    added->wake = wake;
+    added->queueHead = 0;
+    added->queueTail = 0;
+    added->wakeNs = 0;
+    added->packets = 0;
+    added->droppedPackets = 0;
+
+    /* the subscriber is complete before the packet source can find it in the table */
+    for (i = 0; i < pidCount; i++)
+    {
+        __atomic_or_fetch(&pidSubscribers[pids[i] % TS_PID_COUNT], 1U << (added - subscribers), __ATOMIC_RELEASE);
+    }
+    __atomic_add_fetch(&subscriberCount, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&subscriberMutex);
+
+    *subscriberId = added - subscribers;
+
+    return TS_FANOUT_NO_ERROR;
+}
+
+void tsFanoutUnsubscribe(int32_t subscriberId)
+{
+    subscriber *removed = &subscribers[subscriberId];
+    tsFanoutReference reference;
+    uint64_t epoch;
+    uint32_t i;
+
+    pthread_mutex_lock(&subscriberMutex);
+    for (i = 0; i < removed->pidCount; i++)
+    {
+        __atomic_and_fetch(&pidSubscribers[removed->pids[i] % TS_PID_COUNT], ~(1U << subscriberId), __ATOMIC_SEQ_CST);
+    }
+
+    /* a block passed out while the bits were cleared may still add a reference, the next one can not */
+    epoch = __atomic_load_n(&batchEpoch, __ATOMIC_SEQ_CST);
+    while ((epoch & 1) && __atomic_load_n(&batchEpoch, __ATOMIC_ACQUIRE) == epoch)
+    {
+        sched_yield();
+    }
+
+    while (!tsFanoutNext(subscriberId, &reference))
+    {
+        COUNTER_ADD(removed->droppedPackets, __builtin_popcountll(reference.packetMask));
+        tsFanoutRelease(reference.block);
+    }
+    __atomic_sub_fetch(&subscriberCount, 1, __ATOMIC_RELAXED);
+    removed->used = 0;
+    pthread_mutex_unlock(&subscriberMutex);
+}
+
+void tsFanoutPackets(const uint8_t *packets, uint32_t count, uint64_t arrivalNs)
+{
+    uint32_t passed;
+
+    for (passed = 0; passed < count; passed += TS_FANOUT_BLOCK_PACKETS)
+    {
+        fanoutBlock(&packets[passed * TS_PACKET_SIZE], count - passed < TS_FANOUT_BLOCK_PACKETS ? count - passed : TS_FANOUT_BLOCK_PACKETS, arrivalNs);
+    }
+}
+
+tsFanoutStatus tsFanoutNext(int32_t subscriberId, tsFanoutReference *reference)
+{
+    subscriber *reader = &subscribers[subscriberId];
+    uint64_t tail = reader->queueTail;
+
+    if (tail == __atomic_load_n(&reader->queueHead, __ATOMIC_ACQUIRE))
+    {
+        return TS_FANOUT_ERROR;
+    }
+
+    *reference = reader->queue[tail % TS_FANOUT_QUEUE_BLOCKS];
+    __atomic_store_n(&reader->queueTail, tail + 1, __ATOMIC_RELEASE);
+
+    return TS_FANOUT_NO_ERROR;
+}
+
+void tsFanoutRelease(const tsFanoutBlock *block)
+{
+    /* the last release hands the block back to the packet source */
+    __atomic_sub_fetch(&((tsFanoutBlock *)block)->references, 1, __ATOMIC_RELEASE);
+}
+
+void tsFanoutGetStatistics(int32_t subscriberId, tsFanoutStatistics *statistics)
+{
+    statistics->packets = COUNTER_READ(subscribers[subscriberId].packets);
+    statistics->droppedPackets = COUNTER_READ(subscribers[subscriberId].droppedPackets);
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for copying up to TS_FANOUT_BLOCK_PACKETS packets into a block and passing a
+ *           reference to every subscriber with packets in it.
+ *
+ * @param    packets - [in] Consecutive 188 byte packets.
+ *           count - [in] Number of packets, at most TS_FANOUT_BLOCK_PACKETS.
+ *           arrivalNs - [in] Arrival time of the packets.
+****************************************************************************/
+static void fanoutBlock(const uint8_t *packets, uint32_t count, uint64_t arrivalNs)
+{
+    uint64_t masks[TS_FANOUT_MAX_SUBSCRIBERS];
+    uint32_t receivers = 0;
+    uint32_t references = 0;
+    uint32_t bits;
+    uint32_t i;
+    int32_t s;
+    const uint8_t *packet;
+    tsFanoutBlock *block;
+    subscriber *receiver;
+    uint64_t head;
+    uint32_t share;
+
+    __atomic_add_fetch(&batchEpoch, 1, __ATOMIC_SEQ_CST);
+
+    /* one table lookup per packet, usually a single bit */
+    for (i = 0; i < count; i++)
+    {
+        packet = &packets[i * TS_PACKET_SIZE];
+        if (packet[0] != TS_SYNC_BYTE)
+        {
+            continue;
+        }
+
+        bits = __atomic_load_n(&pidSubscribers[((packet[1] & 0x1F) << 8) | packet[2]], __ATOMIC_ACQUIRE);
+        while (bits)
+        {
+            s = __builtin_ctz(bits);
+            bits &= bits - 1;
+            if (!(receivers & (1U << s)))
+            {
+                receivers |= 1U << s;
+                masks[s] = 0;
+            }
+            masks[s] |= 1ULL << i;
+        }
+    }
+
+    if (!receivers)
+    {
+        __atomic_add_fetch(&batchEpoch, 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    block = allocateBlock();
+    if (block)
+    {
+        memcpy(block->packets, packets, count * TS_PACKET_SIZE);
+        block->count = count;
+        block->arrivalNs = arrivalNs;
+        /* held by the packet source until every reference is queued */
+        __atomic_store_n(&block->references, 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        COUNTER_ADD(poolExhausted, 1);
+    }
+
+    /* every reference pins a block, a subscriber which stops reading keeps at most its share of the pool */
+    share = __atomic_load_n(&subscriberCount, __ATOMIC_RELAXED);
+    share = share > 1 ? TS_FANOUT_POOL_BLOCKS / share : TS_FANOUT_POOL_BLOCKS;
+    if (share > TS_FANOUT_QUEUE_BLOCKS)
+    {
+        share = TS_FANOUT_QUEUE_BLOCKS;
+    }
+
+    for (bits = receivers; bits; bits &= bits - 1)
+    {
+        receiver = &subscribers[__builtin_ctz(bits)];
+        head = receiver->queueHead;
+
+        if (!block || head - __atomic_load_n(&receiver->queueTail, __ATOMIC_ACQUIRE) >= share)
+        {
+            COUNTER_ADD(receiver->droppedPackets, __builtin_popcountll(masks[__builtin_ctz(bits)]));
+            continue;
+        }
+
+        __atomic_add_fetch(&block->references, 1, __ATOMIC_RELAXED);
+        references++;
+        receiver->queue[head % TS_FANOUT_QUEUE_BLOCKS].block = block;
+        receiver->queue[head % TS_FANOUT_QUEUE_BLOCKS].packetMask = masks[__builtin_ctz(bits)];
+        __atomic_store_n(&receiver->queueHead, head + 1, __ATOMIC_RELEASE);
+        COUNTER_ADD(receiver->packets, __builtin_popcountll(masks[__builtin_ctz(bits)]));
+
+        /* woken in batches, but a low bitrate service is not left waiting for a full batch */
+        if (receiver->wake && ((head + 1) % TS_FANOUT_WAKE_BLOCKS == 0 || arrivalNs - receiver->wakeNs >= TS_FANOUT_WAKE_NS))
+        {
+            receiver->wakeNs = arrivalNs;
+            sem_post(receiver->wake);
+        }
+    }
+
+    if (block)
+    {
+        tsFanoutRelease(block);
+        COUNTER_ADD(blocksShared, references > 0);
+    }
+    __atomic_add_fetch(&batchEpoch, 1, __ATOMIC_RELEASE);
+}
+
+/****************************************************************************
+ * @brief    Function for finding a free block, searching on from the last one taken. Blocks are
+ *           released about in the order they were taken, so the search is usually one step.
+ *
+ * @return   Free block, NULL if every block is referenced.
+****************************************************************************/
+static tsFanoutBlock *allocateBlock()
+{
+    uint32_t i;
+    tsFanoutBlock *block;
+
+    for (i = 0; i < TS_FANOUT_POOL_BLOCKS; i++)
+    {
+        block = &pool[(nextBlock + i) % TS_FANOUT_POOL_BLOCKS];
+        if (!__atomic_load_n(&block->references, __ATOMIC_ACQUIRE))
+        {
+            nextBlock = (nextBlock + i + 1) % TS_FANOUT_POOL_BLOCKS;
+            return block;
+        }
+    }
+
+    return NULL;
+}
+
+/****************************************************************************
+ * @brief    Functions for reading fan-out counters, called by the metrics server.
+ *
+ * @return   Counter value.
+****************************************************************************/
+static int64_t poolExhaustedTotal()
+{
+    return COUNTER_READ(poolExhausted);
+}
+
+static int64_t blocksSharedTotal()
+{
+    return COUNTER_READ(blocksShared);
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
@@ -0,0 +1,134 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file ts_fanout.h
+ *
+ * \brief
+ * Header of the transport stream fan-out module. Packets received from the tuner are copied
+ * once into reference counted blocks of a fixed pool, and every subscriber whose PIDs are in
+ * a block gets a reference to it with a mask of its packets, found through a PID to
+ * subscriber bitmask table. Subscribers read the packets in place on their own threads and
+ * release the block, which is reused once the last reference is released. The packet source
+ * takes no locks and never waits; blocks a subscriber has no room for are dropped for it. A
+ * subscriber holds at most its share of the pool, so a stalled one never starves the others.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _TS_FANOUT_H_
+#define _TS_FANOUT_H_
+
+#include "ts_input.h"
+
+#include <semaphore.h>
+#include <stdint.h>
+
+#define TS_FANOUT_BLOCK_PACKETS 64    // packets per block, one bit each in a reference mask
+#define TS_FANOUT_POOL_BLOCKS 1024    // 12 MiB, about 5 s of a 20 Mbit/s multiplex
+#define TS_FANOUT_MAX_SUBSCRIBERS 32  // one bit each in the PID table
+#define TS_FANOUT_MAX_PIDS 8          // PIDs of one subscriber
+#define TS_FANOUT_QUEUE_BLOCKS 1024   // references a lone subscriber can fall behind, a power of two
+#define TS_FANOUT_WAKE_BLOCKS 8       // a subscriber is woken every this many references
+#define TS_FANOUT_WAKE_NS 50000000ULL // or on a reference this long after the last wake, for low bitrates
+
+typedef enum _tsFanoutStatus
+{
+    TS_FANOUT_NO_ERROR = 0,
+    TS_FANOUT_ERROR
+} tsFanoutStatus;
+
+typedef struct _tsFanoutBlock
+{
+    uint8_t packets[TS_FANOUT_BLOCK_PACKETS * TS_PACKET_SIZE];
+    uint64_t arrivalNs;  // virtualClockNowNs time the packets were received
+    uint32_t count;
+    uint32_t references; // subscribers still reading the block, 0 for a free block
+} tsFanoutBlock;
+
+typedef struct _tsFanoutReference
+{
+    const tsFanoutBlock *block;
+    uint64_t packetMask; // bit i set if packet i of the block is on a PID of the subscriber
+} tsFanoutReference;
+
+typedef struct _tsFanoutStatistics
+{
+    uint64_t packets;        // packets referenced to the subscriber
+    uint64_t droppedPackets; // packets lost because the subscriber share or the pool was full, or not taken before unsubscribing
+} tsFanoutStatistics;
+
+/****************************************************************************
+ * @brief    Function for fan-out initialization. Registers metrics.
+ *
+ * @return   TS_FANOUT_NO_ERROR, if there are no errors.
+ *           TS_FANOUT_ERROR, in case of an error.
+****************************************************************************/
+tsFanoutStatus tsFanoutInit();
+
+/****************************************************************************
+ * @brief    Function for subscribing to the packets of a set of PIDs.
+ *
+ * @param    pids - [in] PIDs to receive.
+ *           pidCount - [in] Number of PIDs.
+ *           wake - [in] Semaphore posted every TS_FANOUT_WAKE_BLOCKS references, or on a reference
+ *                  TS_FANOUT_WAKE_NS after the last post, NULL to poll.
+ *           subscriberId - [out] Subscriber identifier.
+ *
+ * @return   TS_FANOUT_NO_ERROR, if there are no errors.
+ *           TS_FANOUT_ERROR, if TS_FANOUT_MAX_SUBSCRIBERS subscribers exist.
+****************************************************************************/
+tsFanoutStatus tsFanoutSubscribe(const uint16_t *pids, uint32_t pidCount, sem_t *wake, int32_t *subscriberId);
+
+/****************************************************************************
+ * @brief    Function for ending a subscription. Waits until the packet source can not add references
+ *           any more and releases the ones not taken, their packets are counted as dropped.
+ *
+ * @param    subscriberId - [in] Subscriber identifier.
+****************************************************************************/
+void tsFanoutUnsubscribe(int32_t subscriberId);
+
+/****************************************************************************
+ * @brief    Function for passing received packets to the subscribers, called by the transport stream
+ *           input on the packet source thread.
+ *
+ * @param    packets - [in] Consecutive 188 byte packets.
+ *           count - [in] Number of packets.
+ *           arrivalNs - [in] virtualClockNowNs time the packets were received.
+****************************************************************************/
+void tsFanoutPackets(const uint8_t *packets, uint32_t count, uint64_t arrivalNs);
+
+/****************************************************************************
+ * @brief    Function for taking the next reference of a subscriber, called by the subscriber only.
+ *           The block stays valid until it is released.
+ *
+ * @param    subscriberId - [in] Subscriber identifier.
+ *           reference - [out] Block and mask of the subscriber packets in it.
+ *
+ * @return   TS_FANOUT_NO_ERROR, if a reference was taken.
+ *           TS_FANOUT_ERROR, if there is none.
+****************************************************************************/
+tsFanoutStatus tsFanoutNext(int32_t subscriberId, tsFanoutReference *reference);
+
+/****************************************************************************
+ * @brief    Function for releasing a block taken with tsFanoutNext.
+ *
+ * @param    block - [in] Block of the reference.
+****************************************************************************/
+void tsFanoutRelease(const tsFanoutBlock *block);
+
+/****************************************************************************
+ * @brief    Function for reading the statistics of a subscriber, safe to call from any thread.
+ *
+ * @param    subscriberId - [in] Subscriber identifier.
+ *           statistics - [out] Subscriber statistics.
+****************************************************************************/
+void tsFanoutGetStatistics(int32_t subscriberId, tsFanoutStatistics *statistics);
+
+#endif // _TS_FANOUT_H_
@@ -0,0 +1,316 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file ts_input.c
+ *
+ * \brief
+ * Implementation of the transport stream input module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "ts_input.h"
+#include "pcr_analyzer.h"
+#include "ts_fanout.h"
+#include "timeshift.h"
+#include "metrics.h"
+#include "virtual_clock.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* helper keywords needed only for transport stream input module */
+#define CONTINUITY_SEEN 0x10 // set in continuity once a payload was received on the PID
+
+/* counters have a single writer, stores and loads are atomic so readers never see a torn value */
+#define COUNTER_INCREMENT(counter) __atomic_store_n(&(counter), (counter) + 1, __ATOMIC_RELAXED)
+#define COUNTER_READ(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+typedef struct _pidState
+{
+    uint64_t packets;
+    uint32_t continuityErrors;
+    uint32_t transportErrors;
+    uint32_t scrambledPackets;
+    uint32_t slot;                               // window slot of the last packet
+    uint16_t slotPackets[TS_INPUT_WINDOW_SLOTS]; // packets per slot, indexed by slot modulo the slot count
+    uint8_t continuity;                          // last continuity_counter | CONTINUITY_SEEN
+} pidState;
+
+/* helper variables needed only for transport stream input module */
+static pidState pidStates[TS_PID_COUNT];
+static uint64_t syncLosses;
+static uint64_t packetIndex; // packets received on the multiplex, PCR bitrates are measured in it
+
+/* helper functions needed only for transport stream input module */
+static void countPacket(const uint8_t *packet, uint32_t slot, uint64_t arrivalNs);
+static void advanceWindow(pidState *state, uint32_t slot);
+static uint32_t windowBitrate(pidState *state);
+static int64_t packetsTotal();
+static int64_t continuityErrorsTotal();
+static int64_t transportErrorsTotal();
+static int64_t scrambledPacketsTotal();
+static int64_t syncLossesTotal();
+
+tsInputStatus tsInputInit()
+{
+    memset(pidStates, 0, sizeof(pidStates));
+    syncLosses = 0;
+    packetIndex = 0;
+
+    metricsRegisterCallback(METRICS_TYPE_COUNTER, "tv_ts_packets_total", "Transport stream packets received", packetsTotal);
+    metricsRegisterCallback(METRICS_TYPE_COUNTER, "tv_ts_continuity_errors_total", "Continuity counter discontinuities on all PIDs", continuityErrorsTotal);
+    metricsRegisterCallback(METRICS_TYPE_COUNTER, "tv_ts_transport_errors_total", "Packets with the transport error indicator set", transportErrorsTotal);
+    metricsRegisterCallback(METRICS_TYPE_COUNTER, "tv_ts_scrambled_packets_total", "Packets with transport scrambling control set", scrambledPacketsTotal);
+    metricsRegisterCallback(METRICS_TYPE_COUNTER, "tv_ts_sync_losses_total", "Packets not starting with the sync byte", syncLossesTotal);
+
+    return TS_INPUT_NO_ERROR;
+}
+
+void tsInputPackets(const uint8_t *packets, uint32_t count, uint64_t arrivalNs)
+{
+    uint32_t slot = arrivalNs / TS_INPUT_SLOT_NS;
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        countPacket(&packets[i * TS_PACKET_SIZE], slot, arrivalNs);
+    }
+
+    tsFanoutPackets(packets, count, arrivalNs);
+}
+
+tsInputStatus tsInputPidStatistics(uint16_t pid, tsPidStatistics *statistics)
+{
+    pidState *state;
+
+    if (pid >= TS_PID_COUNT || !statistics)
+    {
+        return TS_INPUT_ERROR;
+    }
+
+    state = &pidStates[pid];
+    statistics->packets = COUNTER_READ(state->packets);
+    if (!statistics->packets)
+    {
+        return TS_INPUT_ERROR;
+    }
+
+    statistics->continuityErrors = COUNTER_READ(state->continuityErrors);
+    statistics->transportErrors = COUNTER_READ(state->transportErrors);
+    statistics->scrambledPackets = COUNTER_READ(state->scrambledPackets);
+    statistics->bitrate = windowBitrate(state);
+
+    return TS_INPUT_NO_ERROR;
+}
+
+void tsInputPrintStatistics()
+{
+    tsPidStatistics statistics;
+    uint32_t pid;
+
+    printf("\nTransport stream input: %llu sync losses\n", (unsigned long long)COUNTER_READ(syncLosses));
+    for (pid = 0; pid < TS_PID_COUNT; pid++)
+    {
+        if (tsInputPidStatistics(pid, &statistics))
+        {
+            continue;
+        }
+
+        printf("  PID 0x%04x %10llu packets %8.1f kbit/s, %u continuity errors, %u transport errors, %u scrambled\n", pid,
+               (unsigned long long)statistics.packets, statistics.bitrate / 1000.0,
+               statistics.continuityErrors, statistics.transportErrors, statistics.scrambledPackets);
+    }
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for updating the statistics of the PID of a packet.
+ *
+ * @param    packet - [in] Transport stream packet.
+ *           slot - [in] Window slot of the packet arrival time.
+ *           arrivalNs - [in] Packet arrival time.
+****************************************************************************/
+static void countPacket(const uint8_t *packet, uint32_t slot, uint64_t arrivalNs)
+{
+    uint16_t pid;
+    uint8_t adaptation;
+    uint8_t continuity;
+    uint8_t discontinuity;
+    pidState *state;
+
+    if (packet[0] != TS_SYNC_BYTE)
+    {
+        COUNTER_INCREMENT(syncLosses);
+        return;
+    }
+
+    pid = ((packet[1] & 0x1F) << 8) | packet[2];
+    state = &pidStates[pid];
+    packetIndex++;
+    timeshiftPacket(pid, packet, arrivalNs);
+
+    COUNTER_INCREMENT(state->packets);
+    advanceWindow(state, slot);
+    COUNTER_INCREMENT(state->slotPackets[slot % TS_INPUT_WINDOW_SLOTS]);
+
+    if (packet[3] & 0xC0)
+    {
+        COUNTER_INCREMENT(state->scrambledPackets);
+    }
+
+    /* the rest of an errored packet can not be trusted, its continuity counter included */
+    if (packet[1] & 0x80)
+    {
+        COUNTER_INCREMENT(state->transportErrors);
+        return;
+    }
+
+    adaptation = (packet[3] >> 4) & 0x03;
+    if ((adaptation & 0x02) && packet[4] >= 7 && (packet[5] & 0x10))
+    {
+        /* adaptation field long enough for the PCR and the PCR flag set */
+        pcrAnalyzerPacket(pid, packet, packetIndex - 1, arrivalNs);
+    }
+
+    if (pid == TS_NULL_PID || !(adaptation & 0x01))
+    {
+        /* counter only increments on packets with payload, null packets have none that matters */
+        return;
+    }
+
+    continuity = packet[3] & 0x0F;
+    discontinuity = (adaptation & 0x02) && packet[4] && (packet[5] & 0x80);
+
+    /* a packet may be sent twice with the same counter */
+    if ((state->continuity & CONTINUITY_SEEN) && !discontinuity &&
+        continuity != ((state->continuity + 1) & 0x0F) && continuity != (state->continuity & 0x0F))
+    {
+        COUNTER_INCREMENT(state->continuityErrors);
+    }
+    state->continuity = continuity | CONTINUITY_SEEN;
+}
+
+/****************************************************************************
+ * @brief    Function for moving the bitrate window of a PID to a slot, clearing the slots passed over.
+ *
+ * @param    state - [in] PID state.
+ *           slot - [in] Current window slot.
+****************************************************************************/
+static void advanceWindow(pidState *state, uint32_t slot)
+{
+    uint32_t passed = slot - state->slot;
+    uint32_t i;
+
+    if (!passed)
+    {
+        return;
+    }
+
+    if (passed > TS_INPUT_WINDOW_SLOTS)
+    {
+        passed = TS_INPUT_WINDOW_SLOTS;
+    }
+    for (i = 1; i <= passed; i++)
+    {
+        __atomic_store_n(&state->slotPackets[(state->slot + i) % TS_INPUT_WINDOW_SLOTS], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&state->slot, slot, __ATOMIC_RELEASE);
+}
+
+/****************************************************************************
+ * @brief    Function for estimating the bitrate of a PID from the complete slots of the window.
+ *           Slots the packet source has not moved past yet are ignored by their age.
+ *
+ * @param    state - [in] PID state.
+ *
+ * @return   Bitrate in bits per second.
+****************************************************************************/
+static uint32_t windowBitrate(pidState *state)
+{
+    uint32_t nowSlot = virtualClockNowNs() / TS_INPUT_SLOT_NS;
+    uint32_t lastSlot = __atomic_load_n(&state->slot, __ATOMIC_ACQUIRE);
+    uint64_t packets = 0;
+    uint32_t slot;
+
+    /* complete slots are the ones before the current, those after the last packet had none */
+    for (slot = nowSlot - (TS_INPUT_WINDOW_SLOTS - 1); slot != nowSlot; slot++)
+    {
+        if (slot <= lastSlot && lastSlot - slot < TS_INPUT_WINDOW_SLOTS)
+        {
+            packets += COUNTER_READ(state->slotPackets[slot % TS_INPUT_WINDOW_SLOTS]);
+        }
+    }
+
+    return packets * TS_PACKET_SIZE * 8 * 1000000000ULL / ((TS_INPUT_WINDOW_SLOTS - 1) * TS_INPUT_SLOT_NS);
+}
+
+/****************************************************************************
+ * @brief    Functions for summing a counter over all PIDs, called by the metrics server.
+ *
+ * @return   Counter total.
+****************************************************************************/
+static int64_t packetsTotal()
+{
+    int64_t total = 0;
+    uint32_t pid;
+
+    for (pid = 0; pid < TS_PID_COUNT; pid++)
+    {
+        total += COUNTER_READ(pidStates[pid].packets);
+    }
+
+    return total;
+}
+
+static int64_t continuityErrorsTotal()
+{
+    int64_t total = 0;
+    uint32_t pid;
+
+    for (pid = 0; pid < TS_PID_COUNT; pid++)
+    {
+        total += COUNTER_READ(pidStates[pid].continuityErrors);
+    }
+
+    return total;
+}
+
+static int64_t transportErrorsTotal()
+{
+    int64_t total = 0;
+    uint32_t pid;
+
+    for (pid = 0; pid < TS_PID_COUNT; pid++)
+    {
+        total += COUNTER_READ(pidStates[pid].transportErrors);
+    }
+
+    return total;
+}
+
+static int64_t scrambledPacketsTotal()
+{
+    int64_t total = 0;
+    uint32_t pid;
+
+    for (pid = 0; pid < TS_PID_COUNT; pid++)
+    {
+        total += COUNTER_READ(pidStates[pid].scrambledPackets);
+    }
+
+    return total;
+}
+
+static int64_t syncLossesTotal()
+{
+    return COUNTER_READ(syncLosses);
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
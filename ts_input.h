@@ -0,0 +1,86 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file ts_input.h
+ *
+ * \brief
+ * Header of the transport stream input module. Packets received from the tuner are passed
+ * to tsInputPackets by the packet source (one thread). Per PID, packets, continuity counter
+ * discontinuities, transport error indicators and scrambled packets are counted and the
+ * bitrate is estimated over a sliding window, in arrays indexed by PID without locks.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _TS_INPUT_H_
+#define _TS_INPUT_H_
+
+#include <stdint.h>
+
+#define TS_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define TS_PID_COUNT 8192
+#define TS_NULL_PID 0x1FFF
+
+#define TS_INPUT_WINDOW_SLOTS 8           // bitrate window slots, the current one is not counted
+#define TS_INPUT_SLOT_NS 125000000ULL     // 1 s window of complete slots
+
+typedef enum _tsInputStatus
+{
+    TS_INPUT_NO_ERROR = 0,
+    TS_INPUT_ERROR
+} tsInputStatus;
+
+typedef struct _tsPidStatistics
+{
+    uint64_t packets;
+    uint32_t continuityErrors;  // continuity_counter jumps without a discontinuity_indicator
+    uint32_t transportErrors;   // packets with transport_error_indicator set
+    uint32_t scrambledPackets;  // packets with transport_scrambling_control other than 00
+    uint32_t bitrate;           // bits per second over the window
+} tsPidStatistics;
+
+/****************************************************************************
+ * @brief    Function for transport stream input initialization. Clears the statistics and
+ *           registers the totals as metrics.
+ *
+ * @return   TS_INPUT_NO_ERROR, if there are no errors.
+ *           TS_INPUT_ERROR, in case of an error.
+****************************************************************************/
+tsInputStatus tsInputInit();
+
+/****************************************************************************
+ * @brief    Function for passing received packets to the input. Called by the packet source
+ *           only, from one thread.
+ *
+ * @param    packets - [in] Consecutive 188 byte packets.
+ *           count - [in] Number of packets.
+ *           arrivalNs - [in] virtualClockNowNs time the packets were received.
+****************************************************************************/
+void tsInputPackets(const uint8_t *packets, uint32_t count, uint64_t arrivalNs);
+
+/****************************************************************************
+ * @brief    Function for reading the statistics of a PID, safe to call from any thread.
+ *           Counters are read while packets keep arriving, so they are not a snapshot.
+ *
+ * @param    pid - [in] Packet identifier.
+ *           statistics - [out] Statistics of the PID.
+ *
+ * @return   TS_INPUT_NO_ERROR, if there are no errors.
+ *           TS_INPUT_ERROR, if the PID is invalid or no packet was received on it.
+****************************************************************************/
+tsInputStatus tsInputPidStatistics(uint16_t pid, tsPidStatistics *statistics);
+
+/****************************************************************************
+ * @brief    Function for printing the statistics of every PID packets were received on.
+****************************************************************************/
+void tsInputPrintStatistics();
+
+#endif // _TS_INPUT_H_
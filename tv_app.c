@@ -17,14 +17,217 @@
  ***************************************************************************************/
 
 #include "remote_controller.h"
+#include "graphics_controller.h"
+#include "timer_controller.h"
+#include "event_reactor.h"
+#include "latency_histogram.h"
+#include "trace.h"
+#include "logger.h"
+#include "metrics.h"
+#include "startup_graph.h"
+#include "ts_input.h"
+#include "ts_fanout.h"
+#include "pcr_analyzer.h"
+#include "pvr_recorder.h"
+#include "timeshift.h"
+#ifdef TDP_FILE_SOURCE
+#include "tdp_file_source.h"
+#endif
 
+#include <malloc.h>
 #include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
 
-int main(int argc, char **argv)
+#ifdef TDP_FILE_SOURCE
+/* set once the event reactor is up, a recording finishing earlier is reaped by the next one */
+static int32_t recordingNotification = -1;
+#endif
+
+/****************************************************************************
+ * @brief    Function for reading heap memory in use, called by the metrics server.
+ *
+ * @return   Allocated heap bytes.
+****************************************************************************/
+static int64_t heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    return mallinfo2().uordblks;
+#else
+    return (uint32_t)mallinfo().uordblks;
+#endif
+}
+
+/****************************************************************************
+ * @brief    Function for reading the number of dropped log records, called by the metrics server.
+ *
+ * @return   Dropped record count.
+****************************************************************************/
+static int64_t logRecordsDropped()
+{
+    return loggerDroppedCount();
+}
+
+/****************************************************************************
+ * @brief    Function for turning the timing wheel when the timerfd is readable.
+ *
+ * @param    fileDesc - [in] Timer file descriptor.
+ *           events - [in] Ready epoll events.
+ *           context - [in] Unused.
+****************************************************************************/
+static void timerEventHandler(int32_t fileDesc, uint32_t events, void *context)
+{
+    timerControllerProcess();
+}
+
+#ifdef TDP_FILE_SOURCE
+/****************************************************************************
+ * @brief    Function for waking the event loop when a stopped recording finished writing, called on
+ *           the recording writer thread.
+****************************************************************************/
+static void recordingFinished()
+{
+    eventReactorNotify(recordingNotification);
+}
+
+/****************************************************************************
+ * @brief    Function for joining finished recording writers and logging their results.
+ *
+ * @param    fileDesc - [in] Unused.
+ *           events - [in] Unused.
+ *           context - [in] Unused.
+****************************************************************************/
+static void recordingFinishedHandler(int32_t fileDesc, uint32_t events, void *context)
 {
+    pvrRecorderReap();
+}
+#endif
+
+/****************************************************************************
+ * @brief    Function for printing latency percentiles and transport stream statistics on SIGUSR1
+ *           and dumping trace on SIGUSR2.
+ *
+ * @param    fileDesc - [in] Signal file descriptor.
+ *           events - [in] Ready epoll events.
+ *           context - [in] Unused.
+****************************************************************************/
+static void reportSignalHandler(int32_t fileDesc, uint32_t events, void *context)
+{
+    struct signalfd_siginfo signalInfo;
+
+    while (read(fileDesc, &signalInfo, sizeof(signalInfo)) == sizeof(signalInfo))
+    {
+        if (signalInfo.ssi_signo == SIGUSR1)
+        {
+            latencyPrintReport();
+            tsInputPrintStatistics();
+            pcrAnalyzerPrintStatistics();
+#ifdef TDP_FILE_SOURCE
+            pvrRecorderPrintStatistics();
+#endif
+            timeshiftPrintStatistics();
+        }
+        else if (signalInfo.ssi_signo == SIGUSR2)
+        {
+            traceDump(TRACE_OUTPUT_PATH);
+        }
+    }
+}
+
+/* startup phase state, filled in by the phases on the startup workers */
+typedef struct _startupContext
+{
+    char *configPath;
     initialConfig config;
-    pthread_t remoteThreadHandle;
     pthread_t channelsSetupHandle;
+} startupContext;
+
+/****************************************************************************
+ * @brief    Startup phase parsing the initial configuration file.
+ *
+ * @param    context - [in] Startup context.
+ *
+ * @return   0, if there are no errors.
+****************************************************************************/
+static int32_t configPhase(void *context)
+{
+    startupContext *startup = (startupContext *)context;
+    return parseConfigurationFile(startup->configPath, &startup->config);
+}
+
+/****************************************************************************
+ * @brief    Startup phase opening the input devices.
+ *
+ * @param    context - [in] Unused.
+ *
+ * @return   0, if there are no errors.
+****************************************************************************/
+static int32_t inputPhase(void *context)
+{
+    return remoteControllerInit();
+}
+
+/****************************************************************************
+ * @brief    Startup phase initializing DirectFB and the OSD surfaces.
+ *
+ * @param    context - [in] Unused.
+ *
+ * @return   0, if there are no errors.
+****************************************************************************/
+static int32_t graphicsPhase(void *context)
+{
+    return graphicsControllerInit();
+}
+
+/****************************************************************************
+ * @brief    Startup phase initializing the tuner and the player, returns once the tuner is locked.
+ *
+ * @param    context - [in] Startup context.
+ *
+ * @return   0, if there are no errors.
+****************************************************************************/
+static int32_t tunerPhase(void *context)
+{
+    startupContext *startup = (startupContext *)context;
+    return streamControllerInit(&startup->config);
+}
+
+/****************************************************************************
+ * @brief    Startup phase starting the streams of the configured starting channel.
+ *
+ * @param    context - [in] Startup context.
+ *
+ * @return   0, if there are no errors.
+****************************************************************************/
+static int32_t firstPlayPhase(void *context)
+{
+    startupContext *startup = (startupContext *)context;
+    return startPlayerStream(&startup->config.startingChannel);
+}
+
+/****************************************************************************
+ * @brief    Startup phase starting the channel scan thread.
+ *
+ * @param    context - [in] Startup context.
+ *
+ * @return   0, if there are no errors.
+****************************************************************************/
+static int32_t channelScanPhase(void *context)
+{
+    startupContext *startup = (startupContext *)context;
+    return pthread_create(&startup->channelsSetupHandle, NULL, &channelsSetup, NULL);
+}
+
+int main(int argc, char **argv)
+{
+    startupContext startup;
+    int32_t configPhaseId;
+    int32_t tunerPhaseId;
+    int32_t firstPlayPhaseId;
+    startupGraphStatus startupResult;
+    sigset_t reportSignals;
+    int32_t signalFileDesc;
 
     if (argc != 2)
     {
@@ -32,29 +235,87 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    /* parse initial configuration file  */
-    ASSERT_TDP_RESULT(parseConfigurationFile(argv[1], &config), "parseConfigurationFile");
+    /* latency report and transport stream statistics (kill -USR1) and trace dump (kill -USR2) on demand,
+       blocked before any thread is started so only the loop receives them */
+    sigemptyset(&reportSignals);
+    sigaddset(&reportSignals, SIGUSR1);
+    sigaddset(&reportSignals, SIGUSR2);
+    ASSERT_TDP_RESULT(pthread_sigmask(SIG_BLOCK, &reportSignals, NULL), "report signal block");
+    signalFileDesc = signalfd(-1, &reportSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    /* asynchronous logging, SDK results are printed by the flusher thread */
+    ASSERT_TDP_RESULT(loggerInit(), "loggerInit");
+
+    /* metrics server, modules register their metrics during their initialization */
+    ASSERT_TDP_RESULT(metricsInit(METRICS_SOCKET_PATH), "metricsInit");
+    metricsRegisterCallback(METRICS_TYPE_GAUGE, "tv_heap_in_use_bytes", "Heap memory allocated by the application", heapInUse);
+    metricsRegisterCallback(METRICS_TYPE_COUNTER, "tv_log_records_dropped_total", "Log records dropped because the logger ring was full", logRecordsDropped);
+
+    /* per PID packet statistics and per program PCR analysis, before the tuner can deliver packets */
+    ASSERT_TDP_RESULT(tsInputInit(), "tsInputInit");
+    ASSERT_TDP_RESULT(pcrAnalyzerInit(), "pcrAnalyzerInit");
+
+#ifdef TDP_FILE_SOURCE
+    /* the SDK passes no tuner packets to the transport stream input, a recording would hold only its PAT and PMT;
+       recordings and their fan-out are built with the file source player, which passes every packet it plays */
+    ASSERT_TDP_RESULT(tsFanoutInit(), "tsFanoutInit");
+    ASSERT_TDP_RESULT(pvrRecorderInit(recordingFinished), "pvrRecorderInit");
+
+    /* the SDK player decodes from the tuner demux only, timeshift is built with the file source player which can be
+       fed from memory; TV plays without timeshift if its buffer can not be created */
+    if (timeshiftInit(TIMESHIFT_BUFFER_SIZE, fileSourcePlayerInput))
+    {
+        LOG_ERROR("Timeshift not available!");
+    }
+#endif
+
+    /* event reactor initialization, remote keys, timers and demux sections are all handled on the main thread */
+    ASSERT_TDP_RESULT(eventReactorInit(), "eventReactorInit");
+    ASSERT_TDP_RESULT(eventReactorAddFileDesc(signalFileDesc, EPOLLIN, "report signals", reportSignalHandler, NULL), "report signal registration");
+#ifdef TDP_FILE_SOURCE
+    ASSERT_TDP_RESULT(eventReactorAddNotification("recording finished", recordingFinishedHandler, NULL, &recordingNotification),
+                      "recording notification registration");
+#endif
 
-    /* remote controller initialization */
-    ASSERT_TDP_RESULT(remoteControllerInit(), "remoteControllerInit");
-    ASSERT_TDP_RESULT(pthread_create(&remoteThreadHandle, NULL, &remoteControllerEvent, NULL), "remote controller thread create");
+    /* timer controller initialization, OSD and channel number timeouts run on the event loop */
+    ASSERT_TDP_RESULT(timerControllerInit(TIMER_CONTROLLER_EXTERNAL_LOOP), "timerControllerInit");
+    ASSERT_TDP_RESULT(eventReactorAddFileDesc(timerControllerFileDesc(), EPOLLIN, "timers", timerEventHandler, NULL), "timer event registration");
 
-    /* graphics controller initialization */
-    ASSERT_TDP_RESULT(graphicsControllerInit(), "graphicsControllerInit");
+    /* input and graphics come up while the tuner locks, the starting channel is tuned as soon as it is locked
+       and the channel scan starts after it; the event loop runs once every phase has finished */
+    startup.configPath = argv[1];
+    startupGraphAddPhase("config", configPhase, &startup, 0, &configPhaseId);
+    startupGraphAddPhase("input", inputPhase, &startup, 0, NULL);
+    startupGraphAddPhase("graphics", graphicsPhase, &startup, 0, NULL);
+    startupGraphAddPhase("tuner lock", tunerPhase, &startup, STARTUP_GRAPH_AFTER(configPhaseId), &tunerPhaseId);
+    startupGraphAddPhase("first play", firstPlayPhase, &startup, STARTUP_GRAPH_AFTER(tunerPhaseId), &firstPlayPhaseId);
+    startupGraphAddPhase("channel scan", channelScanPhase, &startup, STARTUP_GRAPH_AFTER(firstPlayPhaseId), NULL);
 
-    /* stream controller initialization */
-    ASSERT_TDP_RESULT(streamControllerInit(&config), "streamControllerInit");
-    ASSERT_TDP_RESULT(startPlayerStream(&config.startingChannel), "startPlayerStream");
+    startupResult = startupGraphRun(STARTUP_GRAPH_WORKERS);
+    startupGraphPrintReport();
+    ASSERT_TDP_RESULT(startupResult, "startupGraphRun");
 
-    /* channel configuration thread initialization */
-    ASSERT_TDP_RESULT(pthread_create(&channelsSetupHandle, NULL, &channelsSetup, NULL), "channel setup thread create");
+    /* run the event loop until exit key press */
+    ASSERT_TDP_RESULT(eventReactorRun(), "eventReactorRun");
+    eventReactorPrintStatistics();
+    latencyPrintReport();
+    traceDump(TRACE_OUTPUT_PATH);
 
-    /* wait for exit key press */
-    ASSERT_TDP_RESULT(pthread_join(remoteThreadHandle, NULL), "remote controller thread handle join");
+#ifdef TDP_FILE_SOURCE
+    /* running recordings are completed while the tuner still delivers packets */
+    pvrRecorderStopAll();
+#endif
 
     /* deinitialization and deallocation */
     ASSERT_TDP_RESULT(streamControllerDeinit(), "streamControllerDeinit");
+    timeshiftDeinit();
+    ASSERT_TDP_RESULT(remoteControllerDeinit(), "remoteControllerDeinit");
+    ASSERT_TDP_RESULT(timerControllerDeinit(), "timerControllerDeinit");
     ASSERT_TDP_RESULT(graphicsControllerDeinit(), "graphicsControllerDeinit");
+    ASSERT_TDP_RESULT(eventReactorDeinit(), "eventReactorDeinit");
+    close(signalFileDesc);
+    metricsDeinit();
+    loggerDeinit();
 
     return 0;
 }
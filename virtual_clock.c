@@ -0,0 +1,178 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file virtual_clock.c
+ *
+ * \brief
+ * Implementation of the clock module.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "virtual_clock.h"
+
+#include <errno.h>
+#include <time.h>
+
+/* helper keywords needed only for clock module */
+#define SIMULATED_WAIT_SLICE_NS 1000000 // real time between checks of a simulated deadline
+
+/* helper variables needed only for clock module */
+static virtualClockMode clockMode = VIRTUAL_CLOCK_REAL;
+static uint64_t simulatedNow = VIRTUAL_CLOCK_SIMULATED_START_NS;
+static virtualClockListener listeners[VIRTUAL_CLOCK_MAX_LISTENERS];
+static pthread_mutex_t listenerMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* helper functions needed only for clock module */
+static uint64_t readClock(clockid_t clockId);
+static void toTimespec(uint64_t timeNs, struct timespec *time);
+
+virtualClockStatus virtualClockInit(virtualClockMode mode)
+{
+    if (mode != VIRTUAL_CLOCK_REAL && mode != VIRTUAL_CLOCK_SIMULATED)
+    {
+        return VIRTUAL_CLOCK_ERROR;
+    }
+
+    __atomic_store_n(&simulatedNow, VIRTUAL_CLOCK_SIMULATED_START_NS, __ATOMIC_RELAXED);
+    clockMode = mode;
+
+    return VIRTUAL_CLOCK_NO_ERROR;
+}
+
+uint8_t virtualClockIsSimulated()
+{
+    return clockMode == VIRTUAL_CLOCK_SIMULATED;
+}
+
+uint64_t virtualClockNowNs()
+{
+    if (clockMode == VIRTUAL_CLOCK_SIMULATED)
+    {
+        return __atomic_load_n(&simulatedNow, __ATOMIC_ACQUIRE);
+    }
+
+    return readClock(CLOCK_MONOTONIC);
+}
+
+virtualClockStatus virtualClockAdvance(uint64_t deltaNs)
+{
+    uint32_t i;
+
+    if (clockMode != VIRTUAL_CLOCK_SIMULATED)
+    {
+        return VIRTUAL_CLOCK_ERROR;
+    }
+
+    __atomic_add_fetch(&simulatedNow, deltaNs, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&listenerMutex);
+    for (i = 0; i < VIRTUAL_CLOCK_MAX_LISTENERS && listeners[i]; i++)
+    {
+        listeners[i]();
+    }
+    pthread_mutex_unlock(&listenerMutex);
+
+    return VIRTUAL_CLOCK_NO_ERROR;
+}
+
+virtualClockStatus virtualClockAddListener(virtualClockListener listener)
+{
+    uint32_t i;
+
+    pthread_mutex_lock(&listenerMutex);
+    for (i = 0; i < VIRTUAL_CLOCK_MAX_LISTENERS; i++)
+    {
+        if (listeners[i] == listener || !listeners[i])
+        {
+            listeners[i] = listener;
+            pthread_mutex_unlock(&listenerMutex);
+            return VIRTUAL_CLOCK_NO_ERROR;
+        }
+    }
+    pthread_mutex_unlock(&listenerMutex);
+
+    return VIRTUAL_CLOCK_ERROR;
+}
+
+virtualClockStatus virtualClockConditionInit(pthread_cond_t *condition)
+{
+    pthread_condattr_t attributes;
+    int32_t result;
+
+    if (pthread_condattr_init(&attributes))
+    {
+        return VIRTUAL_CLOCK_ERROR;
+    }
+
+    result = pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC) || pthread_cond_init(condition, &attributes);
+    pthread_condattr_destroy(&attributes);
+
+    return result ? VIRTUAL_CLOCK_ERROR : VIRTUAL_CLOCK_NO_ERROR;
+}
+
+int32_t virtualClockTimedWait(pthread_cond_t *condition, pthread_mutex_t *mutex, uint64_t deadlineNs)
+{
+    struct timespec deadline;
+
+    if (virtualClockNowNs() >= deadlineNs)
+    {
+        return ETIMEDOUT;
+    }
+
+    /* conditions measure their timeout on CLOCK_MONOTONIC, wall clock steps do not move the deadline */
+    if (clockMode == VIRTUAL_CLOCK_REAL)
+    {
+        toTimespec(deadlineNs, &deadline);
+        return pthread_cond_timedwait(condition, mutex, &deadline) == ETIMEDOUT ? ETIMEDOUT : 0;
+    }
+
+    /* simulated deadlines can only pass when the harness advances the clock, checked in short real slices */
+    for (;;)
+    {
+        toTimespec(readClock(CLOCK_MONOTONIC) + SIMULATED_WAIT_SLICE_NS, &deadline);
+        if (pthread_cond_timedwait(condition, mutex, &deadline) != ETIMEDOUT)
+        {
+            return 0;
+        }
+        if (virtualClockNowNs() >= deadlineNs)
+        {
+            return ETIMEDOUT;
+        }
+    }
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for reading a system clock in nanoseconds.
+ *
+ * @param    clockId - [in] Clock to read.
+ *
+ * @return   Current time.
+****************************************************************************/
+static uint64_t readClock(clockid_t clockId)
+{
+    struct timespec now;
+    clock_gettime(clockId, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/****************************************************************************
+ * @brief    Function for converting nanoseconds to timespec.
+ *
+ * @param    timeNs - [in] Time in nanoseconds.
+ *           time - [out] Converted time.
+****************************************************************************/
+static void toTimespec(uint64_t timeNs, struct timespec *time)
+{
+    time->tv_sec = timeNs / 1000000000ULL;
+    time->tv_nsec = timeNs % 1000000000ULL;
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */
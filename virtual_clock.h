@@ -0,0 +1,114 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file virtual_clock.h
+ *
+ * \brief
+ * Header of the clock module. Timeouts of the stream, timer and graphics modules are measured
+ * on this clock, which follows CLOCK_MONOTONIC or, in simulated mode, only moves when the test
+ * harness advances it, so scans, zaps and OSD timeouts run deterministically and faster than
+ * real time.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#ifndef _VIRTUAL_CLOCK_H_
+#define _VIRTUAL_CLOCK_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define VIRTUAL_CLOCK_MAX_LISTENERS 4
+#define VIRTUAL_CLOCK_SIMULATED_START_NS 1000000000ULL // simulated time starts at 1 s, 0 is used as "not set" by callers
+
+typedef enum _virtualClockStatus
+{
+    VIRTUAL_CLOCK_NO_ERROR = 0,
+    VIRTUAL_CLOCK_ERROR
+} virtualClockStatus;
+
+typedef enum _virtualClockMode
+{
+    VIRTUAL_CLOCK_REAL = 0,
+    VIRTUAL_CLOCK_SIMULATED
+} virtualClockMode;
+
+/* called from the thread advancing simulated time, after the time has moved */
+typedef void (*virtualClockListener)();
+
+/****************************************************************************
+ * @brief    Function for selecting the clock mode. Must be called before the timer
+ *           controller is initialized, the real clock is used if it is never called.
+ *
+ * @param    mode - [in] VIRTUAL_CLOCK_REAL or VIRTUAL_CLOCK_SIMULATED.
+ *
+ * @return   VIRTUAL_CLOCK_NO_ERROR, if there are no errors.
+ *           VIRTUAL_CLOCK_ERROR, in case of an error.
+****************************************************************************/
+virtualClockStatus virtualClockInit(virtualClockMode mode);
+
+/****************************************************************************
+ * @brief    Function for checking whether simulated time is used.
+ *
+ * @return   1 in simulated mode, 0 otherwise.
+****************************************************************************/
+uint8_t virtualClockIsSimulated();
+
+/****************************************************************************
+ * @brief    Function for reading the clock.
+ *
+ * @return   Current time in nanoseconds.
+****************************************************************************/
+uint64_t virtualClockNowNs();
+
+/****************************************************************************
+ * @brief    Function for moving simulated time forward, wakes timed waits and calls listeners.
+ *
+ * @param    deltaNs - [in] Time to advance in nanoseconds.
+ *
+ * @return   VIRTUAL_CLOCK_NO_ERROR, if there are no errors.
+ *           VIRTUAL_CLOCK_ERROR, if the clock is not simulated.
+****************************************************************************/
+virtualClockStatus virtualClockAdvance(uint64_t deltaNs);
+
+/****************************************************************************
+ * @brief    Function for registering a function called every time simulated time advances.
+ *
+ * @param    listener - [in] Listener, registering the same one again has no effect.
+ *
+ * @return   VIRTUAL_CLOCK_NO_ERROR, if there are no errors.
+ *           VIRTUAL_CLOCK_ERROR, if there is no free listener slot.
+****************************************************************************/
+virtualClockStatus virtualClockAddListener(virtualClockListener listener);
+
+/****************************************************************************
+ * @brief    Function for initializing a condition waited on with virtualClockTimedWait, its
+ *           timeouts are measured on CLOCK_MONOTONIC.
+ *
+ * @param    condition - [out] Condition to initialize.
+ *
+ * @return   VIRTUAL_CLOCK_NO_ERROR, if there are no errors.
+ *           VIRTUAL_CLOCK_ERROR, if the condition can not be initialized.
+****************************************************************************/
+virtualClockStatus virtualClockConditionInit(pthread_cond_t *condition);
+
+/****************************************************************************
+ * @brief    Function for waiting on a condition until a deadline on this clock.
+ *           The condition must be initialized with virtualClockConditionInit.
+ *
+ * @param    condition - [in] Condition to wait on.
+ *           mutex - [in] Mutex locked by the caller.
+ *           deadlineNs - [in] Deadline as returned by virtualClockNowNs plus the timeout.
+ *
+ * @return   0 when signalled (or woken spuriously), ETIMEDOUT when the deadline has passed.
+****************************************************************************/
+int32_t virtualClockTimedWait(pthread_cond_t *condition, pthread_mutex_t *mutex, uint64_t deadlineNs);
+
+#endif // _VIRTUAL_CLOCK_H_
@@ -0,0 +1,510 @@
+/***************************************************************************************
+ * Faculty of Electrical Engineering, Computer Science and Information Technology Osijek
+ *
+ * -----------------------------------------------------
+ * Project assignment from the course: DIGITAL IMAGE PROCESSING DAKR4I-01
+ * -----------------------------------------------------
+ * Assignment title: TV application (code: PPUTVIOS_20_2018_OS)
+ * -----------------------------------------------------
+ * \file zap_benchmark.c
+ *
+ * \brief
+ * Scripted zap benchmark. Starts the application built against the file-backed tdp_api
+ * stand-in, drives it with remote keys written to a uinput device and measures, from the
+ * moment each key is written, the time until the new streams are created and until the OSD
+ * is flipped. Both times are read from the timestamp gauges of the metrics socket.
+ * Percentiles of every action are printed after all cycles and the exit status is 1
+ * if the zap p99 is above the given limit or the application stopped responding.
+ *
+ * Last updated on 4 June 2018
+ *
+ * @Author Luka Umiljanović
+ ***************************************************************************************/
+
+#include "metrics.h"
+
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* helper keywords needed only for zap benchmark module */
+#define DEFAULT_CYCLES 100
+#define DEFAULT_P99_LIMIT_MS 1000
+
+#define REMOTE_KEY_1 2
+#define REMOTE_KEY_0 11
+#define REMOTE_KEY_PROGRAM_UP 62
+#define REMOTE_KEY_PROGRAM_DOWN 61
+#define REMOTE_KEY_INFO 358
+#define REMOTE_KEY_MENU 369
+#define REMOTE_KEY_EXIT 102
+
+#define STARTUP_TIMEOUT_MS 30000
+#define ACTION_TIMEOUT_MS 10000  // numeric entry alone takes 3 s
+#define POLL_INTERVAL_US 1000
+#define SCRAPE_BUFFER_SIZE 65536
+
+#define ZAP_TIME_METRIC "tv_last_zap_monotonic_nanoseconds"
+#define FLIP_TIME_METRIC "tv_last_flip_monotonic_nanoseconds"
+#define CHANNELS_METRIC "tv_channels"
+
+typedef enum _actionType
+{
+    ACTION_PROGRAM_UP = 0,
+    ACTION_PROGRAM_DOWN,
+    ACTION_NUMERIC,
+    ACTION_INFO,
+    ACTION_MENU,
+    ACTION_TYPE_COUNT
+} actionType;
+
+typedef struct _sampleSet
+{
+    uint64_t *values;
+    uint32_t count;
+    uint32_t capacity;
+} sampleSet;
+
+/* helper variables needed only for zap benchmark module */
+static const char *actionNames[ACTION_TYPE_COUNT] = {"program up", "program down", "numeric", "info", "menu"};
+static const uint16_t remoteKeys[] = {REMOTE_KEY_1, REMOTE_KEY_1 + 1, REMOTE_KEY_1 + 2, REMOTE_KEY_1 + 3, REMOTE_KEY_1 + 4,
+                                      REMOTE_KEY_1 + 5, REMOTE_KEY_1 + 6, REMOTE_KEY_1 + 7, REMOTE_KEY_1 + 8, REMOTE_KEY_0,
+                                      REMOTE_KEY_PROGRAM_UP, REMOTE_KEY_PROGRAM_DOWN, REMOTE_KEY_INFO, REMOTE_KEY_MENU, REMOTE_KEY_EXIT};
+static sampleSet zapSamples[ACTION_TYPE_COUNT];
+static sampleSet flipSamples[ACTION_TYPE_COUNT];
+static uint32_t timeouts;
+static int32_t uinputFileDesc = -1;
+
+/* helper functions needed only for zap benchmark module */
+static int32_t createRemote();
+static void pressKey(uint16_t code);
+static uint64_t nowNs();
+static int32_t readMetrics(uint64_t *zapTime, uint64_t *flipTime, uint64_t *channelCount);
+static int32_t waitForStartup(pid_t application, uint64_t *channelCount);
+static int32_t runAction(actionType action, const uint16_t *keys, uint32_t keyCount, uint8_t waitForZap);
+static void addSample(sampleSet *set, uint64_t value);
+static void printSamples(const char *what, actionType action, sampleSet *set);
+static int compareSamples(const void *first, const void *second);
+static uint64_t percentile(const sampleSet *set, uint32_t percent);
+
+int main(int argc, char **argv)
+{
+    uint32_t cycles = DEFAULT_CYCLES;
+    uint32_t p99LimitMs = DEFAULT_P99_LIMIT_MS;
+    uint64_t channelCount;
+    uint32_t cycle;
+    uint32_t i;
+    uint16_t keys[3];
+    pid_t application;
+    int status;
+    int32_t failed = 0;
+
+    if (argc < 4)
+    {
+        printf("Usage: %s <application> <config.xml> <multiplex.ts> [cycles] [zap p99 limit ms]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 4)
+        cycles = atoi(argv[4]);
+    if (argc > 5)
+        p99LimitMs = atoi(argv[5]);
+
+    /* the remote exists before the application starts, so it is found by the first device scan */
+    if (createRemote())
+    {
+        return 1;
+    }
+
+    application = fork();
+    if (application == -1)
+    {
+        printf("Error while starting %s!\n", argv[1]);
+        return 1;
+    }
+    if (!application)
+    {
+        setenv("TDP_FILE_SOURCE", argv[3], 1);
+        execl(argv[1], argv[1], argv[2], (char *)NULL);
+        printf("Error while executing %s!\n", argv[1]);
+        _exit(127);
+    }
+
+    if (waitForStartup(application, &channelCount))
+    {
+        kill(application, SIGTERM);
+        waitpid(application, NULL, 0);
+        return 1;
+    }
+    printf("%llu channels found, running %u cycles\n", (unsigned long long)channelCount, cycles);
+
+    for (cycle = 0; cycle < cycles && !failed; cycle++)
+    {
+        /* around the channel list in both directions, every step is tuned before the next key */
+        for (i = 0; i < channelCount && channelCount > 1 && !failed; i++)
+        {
+            keys[0] = REMOTE_KEY_PROGRAM_UP;
+            failed = runAction(ACTION_PROGRAM_UP, keys, 1, 1);
+        }
+        for (i = 0; i < channelCount && channelCount > 1 && !failed; i++)
+        {
+            keys[0] = REMOTE_KEY_PROGRAM_DOWN;
+            failed = runAction(ACTION_PROGRAM_DOWN, keys, 1, 1);
+        }
+
+        /* one numeric entry per cycle, it waits for the entry timeout */
+        if (!failed)
+        {
+            uint32_t channel = cycle % channelCount + 1;
+            uint32_t digits = 0;
+
+            if (channel >= 100)
+                keys[digits++] = remoteKeys[(channel / 100 + 9) % 10];
+            if (channel >= 10)
+                keys[digits++] = remoteKeys[(channel / 10 % 10 + 9) % 10];
+            keys[digits++] = remoteKeys[(channel % 10 + 9) % 10];
+            failed = runAction(ACTION_NUMERIC, keys, digits, 1);
+        }
+
+        if (!failed)
+        {
+            keys[0] = REMOTE_KEY_INFO;
+            failed = runAction(ACTION_INFO, keys, 1, 0);
+        }
+
+        /* menu on and off */
+        for (i = 0; i < 2 && !failed; i++)
+        {
+            keys[0] = REMOTE_KEY_MENU;
+            failed = runAction(ACTION_MENU, keys, 1, 0);
+        }
+    }
+
+    pressKey(REMOTE_KEY_EXIT);
+    waitpid(application, &status, 0);
+    ioctl(uinputFileDesc, UI_DEV_DESTROY);
+    close(uinputFileDesc);
+
+    printf("\n%-14s %-8s %8s %10s %10s %10s %10s\n", "action", "until", "count", "p50 [ms]", "p95 [ms]", "p99 [ms]", "max [ms]");
+    for (i = 0; i < ACTION_TYPE_COUNT; i++)
+    {
+        printSamples("zap", i, &zapSamples[i]);
+        printSamples("flip", i, &flipSamples[i]);
+    }
+
+    if (failed)
+    {
+        printf("\nFAIL: the application did not respond within %d ms (%u timeouts)\n", ACTION_TIMEOUT_MS, timeouts);
+        return 1;
+    }
+    for (i = 0; i < ACTION_TYPE_COUNT; i++)
+    {
+        if (zapSamples[i].count && percentile(&zapSamples[i], 99) > p99LimitMs * 1000000ULL)
+        {
+            printf("\nFAIL: %s zap p99 is above %u ms\n", actionNames[i], p99LimitMs);
+            failed = 1;
+        }
+    }
+
+    return failed;
+}
+
+/* -------------------- HELPER FUNCTIONS -------------------- */
+/****************************************************************************
+ * @brief    Function for creating the uinput device sending the remote key codes.
+ *
+ * @return   0 if the device is created, -1 otherwise.
+****************************************************************************/
+static int32_t createRemote()
+{
+    struct uinput_user_dev device;
+    uint32_t i;
+
+    uinputFileDesc = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (uinputFileDesc == -1)
+    {
+        printf("Error while opening /dev/uinput, the uinput module and write access are needed!\n");
+        return -1;
+    }
+
+    ioctl(uinputFileDesc, UI_SET_EVBIT, EV_KEY);
+    ioctl(uinputFileDesc, UI_SET_EVBIT, EV_SYN);
+    for (i = 0; i < sizeof(remoteKeys) / sizeof(remoteKeys[0]); i++)
+    {
+        ioctl(uinputFileDesc, UI_SET_KEYBIT, remoteKeys[i]);
+    }
+
+    memset(&device, 0, sizeof(device));
+    snprintf(device.name, UINPUT_MAX_NAME_SIZE, "zap benchmark remote");
+    device.id.bustype = BUS_VIRTUAL;
+    device.id.vendor = 0x1;
+    device.id.product = 0x1;
+
+    if (write(uinputFileDesc, &device, sizeof(device)) != sizeof(device) || ioctl(uinputFileDesc, UI_DEV_CREATE))
+    {
+        printf("Error while creating the uinput remote!\n");
+        close(uinputFileDesc);
+        return -1;
+    }
+
+    return 0;
+}
+
+/****************************************************************************
+ * @brief    Function for sending one key press and release.
+ *
+ * @param    code - [in] Remote key code.
+****************************************************************************/
+static void pressKey(uint16_t code)
+{
+    struct input_event events[4];
+
+    memset(events, 0, sizeof(events));
+    events[0].type = EV_KEY;
+    events[0].code = code;
+    events[0].value = 1;
+    events[1].type = EV_SYN;
+    events[1].code = SYN_REPORT;
+    events[2].type = EV_KEY;
+    events[2].code = code;
+    events[2].value = 0;
+    events[3].type = EV_SYN;
+    events[3].code = SYN_REPORT;
+
+    if (write(uinputFileDesc, events, sizeof(events)) != sizeof(events))
+    {
+        printf("Error while writing key %u!\n", code);
+    }
+}
+
+/****************************************************************************
+ * @brief    Function for reading CLOCK_MONOTONIC, the clock the application timestamps are taken on.
+ *
+ * @return   Current time in nanoseconds.
+****************************************************************************/
+static uint64_t nowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/****************************************************************************
+ * @brief    Function for scraping the metrics socket.
+ *
+ * @param    zapTime - [out] Time the last stream start completed.
+ *           flipTime - [out] Time the last OSD flip completed.
+ *           channelCount - [out] Number of channels found by the scan.
+ *
+ * @return   0 if the metrics were read, -1 if the socket is not served (yet).
+****************************************************************************/
+static int32_t readMetrics(uint64_t *zapTime, uint64_t *flipTime, uint64_t *channelCount)
+{
+    static char buffer[SCRAPE_BUFFER_SIZE];
+    static const char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    struct sockaddr_un address;
+    size_t length = 0;
+    ssize_t received;
+    char *line;
+    int socketFileDesc;
+
+    socketFileDesc = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socketFileDesc == -1)
+    {
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, METRICS_SOCKET_PATH, sizeof(address.sun_path) - 1);
+    if (connect(socketFileDesc, (struct sockaddr *)&address, sizeof(address)) ||
+        write(socketFileDesc, request, sizeof(request) - 1) != sizeof(request) - 1)
+    {
+        close(socketFileDesc);
+        return -1;
+    }
+
+    while (length < sizeof(buffer) - 1 && (received = read(socketFileDesc, &buffer[length], sizeof(buffer) - 1 - length)) > 0)
+    {
+        length += received;
+    }
+    buffer[length] = '\0';
+    close(socketFileDesc);
+
+    *zapTime = *flipTime = *channelCount = 0;
+    for (line = strtok(buffer, "\n"); line; line = strtok(NULL, "\n"))
+    {
+        if (!strncmp(line, ZAP_TIME_METRIC " ", sizeof(ZAP_TIME_METRIC)))
+            *zapTime = strtoull(line + sizeof(ZAP_TIME_METRIC), NULL, 10);
+        else if (!strncmp(line, FLIP_TIME_METRIC " ", sizeof(FLIP_TIME_METRIC)))
+            *flipTime = strtoull(line + sizeof(FLIP_TIME_METRIC), NULL, 10);
+        else if (!strncmp(line, CHANNELS_METRIC " ", sizeof(CHANNELS_METRIC)))
+            *channelCount = strtoull(line + sizeof(CHANNELS_METRIC), NULL, 10);
+    }
+
+    return 0;
+}
+
+/****************************************************************************
+ * @brief    Function for waiting until the application has scanned the channels.
+ *
+ * @param    application - [in] Application process.
+ *           channelCount - [out] Number of channels found.
+ *
+ * @return   0 when the channels are known, -1 if the application exited or timed out.
+****************************************************************************/
+static int32_t waitForStartup(pid_t application, uint64_t *channelCount)
+{
+    uint64_t deadline = nowNs() + STARTUP_TIMEOUT_MS * 1000000ULL;
+    uint64_t zapTime;
+    uint64_t flipTime;
+
+    while (nowNs() < deadline)
+    {
+        if (waitpid(application, NULL, WNOHANG) == application)
+        {
+            printf("The application exited during startup!\n");
+            return -1;
+        }
+        if (!readMetrics(&zapTime, &flipTime, channelCount) && *channelCount)
+        {
+            return 0;
+        }
+        usleep(10 * POLL_INTERVAL_US);
+    }
+
+    printf("No channels were found within %d ms!\n", STARTUP_TIMEOUT_MS);
+    return -1;
+}
+
+/****************************************************************************
+ * @brief    Function for sending the keys of one action and measuring it. The time is taken
+ *           before the first key is written, the first flip and (if waited for) the stream start
+ *           completed after it end the measurement.
+ *
+ * @param    action - [in] Measured action.
+ *           keys - [in] Keys to send.
+ *           keyCount - [in] Number of keys.
+ *           waitForZap - [in] 1 if the action tunes a channel.
+ *
+ * @return   0 if the action completed, -1 on timeout.
+****************************************************************************/
+static int32_t runAction(actionType action, const uint16_t *keys, uint32_t keyCount, uint8_t waitForZap)
+{
+    uint64_t start;
+    uint64_t deadline;
+    uint64_t zapTime = 0;
+    uint64_t flipTime = 0;
+    uint64_t firstFlip = 0;
+    uint64_t channelCount;
+    uint32_t i;
+
+    start = nowNs();
+    for (i = 0; i < keyCount; i++)
+    {
+        pressKey(keys[i]);
+    }
+
+    deadline = start + ACTION_TIMEOUT_MS * 1000000ULL;
+    while (nowNs() < deadline)
+    {
+        usleep(POLL_INTERVAL_US);
+        if (readMetrics(&zapTime, &flipTime, &channelCount))
+        {
+            continue;
+        }
+
+        if (!firstFlip && flipTime > start)
+        {
+            firstFlip = flipTime;
+        }
+        if (firstFlip && (!waitForZap || zapTime > start))
+        {
+            addSample(&flipSamples[action], firstFlip - start);
+            if (waitForZap)
+            {
+                addSample(&zapSamples[action], zapTime - start);
+            }
+            return 0;
+        }
+    }
+
+    timeouts++;
+    return -1;
+}
+
+/****************************************************************************
+ * @brief    Function for storing one measurement.
+ *
+ * @param    set - [in] Sample set.
+ *           value - [in] Measured time in nanoseconds.
+****************************************************************************/
+static void addSample(sampleSet *set, uint64_t value)
+{
+    if (set->count == set->capacity)
+    {
+        uint32_t capacity = set->capacity ? 2 * set->capacity : 256;
+        uint64_t *values = realloc(set->values, capacity * sizeof(uint64_t));
+
+        if (!values)
+        {
+            return;
+        }
+        set->values = values;
+        set->capacity = capacity;
+    }
+
+    set->values[set->count++] = value;
+}
+
+/****************************************************************************
+ * @brief    Function for printing the percentiles of one action.
+ *
+ * @param    what - [in] End of the measurement, zap or flip.
+ *           action - [in] Measured action.
+ *           set - [in] Sample set, sorted in place.
+****************************************************************************/
+static void printSamples(const char *what, actionType action, sampleSet *set)
+{
+    if (!set->count)
+    {
+        return;
+    }
+
+    qsort(set->values, set->count, sizeof(uint64_t), compareSamples);
+    printf("%-14s %-8s %8u %10.2f %10.2f %10.2f %10.2f\n", actionNames[action], what, set->count,
+           percentile(set, 50) / 1e6, percentile(set, 95) / 1e6, percentile(set, 99) / 1e6,
+           set->values[set->count - 1] / 1e6);
+}
+
+static int compareSamples(const void *first, const void *second)
+{
+    uint64_t a = *(const uint64_t *)first;
+    uint64_t b = *(const uint64_t *)second;
+
+    return (a > b) - (a < b);
+}
+
+/****************************************************************************
+ * @brief    Function for reading a percentile of a sorted sample set (nearest rank).
+ *
+ * @param    set - [in] Sorted sample set, not empty.
+ *           percent - [in] Percentile.
+ *
+ * @return   Sample at the percentile.
+****************************************************************************/
+static uint64_t percentile(const sampleSet *set, uint32_t percent)
+{
+    uint32_t rank = (set->count * percent + 99) / 100;
+
+    return set->values[rank ? rank - 1 : 0];
+}
+/* -------------------- HELPER FUNCTIONS -------------------- */